@@ -0,0 +1,110 @@
+#include <benchmark/benchmark.h>
+
+#include <equistore.hpp>
+using namespace equistore;
+
+// Create the values for `n_entries` labels entries, looking like samples in a
+// block (structure, center, neighbor), starting at structure `first`. Each
+// structure contains 10 centers with 10 neighbors each.
+static std::vector<int32_t> labels_values(size_t n_entries, int32_t first = 0) {
+    auto values = std::vector<int32_t>();
+    values.reserve(3 * n_entries);
+    for (size_t i=0; i<n_entries; i++) {
+        values.push_back(first + static_cast<int32_t>(i / 100));
+        values.push_back(static_cast<int32_t>((i / 10) % 10));
+        values.push_back(static_cast<int32_t>(i % 10));
+    }
+    return values;
+}
+
+static Labels create_labels(const std::vector<int32_t>& values) {
+    auto names = std::vector<std::string>{"structure", "center", "neighbor"};
+    return details::labels_from_cxx(names, NDArray<int32_t>(values.data(), {values.size() / 3, 3}));
+}
+
+static void labels_create(benchmark::State& state) {
+    auto n_entries = static_cast<size_t>(state.range(0));
+    auto values = labels_values(n_entries);
+
+    for (auto _: state) {
+        auto labels = create_labels(values);
+        benchmark::DoNotOptimize(labels.count());
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+static void labels_position(benchmark::State& state) {
+    auto n_entries = static_cast<size_t>(state.range(0));
+    auto values = labels_values(n_entries);
+    auto labels = create_labels(values);
+
+    for (auto _: state) {
+        for (size_t i=0; i<n_entries; i++) {
+            benchmark::DoNotOptimize(labels.position(values.data() + 3 * i, 3));
+        }
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+static void labels_positions_batched(benchmark::State& state) {
+    auto n_entries = static_cast<size_t>(state.range(0));
+    auto values = labels_values(n_entries);
+    auto labels = create_labels(values);
+
+    auto positions = std::vector<int64_t>(n_entries);
+    for (auto _: state) {
+        labels.positions(values.data(), n_entries, positions.data());
+        benchmark::DoNotOptimize(positions.data());
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// two sets of labels, with half of the entries in common
+struct SetOperationsFixture {
+    SetOperationsFixture(size_t n_entries):
+        first_values(labels_values(n_entries)),
+        second_values(labels_values(n_entries, static_cast<int32_t>(n_entries / 200))),
+        first(create_labels(first_values)),
+        second(create_labels(second_values))
+    {}
+
+    std::vector<int32_t> first_values;
+    std::vector<int32_t> second_values;
+    Labels first;
+    Labels second;
+};
+
+static void labels_union(benchmark::State& state) {
+    auto n_entries = static_cast<size_t>(state.range(0));
+    auto fixture = SetOperationsFixture(n_entries);
+
+    for (auto _: state) {
+        auto result = fixture.first.set_union(fixture.second);
+        benchmark::DoNotOptimize(result.count());
+    }
+
+    state.SetItemsProcessed(2 * state.iterations() * state.range(0));
+}
+
+static void labels_intersection(benchmark::State& state) {
+    auto n_entries = static_cast<size_t>(state.range(0));
+    auto fixture = SetOperationsFixture(n_entries);
+
+    for (auto _: state) {
+        auto result = fixture.first.set_intersection(fixture.second);
+        benchmark::DoNotOptimize(result.count());
+    }
+
+    state.SetItemsProcessed(2 * state.iterations() * state.range(0));
+}
+
+#define LABELS_ARGS RangeMultiplier(10)->Range(1000, 1000000)
+
+BENCHMARK(labels_create)->LABELS_ARGS;
+BENCHMARK(labels_position)->LABELS_ARGS;
+BENCHMARK(labels_positions_batched)->LABELS_ARGS;
+BENCHMARK(labels_union)->LABELS_ARGS;
+BENCHMARK(labels_intersection)->LABELS_ARGS;
@@ -0,0 +1,81 @@
+#include <benchmark/benchmark.h>
+
+#include <equistore.hpp>
+using namespace equistore;
+
+// input and output arrays shaped like a spherical expansion block, with
+// `n_samples` samples, 7 components and `n_properties` properties. The input
+// is moved to the properties `[property_start, property_start + n_properties)`
+// of the output, which contains `output_properties` properties.
+struct MoveSamplesFixture {
+    MoveSamplesFixture(
+        size_t n_samples,
+        size_t n_properties,
+        size_t output_properties,
+        bool contiguous
+    ):
+        input({n_samples, 7, n_properties}, 1.0),
+        output({n_samples, 7, output_properties})
+    {
+        samples.reserve(n_samples);
+        for (size_t i=0; i<n_samples; i++) {
+            if (contiguous) {
+                samples.push_back({i, i});
+            } else {
+                // reverse order, to prevent coalescing consecutive samples
+                samples.push_back({i, n_samples - i - 1});
+            }
+        }
+    }
+
+    SimpleDataArray input;
+    SimpleDataArray output;
+    std::vector<eqs_sample_mapping_t> samples;
+};
+
+static void move_samples(benchmark::State& state, bool contiguous, size_t output_factor) {
+    auto n_samples = static_cast<size_t>(state.range(0));
+    auto n_properties = static_cast<size_t>(state.range(1));
+    auto output_properties = output_factor * n_properties;
+
+    auto fixture = MoveSamplesFixture(n_samples, n_properties, output_properties, contiguous);
+    // move to the last property range of the output
+    auto property_start = output_properties - n_properties;
+
+    for (auto _: state) {
+        fixture.output.move_samples_from(
+            fixture.input,
+            fixture.samples,
+            property_start,
+            property_start + n_properties
+        );
+        benchmark::DoNotOptimize(fixture.output.data());
+        benchmark::ClobberMemory();
+    }
+
+    auto bytes = n_samples * 7 * n_properties * sizeof(double);
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * bytes));
+}
+
+static void move_samples_full_contiguous(benchmark::State& state) {
+    move_samples(state, true, 1);
+}
+
+static void move_samples_full_scattered(benchmark::State& state) {
+    move_samples(state, false, 1);
+}
+
+static void move_samples_partial_contiguous(benchmark::State& state) {
+    move_samples(state, true, 4);
+}
+
+static void move_samples_partial_scattered(benchmark::State& state) {
+    move_samples(state, false, 4);
+}
+
+#define MOVE_SAMPLES_ARGS ArgsProduct({{1000, 100000}, {8, 128}})
+
+BENCHMARK(move_samples_full_contiguous)->MOVE_SAMPLES_ARGS;
+BENCHMARK(move_samples_full_scattered)->MOVE_SAMPLES_ARGS;
+BENCHMARK(move_samples_partial_contiguous)->MOVE_SAMPLES_ARGS;
+BENCHMARK(move_samples_partial_scattered)->MOVE_SAMPLES_ARGS;
@@ -0,0 +1,94 @@
+#include <benchmark/benchmark.h>
+
+#include <equistore.hpp>
+using namespace equistore;
+
+// QM7_POWER_SPECTRUM and QM7_SPHERICAL_EXPANSION are defined by cmake, and
+// expand to the path of the corresponding files in
+// python/equistore-operations/tests/data
+
+static void tensor_load(benchmark::State& state, const char* path) {
+    auto threads = static_cast<size_t>(state.range(0));
+    for (auto _: state) {
+        auto tensor = TensorMap::load(path, details::default_create_array, threads);
+        benchmark::DoNotOptimize(tensor.keys().count());
+    }
+}
+
+static void tensor_save_buffer(benchmark::State& state, const char* path) {
+    auto tensor = TensorMap::load(path);
+    size_t size = 0;
+    for (auto _: state) {
+        auto buffer = TensorMap::save_buffer(tensor);
+        size = buffer.size();
+        benchmark::DoNotOptimize(buffer.data());
+    }
+
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * size));
+}
+
+static void keys_to_properties(benchmark::State& state, const char* path, std::vector<std::string> keys) {
+    auto tensor = TensorMap::load(path);
+    auto threads = static_cast<size_t>(state.range(0));
+    for (auto _: state) {
+        auto result = tensor.keys_to_properties(keys, /*sort_samples=*/true, threads);
+        benchmark::DoNotOptimize(result.keys().count());
+    }
+}
+
+static void keys_to_samples(benchmark::State& state, const char* path, std::vector<std::string> keys) {
+    auto tensor = TensorMap::load(path);
+    auto threads = static_cast<size_t>(state.range(0));
+    for (auto _: state) {
+        auto result = tensor.keys_to_samples(keys, /*sort_samples=*/true, threads);
+        benchmark::DoNotOptimize(result.keys().count());
+    }
+}
+
+static void components_to_properties(benchmark::State& state) {
+    auto tensor = TensorMap::load(QM7_SPHERICAL_EXPANSION);
+    for (auto _: state) {
+        auto result = tensor.components_to_properties("spherical_harmonics_m");
+        benchmark::DoNotOptimize(result.keys().count());
+    }
+}
+
+static void blocks_matching(benchmark::State& state) {
+    auto tensor = TensorMap::load(QM7_SPHERICAL_EXPANSION);
+    auto keys = tensor.keys();
+
+    // select all blocks with the same species_center as each key in turn
+    auto selections = std::vector<Labels>();
+    for (size_t i=0; i<keys.count(); i++) {
+        auto entry = keys(i, 1);
+        selections.emplace_back(Labels({"species_center"}, {{entry}}));
+    }
+
+    for (auto _: state) {
+        for (const auto& selection: selections) {
+            benchmark::DoNotOptimize(tensor.blocks_matching(selection).size());
+        }
+    }
+
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * selections.size()));
+}
+
+BENCHMARK_CAPTURE(tensor_load, power_spectrum, QM7_POWER_SPECTRUM)->Arg(1)->Arg(0);
+BENCHMARK_CAPTURE(tensor_load, spherical_expansion, QM7_SPHERICAL_EXPANSION)->Arg(1)->Arg(0);
+
+BENCHMARK_CAPTURE(tensor_save_buffer, power_spectrum, QM7_POWER_SPECTRUM);
+BENCHMARK_CAPTURE(tensor_save_buffer, spherical_expansion, QM7_SPHERICAL_EXPANSION);
+
+// braces can not be used inside the BENCHMARK_CAPTURE macro
+static const std::vector<std::string> PS_NEIGHBORS = {"species_neighbor_1", "species_neighbor_2"};
+static const std::vector<std::string> SE_NEIGHBORS = {"species_neighbor"};
+static const std::vector<std::string> CENTERS = {"species_center"};
+
+BENCHMARK_CAPTURE(keys_to_properties, power_spectrum, QM7_POWER_SPECTRUM, PS_NEIGHBORS)->Arg(1)->Arg(0);
+BENCHMARK_CAPTURE(keys_to_properties, spherical_expansion, QM7_SPHERICAL_EXPANSION, SE_NEIGHBORS)->Arg(1)->Arg(0);
+
+BENCHMARK_CAPTURE(keys_to_samples, power_spectrum, QM7_POWER_SPECTRUM, CENTERS)->Arg(1)->Arg(0);
+BENCHMARK_CAPTURE(keys_to_samples, spherical_expansion, QM7_SPHERICAL_EXPANSION, CENTERS)->Arg(1)->Arg(0);
+
+BENCHMARK(components_to_properties);
+BENCHMARK(blocks_matching);
@@ -45,6 +45,22 @@
  */
 #define EQS_INTERNAL_ERROR 255
 
+/**
+ * Data type for 64-bit floating point values (`double`)
+ */
+#define EQS_DTYPE_FLOAT64 1
+
+/**
+ * Data type for 32-bit floating point values (`float`)
+ */
+#define EQS_DTYPE_FLOAT32 2
+
+/**
+ * Data type for 16-bit (half precision, IEEE-754 binary16) floating point
+ * values
+ */
+#define EQS_DTYPE_FLOAT16 3
+
 /**
  * Basic building block for tensor map. A single block contains a n-dimensional
  * `eqs_array_t`, and n sets of `eqs_labels_t` (one for each dimension).
@@ -55,6 +71,18 @@
  */
 typedef struct eqs_block_t eqs_block_t;
 
+/**
+ * Opaque type representing a serialized `TensorMap` opened with
+ * `eqs_lazy_tensormap_open`, from which blocks are loaded on demand.
+ */
+typedef struct eqs_lazy_tensormap_t eqs_lazy_tensormap_t;
+
+/**
+ * Opaque type used to build a `TensorMap` incrementally, adding blocks and
+ * appending samples to existing blocks.
+ */
+typedef struct eqs_tensormap_builder_t eqs_tensormap_builder_t;
+
 /**
  * Opaque type representing a `TensorMap`.
  */
@@ -115,6 +143,12 @@ typedef struct eqs_labels_t {
  */
 typedef uint64_t eqs_data_origin_t;
 
+/**
+ * Type of the data stored in an `eqs_array_t`. This should be one of the
+ * `EQS_DTYPE_XXX` constants.
+ */
+typedef int32_t eqs_dtype_t;
+
 /**
  * Representation of a single sample moved from an array to another one
  */
@@ -224,6 +258,79 @@ typedef struct eqs_array_t {
                                     uintptr_t samples_count,
                                     uintptr_t property_start,
                                     uintptr_t property_end);
+  /**
+   * Create a new array with the same options as the current one (data type,
+   * data location, etc.) and the requested `shape`; and store it in
+   * `new_array`. The number of elements in the `shape` array should be given
+   * in `shape_count`.
+   *
+   * Contrary to `create`, the new array does not need to be initialized,
+   * since all of its entries will be overwritten (through
+   * `move_samples_from`) before being read. This function can be set to
+   * `NULL`, in which case `create` will be used instead.
+   */
+  eqs_status_t (*create_uninit)(const void *array,
+                                const uintptr_t *shape,
+                                uintptr_t shape_count,
+                                struct eqs_array_t *new_array);
+  /**
+   * Get the type of the data stored in this array in `dtype`, as one of the
+   * `EQS_DTYPE_XXX` constants. This function can be set to `NULL`, in which
+   * case the data is assumed to contain 64-bit floating point values.
+   */
+  eqs_status_t (*dtype)(const void *array, eqs_dtype_t *dtype);
+  /**
+   * Get a pointer to the underlying data storage, regardless of the type of
+   * the data (as given by `dtype`).
+   *
+   * This function is allowed to fail if the data is not accessible in RAM,
+   * or not stored as a C-contiguous array. This function can be set to
+   * `NULL`, in which case `data` will be used for arrays containing 64-bit
+   * floating point values.
+   */
+  eqs_status_t (*raw_data)(void *array, void **data);
+  /**
+   * Copy the values of the samples from `sample_start` to `sample_end`
+   * (excluded) in this `array` to `data`. `data` is a C-contiguous buffer
+   * with space for all the values of these samples, with the type given by
+   * `dtype`.
+   *
+   * This function should be set to `NULL` for arrays storing their data
+   * as a C-contiguous array, accessible with `raw_data`. Arrays storing
+   * their data differently (for example sparse arrays) can implement this
+   * function to be serialized, in which case the data is saved a few
+   * samples at the time, without creating a dense copy of the whole array.
+   */
+  eqs_status_t (*get_samples)(const void *array,
+                              uintptr_t sample_start,
+                              uintptr_t sample_end,
+                              void *data);
+  /**
+   * Set the values of the samples from `sample_start` to `sample_end`
+   * (excluded) in this `array` from `data`. `data` is a C-contiguous buffer
+   * containing all the values of these samples, with the type given by
+   * `dtype`.
+   *
+   * Similarly to `get_samples`, this function should be set to `NULL` for
+   * arrays storing their data as a C-contiguous array. If it is set, the
+   * data of arrays created when loading a tensor map is set with this
+   * function, a few samples at the time.
+   */
+  eqs_status_t (*set_samples)(void *array,
+                              uintptr_t sample_start,
+                              uintptr_t sample_end,
+                              const void *data);
+  /**
+   * Set this to `true` if `move_samples_from` can be called concurrently
+   * from multiple threads with this array as the output, each call writing
+   * to different samples or properties.
+   *
+   * When using multiple threads to merge blocks, data from multiple input
+   * arrays is moved concurrently into the same output only for arrays
+   * setting this to `true`. Otherwise, only different output arrays are
+   * filled concurrently.
+   */
+  bool concurrent_move_samples;
 } eqs_array_t;
 
 /**
@@ -231,17 +338,99 @@ typedef struct eqs_array_t {
  * maps.
  *
  * This function gets the `shape` of the array (the `shape` contains
- * `shape_count` elements) and should fill `array` with a new valid
- * `eqs_array_t` or return non-zero `eqs_status_t`.
- *
- * The newly created array should contains 64-bit floating points (`double`)
- * data, and live on CPU, since equistore will use `eqs_array_t.data` to get
- * the data pointer and write to it.
+ * `shape_count` elements) and the data type of the data in the file (`dtype`,
+ * one of the `EQS_DTYPE_XXX` constants); and should fill `array` with a new
+ * valid `eqs_array_t` or return non-zero `eqs_status_t`. The `user_data` is
+ * passed unchanged from the function calling this callback.
+ *
+ * The newly created array should live on CPU, since equistore will use
+ * `eqs_array_t.raw_data` (or `eqs_array_t.data`) to get the data pointer and
+ * write to it. The array does not have to use `dtype`: the data in the file is
+ * converted to the data type of the array (as given by `eqs_array_t.dtype`)
+ * if needed. Using the same data type as the file avoids this conversion.
  */
-typedef eqs_status_t (*eqs_create_array_callback_t)(const uintptr_t *shape,
+typedef eqs_status_t (*eqs_create_array_callback_t)(void *user_data,
+                                                    const uintptr_t *shape,
                                                     uintptr_t shape_count,
+                                                    eqs_dtype_t dtype,
                                                     struct eqs_array_t *array);
 
+/**
+ * Function pointer to create a new `eqs_array_t` pointing to existing data
+ * when de-serializing tensor maps without copies.
+ *
+ * This function gets the `shape` of the array (the `shape` contains
+ * `shape_count` elements), and a pointer to the corresponding `data`, which
+ * contains as many 64-bit floating points values as the product of the shape.
+ * It should fill `array` with a new valid `eqs_array_t` using this data or
+ * return non-zero `eqs_status_t`. The `user_data` is passed unchanged from the
+ * function calling this callback.
+ *
+ * The `data` pointer is not owned by the new array, and points inside the
+ * buffer given to the function calling this callback.
+ */
+typedef eqs_status_t (*eqs_create_array_view_callback_t)(void *user_data,
+                                                         const uintptr_t *shape,
+                                                         uintptr_t shape_count,
+                                                         const double *data,
+                                                         struct eqs_array_t *array);
+
+/**
+ * Function pointer used to write serialized data to an external sink.
+ *
+ * This function should write all the `count` bytes in `data` at the current
+ * position of the sink, overwriting any data already there, and move the
+ * position to the end of the written data. The `user_data` is passed
+ * unchanged from `eqs_tensormap_save_stream`.
+ */
+typedef eqs_status_t (*eqs_write_callback_t)(void *user_data,
+                                             const uint8_t *data,
+                                             uintptr_t count);
+
+/**
+ * Function pointer used to move the current position of an external sink.
+ *
+ * This function should move the current position of the sink to `position`
+ * bytes after the start of the data written by `eqs_tensormap_save_stream`.
+ * The new position is never past the end of the data already written. The
+ * `user_data` is passed unchanged from `eqs_tensormap_save_stream`.
+ */
+typedef eqs_status_t (*eqs_seek_callback_t)(void *user_data, uint64_t position);
+
+/**
+ * Data reported for a single call to an instrumented function.
+ */
+typedef struct eqs_profiling_event_t {
+  /**
+   * name of the instrumented function, as a NULL-terminated string with
+   * static lifetime
+   */
+  const char *name;
+  /**
+   * wall time spent in the function, in nanoseconds
+   */
+  uint64_t duration_ns;
+  /**
+   * number of bytes of array data moved or (de)serialized during the call
+   */
+  uint64_t bytes_moved;
+  /**
+   * number of Labels entries inserted in or looked up from a hash table
+   * during the call
+   */
+  uint64_t labels_entries_hashed;
+  /**
+   * number of calls to functions from `eqs_array_t` during the call
+   */
+  uint64_t array_callbacks;
+} eqs_profiling_event_t;
+
+/**
+ * Callback function used to report profiling events.
+ */
+typedef void (*eqs_profiling_callback_t)(void *user_data,
+                                         const struct eqs_profiling_event_t *event);
+
 #ifdef __cplusplus
 extern "C" {
 #endif // __cplusplus
@@ -290,6 +479,31 @@ eqs_status_t eqs_labels_position(struct eqs_labels_t labels,
                                  uintptr_t values_count,
                                  int64_t *result);
 
+/**
+ * Get the positions of multiple entries in the given set of `labels`, in a
+ * single call. This operation is only available if the labels correspond to
+ * a set of Rust Labels (i.e. `labels.internal_ptr_` is not NULL).
+ *
+ * The `values` array should contain `count` entries, each one containing
+ * `labels.size` values, stored contiguously. For large number of entries,
+ * the lookups are distributed over multiple threads.
+ *
+ * @param labels set of labels with an associated Rust data structure
+ * @param values array containing the entries to lookup
+ * @param count number of entries in the `values` array
+ * @param result array of `count` elements, which will be filled with the
+ *               position of each entry in the labels, or -1 if this entry
+ *               was not found
+ *
+ * @returns The status code of this operation. If the status is not
+ *          `EQS_SUCCESS`, you can use `eqs_last_error()` to get the full
+ *          error message.
+ */
+eqs_status_t eqs_labels_positions(struct eqs_labels_t labels,
+                                  const int32_t *values,
+                                  uintptr_t count,
+                                  int64_t *result);
+
 /**
  * Finish the creation of `eqs_labels_t` by associating it to Rust-owned
  * labels.
@@ -315,8 +529,17 @@ eqs_status_t eqs_labels_create(struct eqs_labels_t *labels);
  * `user_data`; and store the corresponding `user_data_delete` function to be
  * called once the labels go out of scope.
  *
- * Any existing user data will be released (by calling the provided
- * `user_data_delete` function) before overwriting with the new data.
+ * Any existing user data is kept alive until the labels are freed, and then
+ * released by calling the corresponding `user_data_delete` function. This
+ * makes it safe for other threads to keep using the pointer returned by
+ * `eqs_labels_user_data` while new data is being set, but means that the
+ * memory used by all the user data ever registered is only released with the
+ * labels. Data that changes over time (for example a pointer to the labels
+ * values on the current device) should be stored inside a single user data,
+ * registered once.
+ *
+ * Labels can be shared between threads, so `user_data_delete` might be
+ * called from a different thread than the one which set the user data.
  *
  * @param labels set of labels where we want to add user data
  * @param user_data pointer to the data
@@ -336,6 +559,10 @@ eqs_status_t eqs_labels_set_user_data(struct eqs_labels_t labels,
  *
  * If no data has been registered, `*user_data` will be NULL.
  *
+ * This function does not take any lock, and can be called from multiple
+ * threads at the same time. The returned pointer stays valid until the
+ * `labels` are freed, even if `eqs_labels_set_user_data` is called again.
+ *
  * @param labels set of labels containing user data
  * @param user_data this will be set to the pointer than was registered with
  *                  these `labels`
@@ -397,6 +624,41 @@ eqs_status_t eqs_labels_union(struct eqs_labels_t first,
                               int64_t *second_mapping,
                               uintptr_t second_mapping_count);
 
+/**
+ * Take the union of all the `eqs_labels_t` in `labels`, in a single pass.
+ *
+ * The result contains all the entries of `labels[0]`, followed by the new
+ * entries from `labels[1]`, and so on. This gives the same result as
+ * repeatedly calling `eqs_labels_union`, without creating all the
+ * intermediary labels.
+ *
+ * If requested, this function can also give the positions in the union where
+ * each entry of the input `eqs_labels_t` ended up.
+ *
+ * This function allocates memory for `result` which must be released
+ * `eqs_labels_free` when you don't need it anymore.
+ *
+ * @param labels array of labels, all with the same names
+ * @param labels_count number of labels in the `labels` array
+ * @param result empty labels, on output will contain the union of all
+ *        `labels`
+ * @param mapping if you want the mapping from the positions of entries in
+ *        each of the `labels` to the positions in `result`, this should be a
+ *        pointer to an array containing `labels[0].count + labels[1].count +
+ *        ...` elements, to be filled by this function. The mapping for
+ *        `labels[i]` starts after the mapping for `labels[i - 1]`. Otherwise
+ *        it should be a `NULL` pointer.
+ * @param mapping_count number of elements in the `mapping` array
+ * @returns The status code of this operation. If the status is not
+ *          `EQS_SUCCESS`, you can use `eqs_last_error()` to get the full
+ *          error message.
+ */
+eqs_status_t eqs_labels_union_many(const struct eqs_labels_t *labels,
+                                   uintptr_t labels_count,
+                                   struct eqs_labels_t *result,
+                                   int64_t *mapping,
+                                   uintptr_t mapping_count);
+
 /**
  * Take the intersection of two `eqs_labels_t`.
  *
@@ -553,6 +815,9 @@ eqs_status_t eqs_block_labels(const struct eqs_block_t *block,
  * more gradients are added to the parent block, or if the parent block is
  * freed with `eqs_block_free`.
  *
+ * This function does not modify the block, and can be called from multiple
+ * threads at the same time.
+ *
  * @param block pointer to an existing block
  * @param parameter the name of the gradient to be extracted
  * @param gradient pointer to an empty `eqs_block_t` pointer that will be
@@ -697,6 +962,10 @@ eqs_status_t eqs_tensormap_keys(const struct eqs_tensormap_t *tensor, struct eqs
  * `eqs_tensormap_free` or the set of keys is modified by calling one
  * of the `eqs_tensormap_keys_to_XXX` function.
  *
+ * This function does not modify the tensor map, and can be called from
+ * multiple threads at the same time. Different threads can then read the
+ * same block concurrently, as long as none of them modifies it.
+ *
  * @param tensor pointer to an existing tensor map
  * @param block pointer to be filled with a block
  * @param index index of the block to get
@@ -735,6 +1004,42 @@ eqs_status_t eqs_tensormap_blocks_matching(const struct eqs_tensormap_t *tensor,
                                            uintptr_t *count,
                                            struct eqs_labels_t selection);
 
+/**
+ * Get indices of the blocks in this `tensor` where the keys dimensions in
+ * `names` take the corresponding `values`. This is equivalent to
+ * `eqs_tensormap_blocks_matching` with a selection containing a single entry,
+ * without having to create the corresponding labels.
+ *
+ * The first call to this function builds an index of the keys, which is
+ * cached inside the tensor map. Following calls take a time proportional to
+ * the number of matching blocks instead of the number of keys.
+ *
+ * When calling this function, `*count` should contain the number of entries in
+ * `block_indexes`. When the function returns successfully, `*count` will
+ * contain the number of blocks matching the selection. If this is larger than
+ * the initial value of `*count`, only the first blocks are written to
+ * `block_indexes`, and the function should be called again with a larger
+ * array to get all of them.
+ *
+ * @param tensor pointer to an existing tensor map
+ * @param block_indexes array to be filled with indexes of blocks in the tensor
+ *                      map matching the selection
+ * @param count number of entries in `block_indexes`
+ * @param names names of the keys dimensions used in the selection
+ * @param values values taken by the corresponding dimensions in `names`
+ * @param size number of entries in `names` and `values`
+ *
+ * @returns The status code of this operation. If the status is not
+ *          `EQS_SUCCESS`, you can use `eqs_last_error()` to get the full
+ *          error message.
+ */
+eqs_status_t eqs_tensormap_blocks_matching_values(const struct eqs_tensormap_t *tensor,
+                                                  uintptr_t *block_indexes,
+                                                  uintptr_t *count,
+                                                  const char *const *names,
+                                                  const int32_t *values,
+                                                  uintptr_t size);
+
 /**
  * Merge blocks with the same value for selected keys dimensions along the
  * property axis.
@@ -769,6 +1074,13 @@ eqs_status_t eqs_tensormap_blocks_matching(const struct eqs_tensormap_t *tensor,
  * @param keys_to_move description of the keys to move
  * @param sort_samples whether to sort the samples lexicographically after
  *                     merging blocks
+ * @param threads number of threads to use when merging blocks. Use 1 to run
+ *                everything on the current thread, and 0 to use one thread
+ *                per CPU core. When using multiple threads, different
+ *                output blocks are merged concurrently. Data is only moved
+ *                concurrently into the same output array (with disjoint
+ *                samples or properties) if this array sets
+ *                `eqs_array_t.concurrent_move_samples`.
  *
  * @returns A pointer to the newly allocated tensor map, or a `NULL` pointer in
  *          case of error. In case of error, you can use `eqs_last_error()`
@@ -776,7 +1088,8 @@ eqs_status_t eqs_tensormap_blocks_matching(const struct eqs_tensormap_t *tensor,
  */
 struct eqs_tensormap_t *eqs_tensormap_keys_to_properties(const struct eqs_tensormap_t *tensor,
                                                          struct eqs_labels_t keys_to_move,
-                                                         bool sort_samples);
+                                                         bool sort_samples,
+                                                         uintptr_t threads);
 
 /**
  * Move the given dimensions from the component labels to the property labels
@@ -822,6 +1135,13 @@ struct eqs_tensormap_t *eqs_tensormap_components_to_properties(struct eqs_tensor
  * @param keys_to_move description of the keys to move
  * @param sort_samples whether to sort the samples lexicographically after
  *                     merging blocks or not
+ * @param threads number of threads to use when merging blocks. Use 1 to run
+ *                everything on the current thread, and 0 to use one thread
+ *                per CPU core. When using multiple threads, different
+ *                output blocks are merged concurrently. Data is only moved
+ *                concurrently into the same output array (with disjoint
+ *                samples or properties) if this array sets
+ *                `eqs_array_t.concurrent_move_samples`.
  *
  * @returns The status code of this operation. If the status is not
  *          `EQS_SUCCESS`, you can use `eqs_last_error()` to get the full
@@ -829,7 +1149,121 @@ struct eqs_tensormap_t *eqs_tensormap_components_to_properties(struct eqs_tensor
  */
 struct eqs_tensormap_t *eqs_tensormap_keys_to_samples(const struct eqs_tensormap_t *tensor,
                                                       struct eqs_labels_t keys_to_move,
-                                                      bool sort_samples);
+                                                      bool sort_samples,
+                                                      uintptr_t threads);
+
+/**
+ * Concatenate the blocks of multiple tensor maps along the samples axis.
+ *
+ * The keys of the new tensor map are the union of the keys of all `tensors`,
+ * and each block contains the samples of all the blocks with the
+ * corresponding key, in the order of `tensors`. A new `"tensor"` dimension is
+ * added to the samples, containing the index in `tensors` of the tensor map
+ * each sample comes from.
+ *
+ * Blocks with the same key must have the same samples names, components,
+ * properties, and set of gradients. Each output block is allocated once, and
+ * filled with a single call to `move_samples_from` per input block.
+ *
+ * The memory allocated by this function should be released using
+ * `eqs_tensormap_free`.
+ *
+ * @param tensors pointer to an array of `tensors_count` pointers to existing
+ *                tensor maps
+ * @param tensors_count number of entries in the `tensors` array
+ * @param threads number of threads to use when joining blocks. Use 1 to run
+ *                everything on the current thread, and 0 to use one thread
+ *                per CPU core. When using multiple threads, different
+ *                output blocks are joined concurrently. Data is only moved
+ *                concurrently into the same output array (with disjoint
+ *                samples) if this array sets
+ *                `eqs_array_t.concurrent_move_samples`.
+ *
+ * @returns A pointer to the newly allocated tensor map, or a `NULL` pointer in
+ *          case of error. In case of error, you can use `eqs_last_error()`
+ *          to get the error message.
+ */
+struct eqs_tensormap_t *eqs_tensormap_join_samples(const struct eqs_tensormap_t *const *tensors,
+                                                   uintptr_t tensors_count,
+                                                   uintptr_t threads);
+
+/**
+ * Create a new empty `eqs_tensormap_builder_t`, for a tensor map with keys
+ * using the given `names`.
+ *
+ * The memory allocated by this function should be released either with
+ * `eqs_tensormap_builder_finish` or `eqs_tensormap_builder_free`.
+ *
+ * @param names names of the keys dimensions
+ * @param names_count number of entries in `names`
+ *
+ * @returns A pointer to the newly allocated builder, or a `NULL` pointer in
+ *          case of error. In case of error, you can use `eqs_last_error()`
+ *          to get the error message.
+ */
+struct eqs_tensormap_builder_t *eqs_tensormap_builder(const char *const *names,
+                                                      uintptr_t names_count);
+
+/**
+ * Add a `block` associated with the given `key` to this `builder`.
+ *
+ * If the builder already contains a block for this `key`, the samples of the
+ * new `block` are appended to the ones of the existing block, and the
+ * `"sample"` dimension of the gradients samples is updated accordingly. Both
+ * blocks must then have the same components, properties and set of
+ * gradients, and the new samples must not already be present in the
+ * existing block. The data of the appended blocks is copied into a single
+ * array when calling `eqs_tensormap_builder_finish`.
+ *
+ * The builder takes ownership of the block, which should not be used or
+ * released separately after calling this function, even if it fails.
+ *
+ * @param builder pointer to an existing tensor map builder
+ * @param key values of the key for this block
+ * @param key_count number of entries in `key`, this should be the same as
+ *                  the number of names given to `eqs_tensormap_builder`
+ * @param block block to add to the builder
+ *
+ * @returns The status code of this operation. If the status is not
+ *          `EQS_SUCCESS`, you can use `eqs_last_error()` to get the full
+ *          error message.
+ */
+eqs_status_t eqs_tensormap_builder_add_block(struct eqs_tensormap_builder_t *builder,
+                                             const int32_t *key,
+                                             uintptr_t key_count,
+                                             struct eqs_block_t *block);
+
+/**
+ * Finish building a tensor map, and release the `builder`.
+ *
+ * The `builder` is released by this function, even in case of error, and
+ * should not be used afterwards. Blocks added only once to the builder are
+ * moved to the tensor map without copying their data.
+ *
+ * The memory allocated by this function should be released using
+ * `eqs_tensormap_free`.
+ *
+ * @param builder pointer to an existing tensor map builder
+ *
+ * @returns A pointer to the newly allocated tensor map, or a `NULL` pointer in
+ *          case of error. In case of error, you can use `eqs_last_error()`
+ *          to get the error message.
+ */
+struct eqs_tensormap_t *eqs_tensormap_builder_finish(struct eqs_tensormap_builder_t *builder);
+
+/**
+ * Free the memory associated with a `builder` previously created with
+ * `eqs_tensormap_builder`, including all the blocks added to it.
+ *
+ * If `builder` is `NULL`, this function does nothing.
+ *
+ * @param builder pointer to an existing tensor map builder, or `NULL`
+ *
+ * @returns The status code of this operation. If the status is not
+ *          `EQS_SUCCESS`, you can use `eqs_last_error()` to get the full
+ *          error message.
+ */
+eqs_status_t eqs_tensormap_builder_free(struct eqs_tensormap_builder_t *builder);
 
 /**
  * Load a tensor map from the file at the given path.
@@ -842,8 +1276,10 @@ struct eqs_tensormap_t *eqs_tensormap_keys_to_samples(const struct eqs_tensormap
  * `eqs_tensormap_free`.
  *
  * `TensorMap` are serialized using numpy's `.npz` format, i.e. a ZIP file
- * without compression (storage method is STORED), where each file is stored as
- * a `.npy` array. Both the ZIP and NPY format are well documented:
+ * without compression (storage method is STORED) or compressed with DEFLATE
+ * (storage method is DEFLATED, see `eqs_tensormap_save_compressed`), where each
+ * file is stored as a `.npy` array. Both the ZIP and NPY format are well
+ * documented:
  *
  * - ZIP: <https://pkware.cachefly.net/webdocs/casestudies/APPNOTE.TXT>
  * - NPY: <https://numpy.org/doc/stable/reference/generated/numpy.lib.format.html>
@@ -851,7 +1287,9 @@ struct eqs_tensormap_t *eqs_tensormap_keys_to_samples(const struct eqs_tensormap
  * We add other restriction on top of these formats when saving/loading data.
  * First, `Labels` instances are saved as structured array, see the `labels`
  * module for more information. Only 32-bit integers are supported for Labels,
- * and only 64-bit floats are supported for data (values and gradients).
+ * and 64-bit, 32-bit or 16-bit floats are supported for data (values and
+ * gradients). The data is converted to the data type of the arrays returned
+ * by `create_array` if needed.
  *
  * Second, the path of the files in the archive also carry meaning. The keys of
  * the `TensorMap` are stored in `/keys.npy`, and then different blocks are
@@ -876,13 +1314,65 @@ struct eqs_tensormap_t *eqs_tensormap_keys_to_samples(const struct eqs_tensormap
  * @param path path to the file as a NULL-terminated UTF-8 string
  * @param create_array callback function that will be used to create data
  *                     arrays inside each block
+ * @param user_data custom data for the `create_array` callback. This will be
+ *                  passed as the first argument to `create_array` as-is.
+ * @param threads number of threads to use when decoding blocks. Use 1 to run
+ *                everything on the current thread, and 0 to use one thread
+ *                per CPU core. When using multiple threads, `create_array`
+ *                can be called concurrently from different threads.
  *
  * @returns A pointer to the newly allocated tensor map, or a `NULL` pointer in
  *          case of error. In case of error, you can use `eqs_last_error()`
  *          to get the error message.
  */
 struct eqs_tensormap_t *eqs_tensormap_load(const char *path,
-                                           eqs_create_array_callback_t create_array);
+                                           eqs_create_array_callback_t create_array,
+                                           void *user_data,
+                                           uintptr_t threads);
+
+/**
+ * Load a subset of the tensor map from the file at the given path, keeping
+ * only the samples and properties matching the given selections.
+ *
+ * The labels of each block are decoded first, and then only the data for the
+ * selected samples and properties is read from the file. Files saved without
+ * compression (with `eqs_tensormap_save`) are read directly at the offsets of
+ * the selected samples, so loading a small subset is faster than loading the
+ * full file.
+ *
+ * The selections can contain a subset of the dimensions of the samples or
+ * properties, and an entry is kept if its values for these dimensions are
+ * part of the selection. The kept entries stay in the same order as in the
+ * file, and all blocks are kept even if no sample or property matches the
+ * selection. The samples of gradients are filtered and renumbered to only
+ * refer to the kept samples, and gradients use the same properties as the
+ * values.
+ *
+ * The memory allocated by this function should be released using
+ * `eqs_tensormap_free`.
+ *
+ * @param path path to the file as a NULL-terminated UTF-8 string
+ * @param create_array callback function that will be used to create data
+ *                     arrays inside each block
+ * @param user_data custom data for the `create_array` callback, see
+ *                  `eqs_tensormap_load`
+ * @param samples selection for the samples of the blocks, or `NULL` to keep
+ *                all samples
+ * @param properties selection for the properties of the blocks, or `NULL`
+ *                   to keep all properties
+ * @param threads number of threads to use when decoding blocks, see
+ *                `eqs_tensormap_load`
+ *
+ * @returns A pointer to the newly allocated tensor map, or a `NULL` pointer in
+ *          case of error. In case of error, you can use `eqs_last_error()`
+ *          to get the error message.
+ */
+struct eqs_tensormap_t *eqs_tensormap_load_selected(const char *path,
+                                                    eqs_create_array_callback_t create_array,
+                                                    void *user_data,
+                                                    const struct eqs_labels_t *samples,
+                                                    const struct eqs_labels_t *properties,
+                                                    uintptr_t threads);
 
 /**
  * Load a tensor map from the given in-memory buffer.
@@ -898,6 +1388,8 @@ struct eqs_tensormap_t *eqs_tensormap_load(const char *path,
  * @param buffer_count number of elements in the buffer
  * @param create_array callback function that will be used to create data
  *                     arrays inside each block
+ * @param user_data custom data for the `create_array` callback, see
+ *                  `eqs_tensormap_load`
  *
  * @returns A pointer to the newly allocated tensor map, or a `NULL` pointer in
  *          case of error. In case of error, you can use `eqs_last_error()`
@@ -905,7 +1397,152 @@ struct eqs_tensormap_t *eqs_tensormap_load(const char *path,
  */
 struct eqs_tensormap_t *eqs_tensormap_load_buffer(const uint8_t *buffer,
                                                   uintptr_t buffer_count,
-                                                  eqs_create_array_callback_t create_array);
+                                                  eqs_create_array_callback_t create_array,
+                                                  void *user_data);
+
+/**
+ * Load a tensor map from the given in-memory buffer, without copying the
+ * values and gradients data when possible.
+ *
+ * This function is intended to be used with a memory-mapped file as `buffer`,
+ * making the cost of loading data proportional to the data actually used
+ * instead of the file size.
+ *
+ * For each array stored without compression, in the native endianness of the
+ * current machine and with data correctly aligned in memory, the
+ * `create_array_view` callback is called with a pointer inside `buffer`. Files
+ * written by `eqs_tensormap_save` satisfy all of these conditions. The other
+ * arrays are created with the `create_array` callback and filled with a copy
+ * of the data, as in `eqs_tensormap_load_buffer`.
+ *
+ * The arrays created by `create_array_view` point inside `buffer`, which must
+ * stay alive and unmodified for as long as these arrays are used.
+ *
+ * The memory allocated by this function should be released using
+ * `eqs_tensormap_free`.
+ *
+ * @param buffer buffer containing a previously serialized `eqs_tensormap_t`
+ * @param buffer_count number of elements in the buffer
+ * @param create_array callback function that will be used to create data
+ *                     arrays inside each block when the data has to be
+ *                     copied
+ * @param user_data custom data for the `create_array` and
+ *                  `create_array_view` callbacks. This will be passed as the
+ *                  first argument to both callbacks as-is.
+ * @param create_array_view callback function that will be used to create
+ *                          data arrays pointing directly inside `buffer`
+ *
+ * @returns A pointer to the newly allocated tensor map, or a `NULL` pointer in
+ *          case of error. In case of error, you can use `eqs_last_error()`
+ *          to get the error message.
+ */
+struct eqs_tensormap_t *eqs_tensormap_load_buffer_view(const uint8_t *buffer,
+                                                       uintptr_t buffer_count,
+                                                       eqs_create_array_callback_t create_array,
+                                                       void *user_data,
+                                                       eqs_create_array_view_callback_t create_array_view);
+
+/**
+ * Open the serialized tensor map in the file at the given path, without
+ * loading the blocks.
+ *
+ * Only the keys are read when opening the file. The labels and data of each
+ * block are only read when calling `eqs_lazy_tensormap_load_block`. The file
+ * must use the same format as for `eqs_tensormap_load`, and should not be
+ * modified while it is open.
+ *
+ * The memory allocated by this function should be released using
+ * `eqs_lazy_tensormap_free`.
+ *
+ * @param path path to the file as a NULL-terminated UTF-8 string
+ *
+ * @returns A pointer to the newly allocated lazy tensor map, or a `NULL`
+ *          pointer in case of error. In case of error, you can use
+ *          `eqs_last_error()` to get the error message.
+ */
+struct eqs_lazy_tensormap_t *eqs_lazy_tensormap_open(const char *path);
+
+/**
+ * Free the memory associated with a `lazy` tensor map previously created
+ * with `eqs_lazy_tensormap_open`, and close the corresponding file.
+ *
+ * Blocks loaded from this lazy tensor map are not affected, and should be
+ * released separately.
+ *
+ * If `lazy` is `NULL`, this function does nothing.
+ *
+ * @param lazy pointer to an existing lazy tensor map, or `NULL`
+ *
+ * @returns The status code of this operation. If the status is not
+ *          `EQS_SUCCESS`, you can use `eqs_last_error()` to get the full
+ *          error message.
+ */
+eqs_status_t eqs_lazy_tensormap_free(struct eqs_lazy_tensormap_t *lazy);
+
+/**
+ * Get the keys for the given `lazy` tensor map.
+ *
+ * This function allocates memory for `keys` which must be released
+ * `eqs_labels_free` when you don't need it anymore.
+ *
+ * @param lazy pointer to an existing lazy tensor map
+ * @param keys pointer to be filled with the keys of the tensor map
+ *
+ * @returns The status code of this operation. If the status is not
+ *          `EQS_SUCCESS`, you can use `eqs_last_error()` to get the full
+ *          error message.
+ */
+eqs_status_t eqs_lazy_tensormap_keys(const struct eqs_lazy_tensormap_t *lazy,
+                                     struct eqs_labels_t *keys);
+
+/**
+ * Get indices of the blocks in this `lazy` tensor map corresponding to the
+ * given `selection`, without loading any block. This function works like
+ * `eqs_tensormap_blocks_matching`.
+ *
+ * @param lazy pointer to an existing lazy tensor map
+ * @param block_indexes array to be filled with indexes of blocks in the tensor
+ *                      map matching the `selection`
+ * @param count number of entries in `block_indexes`
+ * @param selection labels with a single entry describing which blocks are requested
+ *
+ * @returns The status code of this operation. If the status is not
+ *          `EQS_SUCCESS`, you can use `eqs_last_error()` to get the full
+ *          error message.
+ */
+eqs_status_t eqs_lazy_tensormap_blocks_matching(const struct eqs_lazy_tensormap_t *lazy,
+                                                uintptr_t *block_indexes,
+                                                uintptr_t *count,
+                                                struct eqs_labels_t selection);
+
+/**
+ * Load the `index`-th block (including its gradients) from this `lazy`
+ * tensor map.
+ *
+ * Arrays for the values and gradient data will be created with the given
+ * `create_array` callback, and filled by this function with the
+ * corresponding data. Each call to this function reads the block from the
+ * file again. This function can be called from multiple threads at the same
+ * time.
+ *
+ * The memory allocated by this function should be released using
+ * `eqs_block_free`, or moved into a tensor map using `eqs_tensormap`.
+ *
+ * @param lazy pointer to an existing lazy tensor map
+ * @param index index of the block to load
+ * @param create_array callback function that will be used to create data
+ *                     arrays inside the block
+ * @param user_data custom data for the `create_array` callback, see
+ *                  `eqs_tensormap_load`
+ *
+ * @returns A pointer to the newly allocated block, or a `NULL` pointer in
+ *          case of error. In case of error, you can use `eqs_last_error()`
+ *          to get the error message.
+ */
+struct eqs_block_t *eqs_lazy_tensormap_load_block(const struct eqs_lazy_tensormap_t *lazy,
+                                                  uintptr_t index,
+                                                  eqs_create_array_callback_t create_array,
+                                                  void *user_data);
 
 /**
  * Save a tensor map to the file at the given path.
@@ -921,6 +1558,53 @@ struct eqs_tensormap_t *eqs_tensormap_load_buffer(const uint8_t *buffer,
  */
 eqs_status_t eqs_tensormap_save(const char *path, const struct eqs_tensormap_t *tensor);
 
+/**
+ * Save a tensor map to the file at the given path, compressing the data.
+ *
+ * The files inside the archive are compressed with DEFLATE, using the
+ * fastest compression level. Such archives can be loaded with
+ * `eqs_tensormap_load` and the other loading functions, but the data can
+ * not be used directly from the buffer in `eqs_tensormap_load_buffer_view`,
+ * and is copied instead.
+ *
+ * If the file already exists, it is overwritten.
+ *
+ * @param path path to the file as a NULL-terminated UTF-8 string
+ * @param tensor tensor map to save to the file
+ *
+ * @returns The status code of this operation. If the status is not
+ *          `EQS_SUCCESS`, you can use `eqs_last_error()` to get the full
+ *          error message.
+ */
+eqs_status_t eqs_tensormap_save_compressed(const char *path, const struct eqs_tensormap_t *tensor);
+
+/**
+ * Save a tensor map by streaming the serialized data to an external sink.
+ *
+ * The data is produced incrementally, and given to the `write` callback in
+ * chunks, without ever holding the whole serialized tensor map in memory.
+ * When finishing the archive, some data already written needs to be updated,
+ * and the `seek` callback is used to move the position of the sink before
+ * writing again. The sink should start empty; positions given to `seek` are
+ * relative to the start of the data written by this function.
+ *
+ * The data is written using the same format as `eqs_tensormap_save`.
+ *
+ * @param user_data custom data for the `write` and `seek` callbacks, which
+ *        will be passed as their first argument as-is.
+ * @param write callback used to write data to the sink
+ * @param seek callback used to move the position of the sink
+ * @param tensor tensor map that will be saved to the sink
+ *
+ * @returns The status code of this operation. If the status is not
+ *          `EQS_SUCCESS`, you can use `eqs_last_error()` to get the full error
+ *          message.
+ */
+eqs_status_t eqs_tensormap_save_stream(void *user_data,
+                                       eqs_write_callback_t write,
+                                       eqs_seek_callback_t seek,
+                                       const struct eqs_tensormap_t *tensor);
+
 /**
  * Save a tensor map to an in-memory buffer.
  *
@@ -961,6 +1645,32 @@ eqs_status_t eqs_tensormap_save_buffer(uint8_t **buffer,
                                                            uintptr_t new_size),
                                        const struct eqs_tensormap_t *tensor);
 
+/**
+ * Register a `callback` to be called at the end of the main functions of
+ * equistore (creating and operating on `eqs_tensormap_t`, loading and saving
+ * data, etc.), reporting the time spent in this function and some counters
+ * (bytes of arrays data moved, number of labels entries hashed, number of
+ * calls to `eqs_array_t` functions).
+ *
+ * Only a single callback can be registered at a given time, and calling this
+ * function again will replace the previous callback. Passing a `NULL`
+ * `callback` disables profiling, which is also the default. When profiling
+ * is disabled, the cost of the instrumentation is negligible.
+ *
+ * The callback can be called from any thread, and concurrently from multiple
+ * threads. The counters are shared between threads, so the values reported
+ * for a call can include work done concurrently by other calls.
+ *
+ * @param callback function that will be called with `user_data` and the
+ *                 profiling event, or `NULL` to disable profiling
+ * @param user_data data that will be passed to the callback
+ *
+ * @returns The status code of this operation. If the status is not
+ *          `EQS_SUCCESS`, you can use `eqs_last_error()` to get the full
+ *          error message.
+ */
+eqs_status_t eqs_set_profiling_callback(eqs_profiling_callback_t callback, void *user_data);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif // __cplusplus
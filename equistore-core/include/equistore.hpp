@@ -1,20 +1,55 @@
 #ifndef EQUISTORE_HPP
 #define EQUISTORE_HPP
 
+#include <list>
+#include <algorithm>
 #include <array>
+#include <mutex>
 #include <vector>
 #include <string>
+#include <ostream>
 #include <memory>
 #include <stdexcept>
 #include <exception>
 #include <functional>
 #include <type_traits>
+#include <unordered_map>
 #include <initializer_list>
 
 #include <cassert>
 #include <cstdint>
 #include <cstring>
 #include <cstdlib>
+#include <cerrno>
+
+// Platform headers, only used by `details::MemoryMap`. On Windows, we only
+// include the minimal set of declarations, and prevent the definition of `min`
+// and `max` macros, without changing these settings for the code including
+// this file.
+#ifdef _WIN32
+    #ifndef WIN32_LEAN_AND_MEAN
+        #define WIN32_LEAN_AND_MEAN
+        #define EQUISTORE_UNDEF_WIN32_LEAN_AND_MEAN
+    #endif
+    #ifndef NOMINMAX
+        #define NOMINMAX
+        #define EQUISTORE_UNDEF_NOMINMAX
+    #endif
+    #include <windows.h>
+    #ifdef EQUISTORE_UNDEF_WIN32_LEAN_AND_MEAN
+        #undef WIN32_LEAN_AND_MEAN
+        #undef EQUISTORE_UNDEF_WIN32_LEAN_AND_MEAN
+    #endif
+    #ifdef EQUISTORE_UNDEF_NOMINMAX
+        #undef NOMINMAX
+        #undef EQUISTORE_UNDEF_NOMINMAX
+    #endif
+#else
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+#endif
 
 #include "equistore.h"
 
@@ -49,26 +84,38 @@ namespace details {
     /// allows to save the message associated with an exception, and rethrow an
     /// exception with the same message later (the actual exception type is lost
     /// in the process).
+    ///
+    /// The message is shared between all threads, since the callbacks can run
+    /// on other threads than the one which called the C API function (for
+    /// example when using multiple threads in `TensorMap::keys_to_properties`).
     class LastCxxError {
     public:
         /// Set the last error message to `message`
         static void set_message(std::string message) {
-            auto& stored_message = LastCxxError::get();
-            stored_message = std::move(message);
+            auto& stored = LastCxxError::get();
+            std::lock_guard<std::mutex> lock(stored.mutex);
+            stored.message = std::move(message);
         }
 
-        /// Get the last error message
-        static const std::string& message() {
-            return LastCxxError::get();
+        /// Get the last error message, and reset it to an empty string
+        static std::string take_message() {
+            auto& stored = LastCxxError::get();
+            std::lock_guard<std::mutex> lock(stored.mutex);
+            auto message = std::move(stored.message);
+            stored.message.clear();
+            return message;
         }
 
     private:
-        static std::string& get() {
+        struct StoredMessage {
+            std::mutex mutex;
+            std::string message;
+        };
+
+        static StoredMessage& get() {
             #pragma clang diagnostic push
             #pragma clang diagnostic ignored "-Wexit-time-destructors"
-            /// we are using a per-thread static value to store the last C++
-            /// exception.
-            static thread_local std::string STORED_MESSAGE;
+            static StoredMessage STORED_MESSAGE;
             #pragma clang diagnostic pop
 
             return STORED_MESSAGE;
@@ -84,7 +131,7 @@ namespace details {
         } else if (status > 0) {
             throw Error(eqs_last_error());
         } else { // status < 0
-            throw Error("error in C++ callback: " + LastCxxError::message());
+            throw Error("error in C++ callback: " + LastCxxError::take_message());
         }
     }
 
@@ -107,30 +154,41 @@ namespace details {
     }
 
     /// Check if a pointer allocated by the C API is null, and if it is the
-    /// case, throw an exception of type `equistore::Error` with the last error
-    /// message from the library.
+    /// case, throw an exception of type `equistore::Error` with the message of
+    /// the C++ callback which failed if any, or the last error message from
+    /// the library.
     inline void check_pointer(const void* pointer) {
         if (pointer == nullptr) {
+            auto message = LastCxxError::take_message();
+            if (!message.empty()) {
+                throw Error("error in C++ callback: " + message);
+            }
             throw Error(eqs_last_error());
         }
     }
 
-    /// Compute the product of all values in the `shape` vector
-    inline size_t product(const std::vector<size_t>& shape) {
+    /// Compute the product of the `count` values starting at `shape`
+    inline size_t product(const size_t* shape, size_t count) {
         size_t result = 1;
-        for (auto size: shape) {
-            result *= size;
+        for (size_t i=0; i<count; i++) {
+            result *= shape[i];
         }
         return result;
     }
 
+    /// Compute the product of all values in the `shape` vector
+    inline size_t product(const std::vector<size_t>& shape) {
+        return product(shape.data(), shape.size());
+    }
+
     /// Get the N-dimensional index corresponding to the given linear `index`
     /// and array `shape`
     inline std::vector<size_t> cartesian_index(const std::vector<size_t>& shape, size_t index) {
+        // this is the inverse of `linear_index`, using row-major order
         auto result = std::vector<size_t>(shape.size(), 0);
-        for (size_t i=0; i<shape.size(); i++) {
-            result[i] = index % shape[i];
-            index = index / shape[i];
+        for (size_t i=shape.size(); i>0; i--) {
+            result[i - 1] = index % shape[i - 1];
+            index = index / shape[i - 1];
         }
         assert(index == 0);
         return result;
@@ -532,9 +590,10 @@ public:
 
     /// Labels can be copy-assigned
     Labels& operator=(const Labels& other) {
-        eqs_labels_free(&labels_);
-        std::memset(&labels_, 0, sizeof(labels_));
-        details::check_status(eqs_labels_clone(other.labels_, &labels_));
+        eqs_labels_t labels;
+        std::memset(&labels, 0, sizeof(labels));
+        details::check_status(eqs_labels_clone(other.labels_, &labels));
+        *this = Labels(labels);
         return *this;
     }
 
@@ -584,7 +643,9 @@ public:
     /// Get the user data pointer registered with these `Labels`.
     ///
     /// If no user data have been registered, this function will return
-    /// `nullptr`.
+    /// `nullptr`. This function can be called from multiple threads at the
+    /// same time, and the returned pointer stays valid as long as the
+    /// underlying labels are alive.
     void* user_data() {
         assert(labels_.internal_ptr_ != nullptr);
 
@@ -595,8 +656,9 @@ public:
 
     /// Register some user data pointer with these `Labels`.
     ///
-    /// Any existing user data will be released (by calling the provided
-    /// `delete` function) before overwriting with the new data.
+    /// Any existing user data is kept alive until the labels are freed, since
+    /// other threads might still be using it. Data that changes over time
+    /// should be stored inside a single user data, registered once.
     void set_user_data(LabelsUserData user_data) {
         assert(labels_.internal_ptr_ != nullptr);
 
@@ -637,6 +699,34 @@ public:
         return result;
     }
 
+    /// Get the positions of `count` entries in this set of Labels in a single
+    /// call, writing them to `positions`.
+    ///
+    /// `entries` should contain `count * this->size()` values, with all the
+    /// entries stored contiguously; and `positions` should have space for
+    /// `count` elements. The position of entries which are not part of these
+    /// Labels is set to -1.
+    void positions(const int32_t* entries, size_t count, int64_t* positions) const {
+        assert(labels_.internal_ptr_ != nullptr);
+        details::check_status(eqs_labels_positions(labels_, entries, count, positions));
+    }
+
+    /// Variant of `Labels::positions` taking a vector of contiguous entries as
+    /// input, and returning a vector of positions.
+    std::vector<int64_t> positions(const std::vector<int32_t>& entries) const {
+        if (this->size() == 0 || entries.size() % this->size() != 0) {
+            throw Error(
+                "invalid number of values in Labels::positions: expected a multiple of "
+                + std::to_string(this->size()) + ", got " + std::to_string(entries.size())
+            );
+        }
+
+        auto count = entries.size() / this->size();
+        auto result = std::vector<int64_t>(count);
+        this->positions(entries.data(), count, result.data());
+        return result;
+    }
+
     /// Get the value inside these `Labels` at the given index
     int32_t operator()(size_t i, size_t j) const {
         return NDArray<int32_t>::operator()(i, j);
@@ -733,6 +823,69 @@ public:
         );
     }
 
+    /// Take the union of all the `Labels` in `labels`, in a single pass.
+    ///
+    /// The result contains all the entries of `labels[0]`, followed by the new
+    /// entries from `labels[1]`, and so on. This is the same as repeatedly
+    /// calling `set_union`, without creating all the intermediary `Labels`.
+    ///
+    /// If requested, this function can also give the positions in the
+    /// union where each entry of the input `Labels` ended up.
+    ///
+    /// @param labels the `Labels` we want to take the union of
+    /// @param mapping if you want the mapping from the positions of entries in
+    ///        each of the `labels` to the positions in the union, this should
+    ///        be a pointer to an array containing `labels[0].count() +
+    ///        labels[1].count() + ...` elements, to be filled by this
+    ///        function, with the mapping for `labels[i]` after the one for
+    ///        `labels[i - 1]`. Otherwise it should be a `nullptr`.
+    /// @param mapping_count number of elements in `mapping`
+    static Labels set_union_many(
+        const std::vector<Labels>& labels,
+        int64_t* mapping = nullptr,
+        size_t mapping_count = 0
+    ) {
+        auto all_labels = std::vector<eqs_labels_t>();
+        all_labels.reserve(labels.size());
+        for (const auto& l: labels) {
+            all_labels.push_back(l.labels_);
+        }
+
+        eqs_labels_t result;
+        std::memset(&result, 0, sizeof(result));
+
+        details::check_status(eqs_labels_union_many(
+            all_labels.data(),
+            all_labels.size(),
+            &result,
+            mapping,
+            mapping_count
+        ));
+
+        return Labels(result);
+    }
+
+    /// Take the union of all the `Labels` in `labels`, in a single pass.
+    ///
+    /// @param labels the `Labels` we want to take the union of
+    /// @param mapping if you want the mapping from the positions of entries in
+    ///        each of the `labels` to the positions in the union, this should
+    ///        be a vector containing `labels[0].count() + labels[1].count() +
+    ///        ...` elements, to be filled by this function. Otherwise it
+    ///        should be an empty vector.
+    static Labels set_union_many(
+        const std::vector<Labels>& labels,
+        std::vector<int64_t>& mapping
+    ) {
+        auto mapping_ptr = mapping.data();
+        auto mapping_count = mapping.size();
+        if (mapping_count == 0) {
+            mapping_ptr = nullptr;
+        }
+
+        return Labels::set_union_many(labels, mapping_ptr, mapping_count);
+    }
+
     /// Take the intersection of these `Labels` with `other`.
     ///
     /// If requested, this function can also give the positions in the
@@ -839,13 +992,10 @@ private:
 
     Labels(eqs_labels_t labels):
         NDArray(labels.values, {labels.count, labels.size}),
+        names_(labels.names, labels.names + labels.size),
         labels_(labels)
     {
         assert(labels_.internal_ptr_ != nullptr);
-
-        for (size_t i=0; i<labels.size; i++) {
-            names_.push_back(labels.names[i]);
-        }
     }
 
     Labels(const std::vector<std::string>& names, const int32_t* values, size_t count):
@@ -854,6 +1004,7 @@ private:
     friend Labels details::labels_from_cxx(const std::vector<std::string>&, NDArray<int32_t>);
     friend class TensorMap;
     friend class TensorBlock;
+    friend class LazyTensorMap;
 
     friend class equistore_torch::LabelsHolder;
     friend class equistore_torch::TensorMapHolder;
@@ -881,6 +1032,7 @@ namespace details {
         std::memset(&labels, 0, sizeof(labels));
 
         auto c_names = std::vector<const char*>();
+        c_names.reserve(names.size());
         for (const auto& name: names) {
             c_names.push_back(name.c_str());
         }
@@ -952,6 +1104,10 @@ public:
         eqs_array_t array;
         std::memset(&array, 0, sizeof(array));
 
+        // the sample accessors are only set for arrays which need them, so
+        // that other arrays are saved and loaded with `raw_data`
+        auto raw_data_available = data->raw_data_available();
+        array.concurrent_move_samples = data->concurrent_move_samples();
         array.ptr = data.release();
 
         array.destroy = [](void* array) {
@@ -984,16 +1140,25 @@ public:
                 eqs_array_t* new_array
             ) {
                 auto cxx_array = static_cast<const DataArrayBase*>(array);
-                auto cxx_shape = std::vector<size_t>();
-                for (size_t i=0; i<static_cast<size_t>(shape_count); i++) {
-                    cxx_shape.push_back(static_cast<size_t>(shape[i]));
-                }
-                auto copy = cxx_array->create(std::move(cxx_shape));
+                auto copy = cxx_array->create(shape, static_cast<size_t>(shape_count));
                 *new_array = DataArrayBase::to_eqs_array_t(std::move(copy));
                 return EQS_SUCCESS;
             }, array, shape, shape_count, new_array);
         };
 
+        array.create_uninit = [](const void* array, const uintptr_t* shape, uintptr_t shape_count, eqs_array_t* new_array) {
+            return details::catch_exceptions([](
+                const void* array,
+                const uintptr_t* shape,
+                uintptr_t shape_count,
+                eqs_array_t* new_array
+            ) {
+                auto cxx_array = static_cast<const DataArrayBase*>(array);
+                auto copy = cxx_array->create_uninit(shape, static_cast<size_t>(shape_count));
+                *new_array = DataArrayBase::to_eqs_array_t(std::move(copy));
+                return EQS_SUCCESS;
+            }, array, shape, shape_count, new_array);
+        };
 
         array.data = [](void* array, double** data) {
             return details::catch_exceptions([](void* array, double** data){
@@ -1003,6 +1168,22 @@ public:
             }, array, data);
         };
 
+        array.dtype = [](const void* array, eqs_dtype_t* dtype) {
+            return details::catch_exceptions([](const void* array, eqs_dtype_t* dtype){
+                auto cxx_array = static_cast<const DataArrayBase*>(array);
+                *dtype = cxx_array->dtype();
+                return EQS_SUCCESS;
+            }, array, dtype);
+        };
+
+        array.raw_data = [](void* array, void** data) {
+            return details::catch_exceptions([](void* array, void** data){
+                auto cxx_array = static_cast<DataArrayBase*>(array);
+                *data = cxx_array->raw_data();
+                return EQS_SUCCESS;
+            }, array, data);
+        };
+
         array.shape = [](const void* array, const uintptr_t** shape, uintptr_t* shape_count) {
             return details::catch_exceptions([](const void* array, const uintptr_t** shape, uintptr_t* shape_count){
                 auto cxx_array = static_cast<const DataArrayBase*>(array);
@@ -1016,8 +1197,7 @@ public:
         array.reshape = [](void* array, const uintptr_t* shape, uintptr_t shape_count) {
             return details::catch_exceptions([](void* array, const uintptr_t* shape, uintptr_t shape_count){
                 auto cxx_array = static_cast<DataArrayBase*>(array);
-                auto cxx_shape = std::vector<uintptr_t>(shape, shape + shape_count);
-                cxx_array->reshape(std::move(cxx_shape));
+                cxx_array->reshape(shape, static_cast<size_t>(shape_count));
                 return EQS_SUCCESS;
             }, array, shape, shape_count);
         };
@@ -1048,13 +1228,36 @@ public:
             ) {
                 auto cxx_array = static_cast<DataArrayBase*>(array);
                 auto cxx_input = static_cast<const DataArrayBase*>(input);
-                auto cxx_samples = std::vector<eqs_sample_mapping_t>(samples, samples + samples_count);
 
-                cxx_array->move_samples_from(*cxx_input, cxx_samples, property_start, property_end);
+                cxx_array->move_samples_from(
+                    *cxx_input,
+                    samples,
+                    static_cast<size_t>(samples_count),
+                    property_start,
+                    property_end
+                );
                 return EQS_SUCCESS;
             }, array, input, samples, samples_count, property_start, property_end);
         };
 
+        if (!raw_data_available) {
+            array.get_samples = [](const void* array, uintptr_t sample_start, uintptr_t sample_end, void* data) {
+                return details::catch_exceptions([](const void* array, uintptr_t sample_start, uintptr_t sample_end, void* data){
+                    auto cxx_array = static_cast<const DataArrayBase*>(array);
+                    cxx_array->get_samples(sample_start, sample_end, data);
+                    return EQS_SUCCESS;
+                }, array, sample_start, sample_end, data);
+            };
+
+            array.set_samples = [](void* array, uintptr_t sample_start, uintptr_t sample_end, const void* data) {
+                return details::catch_exceptions([](void* array, uintptr_t sample_start, uintptr_t sample_end, const void* data){
+                    auto cxx_array = static_cast<DataArrayBase*>(array);
+                    cxx_array->set_samples(sample_start, sample_end, data);
+                    return EQS_SUCCESS;
+                }, array, sample_start, sample_end, data);
+            };
+        }
+
         return array;
     }
 
@@ -1077,6 +1280,33 @@ public:
     /// The new array should be filled with zeros.
     virtual std::unique_ptr<DataArrayBase> create(std::vector<uintptr_t> shape) const = 0;
 
+    /// Same as `create(std::vector<uintptr_t>)`, with the shape given as
+    /// `shape_count` integers starting at `shape`. This is the overload called
+    /// from `eqs_array_t::create`, and the default implementation copies the
+    /// shape to a `std::vector` before calling the other overload.
+    virtual std::unique_ptr<DataArrayBase> create(const uintptr_t* shape, size_t shape_count) const {
+        return this->create(std::vector<uintptr_t>(shape, shape + shape_count));
+    }
+
+    /// Create a new array with the same options as the current one (data type,
+    /// data location, etc.) and the requested `shape`, without initializing
+    /// its data.
+    ///
+    /// This is used when all the entries of the new array will be set (with
+    /// `move_samples_from`) before being read. The default implementation
+    /// calls `create`.
+    virtual std::unique_ptr<DataArrayBase> create_uninit(std::vector<uintptr_t> shape) const {
+        return this->create(std::move(shape));
+    }
+
+    /// Same as `create_uninit(std::vector<uintptr_t>)`, with the shape given
+    /// as `shape_count` integers starting at `shape`. The default
+    /// implementation copies the shape to a `std::vector` before calling the
+    /// other overload.
+    virtual std::unique_ptr<DataArrayBase> create_uninit(const uintptr_t* shape, size_t shape_count) const {
+        return this->create_uninit(std::vector<uintptr_t>(shape, shape + shape_count));
+    }
+
 
     /// Get a pointer to the underlying data storage.
     ///
@@ -1085,12 +1315,70 @@ public:
     /// C-contiguous array.
     virtual double* data() = 0;
 
+    /// Get the type of the data stored in this array, as one of the
+    /// `EQS_DTYPE_XXX` constants. The default implementation returns
+    /// `EQS_DTYPE_FLOAT64`.
+    virtual eqs_dtype_t dtype() const {
+        return EQS_DTYPE_FLOAT64;
+    }
+
+    /// Get a pointer to the underlying data storage, regardless of the type of
+    /// the data (as given by `dtype()`).
+    ///
+    /// This function is allowed to fail if the data is not accessible in RAM,
+    /// or not stored as a C-contiguous array. The default implementation
+    /// calls `data()` for arrays containing 64-bit floating point values.
+    virtual void* raw_data() {
+        if (this->dtype() != EQS_DTYPE_FLOAT64) {
+            throw Error("raw_data() is not implemented for this array");
+        }
+        return this->data();
+    }
+
+    /// Is the data of this array accessible (as a single C-contiguous array
+    /// in host memory) with `raw_data()`?
+    ///
+    /// Arrays returning `false` (for example `SparseDataArray`, or arrays
+    /// storing their data on a GPU) must implement `get_samples()` and
+    /// `set_samples()`, which are then used to save and load the data a few
+    /// samples at the time. The default implementation returns `true`.
+    virtual bool raw_data_available() const {
+        return true;
+    }
+
+    /// Copy the values of the samples from `sample_start` to `sample_end`
+    /// (excluded) to `data`, as a C-contiguous array with the type given by
+    /// `dtype()`.
+    ///
+    /// This is only used for arrays where `raw_data_available()` returns
+    /// `false`, and the default implementation throws an exception.
+    virtual void get_samples(uintptr_t /*sample_start*/, uintptr_t /*sample_end*/, void* /*data*/) const {
+        throw Error("get_samples() is not implemented for this array");
+    }
+
+    /// Set the values of the samples from `sample_start` to `sample_end`
+    /// (excluded) from `data`, containing a C-contiguous array with the type
+    /// given by `dtype()`.
+    ///
+    /// This is only used for arrays where `raw_data_available()` returns
+    /// `false`, and the default implementation throws an exception.
+    virtual void set_samples(uintptr_t /*sample_start*/, uintptr_t /*sample_end*/, const void* /*data*/) {
+        throw Error("set_samples() is not implemented for this array");
+    }
+
     /// Get the shape of this array
     virtual const std::vector<uintptr_t>& shape() const = 0;
 
     /// Set the shape of this array to the given `shape`
     virtual void reshape(std::vector<uintptr_t> shape) = 0;
 
+    /// Same as `reshape(std::vector<uintptr_t>)`, with the shape given as
+    /// `shape_count` integers starting at `shape`. The default implementation
+    /// copies the shape to a `std::vector` before calling the other overload.
+    virtual void reshape(const uintptr_t* shape, size_t shape_count) {
+        this->reshape(std::vector<uintptr_t>(shape, shape + shape_count));
+    }
+
     /// Swap the axes `axis_1` and `axis_2` in this `array`.
     virtual void swap_axes(uintptr_t axis_1, uintptr_t axis_2) = 0;
 
@@ -1113,52 +1401,253 @@ public:
         uintptr_t property_end
     ) = 0;
 
+    /// Same as `move_samples_from(const DataArrayBase&,
+    /// std::vector<eqs_sample_mapping_t>, uintptr_t, uintptr_t)`, with the
+    /// samples given as `samples_count` entries starting at `samples`.
+    ///
+    /// This is the overload called from `eqs_array_t::move_samples_from`, and
+    /// the default implementation copies the samples to a `std::vector` before
+    /// calling the other overload. Implementations should override this
+    /// function to avoid the copy when moving large number of samples.
+    virtual void move_samples_from(
+        const DataArrayBase& input,
+        const eqs_sample_mapping_t* samples,
+        size_t samples_count,
+        uintptr_t property_start,
+        uintptr_t property_end
+    ) {
+        this->move_samples_from(
+            input,
+            std::vector<eqs_sample_mapping_t>(samples, samples + samples_count),
+            property_start,
+            property_end
+        );
+    }
+
+    /// Can `move_samples_from()` be called concurrently from multiple threads
+    /// with this array as the output, each call writing to different samples
+    /// or properties?
+    ///
+    /// This is used to set `eqs_array_t.concurrent_move_samples`, and the
+    /// default implementation returns `false`.
+    virtual bool concurrent_move_samples() const {
+        return false;
+    }
 };
 
 
-/// Very basic implementation of DataArrayBase in C++.
+namespace details {
+    /// Implementation of `DataArrayBase::move_samples_from` for arrays storing
+    /// their data as contiguous row-major `T` in memory. `input_data` and
+    /// `output_data` should contain the data for arrays with `input_shape`
+    /// and `output_shape` respectively, and `samples` should contain
+    /// `samples_count` entries.
+    template <typename T>
+    inline void move_samples_contiguous(
+        const T* input_data,
+        const std::vector<uintptr_t>& input_shape,
+        T* output_data,
+        const std::vector<uintptr_t>& output_shape,
+        const eqs_sample_mapping_t* samples,
+        size_t samples_count,
+        uintptr_t property_start,
+        uintptr_t property_end
+    ) {
+        assert(input_shape.size() == output_shape.size());
+
+        size_t property_count = property_end - property_start;
+        size_t property_dim = output_shape.size() - 1;
+        assert(input_shape[property_dim] == property_count);
+
+        // all the components are the same in input and output, so we can
+        // treat them together with the samples as a list of contiguous rows
+        size_t rows_per_sample = 1;
+        for (size_t i=1; i<property_dim; i++) {
+            assert(input_shape[i] == output_shape[i]);
+            rows_per_sample *= output_shape[i];
+        }
+
+        size_t output_property_count = output_shape[property_dim];
+        size_t input_sample_size = rows_per_sample * property_count;
+        size_t output_sample_size = rows_per_sample * output_property_count;
+        if (input_sample_size == 0) {
+            // nothing to copy
+            return;
+        }
+
+        size_t i = 0;
+        while (i < samples_count) {
+            // find runs of consecutive input and output samples, and copy
+            // them all at once
+            auto first = samples[i];
+            size_t run_length = 1;
+            while (i + run_length < samples_count
+                   && samples[i + run_length].input == first.input + run_length
+                   && samples[i + run_length].output == first.output + run_length) {
+                run_length += 1;
+            }
+
+            const T* input_start = input_data + first.input * input_sample_size;
+            T* output_start = output_data + first.output * output_sample_size;
+
+            if (property_count == output_property_count) {
+                // the property range covers the whole output, a run of
+                // samples is a single contiguous chunk of memory
+                std::memcpy(output_start, input_start, run_length * input_sample_size * sizeof(T));
+            } else {
+                output_start += property_start;
+                for (size_t row=0; row<run_length * rows_per_sample; row++) {
+                    std::memcpy(
+                        output_start + row * output_property_count,
+                        input_start + row * property_count,
+                        property_count * sizeof(T)
+                    );
+                }
+            }
+
+            i += run_length;
+        }
+    }
+}
+
+namespace details {
+    /// Get the `eqs_dtype_t` corresponding to the C++ type `T`
+    template <typename T> eqs_dtype_t dtype_of();
+
+    /// Get the `eqs_dtype_t` corresponding to the C++ type `T`
+    template <> inline eqs_dtype_t dtype_of<double>() {
+        return EQS_DTYPE_FLOAT64;
+    }
+
+    /// Get the `eqs_dtype_t` corresponding to the C++ type `T`
+    template <> inline eqs_dtype_t dtype_of<float>() {
+        return EQS_DTYPE_FLOAT32;
+    }
+
+    /// Name of the data origin used by `BasicSimpleDataArray<T>`
+    template <typename T> const char* simple_data_array_origin();
+
+    /// Name of the data origin used by `BasicSimpleDataArray<T>`
+    template <> inline const char* simple_data_array_origin<double>() {
+        return "equistore::SimpleDataArray";
+    }
+
+    /// Name of the data origin used by `BasicSimpleDataArray<T>`
+    template <> inline const char* simple_data_array_origin<float>() {
+        return "equistore::SimpleDataArray<float>";
+    }
+
+    /// Allocator for `std::vector` which default-initializes new elements
+    /// instead of value-initializing them. For arithmetic types, this means
+    /// that `std::vector<T, default_init_allocator<T>>(size)` does not
+    /// zero-fill the data.
+    template <typename T, typename Allocator = std::allocator<T>>
+    class default_init_allocator: public Allocator {
+        using traits = std::allocator_traits<Allocator>;
+    public:
+        template <typename U> struct rebind {
+            using other = default_init_allocator<U, typename traits::template rebind_alloc<U>>;
+        };
+
+        using Allocator::Allocator;
+
+        template <typename U>
+        void construct(U* ptr) noexcept(std::is_nothrow_default_constructible<U>::value) {
+            ::new(static_cast<void*>(ptr)) U;
+        }
+
+        template <typename U, typename... Args>
+        void construct(U* ptr, Args&&... args) {
+            traits::construct(static_cast<Allocator&>(*this), ptr, std::forward<Args>(args)...);
+        }
+    };
+
+    /// Get the data of a `std::vector<T>` as `double`, failing if `T` is not
+    /// `double`.
+    template <typename Allocator>
+    inline double* as_double_data(std::vector<double, Allocator>& data) {
+        return data.data();
+    }
+
+    /// Get the data of a `std::vector<T>` as `double`, failing if `T` is not
+    /// `double`.
+    template <typename Allocator>
+    inline double* as_double_data(std::vector<float, Allocator>&) {
+        throw Error(
+            "can not access the data of this array as double: it contains "
+            "32-bit floating point values, use raw_data() instead"
+        );
+    }
+}
+
+/// Very basic implementation of DataArrayBase in C++, storing values of type
+/// `T` (either `double` or `float`).
 ///
 /// This is included as an example implementation of DataArrayBase, and to make
 /// equistore usable without additional dependencies. For other uses cases, it
 /// might be better to implement DataArrayBase on your data, using
 /// functionalities from `Eigen`, `Boost.Array`, etc.
-class SimpleDataArray: public equistore::DataArrayBase {
+template <typename T>
+class BasicSimpleDataArray: public equistore::DataArrayBase {
 public:
-    /// Create a SimpleDataArray with the given `shape`, and all elements set to
-    /// `value`
-    SimpleDataArray(std::vector<uintptr_t> shape, double value = 0.0):
+    static_assert(
+        std::is_same<T, double>::value || std::is_same<T, float>::value,
+        "BasicSimpleDataArray can only store double or float"
+    );
+
+    /// Create a BasicSimpleDataArray with the given `shape`, and all elements
+    /// set to `value`
+    BasicSimpleDataArray(std::vector<uintptr_t> shape, T value = 0.0):
         shape_(std::move(shape)), data_(details::product(shape_), value) {}
 
-    /// Create a SimpleDataArray with the given `shape` and `data`.
+    /// Create a BasicSimpleDataArray with the given `shape` and `data`.
     ///
     /// The data is interpreted as a row-major n-dimensional array.
-    SimpleDataArray(std::vector<uintptr_t> shape, std::vector<double> data):
+    BasicSimpleDataArray(std::vector<uintptr_t> shape, std::vector<T> data):
         shape_(std::move(shape)),
-        data_(std::move(data))
+        data_(data.begin(), data.end())
     {
         if (data_.size() != details::product(shape_)) {
             throw Error("the shape and size of the data don't match in SimpleDataArray");
         }
     }
 
-    ~SimpleDataArray() override = default;
+    /// Create a BasicSimpleDataArray with the given `shape`, without
+    /// initializing its elements. All the elements must be set before being
+    /// read.
+    static BasicSimpleDataArray uninit(std::vector<uintptr_t> shape) {
+        auto array = BasicSimpleDataArray(std::vector<uintptr_t>{0});
+        array.data_ = storage_t(details::product(shape));
+        array.shape_ = std::move(shape);
+        return array;
+    }
 
-    /// SimpleDataArray can be copy-constructed
-    SimpleDataArray(const SimpleDataArray&) = default;
-    /// SimpleDataArray can be copy-assigned
-    SimpleDataArray& operator=(const SimpleDataArray&) = default;
-    /// SimpleDataArray can be move-constructed
-    SimpleDataArray(SimpleDataArray&&) noexcept = default;
-    /// SimpleDataArray can be move-assigned
-    SimpleDataArray& operator=(SimpleDataArray&&) noexcept = default;
+    ~BasicSimpleDataArray() override = default;
+
+    /// BasicSimpleDataArray can be copy-constructed
+    BasicSimpleDataArray(const BasicSimpleDataArray&) = default;
+    /// BasicSimpleDataArray can be copy-assigned
+    BasicSimpleDataArray& operator=(const BasicSimpleDataArray&) = default;
+    /// BasicSimpleDataArray can be move-constructed
+    BasicSimpleDataArray(BasicSimpleDataArray&&) noexcept = default;
+    /// BasicSimpleDataArray can be move-assigned
+    BasicSimpleDataArray& operator=(BasicSimpleDataArray&&) noexcept = default;
 
     eqs_data_origin_t origin() const override {
         eqs_data_origin_t origin = 0;
-        eqs_register_data_origin("equistore::SimpleDataArray", &origin);
+        eqs_register_data_origin(details::simple_data_array_origin<T>(), &origin);
         return origin;
     }
 
+    eqs_dtype_t dtype() const override {
+        return details::dtype_of<T>();
+    }
+
     double* data() override {
+        return details::as_double_data(data_);
+    }
+
+    void* raw_data() override {
         return data_.data();
     }
 
@@ -1173,8 +1662,16 @@ public:
         shape_ = std::move(shape);
     }
 
+    void reshape(const uintptr_t* shape, size_t shape_count) override {
+        if (details::product(shape_) != details::product(shape, shape_count)) {
+            throw equistore::Error("invalid shape in reshape");
+        }
+        shape_.assign(shape, shape + shape_count);
+    }
+
     void swap_axes(uintptr_t axis_1, uintptr_t axis_2) override {
-        auto new_data = std::vector<double>(details::product(shape_), 0.0);
+        // all the elements are set below
+        auto new_data = storage_t(details::product(shape_));
         auto new_shape = shape_;
         std::swap(new_shape[axis_1], new_shape[axis_2]);
 
@@ -1190,11 +1687,17 @@ public:
     }
 
     std::unique_ptr<DataArrayBase> copy() const override {
-        return std::unique_ptr<DataArrayBase>(new SimpleDataArray(*this));
+        return std::unique_ptr<DataArrayBase>(new BasicSimpleDataArray(*this));
     }
 
+    using DataArrayBase::create;
     std::unique_ptr<DataArrayBase> create(std::vector<uintptr_t> shape) const override {
-        return std::unique_ptr<DataArrayBase>(new SimpleDataArray(std::move(shape)));
+        return std::unique_ptr<DataArrayBase>(new BasicSimpleDataArray(std::move(shape)));
+    }
+
+    using DataArrayBase::create_uninit;
+    std::unique_ptr<DataArrayBase> create_uninit(std::vector<uintptr_t> shape) const override {
+        return std::unique_ptr<DataArrayBase>(new BasicSimpleDataArray(BasicSimpleDataArray::uninit(std::move(shape))));
     }
 
     void move_samples_from(
@@ -1203,151 +1706,814 @@ public:
         uintptr_t property_start,
         uintptr_t property_end
     ) override {
-        const auto& input_array = dynamic_cast<const SimpleDataArray&>(input);
-        assert(input_array.shape_.size() == this->shape_.size());
-
-        size_t property_count = property_end - property_start;
-        size_t property_dim = shape_.size() - 1;
-        assert(input_array.shape_[property_dim] == property_count);
-
-        auto input_index = std::vector<size_t>(shape_.size(), 0);
-        auto output_index = std::vector<size_t>(shape_.size(), 0);
-
-        for (const auto& sample: samples) {
-            input_index[0] = sample.input;
-            output_index[0] = sample.output;
-
-            if (property_dim == 1) {
-                // no components
-                for (size_t property_i=0; property_i<property_count; property_i++) {
-                    input_index[property_dim] = property_i;
-                    output_index[property_dim] = property_i + property_start;
+        this->move_samples_from(input, samples.data(), samples.size(), property_start, property_end);
+    }
 
-                    auto value = input_array.data_[details::linear_index(input_array.shape_, input_index)];
-                    this->data_[details::linear_index(shape_, output_index)] = value;
-                }
-            } else {
-                auto last_component_dim = shape_.size() - 2;
-                for (size_t component_i=1; component_i<shape_.size() - 1; component_i++) {
-                    input_index[component_i] = 0;
-                }
+    void move_samples_from(
+        const DataArrayBase& input,
+        const eqs_sample_mapping_t* samples,
+        size_t samples_count,
+        uintptr_t property_start,
+        uintptr_t property_end
+    ) override {
+        const auto& input_array = dynamic_cast<const BasicSimpleDataArray&>(input);
+        details::move_samples_contiguous(
+            input_array.data_.data(),
+            input_array.shape_,
+            this->data_.data(),
+            this->shape_,
+            samples,
+            samples_count,
+            property_start,
+            property_end
+        );
+    }
 
-                bool done = false;
-                while (!done) {
-                    for (size_t component_i=1; component_i<shape_.size() - 1; component_i++) {
-                        output_index[component_i] = input_index[component_i];
-                    }
-
-                    for (size_t property_i=0; property_i<property_count; property_i++) {
-                        input_index[property_dim] = property_i;
-                        output_index[property_dim] = property_i + property_start;
-
-                        auto value = input_array.data_[details::linear_index(input_array.shape_, input_index)];
-                        this->data_[details::linear_index(shape_, output_index)] = value;
-                    }
-
-                    input_index[last_component_dim] += 1;
-                    for (size_t component_i=last_component_dim; component_i>2; component_i--) {
-                        if (input_index[component_i] >= shape_[component_i]) {
-                            input_index[component_i] = 0;
-                            input_index[component_i - 1] += 1;
-                        }
-                    }
-
-                    if (input_index[1] >= shape_[1]) {
-                        done = true;
-                    }
-                }
-            }
-        }
+    bool concurrent_move_samples() const override {
+        // calls with different samples or properties write to different
+        // parts of memory
+        return true;
     }
 
-    /// Get a const view of the data managed by this SimpleDataArray
-    NDArray<double> view() const {
-        return NDArray<double>(data_.data(), shape_);
+    /// Get a const view of the data managed by this BasicSimpleDataArray
+    NDArray<T> view() const {
+        return NDArray<T>(data_.data(), shape_);
     }
 
-    /// Get a mutable view of the data managed by this SimpleDataArray
-    NDArray<double> view() {
-        return NDArray<double>(data_.data(), shape_);
+    /// Get a mutable view of the data managed by this BasicSimpleDataArray
+    NDArray<T> view() {
+        return NDArray<T>(data_.data(), shape_);
     }
 
-    /// Extract a reference to SimpleDataArray out of an `eqs_array_t`.
+    /// Extract a reference to BasicSimpleDataArray out of an `eqs_array_t`.
     ///
     /// This function fails if the `eqs_array_t` does not contain a
-    /// SimpleDataArray.
-    static SimpleDataArray& from_eqs_array(eqs_array_t& array) {
-        eqs_data_origin_t origin = 0;
-        auto status = array.origin(array.ptr, &origin);
-        if (status != EQS_SUCCESS) {
-            throw Error("failed to get data origin");
-        }
-
-        char buffer[64] = {0};
-        status = eqs_get_data_origin(origin, buffer, 64);
-        if (status != EQS_SUCCESS || std::string(buffer) != "equistore::SimpleDataArray") {
-            throw Error("this array is not an equistore::SimpleDataArray");
-        }
-
+    /// BasicSimpleDataArray with the same type `T`.
+    static BasicSimpleDataArray& from_eqs_array(eqs_array_t& array) {
+        BasicSimpleDataArray::check_origin(array);
         auto* base = static_cast<DataArrayBase*>(array.ptr);
-        return dynamic_cast<SimpleDataArray&>(*base);
+        return dynamic_cast<BasicSimpleDataArray&>(*base);
     }
 
-    /// Extract a const reference to SimpleDataArray out of an `eqs_array_t`.
+    /// Extract a const reference to BasicSimpleDataArray out of an
+    /// `eqs_array_t`.
     ///
     /// This function fails if the `eqs_array_t` does not contain a
-    /// SimpleDataArray.
-    static const SimpleDataArray& from_eqs_array(const eqs_array_t& array) {
+    /// BasicSimpleDataArray with the same type `T`.
+    static const BasicSimpleDataArray& from_eqs_array(const eqs_array_t& array) {
+        BasicSimpleDataArray::check_origin(array);
+        const auto* base = static_cast<const DataArrayBase*>(array.ptr);
+        return dynamic_cast<const BasicSimpleDataArray&>(*base);
+    }
+
+    /// Two BasicSimpleDataArray compare as equal if they have the exact same
+    /// shape and data.
+    friend bool operator==(const BasicSimpleDataArray& lhs, const BasicSimpleDataArray& rhs) {
+        return lhs.shape_ == rhs.shape_ && lhs.data_ == rhs.data_;
+    }
+
+    /// Two BasicSimpleDataArray compare as equal if they have the exact same
+    /// shape and data.
+    friend bool operator!=(const BasicSimpleDataArray& lhs, const BasicSimpleDataArray& rhs) {
+        return !(lhs == rhs);
+    }
+
+private:
+    static void check_origin(const eqs_array_t& array) {
         eqs_data_origin_t origin = 0;
         auto status = array.origin(array.ptr, &origin);
         if (status != EQS_SUCCESS) {
             throw Error("failed to get data origin");
         }
 
+        auto expected = std::string(details::simple_data_array_origin<T>());
         char buffer[64] = {0};
         status = eqs_get_data_origin(origin, buffer, 64);
-        if (status != EQS_SUCCESS || std::string(buffer) != "equistore::SimpleDataArray") {
-            throw Error("this array is not an equistore::SimpleDataArray");
+        if (status != EQS_SUCCESS || std::string(buffer) != expected) {
+            throw Error("this array is not an " + expected);
         }
-
-        const auto* base = static_cast<const DataArrayBase*>(array.ptr);
-        return dynamic_cast<const SimpleDataArray&>(*base);
     }
 
-private:
-    std::vector<uintptr_t> shape_;
-    std::vector<double> data_;
+    // the data is stored with an allocator which does not zero-fill new
+    // elements, to allow creating uninitialized arrays
+    using storage_t = std::vector<T, details::default_init_allocator<T>>;
 
-    friend bool operator==(const SimpleDataArray& lhs, const SimpleDataArray& rhs);
+    std::vector<uintptr_t> shape_;
+    storage_t data_;
 };
 
-/// Two SimpleDataArray compare as equal if they have the exact same shape and
-/// data.
-inline bool operator==(const SimpleDataArray& lhs, const SimpleDataArray& rhs) {
-    return lhs.shape_ == rhs.shape_ && lhs.data_ == rhs.data_;
-}
+/// Simple implementation of DataArrayBase, storing 64-bit floating point
+/// values
+using SimpleDataArray = BasicSimpleDataArray<double>;
 
-/// Two SimpleDataArray compare as equal if they have the exact same shape and
-/// data.
-inline bool operator!=(const SimpleDataArray& lhs, const SimpleDataArray& rhs) {
-    return !(lhs == rhs);
-}
+/// Simple implementation of DataArrayBase, storing 32-bit floating point
+/// values
+using SimpleDataArrayF32 = BasicSimpleDataArray<float>;
 
 
-/******************************************************************************/
-/******************************************************************************/
-/******************************************************************************/
+namespace details {
+    /// Memory-mapping of a full file, used by `TensorMap::load_mmap`.
+    ///
+    /// The file is mapped with copy-on-write semantics: the mapped memory can
+    /// be modified, but the changes are private to this process and are never
+    /// written back to the file.
+    class MemoryMap {
+    public:
+        /// Map the whole file at `path` in memory
+        explicit MemoryMap(const std::string& path) {
+        #ifdef _WIN32
+            auto file = CreateFileA(
+                path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr
+            );
+            if (file == INVALID_HANDLE_VALUE) {
+                throw Error("failed to open '" + path + "' for memory mapping");
+            }
 
+            LARGE_INTEGER size;
+            if (!GetFileSizeEx(file, &size)) {
+                CloseHandle(file);
+                throw Error("failed to get the size of '" + path + "'");
+            }
+            size_ = static_cast<size_t>(size.QuadPart);
 
-/// Basic building block for a tensor map.
+            auto mapping = CreateFileMappingA(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+            CloseHandle(file);
+            if (mapping == nullptr) {
+                throw Error("failed to memory map '" + path + "'");
+            }
+
+            // the view keeps a reference to the mapping, we can close the
+            // handle right away
+            data_ = static_cast<uint8_t*>(MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0));
+            CloseHandle(mapping);
+            if (data_ == nullptr) {
+                throw Error("failed to memory map '" + path + "'");
+            }
+        #else
+            auto fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0) {
+                throw Error("failed to open '" + path + "' for memory mapping: " + std::strerror(errno));
+            }
+
+            struct stat file_stat;
+            if (::fstat(fd, &file_stat) != 0) {
+                auto error = std::string(std::strerror(errno));
+                ::close(fd);
+                throw Error("failed to get the size of '" + path + "': " + error);
+            }
+            size_ = static_cast<size_t>(file_stat.st_size);
+
+            auto* ptr = ::mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+            auto error = std::string(std::strerror(errno));
+            // the mapping stays valid after the file descriptor is closed
+            ::close(fd);
+            if (ptr == MAP_FAILED) {
+                throw Error("failed to memory map '" + path + "': " + error);
+            }
+            data_ = static_cast<uint8_t*>(ptr);
+        #endif
+        }
+
+        ~MemoryMap() {
+        #ifdef _WIN32
+            UnmapViewOfFile(data_);
+        #else
+            ::munmap(data_, size_);
+        #endif
+        }
+
+        /// MemoryMap is not copy-constructible
+        MemoryMap(const MemoryMap&) = delete;
+        /// MemoryMap can not be copy-assigned
+        MemoryMap& operator=(const MemoryMap&) = delete;
+        /// MemoryMap is not move-constructible
+        MemoryMap(MemoryMap&&) = delete;
+        /// MemoryMap can not be move-assigned
+        MemoryMap& operator=(MemoryMap&&) = delete;
+
+        /// Get the pointer to the start of the mapped memory
+        uint8_t* data() const {
+            return data_;
+        }
+
+        /// Get the size of the mapped memory in bytes
+        size_t size() const {
+            return size_;
+        }
+
+    private:
+        uint8_t* data_ = nullptr;
+        size_t size_ = 0;
+    };
+}
+
+/// Implementation of DataArrayBase for arrays loaded with
+/// `TensorMap::load_mmap`.
 ///
-/// A single block contains a n-dimensional `eqs_array_t` (or `DataArrayBase`),
-/// and n sets of `Labels` (one for each dimension). The first dimension is the
-/// *samples* dimension, the last dimension is the *properties* dimension. Any
-/// intermediate dimension is called a *component* dimension.
+/// The data of these arrays can either live directly inside a memory-mapped
+/// file, which is kept alive as long as any array uses it; or be owned by the
+/// array (for arrays created with `copy()`, `create()`, or if the data in the
+/// file could not be used directly).
 ///
-/// Samples should be used to describe *what* we are representing, while
-/// properties should contain information about *how* we are representing it.
+/// Arrays inside a memory-mapped file can still be modified, but modifications
+/// are not written back to the file.
+class MmapDataArray: public equistore::DataArrayBase {
+public:
+    /// Create a MmapDataArray owning its data with the given `shape`, and all
+    /// elements set to zero.
+    explicit MmapDataArray(std::vector<uintptr_t> shape):
+        mapping_(nullptr),
+        owned_(details::product(shape), 0.0),
+        data_(owned_.data()),
+        shape_(std::move(shape)) {}
+
+    /// Create a MmapDataArray with the given `shape`, using the data at `data`
+    /// inside the memory-mapped file `mapping`.
+    ///
+    /// `data` must point inside the `mapping`, to enough memory to contain all
+    /// the elements of an array with the given `shape`.
+    MmapDataArray(std::shared_ptr<details::MemoryMap> mapping, double* data, std::vector<uintptr_t> shape):
+        mapping_(std::move(mapping)),
+        owned_(),
+        data_(data),
+        shape_(std::move(shape)) {}
+
+    ~MmapDataArray() override = default;
+
+    /// MmapDataArray is not copy-constructible, use `copy()` instead
+    MmapDataArray(const MmapDataArray&) = delete;
+    /// MmapDataArray can not be copy-assigned
+    MmapDataArray& operator=(const MmapDataArray&) = delete;
+    /// MmapDataArray can be move-constructed
+    MmapDataArray(MmapDataArray&&) noexcept = default;
+    /// MmapDataArray can be move-assigned
+    MmapDataArray& operator=(MmapDataArray&&) noexcept = default;
+
+    eqs_data_origin_t origin() const override {
+        eqs_data_origin_t origin = 0;
+        eqs_register_data_origin("equistore::MmapDataArray", &origin);
+        return origin;
+    }
+
+    double* data() override {
+        return data_;
+    }
+
+    const std::vector<uintptr_t>& shape() const override {
+        return shape_;
+    }
+
+    void reshape(std::vector<uintptr_t> shape) override {
+        if (details::product(shape_) != details::product(shape)) {
+            throw equistore::Error("invalid shape in reshape");
+        }
+        shape_ = std::move(shape);
+    }
+
+    void reshape(const uintptr_t* shape, size_t shape_count) override {
+        if (details::product(shape_) != details::product(shape, shape_count)) {
+            throw equistore::Error("invalid shape in reshape");
+        }
+        shape_.assign(shape, shape + shape_count);
+    }
+
+    void swap_axes(uintptr_t axis_1, uintptr_t axis_2) override {
+        auto new_data = std::vector<double>(details::product(shape_), 0.0);
+        auto new_shape = shape_;
+        std::swap(new_shape[axis_1], new_shape[axis_2]);
+
+        for (size_t i=0; i<details::product(shape_); i++) {
+            auto index = details::cartesian_index(shape_, i);
+            std::swap(index[axis_1], index[axis_2]);
+
+            new_data[details::linear_index(new_shape, index)] = data_[i];
+        }
+
+        // the data is no longer stored in the file
+        mapping_.reset();
+        owned_ = std::move(new_data);
+        data_ = owned_.data();
+        shape_ = std::move(new_shape);
+    }
+
+    std::unique_ptr<DataArrayBase> copy() const override {
+        auto copy = std::unique_ptr<MmapDataArray>(new MmapDataArray(shape_));
+        auto size = details::product(shape_);
+        if (size != 0) {
+            std::memcpy(copy->data_, data_, size * sizeof(double));
+        }
+        return std::unique_ptr<DataArrayBase>(std::move(copy));
+    }
+
+    using DataArrayBase::create;
+    std::unique_ptr<DataArrayBase> create(std::vector<uintptr_t> shape) const override {
+        return std::unique_ptr<DataArrayBase>(new MmapDataArray(std::move(shape)));
+    }
+
+    void move_samples_from(
+        const DataArrayBase& input,
+        std::vector<eqs_sample_mapping_t> samples,
+        uintptr_t property_start,
+        uintptr_t property_end
+    ) override {
+        this->move_samples_from(input, samples.data(), samples.size(), property_start, property_end);
+    }
+
+    void move_samples_from(
+        const DataArrayBase& input,
+        const eqs_sample_mapping_t* samples,
+        size_t samples_count,
+        uintptr_t property_start,
+        uintptr_t property_end
+    ) override {
+        const auto& input_array = dynamic_cast<const MmapDataArray&>(input);
+        details::move_samples_contiguous(
+            input_array.data_,
+            input_array.shape_,
+            this->data_,
+            this->shape_,
+            samples,
+            samples_count,
+            property_start,
+            property_end
+        );
+    }
+
+    bool concurrent_move_samples() const override {
+        // calls with different samples or properties write to different
+        // parts of memory
+        return true;
+    }
+
+    /// Is the data of this array stored inside a memory-mapped file?
+    bool is_mapped() const {
+        return mapping_ != nullptr;
+    }
+
+    /// Get a const view of the data managed by this MmapDataArray
+    NDArray<double> view() const {
+        return NDArray<double>(static_cast<const double*>(data_), shape_);
+    }
+
+    /// Get a mutable view of the data managed by this MmapDataArray
+    NDArray<double> view() {
+        return NDArray<double>(data_, shape_);
+    }
+
+    /// Extract a const reference to MmapDataArray out of an `eqs_array_t`.
+    ///
+    /// This function fails if the `eqs_array_t` does not contain a
+    /// MmapDataArray.
+    static const MmapDataArray& from_eqs_array(const eqs_array_t& array) {
+        eqs_data_origin_t origin = 0;
+        auto status = array.origin(array.ptr, &origin);
+        if (status != EQS_SUCCESS) {
+            throw Error("failed to get data origin");
+        }
+
+        char buffer[64] = {0};
+        status = eqs_get_data_origin(origin, buffer, 64);
+        if (status != EQS_SUCCESS || std::string(buffer) != "equistore::MmapDataArray") {
+            throw Error("this array is not an equistore::MmapDataArray");
+        }
+
+        const auto* base = static_cast<const DataArrayBase*>(array.ptr);
+        return dynamic_cast<const MmapDataArray&>(*base);
+    }
+
+private:
+    std::shared_ptr<details::MemoryMap> mapping_;
+    std::vector<double> owned_;
+    double* data_;
+    std::vector<uintptr_t> shape_;
+};
+
+
+/// Implementation of DataArrayBase storing only the non-zero values, for
+/// arrays containing mostly zeros.
+///
+/// The data is stored as one sparse row for each sample, containing the
+/// non-zero values and their position in the flattened components and
+/// properties dimensions. This is the compressed sparse row (CSR) format for
+/// the array seen as a matrix of size `n_samples x (n_components x
+/// n_properties)`, with each row stored separately to be able to set the data
+/// of any sample in `move_samples_from`.
+///
+/// All the operations on blocks and tensor maps (`keys_to_properties`,
+/// `keys_to_samples`, `components_to_properties`, `join_samples`, ...) work
+/// directly on the sparse data. When saving and loading, the data is converted
+/// from and to the sparse representation a few samples at the time, without
+/// creating a dense version of the whole array. To load data as a
+/// `SparseDataArray`, use `details::sparse_create_array` as the `create_array`
+/// callback.
+///
+/// The data of a SparseDataArray can not be accessed with `data()` or
+/// `raw_data()`, use `to_dense()` to get a dense copy of the data instead.
+class SparseDataArray: public equistore::DataArrayBase {
+public:
+    /// Create a SparseDataArray with the given `shape`, and all elements set
+    /// to zero.
+    explicit SparseDataArray(std::vector<uintptr_t> shape):
+        shape_(std::move(shape)),
+        rows_(),
+        mutex_(new std::mutex())
+    {
+        if (shape_.empty()) {
+            throw Error("SparseDataArray must have at least one dimension");
+        }
+        rows_.resize(shape_[0]);
+    }
+
+    /// Create a SparseDataArray with the given `shape`, containing the
+    /// non-zero values of `data`.
+    ///
+    /// The data is interpreted as a row-major n-dimensional array.
+    SparseDataArray(std::vector<uintptr_t> shape, const std::vector<double>& data):
+        SparseDataArray(std::move(shape))
+    {
+        if (data.size() != details::product(shape_)) {
+            throw Error("the shape and size of the data don't match in SparseDataArray");
+        }
+        this->set_samples(0, shape_[0], data.data());
+    }
+
+    ~SparseDataArray() override = default;
+
+    /// SparseDataArray can be copy-constructed
+    SparseDataArray(const SparseDataArray& other):
+        shape_(other.shape_),
+        rows_(other.rows_),
+        mutex_(new std::mutex()) {}
+
+    /// SparseDataArray can be copy-assigned
+    SparseDataArray& operator=(const SparseDataArray& other) {
+        if (this != &other) {
+            shape_ = other.shape_;
+            rows_ = other.rows_;
+        }
+        return *this;
+    }
+
+    /// SparseDataArray can be move-constructed
+    SparseDataArray(SparseDataArray&&) noexcept = default;
+    /// SparseDataArray can be move-assigned
+    SparseDataArray& operator=(SparseDataArray&&) noexcept = default;
+
+    eqs_data_origin_t origin() const override {
+        eqs_data_origin_t origin = 0;
+        eqs_register_data_origin("equistore::SparseDataArray", &origin);
+        return origin;
+    }
+
+    double* data() override {
+        throw Error(
+            "can not access the data of a SparseDataArray as a dense array, "
+            "use to_dense() instead"
+        );
+    }
+
+    const std::vector<uintptr_t>& shape() const override {
+        return shape_;
+    }
+
+    void reshape(std::vector<uintptr_t> shape) override {
+        this->reshape(shape.data(), shape.size());
+    }
+
+    void reshape(const uintptr_t* shape, size_t shape_count) override {
+        if (shape_count == 0 || details::product(shape_) != details::product(shape, shape_count)) {
+            throw equistore::Error("invalid shape in reshape");
+        }
+
+        if (shape[0] != shape_[0]) {
+            // the linear index of the values stays the same, but they are
+            // distributed differently between the rows
+            auto row_size = this->row_size();
+            auto new_row_size = details::product(shape + 1, shape_count - 1);
+
+            auto new_rows = std::vector<Row>(shape[0]);
+            for (size_t i=0; i<rows_.size(); i++) {
+                const auto& row = rows_[i];
+                for (size_t j=0; j<row.columns.size(); j++) {
+                    auto index = i * row_size + row.columns[j];
+                    auto& new_row = new_rows[index / new_row_size];
+                    new_row.columns.push_back(index % new_row_size);
+                    new_row.values.push_back(row.values[j]);
+                }
+            }
+
+            rows_ = std::move(new_rows);
+        }
+
+        shape_.assign(shape, shape + shape_count);
+    }
+
+    void swap_axes(uintptr_t axis_1, uintptr_t axis_2) override {
+        if (axis_1 >= shape_.size() || axis_2 >= shape_.size()) {
+            throw Error("invalid axis in swap_axes");
+        }
+
+        if (axis_1 == axis_2) {
+            return;
+        }
+
+        auto new_shape = shape_;
+        std::swap(new_shape[axis_1], new_shape[axis_2]);
+
+        auto new_rows = std::vector<Row>(new_shape[0]);
+        auto index = std::vector<uintptr_t>(shape_.size(), 0);
+        for (size_t i=0; i<rows_.size(); i++) {
+            const auto& row = rows_[i];
+            for (size_t j=0; j<row.columns.size(); j++) {
+                // get the full index of this value, and swap the axes
+                index[0] = i;
+                auto column = row.columns[j];
+                for (size_t dim=shape_.size() - 1; dim>0; dim--) {
+                    index[dim] = column % shape_[dim];
+                    column /= shape_[dim];
+                }
+                std::swap(index[axis_1], index[axis_2]);
+
+                auto new_column = uintptr_t(0);
+                for (size_t dim=1; dim<new_shape.size(); dim++) {
+                    new_column = new_column * new_shape[dim] + index[dim];
+                }
+
+                auto& new_row = new_rows[index[0]];
+                new_row.columns.push_back(new_column);
+                new_row.values.push_back(row.values[j]);
+            }
+        }
+
+        for (auto& row: new_rows) {
+            row.sort();
+        }
+
+        shape_ = std::move(new_shape);
+        rows_ = std::move(new_rows);
+    }
+
+    std::unique_ptr<DataArrayBase> copy() const override {
+        return std::unique_ptr<DataArrayBase>(new SparseDataArray(*this));
+    }
+
+    using DataArrayBase::create;
+    std::unique_ptr<DataArrayBase> create(std::vector<uintptr_t> shape) const override {
+        return std::unique_ptr<DataArrayBase>(new SparseDataArray(std::move(shape)));
+    }
+
+    void move_samples_from(
+        const DataArrayBase& input,
+        std::vector<eqs_sample_mapping_t> samples,
+        uintptr_t property_start,
+        uintptr_t property_end
+    ) override {
+        this->move_samples_from(input, samples.data(), samples.size(), property_start, property_end);
+    }
+
+    void move_samples_from(
+        const DataArrayBase& input,
+        const eqs_sample_mapping_t* samples,
+        size_t samples_count,
+        uintptr_t property_start,
+        uintptr_t property_end
+    ) override {
+        const auto& input_array = dynamic_cast<const SparseDataArray&>(input);
+
+        auto input_properties = input_array.shape_.back();
+        auto output_properties = shape_.back();
+        assert(property_end - property_start == input_properties);
+
+        // different threads can move data to different properties of the
+        // same sample at the same time
+        std::lock_guard<std::mutex> lock(*mutex_);
+
+        for (size_t i=0; i<samples_count; i++) {
+            const auto& input_row = input_array.rows_[samples[i].input];
+            auto& output_row = rows_[samples[i].output];
+
+            if (property_start == 0 && property_end == output_properties) {
+                output_row = input_row;
+                continue;
+            }
+
+            // merge the existing values outside of the property range with
+            // the new values, keeping the columns sorted
+            auto merged = Row();
+            merged.columns.reserve(output_row.columns.size() + input_row.columns.size());
+            merged.values.reserve(output_row.columns.size() + input_row.columns.size());
+
+            size_t existing = 0;
+            for (size_t j=0; j<input_row.columns.size(); j++) {
+                auto component = input_row.columns[j] / input_properties;
+                auto property = input_row.columns[j] % input_properties;
+                auto column = component * output_properties + property_start + property;
+
+                for (; existing<output_row.columns.size() && output_row.columns[existing] < column; existing++) {
+                    merged.push_existing(output_row, existing, property_start, property_end, output_properties);
+                }
+
+                merged.columns.push_back(column);
+                merged.values.push_back(input_row.values[j]);
+            }
+
+            for (; existing<output_row.columns.size(); existing++) {
+                merged.push_existing(output_row, existing, property_start, property_end, output_properties);
+            }
+
+            output_row = std::move(merged);
+        }
+    }
+
+    bool raw_data_available() const override {
+        return false;
+    }
+
+    void get_samples(uintptr_t sample_start, uintptr_t sample_end, void* data) const override {
+        if (sample_start > sample_end || sample_end > rows_.size()) {
+            throw Error("invalid samples range in SparseDataArray::get_samples");
+        }
+
+        auto row_size = this->row_size();
+        auto* output = static_cast<double*>(data);
+        std::fill(output, output + (sample_end - sample_start) * row_size, 0.0);
+
+        for (auto sample=sample_start; sample<sample_end; sample++) {
+            const auto& row = rows_[sample];
+            auto* output_row = output + (sample - sample_start) * row_size;
+            for (size_t j=0; j<row.columns.size(); j++) {
+                output_row[row.columns[j]] = row.values[j];
+            }
+        }
+    }
+
+    void set_samples(uintptr_t sample_start, uintptr_t sample_end, const void* data) override {
+        if (sample_start > sample_end || sample_end > rows_.size()) {
+            throw Error("invalid samples range in SparseDataArray::set_samples");
+        }
+
+        auto row_size = this->row_size();
+        const auto* input = static_cast<const double*>(data);
+        for (auto sample=sample_start; sample<sample_end; sample++) {
+            auto& row = rows_[sample];
+            row.columns.clear();
+            row.values.clear();
+
+            const auto* input_row = input + (sample - sample_start) * row_size;
+            for (size_t column=0; column<row_size; column++) {
+                if (input_row[column] != 0.0) {
+                    row.columns.push_back(column);
+                    row.values.push_back(input_row[column]);
+                }
+            }
+        }
+    }
+
+    /// Get the number of non-zero values stored in this array
+    size_t non_zero_count() const {
+        size_t count = 0;
+        for (const auto& row: rows_) {
+            count += row.values.size();
+        }
+        return count;
+    }
+
+    /// Get a dense copy of the data in this array
+    SimpleDataArray to_dense() const {
+        auto dense = SimpleDataArray(shape_);
+        if (!rows_.empty()) {
+            this->get_samples(0, rows_.size(), dense.data());
+        }
+        return dense;
+    }
+
+    /// Extract a reference to SparseDataArray out of an `eqs_array_t`.
+    ///
+    /// This function fails if the `eqs_array_t` does not contain a
+    /// SparseDataArray.
+    static SparseDataArray& from_eqs_array(eqs_array_t& array) {
+        SparseDataArray::check_origin(array);
+        auto* base = static_cast<DataArrayBase*>(array.ptr);
+        return dynamic_cast<SparseDataArray&>(*base);
+    }
+
+    /// Extract a const reference to SparseDataArray out of an `eqs_array_t`.
+    ///
+    /// This function fails if the `eqs_array_t` does not contain a
+    /// SparseDataArray.
+    static const SparseDataArray& from_eqs_array(const eqs_array_t& array) {
+        SparseDataArray::check_origin(array);
+        const auto* base = static_cast<const DataArrayBase*>(array.ptr);
+        return dynamic_cast<const SparseDataArray&>(*base);
+    }
+
+    /// Two SparseDataArray compare as equal if they have the exact same shape
+    /// and data.
+    friend bool operator==(const SparseDataArray& lhs, const SparseDataArray& rhs) {
+        if (lhs.shape_ != rhs.shape_) {
+            return false;
+        }
+
+        for (size_t i=0; i<lhs.rows_.size(); i++) {
+            if (lhs.rows_[i].columns != rhs.rows_[i].columns || lhs.rows_[i].values != rhs.rows_[i].values) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    /// Two SparseDataArray compare as equal if they have the exact same shape
+    /// and data.
+    friend bool operator!=(const SparseDataArray& lhs, const SparseDataArray& rhs) {
+        return !(lhs == rhs);
+    }
+
+private:
+    /// Non-zero values for a single sample
+    struct Row {
+        /// Position of the values in the flattened components and properties
+        std::vector<uintptr_t> columns;
+        /// Values corresponding to each entry in `columns`
+        std::vector<double> values;
+
+        /// Sort the values in this row by column
+        void sort() {
+            if (std::is_sorted(columns.begin(), columns.end())) {
+                return;
+            }
+
+            auto order = std::vector<size_t>(columns.size());
+            for (size_t i=0; i<order.size(); i++) {
+                order[i] = i;
+            }
+            std::sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+                return columns[a] < columns[b];
+            });
+
+            auto sorted = Row();
+            sorted.columns.reserve(columns.size());
+            sorted.values.reserve(values.size());
+            for (auto i: order) {
+                sorted.columns.push_back(columns[i]);
+                sorted.values.push_back(values[i]);
+            }
+            *this = std::move(sorted);
+        }
+
+        /// Add the value at position `i` in `other` to this row, unless its
+        /// property is between `property_start` and `property_end`
+        void push_existing(const Row& other, size_t i, size_t property_start, size_t property_end, size_t n_properties) {
+            auto property = other.columns[i] % n_properties;
+            if (property < property_start || property >= property_end) {
+                columns.push_back(other.columns[i]);
+                values.push_back(other.values[i]);
+            }
+        }
+    };
+
+    /// Get the number of values in a single sample
+    size_t row_size() const {
+        return details::product(shape_.data() + 1, shape_.size() - 1);
+    }
+
+    static void check_origin(const eqs_array_t& array) {
+        eqs_data_origin_t origin = 0;
+        auto status = array.origin(array.ptr, &origin);
+        if (status != EQS_SUCCESS) {
+            throw Error("failed to get data origin");
+        }
+
+        char buffer[64] = {0};
+        status = eqs_get_data_origin(origin, buffer, 64);
+        if (status != EQS_SUCCESS || std::string(buffer) != "equistore::SparseDataArray") {
+            throw Error("this array is not an equistore::SparseDataArray");
+        }
+    }
+
+    std::vector<uintptr_t> shape_;
+    std::vector<Row> rows_;
+    /// Protects `rows_` in `move_samples_from`, which can be called from
+    /// multiple threads at the same time
+    std::unique_ptr<std::mutex> mutex_;
+};
+
+
+/******************************************************************************/
+/******************************************************************************/
+/******************************************************************************/
+
+
+/// Basic building block for a tensor map.
+///
+/// A single block contains a n-dimensional `eqs_array_t` (or `DataArrayBase`),
+/// and n sets of `Labels` (one for each dimension). The first dimension is the
+/// *samples* dimension, the last dimension is the *properties* dimension. Any
+/// intermediate dimension is called a *component* dimension.
+///
+/// Samples should be used to describe *what* we are representing, while
+/// properties should contain information about *how* we are representing it.
 /// Finally, components should be used to describe vectorial or tensorial
 /// components of the data.
 ///
@@ -1643,19 +2809,102 @@ private:
 
 namespace details {
     /// Default callback for data array creating in `TensorMap::load`, which
-    /// will create a `SimpleDataArray`.
+    /// will create a `SimpleDataArray` for 64-bit floating point data, and a
+    /// `SimpleDataArrayF32` for 32-bit and 16-bit floating point data.
     inline eqs_status_t default_create_array(
+        void*,
         const uintptr_t* shape_ptr,
         uintptr_t shape_count,
+        eqs_dtype_t dtype,
         eqs_array_t* array
     ) {
-        return details::catch_exceptions([](const uintptr_t* shape_ptr, uintptr_t shape_count, eqs_array_t* array){
+        return details::catch_exceptions([](const uintptr_t* shape_ptr, uintptr_t shape_count, eqs_dtype_t dtype, eqs_array_t* array){
             auto shape = std::vector<size_t>();
             for (size_t i=0; i<shape_count; i++) {
                 shape.push_back(static_cast<size_t>(shape_ptr[i]));
             }
 
-            auto cxx_array = std::unique_ptr<DataArrayBase>(new SimpleDataArray(shape));
+            // all the data will be set from the file. There is no 16-bit
+            // floating point type in C++, so these are loaded in 32-bit
+            // floating point arrays.
+            auto cxx_array = std::unique_ptr<DataArrayBase>();
+            if (dtype == EQS_DTYPE_FLOAT32 || dtype == EQS_DTYPE_FLOAT16) {
+                cxx_array.reset(new SimpleDataArrayF32(SimpleDataArrayF32::uninit(shape)));
+            } else {
+                cxx_array.reset(new SimpleDataArray(SimpleDataArray::uninit(shape)));
+            }
+            *array = DataArrayBase::to_eqs_array_t(std::move(cxx_array));
+
+            return EQS_SUCCESS;
+        }, shape_ptr, shape_count, dtype, array);
+    }
+
+    /// Callback for data array creation in `TensorMap::load_mmap`, used when
+    /// the data can not be used directly from the file. This will create a
+    /// `MmapDataArray` owning its data.
+    inline eqs_status_t mmap_create_array(
+        void*,
+        const uintptr_t* shape_ptr,
+        uintptr_t shape_count,
+        eqs_dtype_t,
+        eqs_array_t* array
+    ) {
+        // `MmapDataArray` only stores 64-bit floating point values, the data
+        // in the file will be converted if needed
+        return details::catch_exceptions([](const uintptr_t* shape_ptr, uintptr_t shape_count, eqs_array_t* array){
+            auto shape = std::vector<uintptr_t>(shape_ptr, shape_ptr + shape_count);
+            auto cxx_array = std::unique_ptr<DataArrayBase>(new MmapDataArray(std::move(shape)));
+            *array = DataArrayBase::to_eqs_array_t(std::move(cxx_array));
+
+            return EQS_SUCCESS;
+        }, shape_ptr, shape_count, array);
+    }
+
+    /// Callback for data array creation in `TensorMap::load_mmap`, creating a
+    /// `MmapDataArray` pointing inside the memory-mapped file. `user_data`
+    /// should be a pointer to `std::shared_ptr<details::MemoryMap>`.
+    inline eqs_status_t mmap_create_array_view(
+        void* user_data,
+        const uintptr_t* shape_ptr,
+        uintptr_t shape_count,
+        const double* data,
+        eqs_array_t* array
+    ) {
+        return details::catch_exceptions([](
+            void* user_data,
+            const uintptr_t* shape_ptr,
+            uintptr_t shape_count,
+            const double* data,
+            eqs_array_t* array
+        ) {
+            const auto& mapping = *static_cast<const std::shared_ptr<MemoryMap>*>(user_data);
+            auto shape = std::vector<uintptr_t>(shape_ptr, shape_ptr + shape_count);
+
+            // the file is mapped with copy-on-write, so it is fine to give
+            // mutable access to the data
+            auto cxx_array = std::unique_ptr<DataArrayBase>(new MmapDataArray(
+                mapping, const_cast<double*>(data), std::move(shape)
+            ));
+            *array = DataArrayBase::to_eqs_array_t(std::move(cxx_array));
+
+            return EQS_SUCCESS;
+        }, user_data, shape_ptr, shape_count, data, array);
+    }
+
+    /// Callback for data array creation in `TensorMap::load`, creating a
+    /// `SparseDataArray`.
+    inline eqs_status_t sparse_create_array(
+        void*,
+        const uintptr_t* shape_ptr,
+        uintptr_t shape_count,
+        eqs_dtype_t,
+        eqs_array_t* array
+    ) {
+        // `SparseDataArray` only stores 64-bit floating point values, the data
+        // in the file will be converted if needed
+        return details::catch_exceptions([](const uintptr_t* shape_ptr, uintptr_t shape_count, eqs_array_t* array){
+            auto shape = std::vector<uintptr_t>(shape_ptr, shape_ptr + shape_count);
+            auto cxx_array = std::unique_ptr<DataArrayBase>(new SparseDataArray(std::move(shape)));
             *array = DataArrayBase::to_eqs_array_t(std::move(cxx_array));
 
             return EQS_SUCCESS;
@@ -1750,11 +2999,69 @@ public:
         return matching;
     }
 
+    /// Get a (possibly empty) list of block indexes where the keys dimensions
+    /// in `names` take the corresponding `values`.
+    ///
+    /// This is equivalent to calling `blocks_matching` with a `Labels`
+    /// containing a single entry, but does not need to create this `Labels`
+    /// and uses an index of the keys cached inside the TensorMap. This makes
+    /// it the preferred way to look up blocks repeatedly.
+    std::vector<uintptr_t> blocks_matching(
+        const std::vector<std::string>& names,
+        const std::vector<int32_t>& values
+    ) const {
+        if (names.size() != values.size()) {
+            throw Error(
+                "expected the same number of names and values in block selection, got "
+                + std::to_string(names.size()) + " names and "
+                + std::to_string(values.size()) + " values"
+            );
+        }
+
+        auto c_names = std::vector<const char*>();
+        c_names.reserve(names.size());
+        for (const auto& name: names) {
+            c_names.push_back(name.c_str());
+        }
+
+        // most selections only match a handful of blocks, we'll call the
+        // function again if there are more
+        auto matching = std::vector<uintptr_t>(8);
+        uintptr_t count = matching.size();
+        details::check_status(eqs_tensormap_blocks_matching_values(
+            tensor_,
+            matching.data(),
+            &count,
+            c_names.data(),
+            values.data(),
+            values.size()
+        ));
+
+        if (count > matching.size()) {
+            matching.resize(count);
+            details::check_status(eqs_tensormap_blocks_matching_values(
+                tensor_,
+                matching.data(),
+                &count,
+                c_names.data(),
+                values.data(),
+                values.size()
+            ));
+        }
+
+        assert(count <= matching.size());
+        matching.resize(count);
+        return matching;
+    }
+
     /// Get a block inside this TensorMap by it's index/the index of the
     /// corresponding key.
     ///
     /// The returned `TensorBlock` is a view inside memory owned by this
     /// `TensorMap`, and is only valid as long as the `TensorMap` is kept alive.
+    ///
+    /// Multiple threads can call this function and read from the returned
+    /// blocks at the same time, as long as none of them modifies the blocks.
     TensorBlock block_by_id(uintptr_t index) {
         eqs_block_t* block = nullptr;
         details::check_status(eqs_tensormap_block_by_id(tensor_, &block, index));
@@ -1793,11 +3100,18 @@ public:
     /// @param keys_to_move description of the keys to move
     /// @param sort_samples whether to sort the merged samples or keep them in
     ///                     the order in which they appear in the original blocks
-    TensorMap keys_to_properties(const Labels& keys_to_move, bool sort_samples = true) const {
+    /// @param threads number of threads to use when merging blocks. By default
+    ///                everything runs on the current thread; use 0 to get one
+    ///                thread per CPU core. With more than one thread,
+    ///                different output blocks are merged concurrently, see
+    ///                `DataArrayBase::concurrent_move_samples()` for moving
+    ///                data concurrently inside a single block.
+    TensorMap keys_to_properties(const Labels& keys_to_move, bool sort_samples = true, size_t threads = 1) const {
         auto ptr = eqs_tensormap_keys_to_properties(
             tensor_,
             keys_to_move.as_eqs_labels_t(),
-            sort_samples
+            sort_samples,
+            threads
         );
 
         details::check_pointer(ptr);
@@ -1806,14 +3120,14 @@ public:
 
     /// This function calls `keys_to_properties` with an empty set of `Labels`
     /// with the dimensions defined in `keys_to_move`
-    TensorMap keys_to_properties(const std::vector<std::string>& keys_to_move, bool sort_samples = true) const {
-        return keys_to_properties(Labels(keys_to_move), sort_samples);
+    TensorMap keys_to_properties(const std::vector<std::string>& keys_to_move, bool sort_samples = true, size_t threads = 1) const {
+        return keys_to_properties(Labels(keys_to_move), sort_samples, threads);
     }
 
     /// This function calls `keys_to_properties` with an empty set of `Labels`
     /// with a single dimension: `key_to_move`
-    TensorMap keys_to_properties(const std::string& key_to_move, bool sort_samples = true) const {
-        return keys_to_properties(std::vector<std::string>{key_to_move}, sort_samples);
+    TensorMap keys_to_properties(const std::string& key_to_move, bool sort_samples = true, size_t threads = 1) const {
+        return keys_to_properties(std::vector<std::string>{key_to_move}, sort_samples, threads);
     }
 
     /// Merge blocks with the same value for selected keys dimensions along the
@@ -1838,11 +3152,18 @@ public:
     /// @param keys_to_move description of the keys to move
     /// @param sort_samples whether to sort the merged samples or keep them in
     ///                     the order in which they appear in the original blocks
-    TensorMap keys_to_samples(const Labels& keys_to_move, bool sort_samples = true) const {
+    /// @param threads number of threads to use when merging blocks. By default
+    ///                everything runs on the current thread; use 0 to get one
+    ///                thread per CPU core. With more than one thread,
+    ///                different output blocks are merged concurrently, see
+    ///                `DataArrayBase::concurrent_move_samples()` for moving
+    ///                data concurrently inside a single block.
+    TensorMap keys_to_samples(const Labels& keys_to_move, bool sort_samples = true, size_t threads = 1) const {
         auto ptr = eqs_tensormap_keys_to_samples(
             tensor_,
             keys_to_move.as_eqs_labels_t(),
-            sort_samples
+            sort_samples,
+            threads
         );
 
         details::check_pointer(ptr);
@@ -1851,14 +3172,61 @@ public:
 
     /// This function calls `keys_to_samples` with an empty set of `Labels`
     /// with the dimensions defined in `keys_to_move`
-    TensorMap keys_to_samples(const std::vector<std::string>& keys_to_move, bool sort_samples = true) const {
-        return keys_to_samples(Labels(keys_to_move), sort_samples);
+    TensorMap keys_to_samples(const std::vector<std::string>& keys_to_move, bool sort_samples = true, size_t threads = 1) const {
+        return keys_to_samples(Labels(keys_to_move), sort_samples, threads);
     }
 
     /// This function calls `keys_to_samples` with an empty set of `Labels`
     /// with a single dimension: `key_to_move`
-    TensorMap keys_to_samples(const std::string& key_to_move, bool sort_samples = true) const {
-        return keys_to_samples(std::vector<std::string>{key_to_move}, sort_samples);
+    TensorMap keys_to_samples(const std::string& key_to_move, bool sort_samples = true, size_t threads = 1) const {
+        return keys_to_samples(std::vector<std::string>{key_to_move}, sort_samples, threads);
+    }
+
+    /// Concatenate the blocks of all the `tensors` along the samples axis.
+    ///
+    /// The keys of the result are the union of the keys of all `tensors`,
+    /// and each block contains the samples of all the blocks with the
+    /// corresponding key, in the order of `tensors`. A new `"tensor"`
+    /// dimension is added to the samples, containing the index in `tensors`
+    /// of the tensor map each sample comes from.
+    ///
+    /// Blocks with the same key must have the same samples names,
+    /// components, properties, and set of gradients.
+    ///
+    /// @param tensors the tensor maps to join
+    /// @param threads number of threads to use when joining blocks. By default
+    ///                everything runs on the current thread; use 0 to get one
+    ///                thread per CPU core. With more than one thread,
+    ///                different output blocks are joined concurrently, see
+    ///                `DataArrayBase::concurrent_move_samples()` for moving
+    ///                data concurrently inside a single block.
+    static TensorMap join_samples(const std::vector<TensorMap>& tensors, size_t threads = 1) {
+        auto pointers = std::vector<const TensorMap*>();
+        pointers.reserve(tensors.size());
+        for (const auto& tensor: tensors) {
+            pointers.push_back(&tensor);
+        }
+        return TensorMap::join_samples(pointers, threads);
+    }
+
+    /// Same as `join_samples` above, taking pointers to the tensor maps to
+    /// join. This allows joining tensor maps without moving them into a
+    /// `std::vector`.
+    static TensorMap join_samples(const std::vector<const TensorMap*>& tensors, size_t threads = 1) {
+        auto c_tensors = std::vector<const eqs_tensormap_t*>();
+        c_tensors.reserve(tensors.size());
+        for (const auto* tensor: tensors) {
+            c_tensors.push_back(tensor->tensor_);
+        }
+
+        auto ptr = eqs_tensormap_join_samples(
+            c_tensors.data(),
+            c_tensors.size(),
+            threads
+        );
+
+        details::check_pointer(ptr);
+        return TensorMap(ptr);
     }
 
     /// Move the given `dimensions` from the component labels to the property
@@ -1900,8 +3268,9 @@ public:
      *
      * ``create_array`` will be used to create new arrays when constructing the
      * blocks and gradients, the default version will create data using
-     * :cpp:class:`SimpleDataArray`. See :c:func:`eqs_create_array_callback_t`
-     * for more information.
+     * :cpp:class:`SimpleDataArray` (or ``SimpleDataArrayF32`` for 32-bit and
+     * 16-bit data). See :c:func:`eqs_create_array_callback_t` for more
+     * information.
      *
      * \endverbatim
      *
@@ -1909,12 +3278,71 @@ public:
      * without compression (storage method is `STORED`), where each file is
      * stored as a `.npy` array. See the C API documentation for more
      * information on the format.
+     *
+     * @param path path to the file to load
+     * @param create_array callback used to create arrays for the blocks data
+     * @param threads number of threads to use when decoding blocks. By
+     *        default everything runs on the current thread, use 0 to use one
+     *        thread per CPU core. When using multiple threads, `create_array`
+     *        can be called concurrently from different threads.
+     * @param user_data pointer passed unchanged to every call of `create_array`
      */
     static TensorMap load(
         const std::string& path,
-        eqs_create_array_callback_t create_array = details::default_create_array
+        eqs_create_array_callback_t create_array = details::default_create_array,
+        size_t threads = 1,
+        void* user_data = nullptr
+    ) {
+        auto ptr = eqs_tensormap_load(path.c_str(), create_array, user_data, threads);
+        details::check_pointer(ptr);
+        return TensorMap(ptr);
+    }
+
+    /*!
+     * Load a subset of a previously saved `TensorMap` from the given path,
+     * keeping only the samples and properties matching the given selections.
+     *
+     * Only the data for the selected samples and properties is read from the
+     * file, see :c:func:`eqs_tensormap_load_selected` for more information.
+     *
+     * @param path path to the file to load
+     * @param samples selection for the samples of the blocks, or `nullptr` to
+     *        keep all samples
+     * @param properties selection for the properties of the blocks, or
+     *        `nullptr` to keep all properties
+     * @param create_array callback used to create arrays for the blocks data
+     * @param threads number of threads to use when decoding blocks, see
+     *        `TensorMap::load`
+     * @param user_data pointer passed unchanged to every call of `create_array`
+     */
+    static TensorMap load_selected(
+        const std::string& path,
+        const Labels* samples,
+        const Labels* properties,
+        eqs_create_array_callback_t create_array = details::default_create_array,
+        size_t threads = 1,
+        void* user_data = nullptr
     ) {
-        auto ptr = eqs_tensormap_load(path.c_str(), create_array);
+        eqs_labels_t c_samples;
+        std::memset(&c_samples, 0, sizeof(c_samples));
+        if (samples != nullptr) {
+            c_samples = samples->as_eqs_labels_t();
+        }
+
+        eqs_labels_t c_properties;
+        std::memset(&c_properties, 0, sizeof(c_properties));
+        if (properties != nullptr) {
+            c_properties = properties->as_eqs_labels_t();
+        }
+
+        auto ptr = eqs_tensormap_load_selected(
+            path.c_str(),
+            create_array,
+            user_data,
+            samples != nullptr ? &c_samples : nullptr,
+            properties != nullptr ? &c_properties : nullptr,
+            threads
+        );
         details::check_pointer(ptr);
         return TensorMap(ptr);
     }
@@ -1927,17 +3355,19 @@ public:
      *
      * ``create_array`` will be used to create new arrays when constructing the
      * blocks and gradients, the default version will create data using
-     * :cpp:class:`SimpleDataArray`. See :c:func:`eqs_create_array_callback_t`
-     * for more information.
+     * :cpp:class:`SimpleDataArray` (or ``SimpleDataArrayF32`` for 32-bit and
+     * 16-bit data). See :c:func:`eqs_create_array_callback_t` for more
+     * information.
      *
      * \endverbatim
      */
     static TensorMap load_buffer(
         const uint8_t* buffer,
         size_t buffer_count,
-        eqs_create_array_callback_t create_array = details::default_create_array
+        eqs_create_array_callback_t create_array = details::default_create_array,
+        void* user_data = nullptr
     ) {
-        auto ptr = eqs_tensormap_load_buffer(buffer, buffer_count, create_array);
+        auto ptr = eqs_tensormap_load_buffer(buffer, buffer_count, create_array, user_data);
         details::check_pointer(ptr);
         return TensorMap(ptr);
     }
@@ -1949,19 +3379,22 @@ public:
      *
      * ``create_array`` will be used to create new arrays when constructing the
      * blocks and gradients, the default version will create data using
-     * :cpp:class:`SimpleDataArray`. See :c:func:`eqs_create_array_callback_t`
-     * for more information.
+     * :cpp:class:`SimpleDataArray` (or ``SimpleDataArrayF32`` for 32-bit and
+     * 16-bit data). See :c:func:`eqs_create_array_callback_t` for more
+     * information.
      *
      * \endverbatim
      */
     static TensorMap load_buffer(
         const std::string& buffer,
-        eqs_create_array_callback_t create_array = details::default_create_array
+        eqs_create_array_callback_t create_array = details::default_create_array,
+        void* user_data = nullptr
     ) {
         return TensorMap::load_buffer(
             reinterpret_cast<const uint8_t*>(buffer.data()),
             buffer.size(),
-            create_array
+            create_array,
+            user_data
         );
     }
 
@@ -1972,22 +3405,58 @@ public:
      *
      * ``create_array`` will be used to create new arrays when constructing the
      * blocks and gradients, the default version will create data using
-     * :cpp:class:`SimpleDataArray`. See :c:func:`eqs_create_array_callback_t`
-     * for more information.
+     * :cpp:class:`SimpleDataArray` (or ``SimpleDataArrayF32`` for 32-bit and
+     * 16-bit data). See :c:func:`eqs_create_array_callback_t` for more
+     * information.
      *
      * \endverbatim
      */
     static TensorMap load_buffer(
         const std::vector<uint8_t>& buffer,
-        eqs_create_array_callback_t create_array = details::default_create_array
+        eqs_create_array_callback_t create_array = details::default_create_array,
+        void* user_data = nullptr
     ) {
         return TensorMap::load_buffer(
             buffer.data(),
             buffer.size(),
-            create_array
+            create_array,
+            user_data
         );
     }
 
+    /*!
+     * Load a previously saved `TensorMap` from the given path, using a
+     * memory-mapping of the file instead of reading it.
+     *
+     * \verbatim embed:rst:leading-asterisk
+     *
+     * All the arrays in the loaded tensor map are
+     * :cpp:class:`MmapDataArray`. Whenever possible, the data for values and
+     * gradients is used directly from the file without any copy, and only
+     * read from disk when it is accessed. Files created with
+     * :cpp:func:`TensorMap::save` on a machine with the same endianness can
+     * always be used without copies. Arrays for other files are created and
+     * filled the same way as in :cpp:func:`TensorMap::load`. See
+     * :c:func:`eqs_tensormap_load_buffer_view` for more information.
+     *
+     * \endverbatim
+     *
+     * The file stays mapped in memory as long as any of the arrays is using
+     * it, and should not be modified while it is mapped.
+     */
+    static TensorMap load_mmap(const std::string& path) {
+        auto mapping = std::make_shared<details::MemoryMap>(path);
+        auto ptr = eqs_tensormap_load_buffer_view(
+            mapping->data(),
+            mapping->size(),
+            details::mmap_create_array,
+            &mapping,
+            details::mmap_create_array_view
+        );
+        details::check_pointer(ptr);
+        return TensorMap(ptr);
+    }
+
     /// Save the given `TensorMap` to a file at `path`.
     ///
     /// `TensorMap` are serialized using numpy's `.npz` format, i.e. a ZIP
@@ -1998,30 +3467,107 @@ public:
         details::check_status(eqs_tensormap_save(path.c_str(), tensor.tensor_));
     }
 
+    /// Save the given `TensorMap` to a file at `path`, compressing the data.
+    ///
+    /// This uses the same format as `TensorMap::save`, with all the files
+    /// in the archive compressed with DEFLATE (storage method is
+    /// `DEFLATED`), using the fastest compression level. The resulting file
+    /// can be loaded with `TensorMap::load`, but not memory-mapped with
+    /// `TensorMap::load_mmap` without copying the data.
+    static void save_compressed(const std::string& path, const TensorMap& tensor) {
+        details::check_status(eqs_tensormap_save_compressed(path.c_str(), tensor.tensor_));
+    }
+
+    /// Save the given `TensorMap` to an output `stream`.
+    ///
+    /// The data is written to the stream as it is produced, without holding
+    /// the whole serialized `TensorMap` in memory. The stream must support
+    /// seeking with `seekp`, as is the case for `std::ofstream` and
+    /// `std::ostringstream`. The data is written starting at the current
+    /// position of the stream.
+    static void save(std::ostream& stream, const TensorMap& tensor) {
+        struct StreamSink {
+            std::ostream* stream;
+            std::ostream::pos_type start;
+        };
+
+        auto sink = StreamSink{&stream, stream.tellp()};
+        if (sink.start == std::ostream::pos_type(-1)) {
+            throw Error("can not save TensorMap to a stream which does not support seeking");
+        }
+
+        auto write = [](void* user_data, const uint8_t* data, uintptr_t count) {
+            return details::catch_exceptions([](void* user_data, const uint8_t* data, uintptr_t count) {
+                auto sink = static_cast<StreamSink*>(user_data);
+                sink->stream->write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(count));
+                if (!*sink->stream) {
+                    throw Error("failed to write data to the output stream");
+                }
+                return EQS_SUCCESS;
+            }, user_data, data, count);
+        };
+
+        auto seek = [](void* user_data, uint64_t position) {
+            return details::catch_exceptions([](void* user_data, uint64_t position) {
+                auto sink = static_cast<StreamSink*>(user_data);
+                sink->stream->seekp(sink->start + static_cast<std::streamoff>(position));
+                if (!*sink->stream) {
+                    throw Error("failed to seek in the output stream");
+                }
+                return EQS_SUCCESS;
+            }, user_data, position);
+        };
+
+        details::check_status(eqs_tensormap_save_stream(
+            &sink,
+            write,
+            seek,
+            tensor.tensor_
+        ));
+    }
+
     /// Save a tensor map to an in-memory buffer.
     static std::vector<uint8_t> save_buffer(const TensorMap& tensor) {
-        std::vector<uint8_t> buffer;
+        struct VectorSink {
+            std::vector<uint8_t> buffer;
+            size_t position;
+        };
+
+        auto sink = VectorSink{{}, 0};
+
+        // appending to the vector grows the allocation geometrically, and
+        // does not need to fill the new memory with zeros before writing
+        auto write = [](void* user_data, const uint8_t* data, uintptr_t count) {
+            return details::catch_exceptions([](void* user_data, const uint8_t* data, uintptr_t count) {
+                auto sink = static_cast<VectorSink*>(user_data);
+                auto& buffer = sink->buffer;
 
-        auto ptr = buffer.data();
-        auto size = buffer.size();
+                auto available = buffer.size() - sink->position;
+                auto overwrite = count < available ? static_cast<size_t>(count) : available;
+                if (overwrite != 0) {
+                    std::memcpy(buffer.data() + sink->position, data, overwrite);
+                }
+                buffer.insert(buffer.end(), data + overwrite, data + count);
+
+                sink->position += static_cast<size_t>(count);
+                return EQS_SUCCESS;
+            }, user_data, data, count);
+        };
 
-        auto realloc = [](void* user_data, uint8_t*, uintptr_t new_size) {
-            auto buffer = reinterpret_cast<std::vector<uint8_t>*>(user_data);
-            buffer->resize(new_size, '\0');
-            return buffer->data();
+        auto seek = [](void* user_data, uint64_t position) {
+            auto sink = static_cast<VectorSink*>(user_data);
+            sink->position = static_cast<size_t>(position);
+            return EQS_SUCCESS;
         };
 
-        details::check_status(eqs_tensormap_save_buffer(
-            &ptr,
-            &size,
-            &buffer,
-            realloc,
+        details::check_status(eqs_tensormap_save_stream(
+            &sink,
+            write,
+            seek,
             tensor.tensor_
         ));
 
-        buffer.resize(size, '\0');
-
-        return buffer;
+        return std::move(sink.buffer);
     }
 
     /// Similar to `TensorMap::save_buffer`, but return the result as a
@@ -2057,6 +3603,297 @@ private:
 };
 
 
+/// Incremental construction of a `TensorMap`.
+///
+/// Blocks can be added to the builder one at a time. When adding a block with
+/// a key already present in the builder, the samples of the new block are
+/// appended to the existing block instead. The blocks are only assembled into
+/// a `TensorMap` when calling `TensorMapBuilder::finish`, copying the data of
+/// blocks with appended samples once.
+class TensorMapBuilder final {
+public:
+    /// Create a new empty builder, for a `TensorMap` with the given key names
+    explicit TensorMapBuilder(const std::vector<std::string>& names) {
+        auto c_names = std::vector<const char*>();
+        c_names.reserve(names.size());
+        for (const auto& name: names) {
+            c_names.push_back(name.c_str());
+        }
+
+        builder_ = eqs_tensormap_builder(c_names.data(), c_names.size());
+        details::check_pointer(builder_);
+    }
+
+    ~TensorMapBuilder() {
+        eqs_tensormap_builder_free(builder_);
+    }
+
+    /// TensorMapBuilder can NOT be copy constructed
+    TensorMapBuilder(const TensorMapBuilder&) = delete;
+    /// TensorMapBuilder can NOT be copy assigned
+    TensorMapBuilder& operator=(const TensorMapBuilder&) = delete;
+
+    /// TensorMapBuilder can be move constructed
+    TensorMapBuilder(TensorMapBuilder&& other) noexcept: builder_(nullptr) {
+        *this = std::move(other);
+    }
+
+    /// TensorMapBuilder can be move assigned
+    TensorMapBuilder& operator=(TensorMapBuilder&& other) noexcept {
+        eqs_tensormap_builder_free(builder_);
+
+        this->builder_ = other.builder_;
+        other.builder_ = nullptr;
+
+        return *this;
+    }
+
+    /// Add a `block` associated with the given `key` to this builder. If a
+    /// block with the same `key` was already added, the samples of `block`
+    /// are appended to the existing block. See
+    /// `eqs_tensormap_builder_add_block` for more information.
+    void add_block(const std::vector<int32_t>& key, TensorBlock block) {
+        if (builder_ == nullptr) {
+            throw Error("can not add blocks to a finished TensorMapBuilder");
+        }
+
+        details::check_status(eqs_tensormap_builder_add_block(
+            builder_,
+            key.data(),
+            key.size(),
+            block.release()
+        ));
+    }
+
+    /// Assemble all the blocks added so far into a `TensorMap`. The builder
+    /// can not be used after calling this function.
+    TensorMap finish() {
+        if (builder_ == nullptr) {
+            throw Error("this TensorMapBuilder was already finished");
+        }
+
+        auto builder = builder_;
+        builder_ = nullptr;
+
+        auto ptr = eqs_tensormap_builder_finish(builder);
+        details::check_pointer(ptr);
+        return TensorMap(ptr);
+    }
+
+private:
+    eqs_tensormap_builder_t* builder_;
+};
+
+
+namespace details {
+    /// Least-recently-used cache of values of type `T`, associated with an
+    /// integer key. The cache keeps at most `max_size` values, or all of them
+    /// if `max_size` is 0.
+    ///
+    /// This class is not thread-safe, users should protect it with a mutex.
+    template <typename T>
+    class LruCache {
+    public:
+        /// Create a new empty cache holding at most `max_size` values
+        explicit LruCache(size_t max_size): max_size_(max_size) {}
+
+        /// Get the value associated with `key`, calling `load(key)` to create
+        /// it if it is not already in the cache. This might evict the least
+        /// recently used value from the cache.
+        template <typename Function>
+        T get_or_load(size_t key, Function load) {
+            auto it = positions_.find(key);
+            if (it != positions_.end()) {
+                // mark this entry as the most recently used
+                entries_.splice(entries_.begin(), entries_, it->second);
+                return it->second->second;
+            }
+
+            auto value = load(key);
+            entries_.emplace_front(key, value);
+            positions_[key] = entries_.begin();
+
+            if (max_size_ != 0 && entries_.size() > max_size_) {
+                positions_.erase(entries_.back().first);
+                entries_.pop_back();
+            }
+
+            return value;
+        }
+
+        /// Get the number of values currently in the cache
+        size_t size() const {
+            return entries_.size();
+        }
+
+        /// Remove all values from the cache
+        void clear() {
+            positions_.clear();
+            entries_.clear();
+        }
+
+    private:
+        using Entries = std::list<std::pair<size_t, T>>;
+
+        size_t max_size_;
+        Entries entries_;
+        std::unordered_map<size_t, typename Entries::iterator> positions_;
+    };
+}
+
+
+/// A `TensorMap` stored in a file, from which blocks are loaded on demand.
+///
+/// Opening a `LazyTensorMap` only reads the keys from the file, the labels and
+/// data of each block are read the first time the block is requested with
+/// `block_by_id`. Loaded blocks are kept in memory to be re-used later,
+/// optionally keeping only the most recently used ones.
+///
+/// All functions of this class can be called from multiple threads at the
+/// same time.
+class LazyTensorMap final {
+public:
+    /*!
+     * Open the `TensorMap` previously saved at the given `path`, only reading
+     * the keys.
+     *
+     * \verbatim embed:rst:leading-asterisk
+     *
+     * ``create_array`` will be used to create new arrays when loading the
+     * blocks and gradients, the default version will create data using
+     * :cpp:class:`SimpleDataArray` (or ``SimpleDataArrayF32`` for 32-bit and
+     * 16-bit data). See :c:func:`eqs_create_array_callback_t` for more
+     * information.
+     *
+     * \endverbatim
+     *
+     * @param path path to the file to open
+     * @param max_blocks maximal number of blocks to keep in memory. When
+     *        loading more blocks, the least recently used blocks are released.
+     *        Use 0 to keep all loaded blocks in memory.
+     * @param create_array callback used to create arrays for the blocks data
+     * @param user_data pointer passed unchanged to every call of
+     *        `create_array`. It must stay valid as long as blocks can be
+     *        loaded from this `LazyTensorMap`.
+     */
+    explicit LazyTensorMap(
+        const std::string& path,
+        size_t max_blocks = 0,
+        eqs_create_array_callback_t create_array = details::default_create_array,
+        void* user_data = nullptr
+    ):
+        lazy_(eqs_lazy_tensormap_open(path.c_str())),
+        create_array_(create_array),
+        user_data_(user_data),
+        mutex_(new std::mutex()),
+        cache_(max_blocks)
+    {
+        details::check_pointer(lazy_);
+    }
+
+    ~LazyTensorMap() {
+        eqs_lazy_tensormap_free(lazy_);
+    }
+
+    /// LazyTensorMap can NOT be copy constructed
+    LazyTensorMap(const LazyTensorMap&) = delete;
+    /// LazyTensorMap can NOT be copy assigned
+    LazyTensorMap& operator=(const LazyTensorMap&) = delete;
+
+    /// LazyTensorMap can be move constructed
+    LazyTensorMap(LazyTensorMap&& other) noexcept:
+        lazy_(other.lazy_),
+        create_array_(other.create_array_),
+        user_data_(other.user_data_),
+        mutex_(std::move(other.mutex_)),
+        cache_(std::move(other.cache_))
+    {
+        other.lazy_ = nullptr;
+    }
+
+    /// LazyTensorMap can be move assigned
+    LazyTensorMap& operator=(LazyTensorMap&& other) noexcept {
+        eqs_lazy_tensormap_free(lazy_);
+
+        this->lazy_ = other.lazy_;
+        this->create_array_ = other.create_array_;
+        this->user_data_ = other.user_data_;
+        this->mutex_ = std::move(other.mutex_);
+        this->cache_ = std::move(other.cache_);
+        other.lazy_ = nullptr;
+
+        return *this;
+    }
+
+    /// Get the set of keys labeling the blocks in this tensor map
+    Labels keys() const {
+        eqs_labels_t keys;
+        std::memset(&keys, 0, sizeof(keys));
+
+        details::check_status(eqs_lazy_tensormap_keys(lazy_, &keys));
+        return Labels(keys);
+    }
+
+    /// Get a (possibly empty) list of block indexes matching the `selection`,
+    /// without loading any block
+    std::vector<uintptr_t> blocks_matching(const Labels& selection) const {
+        auto matching = std::vector<uintptr_t>(this->keys().count());
+        uintptr_t count = matching.size();
+
+        details::check_status(eqs_lazy_tensormap_blocks_matching(
+            lazy_,
+            matching.data(),
+            &count,
+            selection.as_eqs_labels_t()
+        ));
+
+        assert(count <= matching.size());
+        matching.resize(count);
+        return matching;
+    }
+
+    /// Get the block at the given `index` in this tensor map, loading it from
+    /// the file if it is not already in memory.
+    ///
+    /// The returned block stays valid even if it is later released from the
+    /// set of blocks kept in memory by this `LazyTensorMap`.
+    std::shared_ptr<TensorBlock> block_by_id(uintptr_t index) {
+        std::lock_guard<std::mutex> lock(*mutex_);
+        return cache_.get_or_load(index, [this](size_t block_index) {
+            return std::make_shared<TensorBlock>(this->load_block(block_index));
+        });
+    }
+
+    /// Load the block at the given `index` from the file, without using or
+    /// updating the set of blocks kept in memory.
+    TensorBlock load_block(uintptr_t index) const {
+        auto block = eqs_lazy_tensormap_load_block(lazy_, index, create_array_, user_data_);
+        details::check_pointer(block);
+        return TensorBlock::unsafe_from_ptr(block);
+    }
+
+    /// Get the number of blocks currently kept in memory
+    size_t loaded_blocks() const {
+        std::lock_guard<std::mutex> lock(*mutex_);
+        return cache_.size();
+    }
+
+    /// Release all the blocks kept in memory. Blocks previously returned by
+    /// `block_by_id` stay valid.
+    void clear() {
+        std::lock_guard<std::mutex> lock(*mutex_);
+        cache_.clear();
+    }
+
+private:
+    eqs_lazy_tensormap_t* lazy_;
+    eqs_create_array_callback_t create_array_;
+    void* user_data_;
+    std::unique_ptr<std::mutex> mutex_;
+    details::LruCache<std::shared_ptr<TensorBlock>> cache_;
+};
+
+
 }
 
 #endif /* EQUISTORE_HPP */
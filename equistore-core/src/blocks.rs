@@ -4,6 +4,7 @@ use std::collections::{HashMap, BTreeSet};
 
 use crate::utils::ConstCString;
 use crate::{Labels, LabelsBuilder};
+use crate::labels::LabelsInterner;
 use crate::{eqs_array_t, get_data_origin};
 use crate::Error;
 
@@ -167,6 +168,20 @@ impl TensorBlock {
         })
     }
 
+    /// Replace the samples, components and properties of this block and all
+    /// its gradients with the shared instances from `interner`.
+    pub(crate) fn intern_labels(&mut self, interner: &LabelsInterner) {
+        self.samples = interner.intern(Arc::clone(&self.samples));
+        for component in &mut self.components.0 {
+            *component = interner.intern(Arc::clone(component));
+        }
+        self.properties = interner.intern(Arc::clone(&self.properties));
+
+        for gradient in self.gradients.values_mut() {
+            gradient.intern_labels(interner);
+        }
+    }
+
     /// Get all gradients defined in this block
     pub fn gradients(&self) -> &HashMap<String, TensorBlock> {
         &self.gradients
@@ -189,6 +204,19 @@ impl TensorBlock {
         &self.gradient_parameters
     }
 
+    /// Remove all the gradients from this block, and return them in the same
+    /// order as `gradient_parameters_c`.
+    pub(crate) fn take_gradients(&mut self) -> Vec<(String, TensorBlock)> {
+        let mut gradients = std::mem::take(&mut self.gradients);
+        return std::mem::take(&mut self.gradient_parameters).into_iter()
+            .map(|parameter| {
+                let parameter = parameter.as_str().to_owned();
+                let gradient = gradients.remove(&parameter).expect("missing gradient");
+                (parameter, gradient)
+            })
+            .collect();
+    }
+
     /// Add a gradient with respect to `parameter` to this block.
     ///
     /// The gradient `data` is given as an array, and the samples and components
@@ -34,6 +34,12 @@ impl eqs_block_t {
     pub(super) fn into_block(self) -> TensorBlock {
         self.0
     }
+
+    /// Create a raw pointer to `eqs_block_t` using a rust Box
+    pub(super) fn into_boxed_raw(block: TensorBlock) -> *mut eqs_block_t {
+        let boxed = Box::new(eqs_block_t(block));
+        return Box::into_raw(boxed);
+    }
 }
 
 
@@ -63,6 +69,7 @@ pub unsafe extern fn eqs_block(
     components_count: usize,
     properties: eqs_labels_t,
 ) -> *mut eqs_block_t {
+    let _span = crate::profiling::span(b"eqs_block\0");
     let mut result = std::ptr::null_mut();
     let unwind_wrapper = std::panic::AssertUnwindSafe(&mut result);
     let status = catch_unwind(move || {
@@ -133,6 +140,7 @@ pub unsafe extern fn eqs_block_free(
 pub unsafe extern fn eqs_block_copy(
     block: *const eqs_block_t,
 ) -> *mut eqs_block_t {
+    let _span = crate::profiling::span(b"eqs_block_copy\0");
     let mut result = std::ptr::null_mut();
     let unwind_wrapper = std::panic::AssertUnwindSafe(&mut result);
     let status = catch_unwind(move || {
@@ -236,6 +244,9 @@ fn _get_gradient<'a>(
 /// more gradients are added to the parent block, or if the parent block is
 /// freed with `eqs_block_free`.
 ///
+/// This function does not modify the block, and can be called from multiple
+/// threads at the same time.
+///
 /// @param block pointer to an existing block
 /// @param parameter the name of the gradient to be extracted
 /// @param gradient pointer to an empty `eqs_block_t` pointer that will be
@@ -254,12 +265,14 @@ pub unsafe extern fn eqs_block_gradient(
         check_pointers!(block, parameter);
         let parameter = CStr::from_ptr(parameter).to_str().unwrap();
 
-        let gradient_rust = (*block).gradient_mut(parameter).ok_or_else(|| {
+        // only take a shared reference to the block here, since other
+        // threads might be accessing it at the same time
+        let gradient_rust = (*block).gradient(parameter).ok_or_else(|| {
             Error::InvalidParameter(format!(
                 "can not find gradients with respect to '{}' in this block", parameter
             ))
         })?;
-        (*gradient) = (gradient_rust as *mut TensorBlock).cast();
+        (*gradient) = (gradient_rust as *const TensorBlock as *mut TensorBlock).cast();
 
         Ok(())
     })
@@ -2,27 +2,58 @@ use std::os::raw::{c_char, c_void};
 use std::ffi::CStr;
 use std::fs::File;
 use std::io::{BufReader, BufWriter};
+use std::sync::Arc;
 
 use crate::Error;
-use crate::data::eqs_array_t;
+use crate::data::{eqs_array_t, eqs_dtype_t, DType};
+use crate::io::LazyTensorMap;
 
 use super::status::{eqs_status_t, catch_unwind};
 use super::tensor::eqs_tensormap_t;
+use super::blocks::eqs_block_t;
+use super::labels::{eqs_labels_t, rust_to_eqs_labels, eqs_labels_to_rust};
 
 /// Function pointer to create a new `eqs_array_t` when de-serializing tensor
 /// maps.
 ///
 /// This function gets the `shape` of the array (the `shape` contains
-/// `shape_count` elements) and should fill `array` with a new valid
-/// `eqs_array_t` or return non-zero `eqs_status_t`.
+/// `shape_count` elements) and the data type of the data in the file (`dtype`,
+/// one of the `EQS_DTYPE_XXX` constants); and should fill `array` with a new
+/// valid `eqs_array_t` or return non-zero `eqs_status_t`. The `user_data` is
+/// passed unchanged from the function calling this callback.
 ///
-/// The newly created array should contains 64-bit floating points (`double`)
-/// data, and live on CPU, since equistore will use `eqs_array_t.data` to get
-/// the data pointer and write to it.
+/// The newly created array should live on CPU, since equistore will use
+/// `eqs_array_t.raw_data` (or `eqs_array_t.data`) to get the data pointer and
+/// write to it. The array does not have to use `dtype`: the data in the file is
+/// converted to the data type of the array (as given by `eqs_array_t.dtype`)
+/// if needed. Using the same data type as the file avoids this conversion.
 #[allow(non_camel_case_types)]
 type eqs_create_array_callback_t = unsafe extern fn(
+    user_data: *mut c_void,
     shape: *const usize,
     shape_count: usize,
+    dtype: eqs_dtype_t,
+    array: *mut eqs_array_t,
+) -> eqs_status_t;
+
+/// Function pointer to create a new `eqs_array_t` pointing to existing data
+/// when de-serializing tensor maps without copies.
+///
+/// This function gets the `shape` of the array (the `shape` contains
+/// `shape_count` elements), and a pointer to the corresponding `data`, which
+/// contains as many 64-bit floating points values as the product of the shape.
+/// It should fill `array` with a new valid `eqs_array_t` using this data or
+/// return non-zero `eqs_status_t`. The `user_data` is passed unchanged from the
+/// function calling this callback.
+///
+/// The `data` pointer is not owned by the new array, and points inside the
+/// buffer given to the function calling this callback.
+#[allow(non_camel_case_types)]
+type eqs_create_array_view_callback_t = unsafe extern fn(
+    user_data: *mut c_void,
+    shape: *const usize,
+    shape_count: usize,
+    data: *const f64,
     array: *mut eqs_array_t,
 ) -> eqs_status_t;
 
@@ -36,8 +67,10 @@ type eqs_create_array_callback_t = unsafe extern fn(
 /// `eqs_tensormap_free`.
 ///
 /// `TensorMap` are serialized using numpy's `.npz` format, i.e. a ZIP file
-/// without compression (storage method is STORED), where each file is stored as
-/// a `.npy` array. Both the ZIP and NPY format are well documented:
+/// without compression (storage method is STORED) or compressed with DEFLATE
+/// (storage method is DEFLATED, see `eqs_tensormap_save_compressed`), where each
+/// file is stored as a `.npy` array. Both the ZIP and NPY format are well
+/// documented:
 ///
 /// - ZIP: <https://pkware.cachefly.net/webdocs/casestudies/APPNOTE.TXT>
 /// - NPY: <https://numpy.org/doc/stable/reference/generated/numpy.lib.format.html>
@@ -45,7 +78,9 @@ type eqs_create_array_callback_t = unsafe extern fn(
 /// We add other restriction on top of these formats when saving/loading data.
 /// First, `Labels` instances are saved as structured array, see the `labels`
 /// module for more information. Only 32-bit integers are supported for Labels,
-/// and only 64-bit floats are supported for data (values and gradients).
+/// and 64-bit, 32-bit or 16-bit floats are supported for data (values and
+/// gradients). The data is converted to the data type of the arrays returned
+/// by `create_array` if needed.
 ///
 /// Second, the path of the files in the archive also carry meaning. The keys of
 /// the `TensorMap` are stored in `/keys.npy`, and then different blocks are
@@ -70,6 +105,12 @@ type eqs_create_array_callback_t = unsafe extern fn(
 /// @param path path to the file as a NULL-terminated UTF-8 string
 /// @param create_array callback function that will be used to create data
 ///                     arrays inside each block
+/// @param user_data custom data for the `create_array` callback. This will be
+///                  passed as the first argument to `create_array` as-is.
+/// @param threads number of threads to use when decoding blocks. Use 1 to run
+///                everything on the current thread, and 0 to use one thread
+///                per CPU core. When using multiple threads, `create_array`
+///                can be called concurrently from different threads.
 ///
 /// @returns A pointer to the newly allocated tensor map, or a `NULL` pointer in
 ///          case of error. In case of error, you can use `eqs_last_error()`
@@ -78,17 +119,112 @@ type eqs_create_array_callback_t = unsafe extern fn(
 pub unsafe extern fn eqs_tensormap_load(
     path: *const c_char,
     create_array: eqs_create_array_callback_t,
+    user_data: *mut c_void,
+    threads: usize,
 ) -> *mut eqs_tensormap_t {
+    let _span = crate::profiling::span(b"eqs_tensormap_load\0");
     let mut result = std::ptr::null_mut();
     let unwind_wrapper = std::panic::AssertUnwindSafe(&mut result);
     let status = catch_unwind(move || {
         check_pointers!(path);
 
-        let create_array = wrap_create_array(&create_array);
+        let create_array = wrap_create_array(&create_array, user_data);
 
         let path = CStr::from_ptr(path).to_str().expect("use UTF-8 for path");
-        let file = BufReader::new(File::open(path)?);
-        let tensor = crate::io::load(file, create_array)?;
+        let file = File::open(path)?;
+        #[cfg(not(any(unix, windows)))]
+        let file = std::sync::Mutex::new(file);
+        let tensor = crate::io::load_parallel(&file, create_array, threads)?;
+
+        // force the closure to capture the full unwind_wrapper, not just
+        // unwind_wrapper.0
+        let _ = &unwind_wrapper;
+        *(unwind_wrapper.0) = eqs_tensormap_t::into_boxed_raw(tensor);
+        Ok(())
+    });
+
+    if !status.is_success() {
+        return std::ptr::null_mut();
+    }
+
+    return result;
+}
+
+/// Load a subset of the tensor map from the file at the given path, keeping
+/// only the samples and properties matching the given selections.
+///
+/// The labels of each block are decoded first, and then only the data for the
+/// selected samples and properties is read from the file. Files saved without
+/// compression (with `eqs_tensormap_save`) are read directly at the offsets of
+/// the selected samples, so loading a small subset is faster than loading the
+/// full file.
+///
+/// The selections can contain a subset of the dimensions of the samples or
+/// properties, and an entry is kept if its values for these dimensions are
+/// part of the selection. The kept entries stay in the same order as in the
+/// file, and all blocks are kept even if no sample or property matches the
+/// selection. The samples of gradients are filtered and renumbered to only
+/// refer to the kept samples, and gradients use the same properties as the
+/// values.
+///
+/// The memory allocated by this function should be released using
+/// `eqs_tensormap_free`.
+///
+/// @param path path to the file as a NULL-terminated UTF-8 string
+/// @param create_array callback function that will be used to create data
+///                     arrays inside each block
+/// @param user_data custom data for the `create_array` callback, see
+///                  `eqs_tensormap_load`
+/// @param samples selection for the samples of the blocks, or `NULL` to keep
+///                all samples
+/// @param properties selection for the properties of the blocks, or `NULL`
+///                   to keep all properties
+/// @param threads number of threads to use when decoding blocks, see
+///                `eqs_tensormap_load`
+///
+/// @returns A pointer to the newly allocated tensor map, or a `NULL` pointer in
+///          case of error. In case of error, you can use `eqs_last_error()`
+///          to get the error message.
+#[no_mangle]
+pub unsafe extern fn eqs_tensormap_load_selected(
+    path: *const c_char,
+    create_array: eqs_create_array_callback_t,
+    user_data: *mut c_void,
+    samples: *const eqs_labels_t,
+    properties: *const eqs_labels_t,
+    threads: usize,
+) -> *mut eqs_tensormap_t {
+    let _span = crate::profiling::span(b"eqs_tensormap_load_selected\0");
+    let mut result = std::ptr::null_mut();
+    let unwind_wrapper = std::panic::AssertUnwindSafe(&mut result);
+    let status = catch_unwind(move || {
+        check_pointers!(path);
+
+        let create_array = wrap_create_array(&create_array, user_data);
+
+        let samples = if samples.is_null() {
+            None
+        } else {
+            Some(eqs_labels_to_rust(&*samples)?)
+        };
+
+        let properties = if properties.is_null() {
+            None
+        } else {
+            Some(eqs_labels_to_rust(&*properties)?)
+        };
+
+        let path = CStr::from_ptr(path).to_str().expect("use UTF-8 for path");
+        let file = File::open(path)?;
+        #[cfg(not(any(unix, windows)))]
+        let file = std::sync::Mutex::new(file);
+        let tensor = crate::io::load_selected(
+            &file,
+            create_array,
+            samples.as_deref(),
+            properties.as_deref(),
+            threads,
+        )?;
 
         // force the closure to capture the full unwind_wrapper, not just
         // unwind_wrapper.0
@@ -117,6 +253,8 @@ pub unsafe extern fn eqs_tensormap_load(
 /// @param buffer_count number of elements in the buffer
 /// @param create_array callback function that will be used to create data
 ///                     arrays inside each block
+/// @param user_data custom data for the `create_array` callback, see
+///                  `eqs_tensormap_load`
 ///
 /// @returns A pointer to the newly allocated tensor map, or a `NULL` pointer in
 ///          case of error. In case of error, you can use `eqs_last_error()`
@@ -126,14 +264,16 @@ pub unsafe extern fn eqs_tensormap_load_buffer(
     buffer: *const u8,
     buffer_count: usize,
     create_array: eqs_create_array_callback_t,
+    user_data: *mut c_void,
 ) -> *mut eqs_tensormap_t {
+    let _span = crate::profiling::span(b"eqs_tensormap_load_buffer\0");
     let mut result = std::ptr::null_mut();
     let unwind_wrapper = std::panic::AssertUnwindSafe(&mut result);
     let status = catch_unwind(move || {
         check_pointers!(buffer);
         assert!(buffer_count > 0);
 
-        let create_array = wrap_create_array(&create_array);
+        let create_array = wrap_create_array(&create_array, user_data);
 
         let buffer = std::slice::from_raw_parts(buffer.cast::<u8>(), buffer_count);
         let cursor = std::io::Cursor::new(buffer);
@@ -154,13 +294,322 @@ pub unsafe extern fn eqs_tensormap_load_buffer(
     return result;
 }
 
-fn wrap_create_array(create_array: &eqs_create_array_callback_t) -> impl Fn(Vec<usize>) -> Result<eqs_array_t, Error> + '_ {
-    |shape: Vec<usize>| {
+/// Load a tensor map from the given in-memory buffer, without copying the
+/// values and gradients data when possible.
+///
+/// This function is intended to be used with a memory-mapped file as `buffer`,
+/// making the cost of loading data proportional to the data actually used
+/// instead of the file size.
+///
+/// For each array stored without compression, in the native endianness of the
+/// current machine and with data correctly aligned in memory, the
+/// `create_array_view` callback is called with a pointer inside `buffer`. Files
+/// written by `eqs_tensormap_save` satisfy all of these conditions. The other
+/// arrays are created with the `create_array` callback and filled with a copy
+/// of the data, as in `eqs_tensormap_load_buffer`.
+///
+/// The arrays created by `create_array_view` point inside `buffer`, which must
+/// stay alive and unmodified for as long as these arrays are used.
+///
+/// The memory allocated by this function should be released using
+/// `eqs_tensormap_free`.
+///
+/// @param buffer buffer containing a previously serialized `eqs_tensormap_t`
+/// @param buffer_count number of elements in the buffer
+/// @param create_array callback function that will be used to create data
+///                     arrays inside each block when the data has to be
+///                     copied
+/// @param user_data custom data for the `create_array` and
+///                  `create_array_view` callbacks. This will be passed as the
+///                  first argument to both callbacks as-is.
+/// @param create_array_view callback function that will be used to create
+///                          data arrays pointing directly inside `buffer`
+///
+/// @returns A pointer to the newly allocated tensor map, or a `NULL` pointer in
+///          case of error. In case of error, you can use `eqs_last_error()`
+///          to get the error message.
+#[no_mangle]
+pub unsafe extern fn eqs_tensormap_load_buffer_view(
+    buffer: *const u8,
+    buffer_count: usize,
+    create_array: eqs_create_array_callback_t,
+    user_data: *mut c_void,
+    create_array_view: eqs_create_array_view_callback_t,
+) -> *mut eqs_tensormap_t {
+    let _span = crate::profiling::span(b"eqs_tensormap_load_buffer_view\0");
+    let mut result = std::ptr::null_mut();
+    let unwind_wrapper = std::panic::AssertUnwindSafe(&mut result);
+    let status = catch_unwind(move || {
+        check_pointers!(buffer);
+        assert!(buffer_count > 0);
+
+        let create_array = wrap_create_array(&create_array, user_data);
+        let create_view = |shape: Vec<usize>, data: &[f64]| {
+            let mut array = eqs_array_t::null();
+            let status = create_array_view(
+                user_data,
+                shape.as_ptr(),
+                shape.len(),
+                data.as_ptr(),
+                &mut array
+            );
+
+            if status.is_success() {
+                return Ok(array);
+            } else {
+                return Err(Error::External {
+                    status: status,
+                    context: "failed to create a new array view in eqs_tensormap_load_buffer_view".into()
+                });
+            }
+        };
+
+        let buffer = std::slice::from_raw_parts(buffer, buffer_count);
+        let tensor = crate::io::load_view(buffer, create_array, create_view)?;
+
+        // force the closure to capture the full unwind_wrapper, not just
+        // unwind_wrapper.0
+        let _ = &unwind_wrapper;
+        *(unwind_wrapper.0) = eqs_tensormap_t::into_boxed_raw(tensor);
+        Ok(())
+    });
+
+    if !status.is_success() {
+        return std::ptr::null_mut();
+    }
+
+    return result;
+}
+
+/// Opaque type representing a serialized `TensorMap` opened with
+/// `eqs_lazy_tensormap_open`, from which blocks are loaded on demand.
+#[allow(non_camel_case_types)]
+pub struct eqs_lazy_tensormap_t(LazyTensorMap<BufReader<File>>);
+
+/// Open the serialized tensor map in the file at the given path, without
+/// loading the blocks.
+///
+/// Only the keys are read when opening the file. The labels and data of each
+/// block are only read when calling `eqs_lazy_tensormap_load_block`. The file
+/// must use the same format as for `eqs_tensormap_load`, and should not be
+/// modified while it is open.
+///
+/// The memory allocated by this function should be released using
+/// `eqs_lazy_tensormap_free`.
+///
+/// @param path path to the file as a NULL-terminated UTF-8 string
+///
+/// @returns A pointer to the newly allocated lazy tensor map, or a `NULL`
+///          pointer in case of error. In case of error, you can use
+///          `eqs_last_error()` to get the error message.
+#[no_mangle]
+pub unsafe extern fn eqs_lazy_tensormap_open(
+    path: *const c_char,
+) -> *mut eqs_lazy_tensormap_t {
+    let mut result = std::ptr::null_mut();
+    let unwind_wrapper = std::panic::AssertUnwindSafe(&mut result);
+    let status = catch_unwind(move || {
+        check_pointers!(path);
+
+        let path = CStr::from_ptr(path).to_str().expect("use UTF-8 for path");
+        let file = BufReader::new(File::open(path)?);
+        let lazy = LazyTensorMap::open(file)?;
+
+        // force the closure to capture the full unwind_wrapper, not just
+        // unwind_wrapper.0
+        let _ = &unwind_wrapper;
+        *(unwind_wrapper.0) = Box::into_raw(Box::new(eqs_lazy_tensormap_t(lazy)));
+        Ok(())
+    });
+
+    if !status.is_success() {
+        return std::ptr::null_mut();
+    }
+
+    return result;
+}
+
+/// Free the memory associated with a `lazy` tensor map previously created
+/// with `eqs_lazy_tensormap_open`, and close the corresponding file.
+///
+/// Blocks loaded from this lazy tensor map are not affected, and should be
+/// released separately.
+///
+/// If `lazy` is `NULL`, this function does nothing.
+///
+/// @param lazy pointer to an existing lazy tensor map, or `NULL`
+///
+/// @returns The status code of this operation. If the status is not
+///          `EQS_SUCCESS`, you can use `eqs_last_error()` to get the full
+///          error message.
+#[no_mangle]
+pub unsafe extern fn eqs_lazy_tensormap_free(
+    lazy: *mut eqs_lazy_tensormap_t,
+) -> eqs_status_t {
+    catch_unwind(|| {
+        if !lazy.is_null() {
+            std::mem::drop(Box::from_raw(lazy));
+        }
+
+        Ok(())
+    })
+}
+
+/// Get the keys for the given `lazy` tensor map.
+///
+/// This function allocates memory for `keys` which must be released
+/// `eqs_labels_free` when you don't need it anymore.
+///
+/// @param lazy pointer to an existing lazy tensor map
+/// @param keys pointer to be filled with the keys of the tensor map
+///
+/// @returns The status code of this operation. If the status is not
+///          `EQS_SUCCESS`, you can use `eqs_last_error()` to get the full
+///          error message.
+#[no_mangle]
+pub unsafe extern fn eqs_lazy_tensormap_keys(
+    lazy: *const eqs_lazy_tensormap_t,
+    keys: *mut eqs_labels_t,
+) -> eqs_status_t {
+    catch_unwind(|| {
+        check_pointers!(lazy, keys);
+
+        if (*keys).is_rust() {
+            return Err(Error::InvalidParameter(
+                "these labels are already allocated, call eqs_labels_free first".into()
+            ));
+        }
+
+        *keys = rust_to_eqs_labels(Arc::clone((*lazy).0.keys()));
+        Ok(())
+    })
+}
+
+/// Get indices of the blocks in this `lazy` tensor map corresponding to the
+/// given `selection`, without loading any block. This function works like
+/// `eqs_tensormap_blocks_matching`.
+///
+/// @param lazy pointer to an existing lazy tensor map
+/// @param block_indexes array to be filled with indexes of blocks in the tensor
+///                      map matching the `selection`
+/// @param count number of entries in `block_indexes`
+/// @param selection labels with a single entry describing which blocks are requested
+///
+/// @returns The status code of this operation. If the status is not
+///          `EQS_SUCCESS`, you can use `eqs_last_error()` to get the full
+///          error message.
+#[no_mangle]
+pub unsafe extern fn eqs_lazy_tensormap_blocks_matching(
+    lazy: *const eqs_lazy_tensormap_t,
+    block_indexes: *mut usize,
+    count: *mut usize,
+    selection: eqs_labels_t,
+) -> eqs_status_t {
+    catch_unwind(|| {
+        check_pointers!(lazy, count);
+
+        let keys = (*lazy).0.keys();
+        if *count != keys.count() {
+            return Err(Error::InvalidParameter(format!(
+                "expected space for {} indices as input to eqs_lazy_tensormap_blocks_matching, got space for {}",
+                keys.count(), *count
+            )));
+        }
+
+        let selection = eqs_labels_to_rust(&selection)?;
+        let rust_blocks = (*lazy).0.blocks_matching(&selection)?;
+        *count = rust_blocks.len();
+
+        if keys.is_empty() {
+            return Ok(());
+        }
+
+        check_pointers!(block_indexes);
+        let block_indexes = std::slice::from_raw_parts_mut(block_indexes, *count);
+        for (idx, block) in rust_blocks.into_iter().enumerate() {
+            block_indexes[idx] = block;
+        }
+
+        Ok(())
+    })
+}
+
+/// Load the `index`-th block (including its gradients) from this `lazy`
+/// tensor map.
+///
+/// Arrays for the values and gradient data will be created with the given
+/// `create_array` callback, and filled by this function with the
+/// corresponding data. Each call to this function reads the block from the
+/// file again. This function can be called from multiple threads at the same
+/// time.
+///
+/// The memory allocated by this function should be released using
+/// `eqs_block_free`, or moved into a tensor map using `eqs_tensormap`.
+///
+/// @param lazy pointer to an existing lazy tensor map
+/// @param index index of the block to load
+/// @param create_array callback function that will be used to create data
+///                     arrays inside the block
+/// @param user_data custom data for the `create_array` callback, see
+///                  `eqs_tensormap_load`
+///
+/// @returns A pointer to the newly allocated block, or a `NULL` pointer in
+///          case of error. In case of error, you can use `eqs_last_error()`
+///          to get the error message.
+#[no_mangle]
+pub unsafe extern fn eqs_lazy_tensormap_load_block(
+    lazy: *const eqs_lazy_tensormap_t,
+    index: usize,
+    create_array: eqs_create_array_callback_t,
+    user_data: *mut c_void,
+) -> *mut eqs_block_t {
+    let _span = crate::profiling::span(b"eqs_lazy_tensormap_load_block\0");
+    let mut result = std::ptr::null_mut();
+    let unwind_wrapper = std::panic::AssertUnwindSafe(&mut result);
+    let status = catch_unwind(move || {
+        check_pointers!(lazy);
+
+        let create_array = wrap_create_array(&create_array, user_data);
+        let block = (*lazy).0.load_block(index, create_array)?;
+
+        // force the closure to capture the full unwind_wrapper, not just
+        // unwind_wrapper.0
+        let _ = &unwind_wrapper;
+        *(unwind_wrapper.0) = eqs_block_t::into_boxed_raw(block);
+        Ok(())
+    });
+
+    if !status.is_success() {
+        return std::ptr::null_mut();
+    }
+
+    return result;
+}
+
+/// `user_data` for the `eqs_create_array_callback_t`, which can be used from
+/// multiple threads when loading blocks in parallel.
+#[derive(Clone, Copy)]
+struct CreateArrayUserData(*mut c_void);
+
+// SAFETY: the user is responsible for making `user_data` usable from any
+// thread, `create_array` can be called concurrently when using multiple threads
+unsafe impl Sync for CreateArrayUserData {}
+unsafe impl Send for CreateArrayUserData {}
+
+fn wrap_create_array(create_array: &eqs_create_array_callback_t, user_data: *mut c_void) -> impl Fn(Vec<usize>, DType) -> Result<eqs_array_t, Error> + '_ {
+    let user_data = CreateArrayUserData(user_data);
+    move |shape: Vec<usize>, dtype: DType| {
+        // force the closure to capture the full user_data (which is Sync),
+        // not just user_data.0
+        let user_data = user_data;
+
         let mut array = eqs_array_t::null();
         let status = unsafe {
             create_array(
+                user_data.0,
                 shape.as_ptr(),
                 shape.len(),
+                dtype.to_raw(),
                 &mut array
             )
         };
@@ -192,6 +641,7 @@ pub unsafe extern fn eqs_tensormap_save(
     path: *const c_char,
     tensor: *const eqs_tensormap_t,
 ) -> eqs_status_t {
+    let _span = crate::profiling::span(b"eqs_tensormap_save\0");
     catch_unwind(|| {
         check_pointers!(path, tensor);
 
@@ -204,6 +654,209 @@ pub unsafe extern fn eqs_tensormap_save(
 }
 
 
+/// Save a tensor map to the file at the given path, compressing the data.
+///
+/// The files inside the archive are compressed with DEFLATE, using the
+/// fastest compression level. Such archives can be loaded with
+/// `eqs_tensormap_load` and the other loading functions, but the data can
+/// not be used directly from the buffer in `eqs_tensormap_load_buffer_view`,
+/// and is copied instead.
+///
+/// If the file already exists, it is overwritten.
+///
+/// @param path path to the file as a NULL-terminated UTF-8 string
+/// @param tensor tensor map to save to the file
+///
+/// @returns The status code of this operation. If the status is not
+///          `EQS_SUCCESS`, you can use `eqs_last_error()` to get the full
+///          error message.
+#[no_mangle]
+pub unsafe extern fn eqs_tensormap_save_compressed(
+    path: *const c_char,
+    tensor: *const eqs_tensormap_t,
+) -> eqs_status_t {
+    let _span = crate::profiling::span(b"eqs_tensormap_save_compressed\0");
+    catch_unwind(|| {
+        check_pointers!(path, tensor);
+
+        let path = CStr::from_ptr(path).to_str().expect("use UTF-8 for path");
+        let file = BufWriter::new(File::create(path)?);
+        crate::io::save_compressed(file, &*tensor)?;
+
+        Ok(())
+    })
+}
+
+/// Function pointer used to write serialized data to an external sink.
+///
+/// This function should write all the `count` bytes in `data` at the current
+/// position of the sink, overwriting any data already there, and move the
+/// position to the end of the written data. The `user_data` is passed
+/// unchanged from `eqs_tensormap_save_stream`.
+#[allow(non_camel_case_types)]
+type eqs_write_callback_t = unsafe extern fn(
+    user_data: *mut c_void,
+    data: *const u8,
+    count: usize,
+) -> eqs_status_t;
+
+/// Function pointer used to move the current position of an external sink.
+///
+/// This function should move the current position of the sink to `position`
+/// bytes after the start of the data written by `eqs_tensormap_save_stream`.
+/// The new position is never past the end of the data already written. The
+/// `user_data` is passed unchanged from `eqs_tensormap_save_stream`.
+#[allow(non_camel_case_types)]
+type eqs_seek_callback_t = unsafe extern fn(
+    user_data: *mut c_void,
+    position: u64,
+) -> eqs_status_t;
+
+/// Wrapper around the `write` and `seek` callbacks given to
+/// `eqs_tensormap_save_stream`
+struct ExternalWriter {
+    user_data: *mut c_void,
+    write: eqs_write_callback_t,
+    seek: eqs_seek_callback_t,
+
+    /// current position in the sink
+    current: u64,
+    /// total number of bytes in the sink
+    size: u64,
+    /// status of the last failed callback, if any
+    status: Option<eqs_status_t>,
+}
+
+impl std::io::Write for ExternalWriter {
+    fn write(&mut self, buf: &[u8]) -> std::io::Result<usize> {
+        let status = unsafe {
+            (self.write)(self.user_data, buf.as_ptr(), buf.len())
+        };
+
+        if !status.is_success() {
+            self.status = Some(status);
+            return Err(std::io::Error::new(
+                std::io::ErrorKind::Other, "failed to write data with the write callback"
+            ));
+        }
+
+        self.current += buf.len() as u64;
+        self.size = std::cmp::max(self.size, self.current);
+
+        return Ok(buf.len());
+    }
+
+    fn flush(&mut self) -> std::io::Result<()> {
+        return Ok(());
+    }
+}
+
+#[allow(clippy::cast_sign_loss, clippy::cast_possible_wrap)]
+impl std::io::Seek for ExternalWriter {
+    fn seek(&mut self, pos: std::io::SeekFrom) -> std::io::Result<u64> {
+        let position = match pos {
+            std::io::SeekFrom::Start(offset) => offset as i64,
+            std::io::SeekFrom::End(offset) => self.size as i64 + offset,
+            std::io::SeekFrom::Current(offset) => self.current as i64 + offset,
+        };
+
+        if position > self.size as i64 {
+            return Err(std::io::Error::new(
+                std::io::ErrorKind::UnexpectedEof, "tried to seek past the end of the stream")
+            );
+        }
+
+        if position < 0 {
+            return Err(std::io::Error::new(
+                std::io::ErrorKind::UnexpectedEof, "tried to seek past the beginning of the stream")
+            );
+        }
+
+        let position = position as u64;
+        if position != self.current {
+            let status = unsafe {
+                (self.seek)(self.user_data, position)
+            };
+
+            if !status.is_success() {
+                self.status = Some(status);
+                return Err(std::io::Error::new(
+                    std::io::ErrorKind::Other, "failed to move in the stream with the seek callback"
+                ));
+            }
+
+            self.current = position;
+        }
+
+        return Ok(self.current);
+    }
+
+    fn stream_position(&mut self) -> std::io::Result<u64> {
+        return Ok(self.current);
+    }
+}
+
+/// Save a tensor map by streaming the serialized data to an external sink.
+///
+/// The data is produced incrementally, and given to the `write` callback in
+/// chunks, without ever holding the whole serialized tensor map in memory.
+/// When finishing the archive, some data already written needs to be updated,
+/// and the `seek` callback is used to move the position of the sink before
+/// writing again. The sink should start empty; positions given to `seek` are
+/// relative to the start of the data written by this function.
+///
+/// The data is written using the same format as `eqs_tensormap_save`.
+///
+/// @param user_data custom data for the `write` and `seek` callbacks, which
+///        will be passed as their first argument as-is.
+/// @param write callback used to write data to the sink
+/// @param seek callback used to move the position of the sink
+/// @param tensor tensor map that will be saved to the sink
+///
+/// @returns The status code of this operation. If the status is not
+///          `EQS_SUCCESS`, you can use `eqs_last_error()` to get the full error
+///          message.
+#[no_mangle]
+pub unsafe extern fn eqs_tensormap_save_stream(
+    user_data: *mut c_void,
+    write: Option<eqs_write_callback_t>,
+    seek: Option<eqs_seek_callback_t>,
+    tensor: *const eqs_tensormap_t,
+) -> eqs_status_t {
+    let _span = crate::profiling::span(b"eqs_tensormap_save_stream\0");
+    catch_unwind(|| {
+        check_pointers!(tensor);
+
+        if write.is_none() || seek.is_none() {
+            return Err(Error::InvalidParameter(
+                "write and seek callbacks can not be NULL in eqs_tensormap_save_stream".into()
+            ));
+        }
+
+        let mut writer = ExternalWriter {
+            user_data,
+            write: write.expect("we checked"),
+            seek: seek.expect("we checked"),
+            current: 0,
+            size: 0,
+            status: None,
+        };
+
+        // group the small writes from the zip archive into larger chunks
+        let result = crate::io::save(BufWriter::new(&mut writer), &*tensor);
+
+        if let Some(status) = writer.status {
+            return Err(Error::External {
+                status: status,
+                context: "failed to write data in eqs_tensormap_save_stream".into()
+            });
+        }
+
+        result
+    })
+}
+
+
 /// Wrapper for an externally managed buffer, that can be grown to fit more data
 struct ExternalBuffer {
     data: *mut *mut u8,
@@ -221,16 +874,19 @@ impl std::io::Write for ExternalBuffer {
         let mut remaining_space = self.len - self.current as usize;
 
         if remaining_space < buf.len() {
-            // find the new size to be able to fit all the data
-            let mut new_size = 0;
-            while remaining_space < buf.len() {
-                new_size = if self.len == 0 {
-                    1024
-                } else {
-                    2 * self.len
-                };
-                remaining_space = new_size - self.current as usize;
+            // find the new size to be able to fit all the data, growing the
+            // allocation geometrically to keep the number of calls to
+            // `realloc` logarithmic in the final size
+            let mut new_size = if self.len == 0 {
+                1024
+            } else {
+                self.len
+            };
+
+            while new_size - (self.current as usize) < buf.len() {
+                new_size *= 2;
             }
+            remaining_space = new_size - self.current as usize;
 
             let new_ptr = unsafe {
                 (self.realloc)(self.realloc_user_data, *self.data, new_size)
@@ -367,6 +1023,7 @@ pub unsafe extern fn eqs_tensormap_save_buffer(
     realloc: Option<unsafe extern fn(user_data: *mut c_void, ptr: *mut u8, new_size: usize) -> *mut u8>,
     tensor: *const eqs_tensormap_t,
 ) -> eqs_status_t {
+    let _span = crate::profiling::span(b"eqs_tensormap_save_buffer\0");
     catch_unwind(|| {
         check_pointers!(tensor, buffer_count, buffer);
 
@@ -2,7 +2,9 @@ use std::os::raw::{c_char, c_void};
 use std::ffi::CStr;
 use std::sync::Arc;
 
-use crate::{LabelValue, Labels, LabelsBuilder, Error};
+use rayon::prelude::*;
+
+use crate::{LabelValue, Labels, Error};
 use super::status::{eqs_status_t, catch_unwind};
 
 /// A set of labels used to carry metadata associated with a tensor map.
@@ -118,18 +120,14 @@ unsafe fn create_rust_labels(labels: &eqs_labels_t) -> Result<Arc<Labels>, Error
         names.push(name);
     }
 
-    let mut builder = LabelsBuilder::new(names)?;
-    builder.reserve(labels.count);
-
-    if labels.count != 0 && labels.size != 0 {
+    let values = if labels.count != 0 && labels.size != 0 {
         assert!(!labels.values.is_null());
-        let slice = std::slice::from_raw_parts(labels.values.cast::<LabelValue>(), labels.count * labels.size);
-        for chunk in slice.chunks_exact(labels.size) {
-            builder.add(chunk)?;
-        }
-    }
+        std::slice::from_raw_parts(labels.values.cast::<LabelValue>(), labels.count * labels.size).to_vec()
+    } else {
+        Vec::new()
+    };
 
-    return Ok(Arc::new(builder.finish()));
+    return Ok(Arc::new(Labels::new(names, values)?));
 }
 
 
@@ -179,6 +177,70 @@ pub unsafe extern fn eqs_labels_position(
 }
 
 
+/// Number of entries above which `eqs_labels_positions` distributes the
+/// lookups over multiple threads
+const PARALLEL_POSITIONS_THRESHOLD: usize = 16384;
+
+/// Get the positions of multiple entries in the given set of `labels`, in a
+/// single call. This operation is only available if the labels correspond to
+/// a set of Rust Labels (i.e. `labels.internal_ptr_` is not NULL).
+///
+/// The `values` array should contain `count` entries, each one containing
+/// `labels.size` values, stored contiguously. For large number of entries,
+/// the lookups are distributed over multiple threads.
+///
+/// @param labels set of labels with an associated Rust data structure
+/// @param values array containing the entries to lookup
+/// @param count number of entries in the `values` array
+/// @param result array of `count` elements, which will be filled with the
+///               position of each entry in the labels, or -1 if this entry
+///               was not found
+///
+/// @returns The status code of this operation. If the status is not
+///          `EQS_SUCCESS`, you can use `eqs_last_error()` to get the full
+///          error message.
+#[no_mangle]
+pub unsafe extern fn eqs_labels_positions(
+    labels: eqs_labels_t,
+    values: *const i32,
+    count: usize,
+    result: *mut i64
+) -> eqs_status_t {
+    let _span = crate::profiling::span(b"eqs_labels_positions\0");
+    catch_unwind(|| {
+        if !labels.is_rust() {
+            return Err(Error::InvalidParameter(
+                "these labels do not support calling eqs_labels_positions, \
+                call eqs_labels_create first".into()
+            ));
+        }
+
+        if count == 0 {
+            return Ok(());
+        }
+        check_pointers!(values, result);
+
+        let labels = &(*labels.internal_ptr_.cast::<Labels>());
+        assert!(labels.size() != 0);
+
+        let entries = std::slice::from_raw_parts(values.cast::<LabelValue>(), count * labels.size());
+        let result = std::slice::from_raw_parts_mut(result, count);
+
+        let lookup = |(entry, result): (&[LabelValue], &mut i64)| {
+            *result = labels.position(entry).map_or(-1, |p| p as i64);
+        };
+
+        if count >= PARALLEL_POSITIONS_THRESHOLD {
+            entries.par_chunks_exact(labels.size()).zip(result.par_iter_mut()).for_each(lookup);
+        } else {
+            entries.chunks_exact(labels.size()).zip(result.iter_mut()).for_each(lookup);
+        }
+
+        Ok(())
+    })
+}
+
+
 /// Finish the creation of `eqs_labels_t` by associating it to Rust-owned
 /// labels.
 ///
@@ -197,6 +259,7 @@ pub unsafe extern fn eqs_labels_position(
 pub unsafe extern fn eqs_labels_create(
     labels: *mut eqs_labels_t,
 ) -> eqs_status_t {
+    let _span = crate::profiling::span(b"eqs_labels_create\0");
     catch_unwind(|| {
         check_pointers!(labels);
 
@@ -219,8 +282,17 @@ pub unsafe extern fn eqs_labels_create(
 /// `user_data`; and store the corresponding `user_data_delete` function to be
 /// called once the labels go out of scope.
 ///
-/// Any existing user data will be released (by calling the provided
-/// `user_data_delete` function) before overwriting with the new data.
+/// Any existing user data is kept alive until the labels are freed, and then
+/// released by calling the corresponding `user_data_delete` function. This
+/// makes it safe for other threads to keep using the pointer returned by
+/// `eqs_labels_user_data` while new data is being set, but means that the
+/// memory used by all the user data ever registered is only released with the
+/// labels. Data that changes over time (for example a pointer to the labels
+/// values on the current device) should be stored inside a single user data,
+/// registered once.
+///
+/// Labels can be shared between threads, so `user_data_delete` might be
+/// called from a different thread than the one which set the user data.
 ///
 /// @param labels set of labels where we want to add user data
 /// @param user_data pointer to the data
@@ -255,6 +327,10 @@ pub unsafe extern fn eqs_labels_set_user_data(
 ///
 /// If no data has been registered, `*user_data` will be NULL.
 ///
+/// This function does not take any lock, and can be called from multiple
+/// threads at the same time. The returned pointer stays valid until the
+/// `labels` are freed, even if `eqs_labels_set_user_data` is called again.
+///
 /// @param labels set of labels containing user data
 /// @param user_data this will be set to the pointer than was registered with
 ///                  these `labels`
@@ -420,6 +496,7 @@ pub unsafe extern fn eqs_labels_union(
     second_mapping: *mut i64,
     second_mapping_count: usize,
 ) -> eqs_status_t {
+    let _span = crate::profiling::span(b"eqs_labels_union\0");
     let unwind_wrapper = std::panic::AssertUnwindSafe(result);
     catch_unwind(|| {
         let (first_mapping, second_mapping) = labels_set_common(
@@ -450,6 +527,93 @@ pub unsafe extern fn eqs_labels_union(
     })
 }
 
+/// Take the union of all the `eqs_labels_t` in `labels`, in a single pass.
+///
+/// The result contains all the entries of `labels[0]`, followed by the new
+/// entries from `labels[1]`, and so on. This gives the same result as
+/// repeatedly calling `eqs_labels_union`, without creating all the
+/// intermediary labels.
+///
+/// If requested, this function can also give the positions in the union where
+/// each entry of the input `eqs_labels_t` ended up.
+///
+/// This function allocates memory for `result` which must be released
+/// `eqs_labels_free` when you don't need it anymore.
+///
+/// @param labels array of labels, all with the same names
+/// @param labels_count number of labels in the `labels` array
+/// @param result empty labels, on output will contain the union of all
+///        `labels`
+/// @param mapping if you want the mapping from the positions of entries in
+///        each of the `labels` to the positions in `result`, this should be a
+///        pointer to an array containing `labels[0].count + labels[1].count +
+///        ...` elements, to be filled by this function. The mapping for
+///        `labels[i]` starts after the mapping for `labels[i - 1]`. Otherwise
+///        it should be a `NULL` pointer.
+/// @param mapping_count number of elements in the `mapping` array
+/// @returns The status code of this operation. If the status is not
+///          `EQS_SUCCESS`, you can use `eqs_last_error()` to get the full
+///          error message.
+#[no_mangle]
+pub unsafe extern fn eqs_labels_union_many(
+    labels: *const eqs_labels_t,
+    labels_count: usize,
+    result: *mut eqs_labels_t,
+    mapping: *mut i64,
+    mapping_count: usize,
+) -> eqs_status_t {
+    let _span = crate::profiling::span(b"eqs_labels_union_many\0");
+    let unwind_wrapper = std::panic::AssertUnwindSafe(result);
+    catch_unwind(|| {
+        let labels = if labels_count == 0 {
+            &[]
+        } else {
+            check_pointers!(labels);
+            std::slice::from_raw_parts(labels, labels_count)
+        };
+
+        let mut rust_labels = Vec::with_capacity(labels.len());
+        for (i, labels) in labels.iter().enumerate() {
+            if !labels.is_rust() {
+                return Err(Error::InvalidParameter(format!(
+                    "the labels at index {} do not support union, call eqs_labels_create first",
+                    i
+                )));
+            }
+            rust_labels.push(&*labels.internal_ptr_.cast::<Labels>());
+        }
+
+        let mut mappings = Vec::new();
+        if !mapping.is_null() {
+            let total_count = labels.iter().map(|l| l.count).sum::<usize>();
+            if mapping_count != total_count {
+                return Err(Error::InvalidParameter(format!(
+                    "`mapping_count` ({}) must match the total number of \
+                    elements in `labels` ({}) but doesn't",
+                    mapping_count,
+                    total_count,
+                )));
+            }
+
+            let mut mapping = std::slice::from_raw_parts_mut(mapping, mapping_count);
+            for labels in labels {
+                let (current, rest) = mapping.split_at_mut(labels.count);
+                mappings.push(current);
+                mapping = rest;
+            }
+        }
+
+        let result_rust = Labels::union_many(&rust_labels, &mut mappings)?;
+
+        // force the closure to capture the full unwind_wrapper, not just
+        // unwind_wrapper.0
+        let _ = &unwind_wrapper;
+        *unwind_wrapper.0 = rust_to_eqs_labels(Arc::new(result_rust));
+
+        Ok(())
+    })
+}
+
 /// Take the intersection of two `eqs_labels_t`.
 ///
 /// If requested, this function can also give the positions in the intersection
@@ -487,6 +651,7 @@ pub unsafe extern fn eqs_labels_intersection(
     second_mapping: *mut i64,
     second_mapping_count: usize,
 ) -> eqs_status_t {
+    let _span = crate::profiling::span(b"eqs_labels_intersection\0");
     let unwind_wrapper = std::panic::AssertUnwindSafe(result);
     catch_unwind(|| {
         let (first_mapping, second_mapping) = labels_set_common(
@@ -24,6 +24,8 @@ pub use self::tensor::eqs_tensormap_t;
 
 pub mod io;
 
+pub mod profiling;
+
 mod utils;
 
 /// Disable printing of the message to stderr when some Rust code reach a panic.
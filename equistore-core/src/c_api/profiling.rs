@@ -0,0 +1,38 @@
+use std::os::raw::c_void;
+
+use crate::profiling::eqs_profiling_callback_t;
+
+use super::status::{catch_unwind, eqs_status_t};
+
+/// Register a `callback` to be called at the end of the main functions of
+/// equistore (creating and operating on `eqs_tensormap_t`, loading and saving
+/// data, etc.), reporting the time spent in this function and some counters
+/// (bytes of arrays data moved, number of labels entries hashed, number of
+/// calls to `eqs_array_t` functions).
+///
+/// Only a single callback can be registered at a given time, and calling this
+/// function again will replace the previous callback. Passing a `NULL`
+/// `callback` disables profiling, which is also the default. When profiling
+/// is disabled, the cost of the instrumentation is negligible.
+///
+/// The callback can be called from any thread, and concurrently from multiple
+/// threads. The counters are shared between threads, so the values reported
+/// for a call can include work done concurrently by other calls.
+///
+/// @param callback function that will be called with `user_data` and the
+///                 profiling event, or `NULL` to disable profiling
+/// @param user_data data that will be passed to the callback
+///
+/// @returns The status code of this operation. If the status is not
+///          `EQS_SUCCESS`, you can use `eqs_last_error()` to get the full
+///          error message.
+#[no_mangle]
+pub unsafe extern fn eqs_set_profiling_callback(
+    callback: eqs_profiling_callback_t,
+    user_data: *mut c_void,
+) -> eqs_status_t {
+    catch_unwind(|| {
+        crate::profiling::set_callback(callback, user_data);
+        Ok(())
+    })
+}
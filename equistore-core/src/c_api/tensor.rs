@@ -3,7 +3,7 @@ use std::sync::Arc;
 use std::ffi::CStr;
 use std::collections::BTreeSet;
 
-use crate::{TensorMap, TensorBlock, Error};
+use crate::{TensorMap, TensorMapBuilder, TensorBlock, LabelValue, Error};
 
 use super::labels::{eqs_labels_t, rust_to_eqs_labels, eqs_labels_to_rust};
 use super::blocks::eqs_block_t;
@@ -64,6 +64,7 @@ pub unsafe extern fn eqs_tensormap(
     blocks: *mut *mut eqs_block_t,
     blocks_count: usize,
 ) -> *mut eqs_tensormap_t {
+    let _span = crate::profiling::span(b"eqs_tensormap\0");
     let mut result = std::ptr::null_mut();
     let unwind_wrapper = std::panic::AssertUnwindSafe(&mut result);
 
@@ -142,6 +143,7 @@ pub unsafe extern fn eqs_tensormap_free(tensor: *mut eqs_tensormap_t) -> eqs_sta
 pub unsafe extern fn eqs_tensormap_copy(
     tensor: *const eqs_tensormap_t,
 ) -> *mut eqs_tensormap_t {
+    let _span = crate::profiling::span(b"eqs_tensormap_copy\0");
     let mut result = std::ptr::null_mut();
     let unwind_wrapper = std::panic::AssertUnwindSafe(&mut result);
     let status = catch_unwind(move || {
@@ -202,6 +204,10 @@ pub unsafe extern fn eqs_tensormap_keys(
 /// `eqs_tensormap_free` or the set of keys is modified by calling one
 /// of the `eqs_tensormap_keys_to_XXX` function.
 ///
+/// This function does not modify the tensor map, and can be called from
+/// multiple threads at the same time. Different threads can then read the
+/// same block concurrently, as long as none of them modifies it.
+///
 /// @param tensor pointer to an existing tensor map
 /// @param block pointer to be filled with a block
 /// @param index index of the block to get
@@ -218,10 +224,12 @@ pub unsafe extern fn eqs_tensormap_block_by_id(
     catch_unwind(|| {
         check_pointers!(tensor, block);
 
-        let blocks = (*tensor).blocks_mut();
-        match blocks.get_mut(index) {
+        // only take a shared reference to the tensor map here, since other
+        // threads might be accessing the blocks at the same time
+        let blocks = (*tensor).blocks();
+        match blocks.get(index) {
             Some(b) => {
-                (*block) = (b as *mut TensorBlock).cast();
+                (*block) = (b as *const TensorBlock as *mut TensorBlock).cast();
             }
             None => {
                 return Err(Error::InvalidParameter(format!(
@@ -262,6 +270,7 @@ pub unsafe extern fn eqs_tensormap_blocks_matching(
 	count: *mut usize,
     selection: eqs_labels_t,
 ) -> eqs_status_t {
+    let _span = crate::profiling::span(b"eqs_tensormap_blocks_matching\0");
     catch_unwind(|| {
         check_pointers!(tensor, count);
 
@@ -291,6 +300,71 @@ pub unsafe extern fn eqs_tensormap_blocks_matching(
 }
 
 
+/// Get indices of the blocks in this `tensor` where the keys dimensions in
+/// `names` take the corresponding `values`. This is equivalent to
+/// `eqs_tensormap_blocks_matching` with a selection containing a single entry,
+/// without having to create the corresponding labels.
+///
+/// The first call to this function builds an index of the keys, which is
+/// cached inside the tensor map. Following calls take a time proportional to
+/// the number of matching blocks instead of the number of keys.
+///
+/// When calling this function, `*count` should contain the number of entries in
+/// `block_indexes`. When the function returns successfully, `*count` will
+/// contain the number of blocks matching the selection. If this is larger than
+/// the initial value of `*count`, only the first blocks are written to
+/// `block_indexes`, and the function should be called again with a larger
+/// array to get all of them.
+///
+/// @param tensor pointer to an existing tensor map
+/// @param block_indexes array to be filled with indexes of blocks in the tensor
+///                      map matching the selection
+/// @param count number of entries in `block_indexes`
+/// @param names names of the keys dimensions used in the selection
+/// @param values values taken by the corresponding dimensions in `names`
+/// @param size number of entries in `names` and `values`
+///
+/// @returns The status code of this operation. If the status is not
+///          `EQS_SUCCESS`, you can use `eqs_last_error()` to get the full
+///          error message.
+#[no_mangle]
+pub unsafe extern fn eqs_tensormap_blocks_matching_values(
+    tensor: *const eqs_tensormap_t,
+    block_indexes: *mut usize,
+    count: *mut usize,
+    names: *const *const c_char,
+    values: *const i32,
+    size: usize,
+) -> eqs_status_t {
+    catch_unwind(|| {
+        check_pointers!(tensor, count);
+
+        let mut rust_names = Vec::with_capacity(size);
+        let mut rust_values: &[LabelValue] = &[];
+        if size != 0 {
+            check_pointers!(names, values);
+            for &name in std::slice::from_raw_parts(names, size) {
+                check_pointers!(name);
+                rust_names.push(CStr::from_ptr(name).to_str().expect("invalid utf8"));
+            }
+            rust_values = std::slice::from_raw_parts(values.cast(), size);
+        }
+
+        let matching = (*tensor).blocks_matching_values(&rust_names, rust_values)?;
+
+        let written = usize::min(*count, matching.len());
+        if written != 0 {
+            check_pointers!(block_indexes);
+            let block_indexes = std::slice::from_raw_parts_mut(block_indexes, written);
+            block_indexes.copy_from_slice(&matching[..written]);
+        }
+        *count = matching.len();
+
+        Ok(())
+    })
+}
+
+
 /// Merge blocks with the same value for selected keys dimensions along the
 /// property axis.
 ///
@@ -324,6 +398,13 @@ pub unsafe extern fn eqs_tensormap_blocks_matching(
 /// @param keys_to_move description of the keys to move
 /// @param sort_samples whether to sort the samples lexicographically after
 ///                     merging blocks
+/// @param threads number of threads to use when merging blocks. Use 1 to run
+///                everything on the current thread, and 0 to use one thread
+///                per CPU core. When using multiple threads, different
+///                output blocks are merged concurrently. Data is only moved
+///                concurrently into the same output array (with disjoint
+///                samples or properties) if this array sets
+///                `eqs_array_t.concurrent_move_samples`.
 ///
 /// @returns A pointer to the newly allocated tensor map, or a `NULL` pointer in
 ///          case of error. In case of error, you can use `eqs_last_error()`
@@ -333,7 +414,9 @@ pub unsafe extern fn eqs_tensormap_keys_to_properties(
     tensor: *const eqs_tensormap_t,
     keys_to_move: eqs_labels_t,
     sort_samples: bool,
+    threads: usize,
 ) -> *mut eqs_tensormap_t {
+    let _span = crate::profiling::span(b"eqs_tensormap_keys_to_properties\0");
     let mut result = std::ptr::null_mut();
     let unwind_wrapper = std::panic::AssertUnwindSafe(&mut result);
 
@@ -341,7 +424,7 @@ pub unsafe extern fn eqs_tensormap_keys_to_properties(
         check_pointers!(tensor);
 
         let keys_to_move = eqs_labels_to_rust(&keys_to_move)?;
-        let moved = (*tensor).keys_to_properties(&keys_to_move, sort_samples)?;
+        let moved = (*tensor).keys_to_properties(&keys_to_move, sort_samples, threads)?;
 
         // force the closure to capture the full unwind_wrapper, not just
         // unwind_wrapper.0
@@ -377,6 +460,7 @@ pub unsafe extern fn eqs_tensormap_components_to_properties(
     dimensions: *const *const c_char,
     dimensions_count: usize,
 ) -> *mut eqs_tensormap_t {
+    let _span = crate::profiling::span(b"eqs_tensormap_components_to_properties\0");
     let mut result = std::ptr::null_mut();
     let unwind_wrapper = std::panic::AssertUnwindSafe(&mut result);
 
@@ -432,6 +516,13 @@ pub unsafe extern fn eqs_tensormap_components_to_properties(
 /// @param keys_to_move description of the keys to move
 /// @param sort_samples whether to sort the samples lexicographically after
 ///                     merging blocks or not
+/// @param threads number of threads to use when merging blocks. Use 1 to run
+///                everything on the current thread, and 0 to use one thread
+///                per CPU core. When using multiple threads, different
+///                output blocks are merged concurrently. Data is only moved
+///                concurrently into the same output array (with disjoint
+///                samples or properties) if this array sets
+///                `eqs_array_t.concurrent_move_samples`.
 ///
 /// @returns The status code of this operation. If the status is not
 ///          `EQS_SUCCESS`, you can use `eqs_last_error()` to get the full
@@ -441,7 +532,9 @@ pub unsafe extern fn eqs_tensormap_keys_to_samples(
     tensor: *const eqs_tensormap_t,
     keys_to_move: eqs_labels_t,
     sort_samples: bool,
+    threads: usize,
 ) -> *mut eqs_tensormap_t {
+    let _span = crate::profiling::span(b"eqs_tensormap_keys_to_samples\0");
     let mut result = std::ptr::null_mut();
     let unwind_wrapper = std::panic::AssertUnwindSafe(&mut result);
 
@@ -449,7 +542,7 @@ pub unsafe extern fn eqs_tensormap_keys_to_samples(
         check_pointers!(tensor);
 
         let keys_to_move = eqs_labels_to_rust(&keys_to_move)?;
-        let moved = (*tensor).keys_to_samples(&keys_to_move, sort_samples)?;
+        let moved = (*tensor).keys_to_samples(&keys_to_move, sort_samples, threads)?;
 
         // force the closure to capture the full unwind_wrapper, not just
         // unwind_wrapper.0
@@ -464,3 +557,228 @@ pub unsafe extern fn eqs_tensormap_keys_to_samples(
 
     return result;
 }
+
+/// Concatenate the blocks of multiple tensor maps along the samples axis.
+///
+/// The keys of the new tensor map are the union of the keys of all `tensors`,
+/// and each block contains the samples of all the blocks with the
+/// corresponding key, in the order of `tensors`. A new `"tensor"` dimension is
+/// added to the samples, containing the index in `tensors` of the tensor map
+/// each sample comes from.
+///
+/// Blocks with the same key must have the same samples names, components,
+/// properties, and set of gradients. Each output block is allocated once, and
+/// filled with a single call to `move_samples_from` per input block.
+///
+/// The memory allocated by this function should be released using
+/// `eqs_tensormap_free`.
+///
+/// @param tensors pointer to an array of `tensors_count` pointers to existing
+///                tensor maps
+/// @param tensors_count number of entries in the `tensors` array
+/// @param threads number of threads to use when joining blocks. Use 1 to run
+///                everything on the current thread, and 0 to use one thread
+///                per CPU core. When using multiple threads, different
+///                output blocks are joined concurrently. Data is only moved
+///                concurrently into the same output array (with disjoint
+///                samples) if this array sets
+///                `eqs_array_t.concurrent_move_samples`.
+///
+/// @returns A pointer to the newly allocated tensor map, or a `NULL` pointer in
+///          case of error. In case of error, you can use `eqs_last_error()`
+///          to get the error message.
+#[no_mangle]
+pub unsafe extern fn eqs_tensormap_join_samples(
+    tensors: *const *const eqs_tensormap_t,
+    tensors_count: usize,
+    threads: usize,
+) -> *mut eqs_tensormap_t {
+    let _span = crate::profiling::span(b"eqs_tensormap_join_samples\0");
+    let mut result = std::ptr::null_mut();
+    let unwind_wrapper = std::panic::AssertUnwindSafe(&mut result);
+
+    let status = catch_unwind(move || {
+        let mut rust_tensors = Vec::new();
+        if tensors_count != 0 {
+            check_pointers!(tensors);
+            for &tensor in std::slice::from_raw_parts(tensors, tensors_count) {
+                check_pointers!(tensor);
+                rust_tensors.push(&**tensor);
+            }
+        }
+
+        let joined = TensorMap::join_samples(&rust_tensors, threads)?;
+
+        // force the closure to capture the full unwind_wrapper, not just
+        // unwind_wrapper.0
+        let _ = &unwind_wrapper;
+        *unwind_wrapper.0 = eqs_tensormap_t::into_boxed_raw(joined);
+        Ok(())
+    });
+
+    if !status.is_success() {
+        return std::ptr::null_mut();
+    }
+
+    return result;
+}
+
+
+/// Opaque type used to build a `TensorMap` incrementally, adding blocks and
+/// appending samples to existing blocks.
+#[allow(non_camel_case_types)]
+pub struct eqs_tensormap_builder_t(TensorMapBuilder);
+
+/// Create a new empty `eqs_tensormap_builder_t`, for a tensor map with keys
+/// using the given `names`.
+///
+/// The memory allocated by this function should be released either with
+/// `eqs_tensormap_builder_finish` or `eqs_tensormap_builder_free`.
+///
+/// @param names names of the keys dimensions
+/// @param names_count number of entries in `names`
+///
+/// @returns A pointer to the newly allocated builder, or a `NULL` pointer in
+///          case of error. In case of error, you can use `eqs_last_error()`
+///          to get the error message.
+#[no_mangle]
+pub unsafe extern fn eqs_tensormap_builder(
+    names: *const *const c_char,
+    names_count: usize,
+) -> *mut eqs_tensormap_builder_t {
+    let mut result = std::ptr::null_mut();
+    let unwind_wrapper = std::panic::AssertUnwindSafe(&mut result);
+
+    let status = catch_unwind(move || {
+        let mut rust_names = Vec::with_capacity(names_count);
+        if names_count != 0 {
+            check_pointers!(names);
+            for &name in std::slice::from_raw_parts(names, names_count) {
+                check_pointers!(name);
+                rust_names.push(CStr::from_ptr(name).to_str().expect("invalid utf8"));
+            }
+        }
+
+        let builder = TensorMapBuilder::new(rust_names)?;
+
+        // force the closure to capture the full unwind_wrapper, not just
+        // unwind_wrapper.0
+        let _ = &unwind_wrapper;
+        *unwind_wrapper.0 = Box::into_raw(Box::new(eqs_tensormap_builder_t(builder)));
+        Ok(())
+    });
+
+    if !status.is_success() {
+        return std::ptr::null_mut();
+    }
+
+    return result;
+}
+
+/// Add a `block` associated with the given `key` to this `builder`.
+///
+/// If the builder already contains a block for this `key`, the samples of the
+/// new `block` are appended to the ones of the existing block, and the
+/// `"sample"` dimension of the gradients samples is updated accordingly. Both
+/// blocks must then have the same components, properties and set of
+/// gradients, and the new samples must not already be present in the
+/// existing block. The data of the appended blocks is copied into a single
+/// array when calling `eqs_tensormap_builder_finish`.
+///
+/// The builder takes ownership of the block, which should not be used or
+/// released separately after calling this function, even if it fails.
+///
+/// @param builder pointer to an existing tensor map builder
+/// @param key values of the key for this block
+/// @param key_count number of entries in `key`, this should be the same as
+///                  the number of names given to `eqs_tensormap_builder`
+/// @param block block to add to the builder
+///
+/// @returns The status code of this operation. If the status is not
+///          `EQS_SUCCESS`, you can use `eqs_last_error()` to get the full
+///          error message.
+#[no_mangle]
+pub unsafe extern fn eqs_tensormap_builder_add_block(
+    builder: *mut eqs_tensormap_builder_t,
+    key: *const i32,
+    key_count: usize,
+    block: *mut eqs_block_t,
+) -> eqs_status_t {
+    let _span = crate::profiling::span(b"eqs_tensormap_builder_add_block\0");
+    catch_unwind(|| {
+        check_pointers!(builder, block);
+        let block = Box::from_raw(block).into_block();
+
+        let mut rust_key: &[LabelValue] = &[];
+        if key_count != 0 {
+            check_pointers!(key);
+            rust_key = std::slice::from_raw_parts(key.cast(), key_count);
+        }
+
+        (*builder).0.add_block(rust_key, block)?;
+
+        Ok(())
+    })
+}
+
+/// Finish building a tensor map, and release the `builder`.
+///
+/// The `builder` is released by this function, even in case of error, and
+/// should not be used afterwards. Blocks added only once to the builder are
+/// moved to the tensor map without copying their data.
+///
+/// The memory allocated by this function should be released using
+/// `eqs_tensormap_free`.
+///
+/// @param builder pointer to an existing tensor map builder
+///
+/// @returns A pointer to the newly allocated tensor map, or a `NULL` pointer in
+///          case of error. In case of error, you can use `eqs_last_error()`
+///          to get the error message.
+#[no_mangle]
+pub unsafe extern fn eqs_tensormap_builder_finish(
+    builder: *mut eqs_tensormap_builder_t,
+) -> *mut eqs_tensormap_t {
+    let _span = crate::profiling::span(b"eqs_tensormap_builder_finish\0");
+    let mut result = std::ptr::null_mut();
+    let unwind_wrapper = std::panic::AssertUnwindSafe(&mut result);
+
+    let status = catch_unwind(move || {
+        check_pointers!(builder);
+        let builder = Box::from_raw(builder).0;
+        let tensor = builder.finish()?;
+
+        // force the closure to capture the full unwind_wrapper, not just
+        // unwind_wrapper.0
+        let _ = &unwind_wrapper;
+        *unwind_wrapper.0 = eqs_tensormap_t::into_boxed_raw(tensor);
+        Ok(())
+    });
+
+    if !status.is_success() {
+        return std::ptr::null_mut();
+    }
+
+    return result;
+}
+
+/// Free the memory associated with a `builder` previously created with
+/// `eqs_tensormap_builder`, including all the blocks added to it.
+///
+/// If `builder` is `NULL`, this function does nothing.
+///
+/// @param builder pointer to an existing tensor map builder, or `NULL`
+///
+/// @returns The status code of this operation. If the status is not
+///          `EQS_SUCCESS`, you can use `eqs_last_error()` to get the full
+///          error message.
+#[no_mangle]
+pub unsafe extern fn eqs_tensormap_builder_free(builder: *mut eqs_tensormap_builder_t) -> eqs_status_t {
+    catch_unwind(|| {
+        if !builder.is_null() {
+            std::mem::drop(Box::from_raw(builder));
+        }
+
+        Ok(())
+    })
+}
@@ -50,6 +50,64 @@ pub fn get_data_origin(origin: eqs_data_origin_t) -> String {
     }
 }
 
+/// Type of the data stored in an `eqs_array_t`. This should be one of the
+/// `EQS_DTYPE_XXX` constants.
+#[repr(transparent)]
+#[allow(non_camel_case_types)]
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct eqs_dtype_t(pub i32);
+
+/// Data type for 64-bit floating point values (`double`)
+pub const EQS_DTYPE_FLOAT64: i32 = 1;
+/// Data type for 32-bit floating point values (`float`)
+pub const EQS_DTYPE_FLOAT32: i32 = 2;
+/// Data type for 16-bit (half precision, IEEE-754 binary16) floating point
+/// values
+pub const EQS_DTYPE_FLOAT16: i32 = 3;
+
+/// Data types supported by equistore for the data in `eqs_array_t`
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum DType {
+    /// 64-bit floating point values
+    Float64,
+    /// 32-bit floating point values
+    Float32,
+    /// 16-bit floating point values
+    Float16,
+}
+
+impl DType {
+    /// Size in bytes of a single value of this data type
+    pub fn size(self) -> usize {
+        match self {
+            DType::Float64 => 8,
+            DType::Float32 => 4,
+            DType::Float16 => 2,
+        }
+    }
+
+    /// Get the data type corresponding to the given `eqs_dtype_t`
+    pub fn from_raw(dtype: eqs_dtype_t) -> Result<DType, Error> {
+        match dtype.0 {
+            EQS_DTYPE_FLOAT64 => Ok(DType::Float64),
+            EQS_DTYPE_FLOAT32 => Ok(DType::Float32),
+            EQS_DTYPE_FLOAT16 => Ok(DType::Float16),
+            other => Err(Error::InvalidParameter(format!(
+                "unknown data type in eqs_array_t: {}", other
+            ))),
+        }
+    }
+
+    /// Get the `eqs_dtype_t` corresponding to this data type
+    pub fn to_raw(self) -> eqs_dtype_t {
+        match self {
+            DType::Float64 => eqs_dtype_t(EQS_DTYPE_FLOAT64),
+            DType::Float32 => eqs_dtype_t(EQS_DTYPE_FLOAT32),
+            DType::Float16 => eqs_dtype_t(EQS_DTYPE_FLOAT16),
+        }
+    }
+}
+
 // SAFETY: this should be checked by the user/implementor of `eqs_array_t`.
 unsafe impl Sync for eqs_array_t {}
 unsafe impl Send for eqs_array_t {}
@@ -163,6 +221,85 @@ pub struct eqs_array_t {
         property_start: usize,
         property_end: usize,
     ) -> eqs_status_t>,
+
+    /// Create a new array with the same options as the current one (data type,
+    /// data location, etc.) and the requested `shape`; and store it in
+    /// `new_array`. The number of elements in the `shape` array should be given
+    /// in `shape_count`.
+    ///
+    /// Contrary to `create`, the new array does not need to be initialized,
+    /// since all of its entries will be overwritten (through
+    /// `move_samples_from`) before being read. This function can be set to
+    /// `NULL`, in which case `create` will be used instead.
+    create_uninit: Option<unsafe extern fn(
+        array: *const c_void,
+        shape: *const usize,
+        shape_count: usize,
+        new_array: *mut eqs_array_t,
+    ) -> eqs_status_t>,
+
+    /// Get the type of the data stored in this array in `dtype`, as one of the
+    /// `EQS_DTYPE_XXX` constants. This function can be set to `NULL`, in which
+    /// case the data is assumed to contain 64-bit floating point values.
+    dtype: Option<unsafe extern fn(
+        array: *const c_void,
+        dtype: *mut eqs_dtype_t,
+    ) -> eqs_status_t>,
+
+    /// Get a pointer to the underlying data storage, regardless of the type of
+    /// the data (as given by `dtype`).
+    ///
+    /// This function is allowed to fail if the data is not accessible in RAM,
+    /// or not stored as a C-contiguous array. This function can be set to
+    /// `NULL`, in which case `data` will be used for arrays containing 64-bit
+    /// floating point values.
+    raw_data: Option<unsafe extern fn(
+        array: *mut c_void,
+        data: *mut *mut c_void,
+    ) -> eqs_status_t>,
+
+    /// Copy the values of the samples from `sample_start` to `sample_end`
+    /// (excluded) in this `array` to `data`. `data` is a C-contiguous buffer
+    /// with space for all the values of these samples, with the type given by
+    /// `dtype`.
+    ///
+    /// This function should be set to `NULL` for arrays storing their data
+    /// as a C-contiguous array, accessible with `raw_data`. Arrays storing
+    /// their data differently (for example sparse arrays) can implement this
+    /// function to be serialized, in which case the data is saved a few
+    /// samples at the time, without creating a dense copy of the whole array.
+    get_samples: Option<unsafe extern fn(
+        array: *const c_void,
+        sample_start: usize,
+        sample_end: usize,
+        data: *mut c_void,
+    ) -> eqs_status_t>,
+
+    /// Set the values of the samples from `sample_start` to `sample_end`
+    /// (excluded) in this `array` from `data`. `data` is a C-contiguous buffer
+    /// containing all the values of these samples, with the type given by
+    /// `dtype`.
+    ///
+    /// Similarly to `get_samples`, this function should be set to `NULL` for
+    /// arrays storing their data as a C-contiguous array. If it is set, the
+    /// data of arrays created when loading a tensor map is set with this
+    /// function, a few samples at the time.
+    set_samples: Option<unsafe extern fn(
+        array: *mut c_void,
+        sample_start: usize,
+        sample_end: usize,
+        data: *const c_void,
+    ) -> eqs_status_t>,
+
+    /// Set this to `true` if `move_samples_from` can be called concurrently
+    /// from multiple threads with this array as the output, each call writing
+    /// to different samples or properties.
+    ///
+    /// When using multiple threads to merge blocks, data from multiple input
+    /// arrays is moved concurrently into the same output only for arrays
+    /// setting this to `true`. Otherwise, only different output arrays are
+    /// filled concurrently.
+    concurrent_move_samples: bool,
 }
 
 /// Representation of a single sample moved from an array to another one
@@ -217,6 +354,12 @@ impl eqs_array_t {
             // do not copy destroy, the user should never call it
             destroy: None,
             move_samples_from: self.move_samples_from,
+            create_uninit: self.create_uninit,
+            dtype: self.dtype,
+            raw_data: self.raw_data,
+            get_samples: self.get_samples,
+            set_samples: self.set_samples,
+            concurrent_move_samples: self.concurrent_move_samples,
         }
     }
 
@@ -233,12 +376,19 @@ impl eqs_array_t {
             copy: None,
             destroy: None,
             move_samples_from: None,
+            create_uninit: None,
+            dtype: None,
+            raw_data: None,
+            get_samples: None,
+            set_samples: None,
+            concurrent_move_samples: false,
         }
     }
 
     /// Get the origin of this array
     pub fn origin(&self) -> Result<eqs_data_origin_t, Error> {
         let function = self.origin.expect("eqs_array_t.origin function is NULL");
+        crate::profiling::array_callback();
 
         let mut origin = eqs_data_origin_t(0);
         let status = unsafe {
@@ -254,78 +404,173 @@ impl eqs_array_t {
         return Ok(origin);
     }
 
-    /// Get the underlying data for this array.
-    pub fn data(&self) -> Result<&[f64], Error> {
-        let shape = self.shape()?;
-        let mut len = 1;
-        for s in shape {
-            len *= s;
-        }
-
-        let function = self.data.expect("eqs_array_t.data function is NULL");
-
-        let mut data_ptr = std::ptr::null_mut();
+    /// Get the type of the data stored in this array. Arrays which do not
+    /// implement `eqs_array_t.dtype` contain 64-bit floating point values.
+    pub fn dtype(&self) -> Result<DType, Error> {
+        let function = match self.dtype {
+            Some(function) => function,
+            None => return Ok(DType::Float64),
+        };
+        crate::profiling::array_callback();
 
+        let mut dtype = eqs_dtype_t(0);
         let status = unsafe {
-            function(
-                self.ptr,
-                &mut data_ptr,
-            )
+            function(self.ptr, &mut dtype)
         };
 
         if !status.is_success() {
             return Err(Error::External {
-                status, context: "calling eqs_array_t.data failed".into()
+                status, context: "calling eqs_array_t.dtype failed".into()
             });
         }
 
-        assert!(len > 0);
+        return DType::from_raw(dtype);
+    }
+
+    /// Get the underlying data for this array as raw bytes, regardless of the
+    /// data type. The values are stored in native endianness.
+    pub fn raw_data(&self) -> Result<&[u8], Error> {
+        let dtype = self.dtype()?;
+        let len = self.shape()?.iter().product::<usize>() * dtype.size();
+        if len == 0 {
+            return Ok(&[]);
+        }
+
+        let data_ptr = self.raw_data_ptr(dtype)?;
         assert!(!data_ptr.is_null());
         let data = unsafe {
-            std::slice::from_raw_parts(data_ptr, len)
+            std::slice::from_raw_parts(data_ptr.cast::<u8>(), len)
         };
 
         return Ok(data);
     }
 
-    /// Get the underlying data for this array.
-    pub fn data_mut(&mut self) -> Result<&mut [f64], Error> {
-        let shape = self.shape()?;
-        let mut len = 1;
-        for s in shape {
-            len *= s;
+    /// Get the underlying data for this array as mutable raw bytes, regardless
+    /// of the data type. The values are stored in native endianness.
+    pub fn raw_data_mut(&mut self) -> Result<&mut [u8], Error> {
+        let dtype = self.dtype()?;
+        let len = self.shape()?.iter().product::<usize>() * dtype.size();
+        if len == 0 {
+            return Ok(&mut []);
         }
 
-        let function = self.data.expect("eqs_array_t.data function is NULL");
+        let data_ptr = self.raw_data_ptr(dtype)?;
+        assert!(!data_ptr.is_null());
+        let data = unsafe {
+            std::slice::from_raw_parts_mut(data_ptr.cast::<u8>(), len)
+        };
+
+        return Ok(data);
+    }
+
+    /// Get the pointer to the data of this array, using `eqs_array_t.raw_data`
+    /// if available, and falling back to `eqs_array_t.data` for 64-bit floats.
+    fn raw_data_ptr(&self, dtype: DType) -> Result<*mut c_void, Error> {
+        let function = match self.raw_data {
+            Some(function) => function,
+            None => {
+                if dtype != DType::Float64 {
+                    return Err(Error::InvalidParameter(format!(
+                        "eqs_array_t.raw_data is NULL for an array containing {:?} data",
+                        dtype
+                    )));
+                }
+
+                let function = self.data.expect("eqs_array_t.data function is NULL");
+                crate::profiling::array_callback();
+
+                let mut data_ptr = std::ptr::null_mut();
+                let status = unsafe {
+                    function(self.ptr, &mut data_ptr)
+                };
+
+                if !status.is_success() {
+                    return Err(Error::External {
+                        status, context: "calling eqs_array_t.data failed".into()
+                    });
+                }
+
+                return Ok(data_ptr.cast());
+            }
+        };
+        crate::profiling::array_callback();
 
         let mut data_ptr = std::ptr::null_mut();
+        let status = unsafe {
+            function(self.ptr, &mut data_ptr)
+        };
+
+        if !status.is_success() {
+            return Err(Error::External {
+                status, context: "calling eqs_array_t.raw_data failed".into()
+            });
+        }
+
+        return Ok(data_ptr);
+    }
+
+    /// Check if this array implements `eqs_array_t.get_samples`, giving access
+    /// to the data of a range of samples instead of the whole array
+    pub fn has_get_samples(&self) -> bool {
+        self.get_samples.is_some()
+    }
+
+    /// Check if this array implements `eqs_array_t.set_samples`, allowing to
+    /// set the data for a range of samples instead of the whole array
+    pub fn has_set_samples(&self) -> bool {
+        self.set_samples.is_some()
+    }
+
+    /// Check if `move_samples_from` can be called concurrently from multiple
+    /// threads with this array as the output
+    pub fn supports_concurrent_move_samples(&self) -> bool {
+        self.concurrent_move_samples
+    }
+
+    /// Copy the values for the given range of `samples` to `data`, as raw
+    /// bytes in native endianness. `data` must be large enough to contain all
+    /// the values for these samples.
+    pub fn get_samples(&self, samples: Range<usize>, data: &mut [u8]) -> Result<(), Error> {
+        let function = self.get_samples.expect("eqs_array_t.get_samples function is NULL");
+        crate::profiling::array_callback();
 
         let status = unsafe {
-            function(
-                self.ptr,
-                &mut data_ptr,
-            )
+            function(self.ptr, samples.start, samples.end, data.as_mut_ptr().cast())
         };
 
         if !status.is_success() {
             return Err(Error::External {
-                status, context: "calling eqs_array_t.data failed".into()
+                status, context: "calling eqs_array_t.get_samples failed".into()
             });
         }
 
-        assert!(len > 0);
-        assert!(!data_ptr.is_null());
-        let data = unsafe {
-            std::slice::from_raw_parts_mut(data_ptr, len)
+        return Ok(());
+    }
+
+    /// Set the values for the given range of `samples` from `data`, containing
+    /// raw bytes in native endianness.
+    pub fn set_samples(&mut self, samples: Range<usize>, data: &[u8]) -> Result<(), Error> {
+        let function = self.set_samples.expect("eqs_array_t.set_samples function is NULL");
+        crate::profiling::array_callback();
+
+        let status = unsafe {
+            function(self.ptr, samples.start, samples.end, data.as_ptr().cast())
         };
 
-        return Ok(data);
+        if !status.is_success() {
+            return Err(Error::External {
+                status, context: "calling eqs_array_t.set_samples failed".into()
+            });
+        }
+
+        return Ok(());
     }
 
     /// Get the shape of this array
     #[allow(clippy::cast_possible_truncation)]
     pub fn shape(&self) -> Result<&[usize], Error> {
         let function = self.shape.expect("eqs_array_t.shape function is NULL");
+        crate::profiling::array_callback();
 
         let mut shape = std::ptr::null();
         let mut shape_count: usize = 0;
@@ -356,6 +601,7 @@ impl eqs_array_t {
     /// Set the shape of this array to the given new `shape`
     pub fn reshape(&mut self, shape: &[usize]) -> Result<(), Error> {
         let function = self.reshape.expect("eqs_array_t.reshape function is NULL");
+        crate::profiling::array_callback();
 
         let status = unsafe {
             function(
@@ -377,6 +623,7 @@ impl eqs_array_t {
     /// Swap the axes `axis_1` and `axis_2` in the dimensions of this array.
     pub fn swap_axes(&mut self, axis_1: usize, axis_2: usize) -> Result<(), Error> {
         let function = self.swap_axes.expect("eqs_array_t.swap_axes function is NULL");
+        crate::profiling::array_callback();
 
         let status = unsafe {
             function(
@@ -398,6 +645,7 @@ impl eqs_array_t {
     /// Create a new array with the same settings as this one and the given `shape`
     pub fn create(&self, shape: &[usize]) -> Result<eqs_array_t, Error> {
         let function = self.create.expect("eqs_array_t.create function is NULL");
+        crate::profiling::array_callback();
 
         let mut data_storage = eqs_array_t::null();
         let status = unsafe {
@@ -418,10 +666,43 @@ impl eqs_array_t {
         return Ok(data_storage);
     }
 
+    /// Create a new array with the same settings as this one and the given
+    /// `shape`, without initializing the data. All the entries of the new
+    /// array must be set with `move_samples_from` before being read.
+    ///
+    /// This falls back to `eqs_array_t::create` if `create_uninit` is not
+    /// implemented for this array.
+    pub fn create_uninit(&self, shape: &[usize]) -> Result<eqs_array_t, Error> {
+        let function = match self.create_uninit {
+            Some(function) => function,
+            None => return self.create(shape),
+        };
+        crate::profiling::array_callback();
+
+        let mut data_storage = eqs_array_t::null();
+        let status = unsafe {
+            function(
+                self.ptr,
+                shape.as_ptr(),
+                shape.len(),
+                &mut data_storage
+            )
+        };
+
+        if !status.is_success() {
+            return Err(Error::External {
+                status, context: "calling eqs_array_t.create_uninit failed".into()
+            });
+        }
+
+        return Ok(data_storage);
+    }
+
     /// Try to copy this `eqs_array_t`. This can fail if the external data can
     /// not be copied for some reason
     pub fn try_clone(&self) -> Result<eqs_array_t, Error> {
         let function = self.copy.expect("eqs_array_t.copy function is NULL");
+        crate::profiling::array_callback();
 
         let mut new_array = eqs_array_t::null();
         let status = unsafe {
@@ -437,6 +718,46 @@ impl eqs_array_t {
         return Ok(new_array);
     }
 
+    /// Get the number of bytes used by a single sample and property of this
+    /// array (i.e. by all the components), for profiling purposes.
+    ///
+    /// The calls to `eqs_array_t` functions made here are not recorded, and
+    /// this returns `None` if any of them fails.
+    fn bytes_per_property(&self) -> Option<usize> {
+        let shape_fn = self.shape?;
+        let mut shape = std::ptr::null();
+        let mut shape_count: usize = 0;
+        let status = unsafe {
+            shape_fn(self.ptr, &mut shape, &mut shape_count)
+        };
+        if !status.is_success() || shape.is_null() || shape_count == 0 {
+            return None;
+        }
+        let shape = unsafe {
+            std::slice::from_raw_parts(shape, shape_count)
+        };
+
+        let dtype_size = match self.dtype {
+            Some(dtype_fn) => {
+                let mut dtype = eqs_dtype_t(0);
+                let status = unsafe { dtype_fn(self.ptr, &mut dtype) };
+                if !status.is_success() {
+                    return None;
+                }
+                DType::from_raw(dtype).ok()?.size()
+            }
+            None => DType::Float64.size(),
+        };
+
+        let per_sample = if shape.len() > 2 {
+            shape[1..shape.len() - 1].iter().product::<usize>()
+        } else {
+            1
+        };
+
+        return Some(per_sample * dtype_size);
+    }
+
     /// Set entries in `self` (the current array) taking data from the `input`
     /// array. The `self` array is guaranteed to be created by calling
     /// `Array::create` with one of the arrays in the same block or tensor
@@ -455,6 +776,14 @@ impl eqs_array_t {
         properties: Range<usize>,
     ) -> Result<(), Error> {
         let function = self.move_samples_from.expect("eqs_array_t.move_samples_from function is NULL");
+        crate::profiling::array_callback();
+
+        if crate::profiling::should_count_bytes() {
+            if let Some(bytes_per_property) = input.bytes_per_property() {
+                let bytes = samples.len() * properties.len() * bytes_per_property;
+                crate::profiling::bytes_moved(bytes);
+            }
+        }
 
         let status = unsafe {
             function(
@@ -502,10 +831,16 @@ mod tests {
                 shape: Some(TestArray::shape),
                 reshape: Some(TestArray::reshape),
                 swap_axes: Some(TestArray::swap_axes),
-                create: None,
+                create: Some(TestArray::create),
                 copy: None,
                 destroy: Some(TestArray::destroy),
-                move_samples_from: None,
+                move_samples_from: Some(TestArray::move_samples_from),
+                create_uninit: None,
+                dtype: None,
+                raw_data: None,
+                get_samples: None,
+                set_samples: None,
+                concurrent_move_samples: false,
             }
         }
 
@@ -551,6 +886,25 @@ mod tests {
             let boxed = Box::from_raw(ptr);
             std::mem::drop(boxed);
         }
+
+        unsafe extern fn create(_: *const c_void, shape_ptr: *const usize, shape_count: usize, new_array: *mut eqs_array_t) -> eqs_status_t {
+            let shape = std::slice::from_raw_parts(shape_ptr, shape_count);
+            *new_array = TestArray::new(shape.to_vec());
+
+            return eqs_status_t(EQS_SUCCESS);
+        }
+
+        // TestArray only stores a shape, so there is no data to move
+        unsafe extern fn move_samples_from(
+            _: *mut c_void,
+            _: *const c_void,
+            _: *const eqs_sample_mapping_t,
+            _: usize,
+            _: usize,
+            _: usize,
+        ) -> eqs_status_t {
+            return eqs_status_t(EQS_SUCCESS);
+        }
     }
 
     #[test]
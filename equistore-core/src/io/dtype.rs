@@ -0,0 +1,269 @@
+use crate::data::DType;
+
+/// Byte order of the data stored in a NPY file
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum Endianness {
+    Little,
+    Big,
+}
+
+impl Endianness {
+    pub fn native() -> Endianness {
+        if cfg!(target_endian = "little") {
+            Endianness::Little
+        } else {
+            Endianness::Big
+        }
+    }
+}
+
+/// Get the NPY type descriptor for `dtype`, using the native endianness
+pub fn npy_descriptor(dtype: DType) -> &'static str {
+    match (dtype, Endianness::native()) {
+        (DType::Float64, Endianness::Little) => "<f8",
+        (DType::Float64, Endianness::Big) => ">f8",
+        (DType::Float32, Endianness::Little) => "<f4",
+        (DType::Float32, Endianness::Big) => ">f4",
+        (DType::Float16, Endianness::Little) => "<f2",
+        (DType::Float16, Endianness::Big) => ">f2",
+    }
+}
+
+/// Parse a NPY type descriptor into a data type and endianness, returning
+/// `None` for data types not supported by equistore.
+pub fn parse_npy_descriptor(descriptor: &str) -> Option<(DType, Endianness)> {
+    let endianness = match descriptor.as_bytes().first()? {
+        b'<' => Endianness::Little,
+        b'>' => Endianness::Big,
+        b'=' => Endianness::native(),
+        _ => return None,
+    };
+
+    let dtype = match &descriptor[1..] {
+        "f8" => DType::Float64,
+        "f4" => DType::Float32,
+        "f2" => DType::Float16,
+        _ => return None,
+    };
+
+    return Some((dtype, endianness));
+}
+
+/// Reverse the bytes of each `size`-bytes value in `data`, converting between
+/// little and big endian.
+pub fn swap_bytes(data: &mut [u8], size: usize) {
+    debug_assert!(data.len() % size == 0);
+
+    // working with fixed-size integers instead of reversing each slice allows
+    // the compiler to vectorize these loops, swapping multiple values with a
+    // single shuffle instruction
+    macro_rules! swap_all {
+        ($type: ty) => {
+            for value in data.chunks_exact_mut(std::mem::size_of::<$type>()) {
+                let bytes = (&*value).try_into().expect("wrong number of bytes");
+                let swapped = <$type>::from_ne_bytes(bytes).swap_bytes();
+                value.copy_from_slice(&swapped.to_ne_bytes());
+            }
+        };
+    }
+
+    match size {
+        1 => {},
+        2 => swap_all!(u16),
+        4 => swap_all!(u32),
+        8 => swap_all!(u64),
+        _ => {
+            for value in data.chunks_exact_mut(size) {
+                value.reverse();
+            }
+        }
+    }
+}
+
+/// Convert `input` (containing values of type `input_dtype` with the given
+/// `endianness`) to `output` (containing values of type `output_dtype` in
+/// native endianness).
+pub fn convert(
+    input: &[u8],
+    input_dtype: DType,
+    endianness: Endianness,
+    output: &mut [u8],
+    output_dtype: DType,
+) {
+    debug_assert_eq!(input.len() / input_dtype.size(), output.len() / output_dtype.size());
+
+    let inputs = input.chunks_exact(input_dtype.size());
+    let outputs = output.chunks_exact_mut(output_dtype.size());
+    for (input, output) in inputs.zip(outputs) {
+        let value = read_value(input, input_dtype, endianness);
+        write_value(value, output, output_dtype);
+    }
+}
+
+fn read_value(bytes: &[u8], dtype: DType, endianness: Endianness) -> f64 {
+    macro_rules! from_bytes {
+        ($type: ty) => {{
+            let bytes = bytes.try_into().expect("wrong number of bytes");
+            match endianness {
+                Endianness::Little => <$type>::from_le_bytes(bytes),
+                Endianness::Big => <$type>::from_be_bytes(bytes),
+            }
+        }};
+    }
+
+    match dtype {
+        DType::Float64 => from_bytes!(f64),
+        DType::Float32 => f64::from(from_bytes!(f32)),
+        DType::Float16 => f16_to_f64(from_bytes!(u16)),
+    }
+}
+
+#[allow(clippy::cast_possible_truncation)]
+fn write_value(value: f64, bytes: &mut [u8], dtype: DType) {
+    match dtype {
+        DType::Float64 => bytes.copy_from_slice(&value.to_ne_bytes()),
+        DType::Float32 => bytes.copy_from_slice(&(value as f32).to_ne_bytes()),
+        DType::Float16 => bytes.copy_from_slice(&f64_to_f16(value).to_ne_bytes()),
+    }
+}
+
+/// Convert the bits of an IEEE-754 binary16 value to a 64-bit float. All
+/// binary16 values are exactly representable as 64-bit floats.
+pub fn f16_to_f64(bits: u16) -> f64 {
+    let sign = if bits & 0x8000 != 0 { -1.0 } else { 1.0 };
+    let exponent = i32::from((bits >> 10) & 0x1f);
+    let mantissa = f64::from(bits & 0x3ff);
+
+    let value = match exponent {
+        // subnormal numbers
+        0 => mantissa * f64::powi(2.0, -24),
+        0x1f => if mantissa == 0.0 { f64::INFINITY } else { f64::NAN },
+        _ => (1.0 + mantissa / 1024.0) * f64::powi(2.0, exponent - 15),
+    };
+
+    return sign * value;
+}
+
+/// Convert a 64-bit float to the bits of the closest IEEE-754 binary16 value,
+/// rounding to nearest-even.
+#[allow(clippy::cast_possible_truncation, clippy::cast_sign_loss)]
+pub fn f64_to_f16(value: f64) -> u16 {
+    let sign = if value.is_sign_negative() { 0x8000 } else { 0 };
+    let magnitude = value.abs();
+
+    if magnitude.is_nan() {
+        return sign | 0x7e00;
+    } else if magnitude >= 65520.0 {
+        // values larger than the largest binary16 (after rounding) overflow
+        // to infinity
+        return sign | 0x7c00;
+    } else if magnitude < f64::powi(2.0, -14) {
+        // subnormal numbers, in units of 2^-24
+        let scaled = round_ties_even(magnitude * f64::powi(2.0, 24));
+        return sign | scaled as u16;
+    }
+
+    let exponent = magnitude.log2().floor() as i32;
+    // log2 can be off by one for values close to a power of two
+    let exponent = if f64::powi(2.0, exponent) > magnitude {
+        exponent - 1
+    } else if f64::powi(2.0, exponent + 1) <= magnitude {
+        exponent + 1
+    } else {
+        exponent
+    };
+
+    let mantissa = round_ties_even((magnitude / f64::powi(2.0, exponent) - 1.0) * 1024.0) as u16;
+    // rounding the mantissa can carry into the exponent, which is handled by
+    // adding the two bit patterns
+    let biased = ((exponent + 15) as u16) << 10;
+    return sign | (biased + mantissa);
+}
+
+fn round_ties_even(value: f64) -> f64 {
+    let rounded = value.round();
+    if (value - value.trunc()).abs() == 0.5 && rounded % 2.0 != 0.0 {
+        return rounded - value.signum();
+    }
+    return rounded;
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn descriptors() {
+        for &dtype in &[DType::Float64, DType::Float32, DType::Float16] {
+            let (parsed, endianness) = parse_npy_descriptor(npy_descriptor(dtype)).unwrap();
+            assert_eq!(parsed, dtype);
+            assert_eq!(endianness, Endianness::native());
+        }
+
+        assert_eq!(parse_npy_descriptor(">f4"), Some((DType::Float32, Endianness::Big)));
+        assert_eq!(parse_npy_descriptor("<i4"), None);
+        assert_eq!(parse_npy_descriptor("|b1"), None);
+    }
+
+    #[test]
+    fn float16() {
+        let values = [
+            (0x0000, 0.0), (0x3c00, 1.0), (0xc000, -2.0), (0x3555, 0.333251953125),
+            (0x7bff, 65504.0), (0x0001, 5.960464477539063e-8), (0x0400, 6.103515625e-5),
+            (0x7c00, f64::INFINITY), (0xfc00, f64::NEG_INFINITY),
+        ];
+
+        for &(bits, value) in &values {
+            assert_eq!(f16_to_f64(bits), value);
+            assert_eq!(f64_to_f16(value), bits);
+        }
+
+        assert!(f16_to_f64(0x7e00).is_nan());
+        assert_eq!(f64_to_f16(f64::NAN) & 0x7e00, 0x7e00);
+
+        // rounding to nearest-even, including carry into the exponent
+        assert_eq!(f64_to_f16(1.0 + 1.0 / 2048.0), 0x3c00);
+        assert_eq!(f64_to_f16(1.0 + 3.0 / 2048.0), 0x3c02);
+        assert_eq!(f64_to_f16(2.0 - 1.0 / 4096.0), 0x4000);
+        assert_eq!(f64_to_f16(70000.0), 0x7c00);
+    }
+
+    #[test]
+    fn conversions() {
+        let input = [1.5f64, -2.25, 1e-3];
+        let mut input_bytes = Vec::new();
+        for value in input {
+            input_bytes.extend_from_slice(&value.to_be_bytes());
+        }
+
+        let mut output = vec![0u8; 3 * 4];
+        convert(&input_bytes, DType::Float64, Endianness::Big, &mut output, DType::Float32);
+
+        let output = output.chunks_exact(4)
+            .map(|bytes| f32::from_ne_bytes(bytes.try_into().unwrap()))
+            .collect::<Vec<_>>();
+        assert_eq!(output, [1.5f32, -2.25, 1e-3]);
+
+        let mut data = input_bytes.clone();
+        swap_bytes(&mut data, 8);
+        for (value, bytes) in input.iter().zip(data.chunks_exact(8)) {
+            assert_eq!(*value, f64::from_le_bytes(bytes.try_into().unwrap()));
+        }
+    }
+
+    #[test]
+    fn byte_swap() {
+        let mut data = vec![1, 2, 3, 4, 5, 6, 7, 8];
+        swap_bytes(&mut data, 2);
+        assert_eq!(data, [2, 1, 4, 3, 6, 5, 8, 7]);
+
+        swap_bytes(&mut data, 4);
+        assert_eq!(data, [3, 4, 1, 2, 7, 8, 5, 6]);
+
+        swap_bytes(&mut data, 8);
+        assert_eq!(data, [6, 5, 8, 7, 2, 1, 4, 3]);
+
+        swap_bytes(&mut data, 1);
+        assert_eq!(data, [6, 5, 8, 7, 2, 1, 4, 3]);
+    }
+}
@@ -1,8 +1,10 @@
-use byteorder::{LittleEndian, ReadBytesExt, BigEndian, WriteBytesExt, NativeEndian};
+use std::sync::Arc;
 
 use super::npy_header::{Header, DataType};
+use super::dtype::{Endianness, swap_bytes};
 use super::check_for_extra_bytes;
-use crate::{Error, Labels, LabelsBuilder, LabelValue};
+use crate::{Error, Labels, LabelValue};
+use crate::labels::LabelsInterner;
 
 /// Read `Labels` stored using numpy's NPY format.
 ///
@@ -11,7 +13,21 @@ use crate::{Error, Labels, LabelsBuilder, LabelValue};
 /// associating name and either "<i4" for little endian file or ">i4" for big
 /// endian file. Data is stored in exactly the same way as inside a `Labels`,
 /// i.e. a big blob of 32-bit integers.
-pub fn read_npy_labels<R: std::io::Read>(mut reader: R) -> Result<Labels, Error> {
+pub fn read_npy_labels<R: std::io::Read>(reader: R) -> Result<Labels, Error> {
+    let (names, data) = read_npy_labels_data(reader)?;
+    return Labels::new(names.iter().map(|s| &**s).collect(), data);
+}
+
+/// Same as [`read_npy_labels`], using `interner` to share the result with
+/// previously read labels with the same names and values.
+pub(crate) fn read_npy_labels_interned<R: std::io::Read>(reader: R, interner: &LabelsInterner) -> Result<Arc<Labels>, Error> {
+    let (names, data) = read_npy_labels_data(reader)?;
+    let names = names.iter().map(|s| &**s).collect::<Vec<_>>();
+    return interner.intern_with(&names, &data, || Labels::new(names.clone(), data.clone()));
+}
+
+/// Read the names and values of NPY-serialized `Labels`
+fn read_npy_labels_data<R: std::io::Read>(mut reader: R) -> Result<(Vec<String>, Vec<LabelValue>), Error> {
     let header = Header::from_reader(&mut reader)?;
     if header.fortran_order {
         return Err(Error::Serialization("Labels can not be loaded from fortran-order arrays".into()));
@@ -20,20 +36,36 @@ pub fn read_npy_labels<R: std::io::Read>(mut reader: R) -> Result<Labels, Error>
     }
     let (names, endianness) = check_type_descriptor(&header.type_descriptor)?;
 
-    let mut data = vec![0; header.shape[0] * names.len()];
-    match endianness {
-        Endianness::LittleEndian => reader.read_i32_into::<LittleEndian>(&mut data)?,
-        Endianness::BigEndian => reader.read_i32_into::<BigEndian>(&mut data)?,
+    // the data is read directly in the final storage, and converted in bulk
+    // to the native endianness if needed
+    let mut data = vec![LabelValue::new(0); header.shape[0] * names.len()];
+    let bytes = values_as_bytes_mut(&mut data);
+    reader.read_exact(bytes)?;
+    if endianness != Endianness::native() {
+        swap_bytes(bytes, std::mem::size_of::<LabelValue>());
     }
 
     check_for_extra_bytes(&mut reader)?;
 
-    let mut builder = LabelsBuilder::new(names.iter().map(|s| &**s).collect())?;
-    for chunk in data.chunks_exact(names.len()) {
-        builder.add(&chunk.iter().map(|&i| LabelValue::new(i)).collect::<Vec<_>>())?;
+    return Ok((names, data));
+}
+
+/// Get the raw bytes of `values`
+fn values_as_bytes(values: &[LabelValue]) -> &[u8] {
+    // SAFETY: `LabelValue` is a `repr(transparent)` wrapper around `i32`,
+    // without padding or invalid bit patterns
+    unsafe {
+        std::slice::from_raw_parts(values.as_ptr().cast(), std::mem::size_of_val(values))
     }
+}
 
-    return Ok(builder.finish());
+/// Get the raw bytes of `values`, allowing to modify them
+fn values_as_bytes_mut(values: &mut [LabelValue]) -> &mut [u8] {
+    // SAFETY: `LabelValue` is a `repr(transparent)` wrapper around `i32`, and
+    // any bit pattern is a valid `i32`
+    unsafe {
+        std::slice::from_raw_parts_mut(values.as_mut_ptr().cast(), std::mem::size_of_val(values))
+    }
 }
 
 /// Write `Labels` to the writer using numpy's NPY format.
@@ -58,21 +90,13 @@ pub fn write_npy_labels<W: std::io::Write>(writer: &mut W, labels: &Labels) -> R
     };
     header.write(&mut *writer)?;
 
-    for entry in labels {
-        for value in entry {
-            writer.write_i32::<NativeEndian>(value.i32())?;
-        }
-    }
+    // the labels are stored exactly like the data in the file, so we can
+    // write all of them at once
+    writer.write_all(values_as_bytes(labels.values()))?;
 
     return Ok(());
 }
 
-#[derive(Debug, Clone, Copy, PartialEq, Eq)]
-enum Endianness {
-    BigEndian,
-    LittleEndian,
-}
-
 /// Check that the given type descriptor matches the expected one for Labels and
 /// return the corresponding set of names & endianness.
 fn check_type_descriptor(desc: &DataType) -> Result<(Vec<String>, Endianness), Error> {
@@ -86,18 +110,18 @@ fn check_type_descriptor(desc: &DataType) -> Result<(Vec<String>, Endianness), E
             for (name, typ) in list {
                 if endianness.is_none() {
                     if typ == "<i4" {
-                        endianness = Some(Endianness::LittleEndian);
+                        endianness = Some(Endianness::Little);
                     } else if typ == ">i4" {
-                        endianness = Some(Endianness::BigEndian);
+                        endianness = Some(Endianness::Big);
                     }
                 }
 
                 if typ == "<i4" {
-                    if endianness != Some(Endianness::LittleEndian) {
+                    if endianness != Some(Endianness::Little) {
                         return Err(error);
                     }
                 } else if typ == ">i4" {
-                    if endianness != Some(Endianness::BigEndian) {
+                    if endianness != Some(Endianness::Big) {
                         return Err(error);
                     }
                 } else {
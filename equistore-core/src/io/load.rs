@@ -1,14 +1,20 @@
-use std::collections::HashSet;
-use std::sync::Arc;
+use std::collections::HashMap;
+use std::io::{Read, BufReader};
+use std::sync::{Arc, Mutex};
 
-use byteorder::{LittleEndian, BigEndian, ReadBytesExt};
-use zip::ZipArchive;
+use flate2::read::DeflateDecoder;
+use zip::{ZipArchive, CompressionMethod};
 
 use crate::{TensorMap, TensorBlock, Labels, Error, eqs_array_t};
+use crate::utils::{run_with_threads, try_map};
+use crate::tensor::KeysIndex;
+use crate::labels::LabelsInterner;
+use crate::data::DType;
 
-use super::check_for_extra_bytes;
-use super::labels::read_npy_labels;
+use super::{check_for_extra_bytes, CHUNK_SIZE};
+use super::labels::{read_npy_labels, read_npy_labels_interned};
 use super::npy_header::{Header, DataType};
+use super::dtype::{Endianness, npy_descriptor, parse_npy_descriptor, swap_bytes, convert};
 
 
 /// Load the serialized tensor map from the given path.
@@ -18,8 +24,9 @@ use super::npy_header::{Header, DataType};
 /// data.
 ///
 /// `TensorMap` are serialized using numpy's `.npz` format, i.e. a ZIP file
-/// without compression (storage method is STORED), where each file is stored as
-/// a `.npy` array. Both the ZIP and NPY format are well documented:
+/// without compression (storage method is STORED) or compressed with DEFLATE
+/// (storage method is DEFLATED, see `save_compressed`), where each file is
+/// stored as a `.npy` array. Both the ZIP and NPY format are well documented:
 ///
 /// - ZIP: <https://pkware.cachefly.net/webdocs/casestudies/APPNOTE.TXT>
 /// - NPY: <https://numpy.org/doc/stable/reference/generated/numpy.lib.format.html>
@@ -27,7 +34,10 @@ use super::npy_header::{Header, DataType};
 /// We add other restriction on top of these formats when saving/loading data.
 /// First, `Labels` instances are saved as structured array, see the `labels`
 /// module for more information. Only 32-bit integers are supported for Labels,
-/// and only 64-bit floats are supported for data (values and gradients).
+/// and 64-bit, 32-bit or 16-bit floats are supported for data (values and
+/// gradients). `create_array` gets the shape of the array and the data type of
+/// the data in the file, and the data is converted to the data type of the
+/// arrays returned by `create_array` if needed.
 ///
 /// Second, the path of the files in the archive also carry meaning. The keys of
 /// the `TensorMap` are stored in `/keys.npy`, and then different blocks are
@@ -50,86 +60,556 @@ use super::npy_header::{Header, DataType};
 /// ```
 pub fn load<R, F>(reader: R, create_array: F) -> Result<TensorMap, Error>
     where R: std::io::Read + std::io::Seek,
-          F: Fn(Vec<usize>) -> Result<eqs_array_t, Error>
+          F: Fn(Vec<usize>, DType) -> Result<eqs_array_t, Error>
 {
+    return load_impl(reader, &create_array, None);
+}
+
+/// Data source which can be read at arbitrary offsets without a shared
+/// cursor, allowing multiple threads to read from it at the same time.
+pub trait ReadAt: Sync {
+    /// Read some bytes starting at `offset` into `buffer`, returning the
+    /// number of bytes read. This should return 0 when `offset` is at or after
+    /// the end of the source.
+    fn read_at(&self, buffer: &mut [u8], offset: u64) -> std::io::Result<usize>;
+
+    /// Get the total size of this source in bytes
+    fn size(&self) -> std::io::Result<u64>;
+}
+
+impl ReadAt for [u8] {
+    fn read_at(&self, buffer: &mut [u8], offset: u64) -> std::io::Result<usize> {
+        let start = usize::try_from(offset).unwrap_or(usize::MAX);
+        if start >= self.len() {
+            return Ok(0);
+        }
+
+        let count = std::cmp::min(buffer.len(), self.len() - start);
+        buffer[..count].copy_from_slice(&self[start..start + count]);
+        return Ok(count);
+    }
+
+    fn size(&self) -> std::io::Result<u64> {
+        return Ok(self.len() as u64);
+    }
+}
+
+#[cfg(any(unix, windows))]
+impl ReadAt for std::fs::File {
+    #[cfg(unix)]
+    fn read_at(&self, buffer: &mut [u8], offset: u64) -> std::io::Result<usize> {
+        return std::os::unix::fs::FileExt::read_at(self, buffer, offset);
+    }
+
+    #[cfg(windows)]
+    fn read_at(&self, buffer: &mut [u8], offset: u64) -> std::io::Result<usize> {
+        return std::os::windows::fs::FileExt::seek_read(self, buffer, offset);
+    }
+
+    fn size(&self) -> std::io::Result<u64> {
+        return Ok(self.metadata()?.len());
+    }
+}
+
+/// Fallback for platforms without positioned reads, where the file cursor is
+/// shared and reads from multiple threads are serialized.
+impl ReadAt for Mutex<std::fs::File> {
+    fn read_at(&self, buffer: &mut [u8], offset: u64) -> std::io::Result<usize> {
+        let mut file = self.lock().expect("mutex got poisoned");
+        std::io::Seek::seek(&mut *file, std::io::SeekFrom::Start(offset))?;
+        return file.read(buffer);
+    }
+
+    fn size(&self) -> std::io::Result<u64> {
+        let file = self.lock().expect("mutex got poisoned");
+        return Ok(file.metadata()?.len());
+    }
+}
+
+/// Cursor over a `ReadAt` source, implementing `Read` and `Seek`
+pub(super) struct ReadAtCursor<'a, S: ?Sized> {
+    pub(super) source: &'a S,
+    pub(super) position: u64,
+}
+
+impl<'a, S: ReadAt + ?Sized> Read for ReadAtCursor<'a, S> {
+    fn read(&mut self, buffer: &mut [u8]) -> std::io::Result<usize> {
+        let count = self.source.read_at(buffer, self.position)?;
+        self.position += count as u64;
+        return Ok(count);
+    }
+}
+
+#[allow(clippy::cast_sign_loss, clippy::cast_possible_wrap)]
+impl<'a, S: ReadAt + ?Sized> std::io::Seek for ReadAtCursor<'a, S> {
+    fn seek(&mut self, pos: std::io::SeekFrom) -> std::io::Result<u64> {
+        let position = match pos {
+            std::io::SeekFrom::Start(offset) => offset as i64,
+            std::io::SeekFrom::End(offset) => self.source.size()? as i64 + offset,
+            std::io::SeekFrom::Current(offset) => self.position as i64 + offset,
+        };
+
+        if position < 0 {
+            return Err(std::io::Error::new(
+                std::io::ErrorKind::InvalidInput, "tried to seek before the start of the data")
+            );
+        }
+
+        self.position = position as u64;
+        return Ok(self.position);
+    }
+}
+
+/// Load the serialized tensor map from the given `source`, decoding the
+/// blocks in parallel.
+///
+/// The archive directory is read once, and then each block (with its labels
+/// and gradients) is decoded independently, reading the files directly at
+/// their offset in the `source`.
+///
+/// `threads` is the number of threads to use. With 1 thread, this is the same
+/// as calling [`load`]; and 0 means one thread per CPU core. When using
+/// multiple threads, `create_array` will be called concurrently from
+/// different threads.
+pub fn load_parallel<S, F>(source: &S, create_array: F, threads: usize) -> Result<TensorMap, Error>
+    where S: ReadAt + ?Sized,
+          F: Fn(Vec<usize>, DType) -> Result<eqs_array_t, Error> + Sync
+{
+    let reader = BufReader::new(ReadAtCursor { source, position: 0 });
+    if threads == 1 {
+        return load_impl(reader, &create_array, None);
+    }
+
     let mut archive = ZipArchive::new(reader).map_err(|e| ("<root>".into(), e))?;
+    let keys = read_keys(&mut archive)?;
+    let index = ArchiveIndex::new(&mut archive)?;
 
-    let path = String::from("keys.npy");
-    let keys = read_npy_labels(archive.by_name(&path).map_err(|e| (path, e))?)?;
+    let interner = LabelsInterner::new();
+    let blocks_ids = (0..keys.count()).collect::<Vec<_>>();
+    let blocks = run_with_threads(threads, |parallel| {
+        try_map(&blocks_ids, parallel, |&block_i| {
+            let mut entries = IndexedEntries {
+                source: source,
+                index: &index,
+            };
 
-    if archive.by_name("blocks/0/values/data.npy").is_ok() {
-        return Err(Error::Serialization(
-            "trying to load a file in the old equistore format, please convert \
-            it to the new format first using the script at \
-            https://github.com/lab-cosmo/equistore/blob/master/python/scripts/convert-equistore-npz.py
-            ".into()
-        ));
+            read_block(
+                &mut entries,
+                &format!("blocks/{}", block_i),
+                None,
+                &create_array,
+                None,
+                &interner,
+                &index.gradients,
+            )
+        })
+    })?;
+
+    return TensorMap::new(Arc::new(keys), blocks);
+}
+
+/// Position, size and storage method of a single file in an archive
+#[derive(Debug, Clone, Copy)]
+pub(super) struct IndexEntry {
+    /// start of the (possibly compressed) data in the archive
+    pub(super) data_start: u64,
+    /// size of the data in the archive
+    pub(super) compressed_size: u64,
+    /// size of the data after decompression
+    pub(super) size: u64,
+    /// is the data compressed with DEFLATE?
+    pub(super) deflated: bool,
+}
+
+/// Position and size of all the files in an archive
+pub(super) struct ArchiveIndex {
+    pub(super) files: HashMap<String, IndexEntry>,
+    pub(super) gradients: GradientsIndex,
+}
+
+impl ArchiveIndex {
+    pub(super) fn new<R: std::io::Read + std::io::Seek>(archive: &mut ZipArchive<R>) -> Result<ArchiveIndex, Error> {
+        let mut files = HashMap::new();
+        let mut names = Vec::with_capacity(archive.len());
+        for i in 0..archive.len() {
+            let file = archive.by_index_raw(i).map_err(|e| ("<root>".into(), e))?;
+            names.push(file.name().to_owned());
+            let deflated = match file.compression() {
+                CompressionMethod::Stored => false,
+                CompressionMethod::Deflated => true,
+                _ => {
+                    return Err(Error::Serialization(format!(
+                        "unsupported compression method for '{}', only STORED and DEFLATED are supported",
+                        file.name()
+                    )));
+                }
+            };
+
+            files.insert(file.name().to_owned(), IndexEntry {
+                data_start: file.data_start(),
+                compressed_size: file.compressed_size(),
+                size: file.size(),
+                deflated: deflated,
+            });
+        }
+
+        let gradients = GradientsIndex::new(names.iter().map(String::as_str));
+        return Ok(ArchiveIndex { files, gradients });
+    }
+}
+
+/// Gradients parameters of all the blocks (and gradients) in an archive,
+/// extracted once from the names of the files. This allows finding the
+/// gradients of a block without going over all the files in the archive for
+/// every block.
+pub(super) struct GradientsIndex {
+    /// Map from the prefix of a block (e.g. `blocks/3` or
+    /// `blocks/3/gradients/positions`) to the parameters of its gradients, in
+    /// the order in which they appear in the archive
+    parameters: HashMap<String, Vec<String>>,
+}
+
+impl GradientsIndex {
+    /// Create the index for all the files in `archive`, in the order of the
+    /// archive central directory. `ZipArchive::file_names` can not be used
+    /// here, since it iterates over the files in an arbitrary order.
+    pub(super) fn from_archive<R: std::io::Read + std::io::Seek>(archive: &mut ZipArchive<R>) -> Result<GradientsIndex, Error> {
+        let mut names = Vec::with_capacity(archive.len());
+        for i in 0..archive.len() {
+            let file = archive.by_index_raw(i).map_err(|e| ("<root>".into(), e))?;
+            names.push(file.name().to_owned());
+        }
+
+        return Ok(GradientsIndex::new(names.iter().map(String::as_str)));
+    }
+
+    /// Create the index from the names of the files in an archive, the
+    /// gradients of each block are kept in the same order as `file_names`
+    pub(super) fn new<'a>(file_names: impl Iterator<Item = &'a str>) -> GradientsIndex {
+        let mut parameters = HashMap::<String, Vec<String>>::new();
+        for name in file_names {
+            // each gradient contains a `<prefix>/gradients/<parameter>/samples.npy`
+            // file, where `prefix` can itself be a gradient
+            if let Some(gradient) = name.strip_suffix("/samples.npy") {
+                if let Some((prefix, parameter)) = gradient.rsplit_once("/gradients/") {
+                    if !parameter.contains('/') {
+                        parameters.entry(prefix.to_owned()).or_default().push(parameter.to_owned());
+                    }
+                }
+            }
+        }
+
+        return GradientsIndex { parameters };
+    }
+
+    /// Get the gradients parameters of the block stored at `prefix`
+    pub(super) fn get(&self, prefix: &str) -> &[String] {
+        return self.parameters.get(prefix).map_or(&[], Vec::as_slice);
+    }
+}
+
+/// Access to the files needed to decode blocks in a serialized tensor map
+trait Entries {
+    /// Read the Labels stored at `path`, sharing them with equal labels
+    /// previously read through the same `interner`
+    fn read_labels(&mut self, path: String, interner: &LabelsInterner) -> Result<Arc<Labels>, Error>;
+
+    /// Read the data array stored at `path`, see `read_data`
+    fn read_data<F>(
+        &mut self,
+        path: String,
+        create_array: &F,
+        view: Option<&BufferView>,
+    ) -> Result<(eqs_array_t, Vec<usize>), Error>
+        where F: Fn(Vec<usize>, DType) -> Result<eqs_array_t, Error>;
+}
+
+impl<R: std::io::Read + std::io::Seek> Entries for ZipArchive<R> {
+    fn read_labels(&mut self, path: String, interner: &LabelsInterner) -> Result<Arc<Labels>, Error> {
+        let file = self.by_name(&path).map_err(|e| (path, e))?;
+        return read_npy_labels_interned(file, interner);
     }
 
+    fn read_data<F>(
+        &mut self,
+        path: String,
+        create_array: &F,
+        view: Option<&BufferView>,
+    ) -> Result<(eqs_array_t, Vec<usize>), Error>
+        where F: Fn(Vec<usize>, DType) -> Result<eqs_array_t, Error>
+    {
+        let mut file = self.by_name(&path).map_err(|e| (path, e))?;
+        let is_stored = file.compression() == CompressionMethod::Stored;
+        let data_start = file.data_start();
+        let file_size = file.size();
+        return read_data(&mut file, is_stored, data_start, file_size, create_array, view);
+    }
+}
+
+/// Files in an archive, read by offset from a `ReadAt` source
+pub(super) struct IndexedEntries<'a, S: ?Sized> {
+    pub(super) source: &'a S,
+    pub(super) index: &'a ArchiveIndex,
+}
+
+impl<'a, S: ReadAt + ?Sized> IndexedEntries<'a, S> {
+    /// Get a reader for the (decompressed) file at `path`, and the
+    /// corresponding index entry
+    pub(super) fn open(&self, path: String) -> Result<(Box<dyn Read + 'a>, IndexEntry), Error> {
+        let entry = match self.index.files.get(&path) {
+            Some(&entry) => entry,
+            None => return Err((path, zip::result::ZipError::FileNotFound).into()),
+        };
+
+        let reader = BufReader::new(ReadAtCursor {
+            source: self.source,
+            position: entry.data_start,
+        });
+
+        let reader: Box<dyn Read + 'a> = if entry.deflated {
+            Box::new(DeflateDecoder::new(reader.take(entry.compressed_size)))
+        } else {
+            Box::new(reader)
+        };
+
+        return Ok((reader, entry));
+    }
+}
+
+impl<'a, S: ReadAt + ?Sized> Entries for IndexedEntries<'a, S> {
+    fn read_labels(&mut self, path: String, interner: &LabelsInterner) -> Result<Arc<Labels>, Error> {
+        let (reader, entry) = self.open(path)?;
+        return read_npy_labels_interned(reader.take(entry.size), interner);
+    }
+
+    fn read_data<F>(
+        &mut self,
+        path: String,
+        create_array: &F,
+        view: Option<&BufferView>,
+    ) -> Result<(eqs_array_t, Vec<usize>), Error>
+        where F: Fn(Vec<usize>, DType) -> Result<eqs_array_t, Error>
+    {
+        let (mut reader, entry) = self.open(path)?;
+        return read_data(&mut reader, !entry.deflated, entry.data_start, entry.size, create_array, view);
+    }
+}
+
+/// Load the serialized tensor map from the given in-memory `buffer`, without
+/// copying the values and gradients data when possible.
+///
+/// For each data array stored without compression, in native endianness and
+/// with a properly aligned start in the `buffer`, the `create_view` callback
+/// will be called with the shape of the array and a slice pointing directly
+/// inside `buffer`. All other arrays are created with `create_array` and
+/// filled with a copy of the data, as in [`load`]. Files created by [`save`]
+/// on a machine with the same endianness can always be loaded without copies.
+///
+/// The arrays created by `create_view` will typically point inside `buffer`,
+/// and it is the responsibility of the caller to keep `buffer` alive for as
+/// long as these arrays are used.
+///
+/// [`save`]: crate::io::save
+pub fn load_view<F, V>(buffer: &[u8], create_array: F, create_view: V) -> Result<TensorMap, Error>
+    where F: Fn(Vec<usize>, DType) -> Result<eqs_array_t, Error>,
+          V: Fn(Vec<usize>, &[f64]) -> Result<eqs_array_t, Error>
+{
+    let view = BufferView {
+        buffer: buffer,
+        create_view: &create_view,
+    };
+
+    return load_impl(std::io::Cursor::new(buffer), &create_array, Some(&view));
+}
+
+/// In-memory buffer containing the whole archive, used to create arrays
+/// pointing directly to the data instead of copying it
+struct BufferView<'a> {
+    buffer: &'a [u8],
+    create_view: &'a dyn Fn(Vec<usize>, &[f64]) -> Result<eqs_array_t, Error>,
+}
+
+impl<'a> BufferView<'a> {
+    /// Get the `count` 64-bit floats starting at `offset` in the buffer, if
+    /// they are inside the buffer and correctly aligned.
+    fn data(&self, offset: u64, count: usize) -> Option<&'a [f64]> {
+        let start = usize::try_from(offset).ok()?;
+        let n_bytes = count.checked_mul(std::mem::size_of::<f64>())?;
+        let bytes = self.buffer.get(start..start.checked_add(n_bytes)?)?;
+
+        if bytes.as_ptr().align_offset(std::mem::align_of::<f64>()) != 0 {
+            return None;
+        }
+
+        // SAFETY: the pointer is aligned, and `count` f64 fit inside the buffer
+        let data = unsafe {
+            std::slice::from_raw_parts(bytes.as_ptr().cast::<f64>(), count)
+        };
+
+        return Some(data);
+    }
+}
+
+fn load_impl<R, F>(reader: R, create_array: &F, view: Option<&BufferView>) -> Result<TensorMap, Error>
+    where R: std::io::Read + std::io::Seek,
+          F: Fn(Vec<usize>, DType) -> Result<eqs_array_t, Error>
+{
+    let mut archive = ZipArchive::new(reader).map_err(|e| ("<root>".into(), e))?;
+    let keys = read_keys(&mut archive)?;
+    let gradients = GradientsIndex::from_archive(&mut archive)?;
+
+    let interner = LabelsInterner::new();
     let mut blocks = Vec::new();
     for block_i in 0..keys.count() {
         blocks.push(read_block(
             &mut archive,
             &format!("blocks/{}", block_i),
             None,
-            &create_array,
+            create_array,
+            view,
+            &interner,
+            &gradients,
         )?,);
     }
 
     return TensorMap::new(Arc::new(keys), blocks);
 }
 
+/// A serialized `TensorMap`, from which blocks are only loaded when requested.
+///
+/// Opening a `LazyTensorMap` only reads the keys, and the labels and data of
+/// each block are read from the archive on demand with
+/// [`LazyTensorMap::load_block`]. The format is the same as for [`load`].
+///
+/// Loading blocks from multiple threads at the same time is supported, but
+/// the archive reads are serialized.
+pub struct LazyTensorMap<R> {
+    archive: Mutex<ZipArchive<R>>,
+    keys: Arc<Labels>,
+    keys_index: KeysIndex,
+    /// Share equal labels between the blocks loaded from this archive
+    interner: LabelsInterner,
+    gradients: GradientsIndex,
+}
+
+impl<R: std::io::Read + std::io::Seek> LazyTensorMap<R> {
+    /// Open the serialized tensor map in `reader`, reading only the keys.
+    pub fn open(reader: R) -> Result<LazyTensorMap<R>, Error> {
+        let mut archive = ZipArchive::new(reader).map_err(|e| ("<root>".into(), e))?;
+        let keys = read_keys(&mut archive)?;
+        let gradients = GradientsIndex::from_archive(&mut archive)?;
+
+        return Ok(LazyTensorMap {
+            archive: Mutex::new(archive),
+            keys: Arc::new(keys),
+            keys_index: KeysIndex::new(),
+            interner: LabelsInterner::new(),
+            gradients: gradients,
+        });
+    }
+
+    /// Get the keys of the serialized tensor map
+    pub fn keys(&self) -> &Arc<Labels> {
+        &self.keys
+    }
+
+    /// Get the index of blocks matching the given selection, see
+    /// `TensorMap::blocks_matching` for more information.
+    pub fn blocks_matching(&self, selection: &Labels) -> Result<Vec<usize>, Error> {
+        return self.keys_index.blocks_matching(&self.keys, selection);
+    }
+
+    /// Read the block at index `block_id` (with its gradients) from the
+    /// archive. Arrays for the values and gradients will be created with the
+    /// given `create_array` callback.
+    ///
+    /// Each call reads the block from the archive again, it is up to the
+    /// caller to cache the blocks if needed.
+    pub fn load_block<F>(&self, block_id: usize, create_array: F) -> Result<TensorBlock, Error>
+        where F: Fn(Vec<usize>, DType) -> Result<eqs_array_t, Error>
+    {
+        if block_id >= self.keys.count() {
+            return Err(Error::InvalidParameter(format!(
+                "block index out of bounds: we have {} blocks but the index is {}",
+                self.keys.count(), block_id
+            )));
+        }
+
+        let mut archive = self.archive.lock().expect("mutex got poisoned");
+        return read_block(
+            &mut *archive,
+            &format!("blocks/{}", block_id),
+            None,
+            &create_array,
+            None,
+            &self.interner,
+            &self.gradients,
+        );
+    }
+}
+
+// Read the keys of a serialized tensor map from the archive
+pub(super) fn read_keys<R>(archive: &mut ZipArchive<R>) -> Result<Labels, Error>
+    where R: std::io::Read + std::io::Seek,
+{
+    let path = String::from("keys.npy");
+    let keys = read_npy_labels(archive.by_name(&path).map_err(|e| (path, e))?)?;
+
+    if archive.by_name("blocks/0/values/data.npy").is_ok() {
+        return Err(Error::Serialization(
+            "trying to load a file in the old equistore format, please convert \
+            it to the new format first using the script at \
+            https://github.com/lab-cosmo/equistore/blob/master/python/scripts/convert-equistore-npz.py
+            ".into()
+        ));
+    }
+
+    return Ok(keys);
+}
+
 #[allow(clippy::needless_pass_by_value)]
-fn read_block<R, F>(
-    archive: &mut ZipArchive<R>,
+fn read_block<E, F>(
+    entries: &mut E,
     prefix: &str,
     properties: Option<Arc<Labels>>,
     create_array: &F,
+    view: Option<&BufferView>,
+    interner: &LabelsInterner,
+    gradients: &GradientsIndex,
 ) -> Result<TensorBlock, Error>
-    where R: std::io::Read + std::io::Seek,
-          F: Fn(Vec<usize>) -> Result<eqs_array_t, Error>
+    where E: Entries,
+          F: Fn(Vec<usize>, DType) -> Result<eqs_array_t, Error>
 {
     let path = format!("{}/values.npy", prefix);
-    let data_file = archive.by_name(&path).map_err(|e| (path, e))?;
-    let (data, shape) = read_data(data_file, &create_array)?;
+    let (data, shape) = entries.read_data(path, create_array, view)?;
 
     let path = format!("{}/samples.npy", prefix);
-    let samples_file = archive.by_name(&path).map_err(|e| (path, e))?;
-    let samples = Arc::new(read_npy_labels(samples_file)?);
+    let samples = entries.read_labels(path, interner)?;
 
     let mut components = Vec::new();
     for i in 0..(shape.len() - 2) {
         let path = format!("{}/components/{}.npy", prefix, i);
-        let component_file = archive.by_name(&path).map_err(|e| (path, e))?;
-        components.push(Arc::new(read_npy_labels(component_file)?));
+        components.push(entries.read_labels(path, interner)?);
     }
 
     let properties = if let Some(ref properties) = properties {
         properties.clone()
     } else {
         let path = format!("{}/properties.npy", prefix);
-        let properties_file = archive.by_name(&path).map_err(|e| (path, e))?;
-        Arc::new(read_npy_labels(properties_file)?)
+        entries.read_labels(path, interner)?
     };
 
     let mut block = TensorBlock::new(data, samples, components, properties.clone())?;
 
-    let mut parameters = HashSet::new();
-    let gradient_prefix = format!("{}/gradients/", prefix);
-    for name in archive.file_names() {
-        if name.starts_with(&gradient_prefix) && name.ends_with("/samples.npy") {
-            let (_, parameter) = name.split_at(gradient_prefix.len());
-            let parameter = parameter.split('/').next().expect("could not find gradient parameter");
-            parameters.insert(parameter.to_string());
-        }
-    }
-
-    for parameter in &parameters {
+    for parameter in gradients.get(prefix) {
         let gradient = read_block(
-            archive,
+            entries,
             &format!("{}/gradients/{}", prefix, parameter),
             Some(properties.clone()),
-            create_array
+            create_array,
+            view,
+            interner,
+            gradients,
         )?;
 
         block.add_gradient(parameter, gradient)?;
@@ -138,34 +618,168 @@ fn read_block<R, F>(
     return Ok(block);
 }
 
-// Read a data array from the given reader, using numpy's NPY format
-fn read_data<R, F>(mut reader: R, create_array: &F) -> Result<(eqs_array_t, Vec<usize>), Error>
-    where R: std::io::Read, F: Fn(Vec<usize>) -> Result<eqs_array_t, Error>
+// Read a data array from the given file, using numpy's NPY format. The file
+// contains `file_size` bytes, starting at `data_start` in the archive. If
+// `view` is given, the array will directly point inside the corresponding
+// buffer when possible.
+fn read_data<R, F>(
+    file: &mut R,
+    is_stored: bool,
+    data_start: u64,
+    file_size: u64,
+    create_array: &F,
+    view: Option<&BufferView>,
+) -> Result<(eqs_array_t, Vec<usize>), Error>
+    where R: std::io::Read,
+          F: Fn(Vec<usize>, DType) -> Result<eqs_array_t, Error>
 {
+    // keep track of how many bytes the header takes
+    let mut reader = file.take(file_size);
     let header = Header::from_reader(&mut reader)?;
+    let header_size = file_size - reader.limit();
+
     if header.fortran_order {
         return Err(Error::Serialization("data can not be loaded from fortran-order arrays".into()));
     }
 
     let shape = header.shape;
-    let mut array = create_array(shape.clone())?;
+    let native_type = npy_descriptor(DType::Float64);
+
+    if let Some(view) = view {
+        let count = shape.iter().product::<usize>();
+        let data_size = file_size - header_size;
 
-    match header.type_descriptor {
-        DataType::Scalar(s) if s == "<f8" => {
-            reader.read_f64_into::<LittleEndian>(array.data_mut()?)?;
+        let is_native = matches!(header.type_descriptor, DataType::Scalar(ref s) if s == native_type);
+        let expected_size = (count as u64).checked_mul(std::mem::size_of::<f64>() as u64);
+        if is_stored && is_native && expected_size == Some(data_size) {
+            if let Some(data) = view.data(data_start + header_size, count) {
+                let array = (view.create_view)(shape.clone(), data)?;
+                return Ok((array, shape));
+            }
         }
-        DataType::Scalar(s) if s == ">f8" => {
-            reader.read_f64_into::<BigEndian>(array.data_mut()?)?;
+    }
+
+    let descriptor = match header.type_descriptor {
+        DataType::Scalar(ref s) => parse_npy_descriptor(s),
+        DataType::Compound(_) => None,
+    };
+    let (file_dtype, endianness) = descriptor.ok_or_else(|| Error::Serialization(format!(
+        "unknown type for data array, expected 64, 32 or 16-bit floating points, got {}",
+        header.type_descriptor
+    )))?;
+
+    let mut array = create_array(shape.clone(), file_dtype)?;
+    let array_dtype = array.dtype()?;
+
+    if array.has_set_samples() {
+        // the array does not store its data as a contiguous buffer, set the
+        // data a few samples at the time
+        let n_samples = shape.first().copied().unwrap_or(0);
+        let sample_size = shape.iter().skip(1).product::<usize>() * file_dtype.size();
+        let chunk_samples = std::cmp::max(1, CHUNK_SIZE / std::cmp::max(1, sample_size));
+
+        let mut buffer = Vec::new();
+        let mut converted = Vec::new();
+        let mut start = 0;
+        while start < n_samples {
+            let end = std::cmp::min(start + chunk_samples, n_samples);
+            buffer.resize((end - start) * sample_size, 0);
+            reader.read_exact(&mut buffer)?;
+
+            set_samples_from(&mut array, start..end, &mut buffer, file_dtype, endianness, &mut converted)?;
+            start = end;
         }
-        _ => {
-            return Err(Error::Serialization(format!(
-                "unknown type for data array, expected 64-bit floating points, got {}",
-                header.type_descriptor
-            )));
+    } else if file_dtype == array_dtype {
+        let data = array.raw_data_mut()?;
+        reader.read_exact(data)?;
+        if endianness != Endianness::native() {
+            swap_bytes(data, array_dtype.size());
         }
+    } else {
+        // the array created by the user does not use the same data type as
+        // the file, convert the data while loading it
+        let count = shape.iter().product::<usize>();
+        let mut buffer = vec![0; count * file_dtype.size()];
+        reader.read_exact(&mut buffer)?;
+        convert(&buffer, file_dtype, endianness, array.raw_data_mut()?, array_dtype);
     }
 
     check_for_extra_bytes(&mut reader)?;
+    crate::profiling::bytes_moved(shape.iter().product::<usize>() * file_dtype.size());
 
     return Ok((array, shape));
 }
+
+/// Set the data for the given `samples` of `array` from `buffer`, containing
+/// values of type `file_dtype` stored with the given `endianness`. `converted`
+/// is used as temporary storage if `array` uses a different data type.
+pub(super) fn set_samples_from(
+    array: &mut eqs_array_t,
+    samples: std::ops::Range<usize>,
+    buffer: &mut [u8],
+    file_dtype: DType,
+    endianness: Endianness,
+    converted: &mut Vec<u8>,
+) -> Result<(), Error> {
+    let array_dtype = array.dtype()?;
+    if array_dtype == file_dtype {
+        if endianness != Endianness::native() {
+            swap_bytes(buffer, file_dtype.size());
+        }
+        return array.set_samples(samples, buffer);
+    }
+
+    converted.resize(buffer.len() / file_dtype.size() * array_dtype.size(), 0);
+    convert(buffer, file_dtype, endianness, converted, array_dtype);
+    return array.set_samples(samples, converted);
+}
+
+#[cfg(test)]
+mod tests {
+    use std::io::Write;
+    use std::sync::Mutex;
+
+    use super::{GradientsIndex, ReadAt};
+
+    #[test]
+    fn gradients_index() {
+        let names = [
+            "keys.npy",
+            "blocks/0/values.npy",
+            "blocks/0/samples.npy",
+            "blocks/0/properties.npy",
+            "blocks/0/gradients/positions/values.npy",
+            "blocks/0/gradients/positions/samples.npy",
+            "blocks/0/gradients/positions/gradients/cell/samples.npy",
+            "blocks/0/gradients/cell/samples.npy",
+            "blocks/1/samples.npy",
+            "blocks/1/gradients/cell/components/0.npy",
+            "blocks/1/gradients/cell/samples.npy",
+        ];
+        let index = GradientsIndex::new(names.iter().copied());
+
+        assert_eq!(index.get("blocks/0"), ["positions", "cell"]);
+        assert_eq!(index.get("blocks/0/gradients/positions"), ["cell"]);
+        assert!(index.get("blocks/0/gradients/cell").is_empty());
+        assert_eq!(index.get("blocks/1"), ["cell"]);
+        assert!(index.get("blocks/2").is_empty());
+    }
+
+    #[test]
+    fn mutex_file_read_at() {
+        let path = std::env::temp_dir().join(format!("equistore-read-at-{}", std::process::id()));
+        std::fs::File::create(&path).unwrap().write_all(b"0123456789").unwrap();
+
+        let file = Mutex::new(std::fs::File::open(&path).unwrap());
+        assert_eq!(file.size().unwrap(), 10);
+
+        let mut buffer = [0; 4];
+        assert_eq!(file.read_at(&mut buffer, 6).unwrap(), 4);
+        assert_eq!(&buffer, b"6789");
+        assert_eq!(file.read_at(&mut buffer, 2).unwrap(), 4);
+        assert_eq!(&buffer, b"2345");
+        assert_eq!(file.read_at(&mut buffer, 10).unwrap(), 0);
+
+        std::fs::remove_file(&path).unwrap();
+    }
+}
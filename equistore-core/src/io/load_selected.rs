@@ -0,0 +1,516 @@
+use std::io::{Read, BufReader};
+use std::sync::Arc;
+
+use zip::ZipArchive;
+
+use crate::{TensorMap, TensorBlock, Labels, LabelsBuilder, LabelValue, Error, eqs_array_t};
+use crate::utils::{run_with_threads, try_map};
+use crate::labels::LabelsInterner;
+use crate::data::DType;
+
+use super::labels::read_npy_labels_interned;
+use super::npy_header::{Header, DataType};
+use super::dtype::{Endianness, parse_npy_descriptor, swap_bytes, convert};
+use super::load::{ReadAt, ReadAtCursor, ArchiveIndex, IndexedEntries, read_keys, set_samples_from};
+use super::CHUNK_SIZE;
+
+/// Load a subset of the serialized tensor map from the given `source`,
+/// keeping only the samples and properties matching the given selections.
+///
+/// The labels of each block are decoded first, and then only the rows and
+/// columns of the data corresponding to the selected samples and properties
+/// are read from the `source`. For files stored without compression, each
+/// selected row is read directly at its offset in the file, so loading a
+/// small subset does not require reading the full file.
+///
+/// `samples` and `properties` can contain a subset of the dimensions of the
+/// corresponding labels, and an entry is kept if its values for these
+/// dimensions are part of the selection. Using `None` keeps all the entries.
+/// The kept entries stay in the same order as in the file; all blocks are
+/// kept, even if no samples or properties match the selection. The samples of
+/// gradients are filtered and renumbered to follow the samples of the values,
+/// and gradients use the same properties as the values.
+///
+/// `threads` and `create_array` have the same meaning as in [`load_parallel`].
+///
+/// [`load_parallel`]: crate::io::load_parallel
+pub fn load_selected<S, F>(
+    source: &S,
+    create_array: F,
+    samples: Option<&Labels>,
+    properties: Option<&Labels>,
+    threads: usize,
+) -> Result<TensorMap, Error>
+    where S: ReadAt + ?Sized,
+          F: Fn(Vec<usize>, DType) -> Result<eqs_array_t, Error> + Sync
+{
+    let reader = BufReader::new(ReadAtCursor { source, position: 0 });
+    let mut archive = ZipArchive::new(reader).map_err(|e| ("<root>".into(), e))?;
+    let keys = read_keys(&mut archive)?;
+    let index = ArchiveIndex::new(&mut archive)?;
+
+    let interner = LabelsInterner::new();
+    let blocks_ids = (0..keys.count()).collect::<Vec<_>>();
+    let blocks = run_with_threads(threads, |parallel| {
+        try_map(&blocks_ids, parallel, |&block_i| {
+            let reader = SelectedReader {
+                entries: IndexedEntries {
+                    source: source,
+                    index: &index,
+                },
+                create_array: &create_array,
+                interner: &interner,
+            };
+
+            reader.read_block(
+                &format!("blocks/{}", block_i),
+                samples.map_or(SamplesFilter::All, SamplesFilter::Selection),
+                PropertiesFilter::Selection(properties),
+            )
+        })
+    })?;
+
+    return TensorMap::new(Arc::new(keys), blocks);
+}
+
+/// How to select the samples of a block
+#[derive(Clone, Copy)]
+enum SamplesFilter<'a> {
+    /// Keep all the samples
+    All,
+    /// Keep the samples matching the given labels
+    Selection(&'a Labels),
+    /// Gradient samples, the first dimension refers to the samples of the
+    /// parent block, and this mapping gives the new position of each parent
+    /// sample, or -1 if it was removed
+    Parent(&'a [i64]),
+}
+
+/// How to select the properties of a block
+enum PropertiesFilter<'a> {
+    /// Keep the properties matching the given labels, or everything if the
+    /// labels are `None`
+    Selection(Option<&'a Labels>),
+    /// Use already filtered properties (from the parent block for gradients),
+    /// together with the positions of the kept properties in the file, or
+    /// `None` if all properties are kept
+    Parent(Arc<Labels>, Option<&'a [usize]>),
+}
+
+struct SelectedReader<'a, S: ?Sized, F> {
+    entries: IndexedEntries<'a, S>,
+    create_array: &'a F,
+    interner: &'a LabelsInterner,
+}
+
+impl<'a, S, F> SelectedReader<'a, S, F>
+    where S: ReadAt + ?Sized,
+          F: Fn(Vec<usize>, DType) -> Result<eqs_array_t, Error>
+{
+    fn read_labels(&self, path: String) -> Result<Arc<Labels>, Error> {
+        let (reader, entry) = self.entries.open(path)?;
+        return read_npy_labels_interned(reader.take(entry.size), self.interner);
+    }
+
+    #[allow(clippy::cast_possible_wrap)]
+    fn read_block(
+        &self,
+        prefix: &str,
+        samples_filter: SamplesFilter,
+        properties_filter: PropertiesFilter,
+    ) -> Result<TensorBlock, Error> {
+        let all_samples = self.read_labels(format!("{}/samples.npy", prefix))?;
+        let (samples, samples_rows) = match samples_filter {
+            SamplesFilter::All => (all_samples.clone(), None),
+            SamplesFilter::Selection(selection) => {
+                let (samples, rows) = select_entries(&all_samples, selection, "samples")?;
+                (self.interner.intern(Arc::new(samples)), Some(rows))
+            }
+            SamplesFilter::Parent(mapping) => {
+                let (samples, rows) = select_gradient_samples(&all_samples, mapping)?;
+                (self.interner.intern(Arc::new(samples)), Some(rows))
+            }
+        };
+
+        let mut components = Vec::new();
+        let mut i = 0;
+        let components_prefix = format!("{}/components/", prefix);
+        while self.entries.index.files.contains_key(&format!("{}{}.npy", components_prefix, i)) {
+            components.push(self.read_labels(format!("{}{}.npy", components_prefix, i))?);
+            i += 1;
+        }
+
+        let (properties, properties_columns) = match properties_filter {
+            PropertiesFilter::Selection(selection) => {
+                let all_properties = self.read_labels(format!("{}/properties.npy", prefix))?;
+                if let Some(selection) = selection {
+                    let (properties, columns) = select_entries(&all_properties, selection, "properties")?;
+                    (self.interner.intern(Arc::new(properties)), Some(columns))
+                } else {
+                    (all_properties, None)
+                }
+            }
+            PropertiesFilter::Parent(properties, columns) => {
+                (properties, columns.map(<[usize]>::to_vec))
+            }
+        };
+
+        let data = self.read_data(
+            format!("{}/values.npy", prefix),
+            all_samples.count(),
+            samples_rows.as_deref(),
+            properties_columns.as_deref(),
+        )?;
+
+        let mut block = TensorBlock::new(data, samples, components, properties.clone())?;
+
+        let parameters = self.entries.index.gradients.get(prefix);
+        if parameters.is_empty() {
+            return Ok(block);
+        }
+
+        // new position of the samples read from the file, used to filter
+        // and renumber the gradient samples
+        let mapping = if let Some(ref rows) = samples_rows {
+            let mut mapping = vec![-1; all_samples.count()];
+            for (new, &old) in rows.iter().enumerate() {
+                mapping[old] = new as i64;
+            }
+            mapping
+        } else {
+            (0..all_samples.count() as i64).collect()
+        };
+
+        for parameter in parameters {
+            let gradient = self.read_block(
+                &format!("{}/gradients/{}", prefix, parameter),
+                SamplesFilter::Parent(&mapping),
+                PropertiesFilter::Parent(properties.clone(), properties_columns.as_deref()),
+            )?;
+
+            block.add_gradient(parameter, gradient)?;
+        }
+
+        return Ok(block);
+    }
+
+    /// Read the rows (first dimension) and columns (last dimension) of the
+    /// data array stored at `path`. The array in the file should contain
+    /// `n_samples` rows. `None` means that all rows/columns should be read.
+    fn read_data(
+        &self,
+        path: String,
+        n_samples: usize,
+        rows: Option<&[usize]>,
+        columns: Option<&[usize]>,
+    ) -> Result<eqs_array_t, Error> {
+        let (reader, entry) = self.entries.open(path)?;
+
+        // keep track of how many bytes the header takes
+        let mut reader = reader.take(entry.size);
+        let header = Header::from_reader(&mut reader)?;
+        let header_size = entry.size - reader.limit();
+
+        if header.fortran_order {
+            return Err(Error::Serialization("data can not be loaded from fortran-order arrays".into()));
+        }
+
+        let descriptor = match header.type_descriptor {
+            DataType::Scalar(ref s) => parse_npy_descriptor(s),
+            DataType::Compound(_) => None,
+        };
+        let (file_dtype, endianness) = descriptor.ok_or_else(|| Error::Serialization(format!(
+            "unknown type for data array, expected 64, 32 or 16-bit floating points, got {}",
+            header.type_descriptor
+        )))?;
+
+        let shape = header.shape;
+        let count = shape.iter().product::<usize>();
+        if shape.len() < 2 || shape[0] != n_samples {
+            return Err(Error::Serialization(format!(
+                "invalid shape for data array: expected {} samples, got shape {:?}",
+                n_samples, shape
+            )));
+        }
+
+        if (count * file_dtype.size()) as u64 != entry.size - header_size {
+            return Err(Error::Serialization(format!(
+                "invalid size for data array: expected {} bytes, got {}",
+                count * file_dtype.size(), entry.size - header_size
+            )));
+        }
+
+        let n_properties = shape[shape.len() - 1];
+        if let Some(columns) = columns {
+            if columns.iter().any(|&c| c >= n_properties) {
+                return Err(Error::Serialization(format!(
+                    "invalid shape for data array: expected {} properties, got shape {:?}",
+                    n_properties, shape
+                )));
+            }
+        }
+
+        let mut new_shape = shape.clone();
+        if let Some(rows) = rows {
+            new_shape[0] = rows.len();
+        }
+        if let Some(columns) = columns {
+            *new_shape.last_mut().expect("shape is not empty") = columns.len();
+        }
+        let new_count = new_shape.iter().product::<usize>();
+
+        let layout = RowsLayout {
+            value_size: file_dtype.size(),
+            n_subrows: shape[1..shape.len() - 1].iter().product(),
+            n_properties: n_properties,
+            columns: columns,
+        };
+
+        let mut rows_reader = if entry.deflated {
+            RowsReader::Deflated { reader: reader, position: 0 }
+        } else {
+            RowsReader::Stored {
+                source: self.entries.source,
+                data_start: entry.data_start + header_size,
+            }
+        };
+
+        let mut array = (self.create_array)(new_shape, file_dtype)?;
+        let array_dtype = array.dtype()?;
+
+        if array.has_set_samples() {
+            // the array does not store its data as a contiguous buffer, set
+            // the data a few rows at the time
+            let n_selected = rows.map_or(n_samples, <[usize]>::len);
+            let output_size = layout.output_size();
+            let chunk_rows = std::cmp::max(1, CHUNK_SIZE / std::cmp::max(1, output_size));
+
+            let mut chunk = Vec::new();
+            let mut buffer = Vec::new();
+            let mut converted = Vec::new();
+            let mut start = 0;
+            while start < n_selected {
+                let end = std::cmp::min(start + chunk_rows, n_selected);
+                chunk.clear();
+                chunk.extend((start..end).map(|i| rows.map_or(i, |rows| rows[i])));
+
+                buffer.resize((end - start) * output_size, 0);
+                read_rows(&mut rows_reader, &layout, n_samples, Some(&chunk), &mut buffer)?;
+
+                set_samples_from(&mut array, start..end, &mut buffer, file_dtype, endianness, &mut converted)?;
+                start = end;
+            }
+        } else if array_dtype == file_dtype {
+            let data = array.raw_data_mut()?;
+            read_rows(&mut rows_reader, &layout, n_samples, rows, data)?;
+            if endianness != Endianness::native() {
+                swap_bytes(data, file_dtype.size());
+            }
+        } else {
+            // the array created by the user does not use the same data type
+            // as the file, convert the data after reading it
+            let mut buffer = vec![0; new_count * file_dtype.size()];
+            read_rows(&mut rows_reader, &layout, n_samples, rows, &mut buffer)?;
+            convert(&buffer, file_dtype, endianness, array.raw_data_mut()?, array_dtype);
+        }
+
+        crate::profiling::bytes_moved(new_count * file_dtype.size());
+
+        return Ok(array);
+    }
+}
+
+/// Find the entries of `labels` matching the `selection`, returning the
+/// corresponding new labels and the positions of these entries in `labels`.
+fn select_entries(labels: &Labels, selection: &Labels, kind: &str) -> Result<(Labels, Vec<usize>), Error> {
+    let names = labels.names();
+
+    let mut dimensions = Vec::new();
+    for name in selection.names() {
+        match names.iter().position(|&n| n == name) {
+            Some(i) => dimensions.push(i),
+            None => {
+                return Err(Error::InvalidParameter(format!(
+                    "'{}' is not part of the {} for this tensor map",
+                    name, kind
+                )));
+            }
+        }
+    }
+
+    let mut builder = LabelsBuilder::new(names)?;
+    let mut positions = Vec::new();
+    let mut candidate = vec![LabelValue::new(0); dimensions.len()];
+    for (position, entry) in labels.iter().enumerate() {
+        for (value, &dimension) in candidate.iter_mut().zip(&dimensions) {
+            *value = entry[dimension];
+        }
+
+        if selection.contains(&candidate) {
+            builder.add(entry)?;
+            positions.push(position);
+        }
+    }
+
+    return Ok((builder.finish(), positions));
+}
+
+/// Find the gradient samples referring to kept samples of the parent block,
+/// using the `mapping` from old to new positions of the parent samples.
+/// The first dimension of the new gradient samples is updated accordingly.
+fn select_gradient_samples(samples: &Labels, mapping: &[i64]) -> Result<(Labels, Vec<usize>), Error> {
+    let mut builder = LabelsBuilder::new(samples.names())?;
+    let mut positions = Vec::new();
+    let mut new_entry = Vec::new();
+    for (position, entry) in samples.iter().enumerate() {
+        let parent = entry[0].usize();
+        let new_parent = *mapping.get(parent).ok_or_else(|| Error::Serialization(format!(
+            "invalid gradient sample: the block contains {} samples, but the gradient refers to sample {}",
+            mapping.len(), parent
+        )))?;
+
+        if new_parent < 0 {
+            continue;
+        }
+
+        new_entry.clear();
+        new_entry.extend_from_slice(entry);
+        new_entry[0] = LabelValue::new(i32::try_from(new_parent).expect("too many samples"));
+        builder.add(&new_entry)?;
+        positions.push(position);
+    }
+
+    return Ok((builder.finish(), positions));
+}
+
+/// Layout of a single row (i.e. a single sample) of a data array
+struct RowsLayout<'a> {
+    /// size of a single value in bytes
+    value_size: usize,
+    /// number of sub-rows (one for each entry in the components) in a row
+    n_subrows: usize,
+    /// number of properties in the file
+    n_properties: usize,
+    /// positions of the properties to keep, `None` to keep all of them
+    columns: Option<&'a [usize]>,
+}
+
+impl<'a> RowsLayout<'a> {
+    /// Size in bytes of a row in the file
+    fn input_size(&self) -> usize {
+        self.n_subrows * self.n_properties * self.value_size
+    }
+
+    /// Size in bytes of a row after selecting the properties
+    fn output_size(&self) -> usize {
+        let n_columns = self.columns.map_or(self.n_properties, <[usize]>::len);
+        self.n_subrows * n_columns * self.value_size
+    }
+}
+
+/// Read the data of a NPY file, either directly at any offsets for files
+/// stored without compression, or sequentially for compressed files.
+enum RowsReader<'a, S: ?Sized> {
+    Stored {
+        source: &'a S,
+        data_start: u64,
+    },
+    Deflated {
+        reader: std::io::Take<Box<dyn Read + 'a>>,
+        position: u64,
+    },
+}
+
+impl<'a, S: ReadAt + ?Sized> RowsReader<'a, S> {
+    /// Fill `buffer` with the data starting at `offset` bytes after the NPY
+    /// header. For compressed files, `offset` must not be before the end of
+    /// the previous read.
+    fn read_exact_at(&mut self, mut buffer: &mut [u8], offset: u64) -> Result<(), Error> {
+        match self {
+            RowsReader::Stored { source, data_start } => {
+                let mut offset = *data_start + offset;
+                while !buffer.is_empty() {
+                    match source.read_at(buffer, offset) {
+                        Ok(0) => return Err(std::io::Error::from(std::io::ErrorKind::UnexpectedEof).into()),
+                        Ok(count) => {
+                            buffer = &mut buffer[count..];
+                            offset += count as u64;
+                        }
+                        Err(e) if e.kind() == std::io::ErrorKind::Interrupted => {}
+                        Err(e) => return Err(e.into()),
+                    }
+                }
+            }
+            RowsReader::Deflated { reader, position } => {
+                debug_assert!(offset >= *position);
+                let skip = offset - *position;
+                let skipped = std::io::copy(&mut reader.by_ref().take(skip), &mut std::io::sink())?;
+                if skipped != skip {
+                    return Err(std::io::Error::from(std::io::ErrorKind::UnexpectedEof).into());
+                }
+                reader.read_exact(buffer)?;
+                *position = offset + buffer.len() as u64;
+            }
+        }
+
+        return Ok(());
+    }
+}
+
+/// Read the given `rows` (or all `n_rows` rows if `rows` is `None`) from the
+/// `reader`, keeping only the selected columns, and store them in `output`.
+/// Consecutive rows are read together.
+fn read_rows<S: ReadAt + ?Sized>(
+    reader: &mut RowsReader<'_, S>,
+    layout: &RowsLayout,
+    n_rows: usize,
+    rows: Option<&[usize]>,
+    output: &mut [u8],
+) -> Result<(), Error> {
+    let input_size = layout.input_size();
+    let output_size = layout.output_size();
+    if output_size == 0 {
+        return Ok(());
+    }
+
+    let max_chunk_rows = if layout.columns.is_some() {
+        std::cmp::max(1, CHUNK_SIZE / input_size)
+    } else {
+        usize::MAX
+    };
+
+    let row = |i: usize| rows.map_or(i, |rows| rows[i]);
+    let n_selected = rows.map_or(n_rows, <[usize]>::len);
+
+    let mut buffer = Vec::new();
+    let mut i = 0;
+    while i < n_selected {
+        let first = row(i);
+        let mut chunk_rows = 1;
+        while i + chunk_rows < n_selected && chunk_rows < max_chunk_rows && row(i + chunk_rows) == first + chunk_rows {
+            chunk_rows += 1;
+        }
+
+        let output = &mut output[i * output_size..(i + chunk_rows) * output_size];
+        let offset = (first * input_size) as u64;
+        if let Some(columns) = layout.columns {
+            buffer.resize(chunk_rows * input_size, 0);
+            reader.read_exact_at(&mut buffer, offset)?;
+
+            let size = layout.value_size;
+            let input_subrows = buffer.chunks_exact(layout.n_properties * size);
+            let output_subrows = output.chunks_exact_mut(columns.len() * size);
+            for (input, output) in input_subrows.zip(output_subrows) {
+                for (output, &column) in output.chunks_exact_mut(size).zip(columns) {
+                    output.copy_from_slice(&input[column * size..(column + 1) * size]);
+                }
+            }
+        } else {
+            reader.read_exact_at(output, offset)?;
+        }
+
+        i += chunk_rows;
+    }
+
+    return Ok(());
+}
@@ -1,14 +1,21 @@
 mod npy_header;
+mod dtype;
 mod labels;
 
 mod load;
-pub use self::load::load;
+mod load_selected;
+pub use self::load::{load, load_view, load_parallel, ReadAt, LazyTensorMap};
+pub use self::load_selected::load_selected;
 
 mod save;
-pub use self::save::save;
+pub use self::save::{save, save_compressed};
 
 use crate::Error;
 
+/// Maximal number of bytes read or written at once when working with the data
+/// of a subset of the rows of an array
+const CHUNK_SIZE: usize = 1 << 20;
+
 // returns an error if the given reader contains any more data
 fn check_for_extra_bytes<R: std::io::Read>(reader: &mut R) -> Result<(), Error> {
     let extra = reader.read_to_end(&mut Vec::new())?;
@@ -1,10 +1,11 @@
-use byteorder::{WriteBytesExt, NativeEndian};
 use zip::{ZipWriter, DateTime};
 
 use crate::{TensorMap, TensorBlock, Error, eqs_array_t};
 
 use super::npy_header::{Header, DataType};
+use super::dtype::npy_descriptor;
 use super::labels::write_npy_labels;
+use super::CHUNK_SIZE;
 
 
 /// Save the given tensor to a file (or any other writer).
@@ -12,22 +13,61 @@ use super::labels::write_npy_labels;
 /// The format used is documented in the [`load`] function, and is based on
 /// numpy's NPZ format (i.e. zip archive containing NPY files).
 pub fn save<W: std::io::Write + std::io::Seek>(writer: W, tensor: &TensorMap) -> Result<(), Error> {
-    let mut archive = ZipWriter::new(writer);
+    return save_impl(writer, tensor, Compression::Stored);
+}
+
+/// Save the given tensor to a file (or any other writer), compressing all
+/// the files in the archive.
+///
+/// This uses the same format as [`save`], with each file in the archive
+/// compressed with DEFLATE (using the fastest compression level), which is
+/// the same format as numpy's `savez_compressed`. Each block is stored in
+/// separate files of the archive, which can then be decompressed in
+/// parallel when loading. Compressed data can not be memory-mapped or used
+/// directly with `load_view`, and will be copied instead.
+pub fn save_compressed<W: std::io::Write + std::io::Seek>(writer: W, tensor: &TensorMap) -> Result<(), Error> {
+    return save_impl(writer, tensor, Compression::Deflated);
+}
 
-    let options = zip::write::FileOptions::default()
-        .compression_method(zip::CompressionMethod::Stored)
-        .large_file(true)
-        .last_modified_time(DateTime::from_date_and_time(2000, 1, 1, 0, 0, 0).expect("invalid datetime"));
+/// Storage method for the files in the archive
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+enum Compression {
+    Stored,
+    Deflated,
+}
 
+impl Compression {
+    fn file_options(self) -> zip::write::FileOptions {
+        let options = zip::write::FileOptions::default()
+            .large_file(true)
+            .last_modified_time(DateTime::from_date_and_time(2000, 1, 1, 0, 0, 0).expect("invalid datetime"));
+
+        match self {
+            Compression::Stored => options.compression_method(zip::CompressionMethod::Stored),
+            Compression::Deflated => {
+                options.compression_method(zip::CompressionMethod::Deflated)
+                    .compression_level(Some(1))
+            }
+        }
+    }
+}
+
+fn save_impl<W: std::io::Write + std::io::Seek>(writer: W, tensor: &TensorMap, compression: Compression) -> Result<(), Error> {
+    let mut archive = ZipWriter::new(writer);
+
+    let options = compression.file_options();
     let path = String::from("keys.npy");
     archive.start_file(&path, options).map_err(|e| (path, e))?;
     write_npy_labels(&mut archive, tensor.keys())?;
 
     for (block_i, block) in tensor.blocks().iter().enumerate() {
-        write_block(&mut archive, &format!("blocks/{}", block_i), true, block)?;
+        write_block(&mut archive, &format!("blocks/{}", block_i), true, block, compression)?;
     }
 
-    archive.finish().map_err(|e| ("<root>".into(), e))?;
+    let mut writer = archive.finish().map_err(|e| ("<root>".into(), e))?;
+    // make sure errors when flushing buffered writers are reported, instead
+    // of being ignored when dropping the writer
+    writer.flush()?;
 
     return Ok(());
 }
@@ -37,14 +77,21 @@ fn write_block<W: std::io::Write + std::io::Seek>(
     prefix: &str,
     values: bool,
     block: &TensorBlock,
+    compression: Compression,
 ) -> Result<(), Error> {
-    let options = zip::write::FileOptions::default()
-        .compression_method(zip::CompressionMethod::Stored)
-        .large_file(true)
-        .last_modified_time(DateTime::from_date_and_time(2000, 1, 1, 0, 0, 0).expect("invalid datetime"));
+    let options = compression.file_options();
 
+    // align the start of the data to 64 bytes. Since the NPY header is padded
+    // to a multiple of 64 bytes, the array data will also be aligned, allowing
+    // to use it directly from a memory-mapped file.
     let path = format!("{}/values.npy", prefix);
-    archive.start_file(&path, options).map_err(|e| (path, e))?;
+    if compression == Compression::Stored {
+        archive.start_file_aligned(&path, options, 64).map_err(|e| (path, e))?;
+    } else {
+        // compressed data can not be used directly, there is no need to
+        // align it
+        archive.start_file(&path, options).map_err(|e| (path, e))?;
+    }
     write_data(archive, &block.values)?;
 
     let path = format!("{}/samples.npy", prefix);
@@ -63,32 +110,68 @@ fn write_block<W: std::io::Write + std::io::Seek>(
         write_npy_labels(archive, &block.properties)?;
     }
 
-    for (parameter, gradient) in block.gradients() {
+    for parameter in block.gradient_parameters_c() {
+        let parameter = parameter.as_str();
+        let gradient = block.gradient(parameter).expect("missing gradient");
         let prefix = format!("{}/gradients/{}", prefix, parameter);
-        write_block(archive, &prefix, false, gradient)?;
+        write_block(archive, &prefix, false, gradient, compression)?;
     }
 
     Ok(())
 }
 
-// Write an array to the given writer, using numpy's NPY format
+// Write an array to the given writer, using numpy's NPY format. The data is
+// written with the same data type it has in memory.
 fn write_data<W: std::io::Write>(writer: &mut W, array: &eqs_array_t) -> Result<(), Error> {
-    let type_descriptor = if cfg!(target_endian = "little") {
-        "<f8"
-    } else {
-        ">f8"
-    };
+    let dtype = array.dtype()?;
 
     let header = Header {
-        type_descriptor: DataType::Scalar(type_descriptor.into()),
+        type_descriptor: DataType::Scalar(npy_descriptor(dtype).into()),
         fortran_order: false,
         shape: array.shape()?.to_vec(),
     };
 
     header.write(&mut *writer)?;
 
-    for &value in array.data()? {
-        writer.write_f64::<NativeEndian>(value)?;
+    if array.has_get_samples() {
+        return write_data_by_samples(writer, array, &header.shape, dtype.size());
+    }
+
+    // the data is stored in native endianness, matching the header
+    let data = array.raw_data()?;
+    writer.write_all(data)?;
+    crate::profiling::bytes_moved(data.len());
+
+    return Ok(());
+}
+
+// Write the data for an array which does not store its data as a single
+// contiguous buffer, getting the data for a few samples at the time.
+fn write_data_by_samples<W: std::io::Write>(
+    writer: &mut W,
+    array: &eqs_array_t,
+    shape: &[usize],
+    value_size: usize,
+) -> Result<(), Error> {
+    let n_samples = shape[0];
+    let sample_size = shape[1..].iter().product::<usize>() * value_size;
+    if sample_size == 0 {
+        return Ok(());
+    }
+
+    let chunk_samples = std::cmp::max(1, CHUNK_SIZE / sample_size);
+    let mut buffer = vec![0; std::cmp::min(chunk_samples, n_samples) * sample_size];
+
+    let mut start = 0;
+    while start < n_samples {
+        let end = std::cmp::min(start + chunk_samples, n_samples);
+        let buffer = &mut buffer[..(end - start) * sample_size];
+
+        array.get_samples(start..end, buffer)?;
+        writer.write_all(buffer)?;
+        crate::profiling::bytes_moved(buffer.len());
+
+        start = end;
     }
 
     return Ok(());
@@ -1,12 +1,14 @@
 #![allow(clippy::default_trait_access, clippy::module_name_repetitions)]
-use std::sync::RwLock;
+use std::sync::{Arc, Weak, Mutex, RwLock};
+use std::sync::atomic::{AtomicPtr, Ordering};
+use std::hash::{BuildHasher, Hash, Hasher};
 use std::ffi::CString;
-use std::collections::BTreeSet;
 use std::os::raw::c_void;
 
 use hashbrown::HashMap;
 use hashbrown::hash_map::RawEntryMut;
 
+use once_cell::sync::Lazy;
 use smallvec::SmallVec;
 
 use crate::Error;
@@ -98,12 +100,140 @@ impl LabelValue {
 
 type DefaultHasher = std::hash::BuildHasherDefault<ahash::AHasher>;
 
+/// Index used to find the position of a given entry in a set of `Labels`.
+#[derive(Clone)]
+enum LabelsIndex {
+    /// All the entries are sorted in strictly increasing lexicographic order.
+    /// The position of an entry is found with a binary search over the
+    /// values, which does not require any additional memory.
+    Sorted,
+    /// The entries are not sorted, and we store the position of all of them
+    /// in a hash map. This uses `AHasher` instead of the default hasher in std
+    /// since it is much faster and we don't need the cryptographic strength
+    /// hash from std.
+    Hashed(HashMap<SmallVec<[LabelValue; 4]>, usize, DefaultHasher>),
+}
+
+impl LabelsIndex {
+    /// Build a hash map index for the given `values`, containing entries with
+    /// `size` elements. `additional` is the number of entries we expect to
+    /// add later.
+    fn hashed(values: &[LabelValue], size: usize, additional: usize) -> LabelsIndex {
+        if size == 0 {
+            return LabelsIndex::Hashed(HashMap::default());
+        }
+
+        let mut positions = HashMap::with_capacity_and_hasher(
+            values.len() / size + additional,
+            DefaultHasher::default(),
+        );
+
+        for (i, entry) in values.chunks_exact(size).enumerate() {
+            positions.insert(entry.iter().copied().collect(), i);
+        }
+        crate::profiling::labels_entries_hashed(values.len() / size);
+
+        return LabelsIndex::Hashed(positions);
+    }
+
+    /// Find the position of `entry` inside `values`, where `values` contains
+    /// entries with `size` elements.
+    fn find(&self, values: &[LabelValue], size: usize, entry: &[LabelValue]) -> Option<usize> {
+        match self {
+            LabelsIndex::Sorted => {
+                if size == 0 {
+                    return None;
+                }
+
+                let mut low = 0;
+                let mut high = values.len() / size;
+                while low < high {
+                    let middle = low + (high - low) / 2;
+                    let current = &values[(middle * size)..((middle + 1) * size)];
+                    match current.cmp(entry) {
+                        std::cmp::Ordering::Less => low = middle + 1,
+                        std::cmp::Ordering::Greater => high = middle,
+                        std::cmp::Ordering::Equal => return Some(middle),
+                    }
+                }
+
+                return None;
+            }
+            LabelsIndex::Hashed(positions) => {
+                crate::profiling::labels_entries_hashed(1);
+                positions.get(entry).copied()
+            }
+        }
+    }
+}
+
+/// Names of the dimensions in a set of `Labels`. The same allocation is shared
+/// by all labels with the same names, see `shared_names`.
+type LabelsNames = Arc<[ConstCString]>;
+
+/// Maximal number of different sets of names stored in `NAMES_CACHE`
+const MAX_CACHED_NAMES: usize = 4096;
+
+/// Cache for the names of all labels created so far, indexed by the hash of
+/// the names. Metadata typically uses only a handful of different names, and
+/// sharing them removes one allocation per name each time new labels are
+/// created. The names are never removed from the cache.
+static NAMES_CACHE: Lazy<RwLock<HashMap<u64, Vec<LabelsNames>, DefaultHasher>>> = Lazy::new(Default::default);
+
+/// Get the shared `LabelsNames` instance for the given `names`, creating
+/// and caching it if needed.
+fn shared_names(names: &[&str]) -> LabelsNames {
+    let same_names = |candidate: &&LabelsNames| {
+        candidate.len() == names.len() && candidate.iter().zip(names).all(|(c, n)| c.as_str() == *n)
+    };
+
+    let mut hasher = DefaultHasher::default().build_hasher();
+    names.hash(&mut hasher);
+    let hash = hasher.finish();
+
+    {
+        let cache = NAMES_CACHE.read().expect("poisoned lock");
+        if let Some(candidates) = cache.get(&hash) {
+            if let Some(candidate) = candidates.iter().find(same_names) {
+                return Arc::clone(candidate);
+            }
+        }
+
+        if cache.len() >= MAX_CACHED_NAMES {
+            // the cache is full, don't wait on the write lock
+            return create_names(names);
+        }
+    }
+
+    let mut cache = NAMES_CACHE.write().expect("poisoned lock");
+    if cache.len() >= MAX_CACHED_NAMES {
+        return create_names(names);
+    }
+
+    let candidates = cache.entry(hash).or_default();
+    // another thread could have added the same names since we released the
+    // read lock
+    if let Some(candidate) = candidates.iter().find(same_names) {
+        return Arc::clone(candidate);
+    }
+
+    let new_names = create_names(names);
+    candidates.push(Arc::clone(&new_names));
+    return new_names;
+}
+
+fn create_names(names: &[&str]) -> LabelsNames {
+    return names.iter()
+        .map(|&s| ConstCString::new(CString::new(s).expect("invalid C string")))
+        .collect();
+}
+
 /// Builder for `Labels`, this should be used to construct `Labels`.
 pub struct LabelsBuilder {
     // cf `Labels` for the documentation of the fields
-    names: Vec<ConstCString>,
+    names: LabelsNames,
     values: Vec<LabelValue>,
-    positions: HashMap<SmallVec<[LabelValue; 4]>, usize, DefaultHasher>,
+    index: LabelsIndex,
 }
 
 impl LabelsBuilder {
@@ -117,30 +247,39 @@ impl LabelsBuilder {
             }
         }
 
-        let mut unique_names = BTreeSet::new();
-        for name in &names {
-            if !unique_names.insert(name) {
+        // there are only a few names, so comparing all pairs is faster than
+        // allocating a set
+        for (i, name) in names.iter().enumerate() {
+            if names[..i].contains(name) {
                 return Err(Error::InvalidParameter(format!(
                     "labels names must be unique, got '{}' multiple times", name
                 )));
             }
         }
 
-        let names = names.into_iter()
-            .map(|s| ConstCString::new(CString::new(s).expect("invalid C string")))
-            .collect::<Vec<_>>();
-
         Ok(LabelsBuilder {
-            names: names,
+            names: shared_names(&names),
             values: Vec::new(),
-            positions: Default::default(),
+            index: LabelsIndex::Sorted,
         })
     }
 
+    /// Create a new `LabelsBuilder` containing all the entries of `labels`,
+    /// re-using the existing index instead of adding entries one by one.
+    pub(crate) fn from_labels(labels: &Labels) -> LabelsBuilder {
+        LabelsBuilder {
+            names: Arc::clone(&labels.names),
+            values: labels.values.clone(),
+            index: labels.index.clone(),
+        }
+    }
+
     /// Reserve space for `additional` other entries in the labels.
     pub fn reserve(&mut self, additional: usize) {
         self.values.reserve(additional * self.names.len());
-        self.positions.reserve(additional);
+        if let LabelsIndex::Hashed(ref mut positions) = self.index {
+            positions.reserve(additional);
+        }
     }
 
     /// Get the number of labels in a single value
@@ -148,6 +287,11 @@ impl LabelsBuilder {
         self.names.len()
     }
 
+    /// Get the names of the entries/columns in the labels being built
+    pub fn names(&self) -> Vec<&str> {
+        self.names.iter().map(|s| s.as_str()).collect()
+    }
+
     /// Get the current number of entries
     pub fn count(&self) -> usize {
         if self.size() == 0 {
@@ -157,6 +301,17 @@ impl LabelsBuilder {
         }
     }
 
+    /// Get the position of the given `entry` in the labels added so far, or
+    /// `None` if the entry is not there yet.
+    pub fn position(&self, entry: &[LabelValue]) -> Option<usize> {
+        assert_eq!(
+            self.size(), entry.len(),
+            "wrong size for label: got {}, but expected {}",
+            entry.len(), self.size()
+        );
+        return self.index.find(&self.values, self.size(), entry);
+    }
+
     /// Add a single `entry` to this set of labels.
     ///
     /// This function will return an `Error` when attempting to add the same
@@ -167,13 +322,7 @@ impl LabelsBuilder {
         let entry = entry.iter().copied().map(Into::into).collect::<SmallVec<_>>();
         match self.add_or_get_position(entry) {
             Ok(_) => return Ok(()),
-            Err((existing, entry)) => {
-                let values_display = entry.iter().map(|v| v.to_string()).collect::<Vec<_>>().join(", ");
-                return Err(Error::InvalidParameter(format!(
-                    "can not have the same label value multiple time: [{}] is already present at position {}",
-                    values_display, existing
-                )));
-            }
+            Err((existing, entry)) => return Err(duplicated_entry(&entry, existing)),
         }
     }
 
@@ -184,9 +333,38 @@ impl LabelsBuilder {
             labels_entry.len(), self.size()
         );
 
-        let new_position = self.positions.len();
+        let new_position = self.count();
+
+        if let LabelsIndex::Sorted = self.index {
+            let size = self.size();
+            let is_after_last = match self.values.len().checked_sub(size) {
+                Some(start) => labels_entry.as_slice() > &self.values[start..],
+                None => true,
+            };
+
+            if is_after_last {
+                // the entries are still sorted, and the new one can not be
+                // already present
+                self.values.extend(&labels_entry);
+                return Ok(new_position);
+            }
+
+            // this entry breaks the sorting, switch to a hash map index
+            let additional = if size == 0 {
+                0
+            } else {
+                (self.values.capacity() - self.values.len()) / size
+            };
+            self.index = LabelsIndex::hashed(&self.values, size, additional);
+        }
 
-        match self.positions.raw_entry_mut().from_key(&labels_entry) {
+        let positions = match self.index {
+            LabelsIndex::Hashed(ref mut positions) => positions,
+            LabelsIndex::Sorted => unreachable!(),
+        };
+
+        crate::profiling::labels_entries_hashed(1);
+        match positions.raw_entry_mut().from_key(&labels_entry) {
             RawEntryMut::Occupied(entry) => {
                 return Err((*entry.get(), labels_entry));
             },
@@ -204,22 +382,32 @@ impl LabelsBuilder {
         if self.names.is_empty() {
             assert!(self.values.is_empty());
             return Labels {
-                names: Vec::new(),
+                names: self.names,
                 values: Vec::new(),
-                positions: Default::default(),
-                user_data: RwLock::new(UserData::null()),
+                index: LabelsIndex::Sorted,
+                user_data: UserDataSlot::new(),
             }
         }
 
         return Labels {
             names: self.names,
             values: self.values,
-            positions: self.positions,
-            user_data: RwLock::new(UserData::null()),
+            index: self.index,
+            user_data: UserDataSlot::new(),
         };
     }
 }
 
+/// Error used when trying to add `entry` to labels already containing it at
+/// position `existing`
+pub(crate) fn duplicated_entry(entry: &[LabelValue], existing: usize) -> Error {
+    let values_display = entry.iter().map(|v| v.to_string()).collect::<Vec<_>>().join(", ");
+    return Error::InvalidParameter(format!(
+        "can not have the same label value multiple time: [{}] is already present at position {}",
+        values_display, existing
+    ));
+}
+
 /// Check if the given name is a valid identifier, to be used as a
 /// column name in `Labels`.
 pub fn is_valid_label_name(name: &str) -> bool {
@@ -246,15 +434,14 @@ struct UserData {
     delete: Option<unsafe extern fn(*mut c_void)>,
 }
 
-impl UserData {
-    /// Create an empty `UserData`
-    fn null() -> UserData {
-        UserData {
-            ptr: std::ptr::null_mut(),
-            delete: None,
-        }
-    }
-}
+
+// SAFETY: the user data is never accessed by equistore itself, only given back
+// to the user through the C API (`eqs_labels_user_data`). Users are
+// responsible for synchronizing access to the data, and the documentation of
+// `eqs_labels_set_user_data` states that `delete` can be called from any
+// thread.
+unsafe impl Sync for UserData {}
+unsafe impl Send for UserData {}
 
 impl Drop for UserData {
     fn drop(&mut self) {
@@ -266,6 +453,37 @@ impl Drop for UserData {
     }
 }
 
+/// Storage for the user data associated with a set of labels.
+///
+/// Reading the current user data is lock-free, so that multiple threads can
+/// access the same labels without contention. Replaced user data is only
+/// released when the slot is dropped: pointers returned by `get` stay valid for
+/// the lifetime of the labels, even if another thread calls `set` at the same
+/// time.
+struct UserDataSlot {
+    current: AtomicPtr<c_void>,
+    all: Mutex<Vec<UserData>>,
+}
+
+impl UserDataSlot {
+    fn new() -> UserDataSlot {
+        UserDataSlot {
+            current: AtomicPtr::new(std::ptr::null_mut()),
+            all: Mutex::new(Vec::new()),
+        }
+    }
+
+    fn get(&self) -> *mut c_void {
+        self.current.load(Ordering::Acquire)
+    }
+
+    fn set(&self, data: UserData) {
+        let mut all = self.all.lock().expect("poisoned lock");
+        self.current.store(data.ptr, Ordering::Release);
+        all.push(data);
+    }
+}
+
 /// A set of labels used to carry metadata associated with a tensor map.
 ///
 /// This is similar to a list of named tuples, but stored as a 2D array of shape
@@ -276,18 +494,18 @@ impl Drop for UserData {
 /// The main way to construct a new set of labels is to use a `LabelsBuilder`.
 pub struct Labels {
     /// Names of the labels, stored as const C strings for easier integration
-    /// with the C API
-    names: Vec<ConstCString>,
+    /// with the C API. The names are shared with all other labels using the
+    /// same names.
+    names: LabelsNames,
     /// Values of the labels, as a linearized 2D array in row-major order
     values: Vec<LabelValue>,
-    /// Store the position of all the known labels, for faster access later.
-    /// This uses `XxHash64` instead of the default hasher in std since
-    /// `XxHash64` is much faster and we don't need the cryptographic strength
-    /// hash from std.
-    positions: HashMap<SmallVec<[LabelValue; 4]>, usize, DefaultHasher>,
+    /// Index used to find the position of entries. Sorted labels are searched
+    /// directly in `values`, other labels store the position of all entries
+    /// in a hash map for faster access later.
+    index: LabelsIndex,
     /// Some data provided by the user that we should keep around (this is
     /// used to store a pointer to the on-GPU tensor in equistore-torch).
-    user_data: RwLock<UserData>,
+    user_data: UserDataSlot,
 }
 
 impl PartialEq for Labels {
@@ -319,6 +537,63 @@ impl std::fmt::Debug for Labels {
 }
 
 impl Labels {
+    /// Create a new set of `Labels` with the given `names` and `values`.
+    /// `values` should contain all the entries one after the other, i.e. a
+    /// linearized 2D array in row-major order.
+    ///
+    /// This is faster than adding the entries one by one to a
+    /// `LabelsBuilder`: sorted values are checked with a single pass over the
+    /// data, and other values are indexed without creating temporary entries.
+    pub fn new(names: Vec<&str>, values: Vec<LabelValue>) -> Result<Labels, Error> {
+        let builder = LabelsBuilder::new(names)?;
+        let size = builder.size();
+        if size == 0 {
+            if !values.is_empty() {
+                return Err(Error::InvalidParameter(
+                    "can not have values in labels without any names".into()
+                ));
+            }
+            return Ok(builder.finish());
+        }
+
+        if values.len() % size != 0 {
+            return Err(Error::InvalidParameter(format!(
+                "the number of values ({}) must be a multiple of the number of names ({})",
+                values.len(), size
+            )));
+        }
+
+        let is_sorted = values.chunks_exact(size)
+            .zip(values.chunks_exact(size).skip(1))
+            .all(|(previous, current)| previous < current);
+
+        let index = if is_sorted {
+            LabelsIndex::Sorted
+        } else {
+            let count = values.len() / size;
+            let mut positions = HashMap::with_capacity_and_hasher(count, DefaultHasher::default());
+            for (i, entry) in values.chunks_exact(size).enumerate() {
+                match positions.raw_entry_mut().from_key(entry) {
+                    RawEntryMut::Occupied(existing) => {
+                        return Err(duplicated_entry(entry, *existing.get()));
+                    },
+                    RawEntryMut::Vacant(vacant) => {
+                        vacant.insert(SmallVec::from_slice(entry), i);
+                    }
+                }
+            }
+            crate::profiling::labels_entries_hashed(count);
+            LabelsIndex::Hashed(positions)
+        };
+
+        return Ok(Labels {
+            names: builder.names,
+            values: values,
+            index: index,
+            user_data: UserDataSlot::new(),
+        });
+    }
+
     /// Get the number of entries/named values in a single label
     pub fn size(&self) -> usize {
         self.names.len()
@@ -338,8 +613,7 @@ impl Labels {
     /// Get the registered user data (this will be NULL if no data was
     /// registered)
     pub fn user_data(&self) -> *mut c_void {
-        let guard = self.user_data.read().expect("poisoned lock");
-        return guard.ptr;
+        self.user_data.get()
     }
 
     /// Register user data for these Labels.
@@ -347,18 +621,17 @@ impl Labels {
     /// The `user_data_delete` will be called with `user_data` when the Labels
     /// are dropped, and should free the memory associated with `user_data`.
     ///
-    /// Any existing user data will be released (by calling the provided
-    /// `user_data_delete` function) before overwriting with the new data.
+    /// Existing user data is kept alive (and released at the same time as the
+    /// new data) since other threads might still be using it.
     pub fn set_user_data(
         &self,
         user_data: *mut c_void,
         user_data_delete: Option<unsafe extern fn(*mut c_void)>,
     ) {
-        let mut guard = self.user_data.write().expect("poisoned lock");
-        *guard = UserData {
+        self.user_data.set(UserData {
             ptr: user_data,
             delete: user_data_delete,
-        };
+        });
     }
 
     /// Get the total number of entries in this set of labels
@@ -370,6 +643,13 @@ impl Labels {
         }
     }
 
+    /// Check if the entries in this set of labels are sorted in strictly
+    /// increasing lexicographic order. Sorted labels do not need to store an
+    /// additional index to find the position of entries.
+    pub fn is_sorted(&self) -> bool {
+        matches!(self.index, LabelsIndex::Sorted)
+    }
+
     /// Check if this set of Labels is empty (contains no entry)
     pub fn is_empty(&self) -> bool {
         self.count() == 0
@@ -377,7 +657,11 @@ impl Labels {
 
     /// Check whether the given `label` is part of this set of labels
     pub fn contains(&self, label: &[LabelValue]) -> bool {
-        self.positions.contains_key(label)
+        if label.len() != self.size() {
+            return false;
+        }
+
+        self.index.find(&self.values, self.size(), label).is_some()
     }
 
     /// Get the position (i.e. row index) of the given label in the full labels
@@ -385,7 +669,13 @@ impl Labels {
     pub fn position(&self, value: &[LabelValue]) -> Option<usize> {
         assert!(value.len() == self.size(), "invalid size of index in Labels::position");
 
-        self.positions.get(value).copied()
+        self.index.find(&self.values, self.size(), value)
+    }
+
+    /// Get all the values in this set of labels, as a linearized 2D array in
+    /// row-major order
+    pub fn values(&self) -> &[LabelValue] {
+        &self.values
     }
 
     /// Iterate over the entries in this set of labels
@@ -408,12 +698,6 @@ impl Labels {
             ));
         }
 
-        let mut builder = LabelsBuilder {
-            names: self.names.clone(),
-            values: self.values.clone(),
-            positions: self.positions.clone(),
-        };
-
         if !first_mapping.is_empty() {
             assert!(first_mapping.len() == self.count());
             for i in 0..self.count() {
@@ -421,6 +705,16 @@ impl Labels {
             }
         }
 
+        if self.size() != 0 && self.is_sorted() && other.is_sorted() {
+            return Ok(self.sorted_union(other, second_mapping));
+        }
+
+        let mut builder = LabelsBuilder {
+            names: self.names.clone(),
+            values: self.values.clone(),
+            index: self.index.clone(),
+        };
+
         for (i, entry) in other.iter().enumerate() {
             let entry = entry.iter().copied().map(Into::into).collect::<SmallVec<_>>();
             let position = builder.add_or_get_position(entry);
@@ -438,6 +732,153 @@ impl Labels {
         return Ok(builder.finish());
     }
 
+    /// Implementation of `union` when both `self` and `other` are sorted. This
+    /// finds the entries of `other` already in `self` with a linear merge of
+    /// the two sets of entries instead of hash map lookups. The result
+    /// contains all the entries of `self`, followed by the new entries from
+    /// `other`, as for the general case.
+    fn sorted_union(&self, other: &Labels, second_mapping: &mut [i64]) -> Labels {
+        debug_assert!(self.is_sorted() && other.is_sorted());
+
+        let mut values = Vec::with_capacity(self.values.len() + other.values.len());
+        values.extend_from_slice(&self.values);
+
+        let mut new_position = self.count();
+        let mut first = self.iter().enumerate().peekable();
+        for (i, entry) in other.iter().enumerate() {
+            let mut position = None;
+            while let Some(&(j, candidate)) = first.peek() {
+                match candidate.cmp(entry) {
+                    std::cmp::Ordering::Less => {
+                        first.next();
+                    }
+                    std::cmp::Ordering::Equal => {
+                        position = Some(j);
+                        first.next();
+                        break;
+                    }
+                    std::cmp::Ordering::Greater => break,
+                }
+            }
+
+            let position = position.unwrap_or_else(|| {
+                values.extend_from_slice(entry);
+                new_position += 1;
+                new_position - 1
+            });
+
+            if !second_mapping.is_empty() {
+                second_mapping[i] = position as i64;
+            }
+        }
+
+        // the new entries are sorted since they come from `other`, so the
+        // result is sorted if they all come after the last entry of `self`
+        let size = self.size();
+        let new_values = &values[self.values.len()..];
+        let still_sorted = match self.values.len().checked_sub(size) {
+            Some(last) => new_values.is_empty() || new_values[..size] > self.values[last..],
+            None => true,
+        };
+
+        let index = if still_sorted {
+            LabelsIndex::Sorted
+        } else {
+            LabelsIndex::hashed(&values, size, 0)
+        };
+
+        return Labels {
+            names: self.names.clone(),
+            values: values,
+            index: index,
+            user_data: UserDataSlot::new(),
+        };
+    }
+
+    /// Compute the union of all the `labels` in a single pass, and optionally
+    /// the mapping from the position of entries in each of the inputs to the
+    /// positions of entries in the output.
+    ///
+    /// The result contains all the entries of `labels[0]`, followed by the new
+    /// entries of `labels[1]`, and so on; i.e. the same as repeatedly calling
+    /// `union`, without the cost of creating all the intermediary results.
+    ///
+    /// `mappings` should either be empty, or contain one slice for each
+    /// element of `labels`. Mapping will be computed only for the non-empty
+    /// slices.
+    pub fn union_many(labels: &[&Labels], mappings: &mut [&mut [i64]]) -> Result<Labels, Error> {
+        let first = match labels.first() {
+            Some(first) => first,
+            None => {
+                return Err(Error::InvalidParameter(
+                    "can not take the union of an empty list of Labels".into()
+                ));
+            }
+        };
+
+        for other in &labels[1..] {
+            if first.names != other.names {
+                return Err(Error::InvalidParameter(
+                    "can not take the union of these Labels, they have different names".into()
+                ));
+            }
+        }
+
+        if !mappings.is_empty() && mappings.len() != labels.len() {
+            return Err(Error::InvalidParameter(format!(
+                "expected {} mappings in Labels::union_many, got {}",
+                labels.len(), mappings.len()
+            )));
+        }
+
+        for (labels, mapping) in labels.iter().zip(mappings.iter()) {
+            if !mapping.is_empty() && mapping.len() != labels.count() {
+                return Err(Error::InvalidParameter(format!(
+                    "expected space for {} entries in Labels::union_many mapping, got {}",
+                    labels.count(), mapping.len()
+                )));
+            }
+        }
+
+        let mut builder = LabelsBuilder {
+            names: first.names.clone(),
+            values: first.values.clone(),
+            index: first.index.clone(),
+        };
+
+        if builder.size() == 0 {
+            return Ok(builder.finish());
+        }
+
+        builder.reserve(labels[1..].iter().map(|l| l.count()).sum());
+
+        if let Some(mapping) = mappings.first_mut() {
+            for (i, position) in mapping.iter_mut().enumerate() {
+                *position = i as i64;
+            }
+        }
+
+        for (i, other) in labels.iter().enumerate().skip(1) {
+            let mapping: &mut [i64] = match mappings.get_mut(i) {
+                Some(mapping) => mapping,
+                None => &mut [],
+            };
+
+            for (j, entry) in other.iter().enumerate() {
+                let entry = entry.iter().copied().collect::<SmallVec<_>>();
+                let position = match builder.add_or_get_position(entry) {
+                    Ok(index) | Err((index, _)) => index,
+                };
+
+                if !mapping.is_empty() {
+                    mapping[j] = position as i64;
+                }
+            }
+        }
+
+        return Ok(builder.finish());
+    }
+
     /// Compute the intersection of two labels, and optionally the mapping from
     /// the position of entries in the inputs to positions of entries in the
     /// output.
@@ -450,6 +891,10 @@ impl Labels {
             ));
         }
 
+        if self.size() != 0 && self.is_sorted() && other.is_sorted() {
+            return Ok(self.sorted_intersection(other, first_mapping, second_mapping));
+        }
+
         // make `first` the Labels with fewest entries
         let (first, first_indexes, second, second_indexes) = if self.count() <= other.count() {
             (&self, first_mapping, &other, second_mapping)
@@ -485,6 +930,61 @@ impl Labels {
 
         return Ok(builder.finish());
     }
+
+    /// Implementation of `intersection` when both `self` and `other` are
+    /// sorted, using a linear merge of the two sets of entries. The result is
+    /// also sorted, and does not need a hash map index.
+    fn sorted_intersection(&self, other: &Labels, first_mapping: &mut [i64], second_mapping: &mut [i64]) -> Labels {
+        debug_assert!(self.is_sorted() && other.is_sorted());
+
+        if !first_mapping.is_empty() {
+            assert!(first_mapping.len() == self.count());
+            first_mapping.fill(-1);
+        }
+
+        if !second_mapping.is_empty() {
+            assert!(second_mapping.len() == other.count());
+            second_mapping.fill(-1);
+        }
+
+        let mut values = Vec::new();
+        let mut new_position = 0;
+
+        let mut first = self.iter().enumerate().peekable();
+        let mut second = other.iter().enumerate().peekable();
+        while let (Some(&(i, first_entry)), Some(&(j, second_entry))) = (first.peek(), second.peek()) {
+            match first_entry.cmp(second_entry) {
+                std::cmp::Ordering::Less => {
+                    first.next();
+                }
+                std::cmp::Ordering::Greater => {
+                    second.next();
+                }
+                std::cmp::Ordering::Equal => {
+                    values.extend_from_slice(first_entry);
+
+                    if !first_mapping.is_empty() {
+                        first_mapping[i] = new_position;
+                    }
+
+                    if !second_mapping.is_empty() {
+                        second_mapping[j] = new_position;
+                    }
+
+                    new_position += 1;
+                    first.next();
+                    second.next();
+                }
+            }
+        }
+
+        return Labels {
+            names: self.names.clone(),
+            values: values,
+            index: LabelsIndex::Sorted,
+            user_data: UserDataSlot::new(),
+        };
+    }
 }
 
 /// iterator over `Labels` entries
@@ -523,9 +1023,106 @@ impl std::ops::Index<usize> for Labels {
     }
 }
 
+/// Deduplicate equal `Labels`, so that metadata shared by multiple blocks (or
+/// by a block and its gradients) is stored and indexed only once.
+///
+/// Labels are grouped by a cheap content hash, using the names, the number of
+/// entries and a couple of entries; and then compared in full with the other
+/// labels in the same group. Labels with user data are never replaced by
+/// another instance, since the user data belongs to a specific instance.
+///
+/// The interner only keeps weak references to the labels, and does not
+/// prevent them from being freed.
+#[derive(Debug, Default)]
+pub(crate) struct LabelsInterner {
+    labels: Mutex<HashMap<u64, Vec<Weak<Labels>>, DefaultHasher>>,
+}
+
+impl LabelsInterner {
+    /// Create a new empty interner
+    pub fn new() -> LabelsInterner {
+        LabelsInterner::default()
+    }
+
+    /// Get the shared instance of labels equal to `labels`, registering
+    /// `labels` as the shared instance if there is none yet.
+    pub fn intern(&self, labels: Arc<Labels>) -> Arc<Labels> {
+        let hash = content_hash(labels.names.iter().map(ConstCString::as_str), labels.size(), &labels.values);
+        let can_replace = labels.user_data().is_null();
+
+        let mut all_labels = self.labels.lock().expect("mutex got poisoned");
+        let candidates = all_labels.entry(hash).or_default();
+        candidates.retain(|candidate| candidate.strong_count() != 0);
+
+        for candidate in candidates.iter().filter_map(Weak::upgrade) {
+            if Arc::ptr_eq(&candidate, &labels) {
+                return labels;
+            }
+
+            // labels with user data belong to whoever set it, and are not
+            // shared with anyone else
+            if can_replace && candidate.user_data().is_null() && *candidate == *labels {
+                return candidate;
+            }
+        }
+
+        candidates.push(Arc::downgrade(&labels));
+        return labels;
+    }
+
+    /// Get the shared instance of labels with the given `names` and
+    /// `values`, only calling `build` to create new labels if there is no
+    /// shared instance yet.
+    pub fn intern_with<F>(&self, names: &[&str], values: &[LabelValue], build: F) -> Result<Arc<Labels>, Error>
+        where F: FnOnce() -> Result<Labels, Error>
+    {
+        let hash = content_hash(names.iter().copied(), names.len(), values);
+
+        {
+            let mut all_labels = self.labels.lock().expect("mutex got poisoned");
+            if let Some(candidates) = all_labels.get_mut(&hash) {
+                for candidate in candidates.iter().filter_map(Weak::upgrade) {
+                    if candidate.values == values && candidate.names() == names && candidate.user_data().is_null() {
+                        return Ok(candidate);
+                    }
+                }
+            }
+        }
+
+        // build the labels without holding the lock, since this can be
+        // expensive. Another thread might build the same labels concurrently,
+        // in which case `intern` will return the first one registered.
+        let labels = Arc::new(build()?);
+        return Ok(self.intern(labels));
+    }
+}
+
+/// Compute a hash for labels with the given `names` and `values`, containing
+/// entries with `size` elements. This only looks at a few entries, to keep
+/// the cost independent of the number of entries.
+fn content_hash<'a>(names: impl Iterator<Item=&'a str>, size: usize, values: &[LabelValue]) -> u64 {
+    let mut hasher = DefaultHasher::default().build_hasher();
+    for name in names {
+        name.hash(&mut hasher);
+    }
+
+    if size != 0 {
+        let count = values.len() / size;
+        count.hash(&mut hasher);
+        if count != 0 {
+            for i in [0, count / 2, count - 1] {
+                values[(i * size)..((i + 1) * size)].hash(&mut hasher);
+            }
+        }
+    }
+
+    return hasher.finish();
+}
+
 #[cfg(test)]
 mod tests {
     use super::*;
+    use std::sync::atomic::AtomicUsize;
 
     #[test]
     fn valid_names() {
@@ -536,6 +1133,104 @@ mod tests {
         assert_eq!(e.to_string(), "invalid parameter: labels names must be unique, got 'not' multiple times");
     }
 
+    #[test]
+    fn from_values() {
+        let entry = |values: &[i32]| values.iter().copied().map(LabelValue::new).collect::<Vec<_>>();
+
+        let sorted = Labels::new(vec!["aa", "bb"], entry(&[0, 1, 0, 3, 2, -1])).unwrap();
+        assert!(sorted.is_sorted());
+        assert_eq!(sorted.count(), 3);
+        assert_eq!(sorted.position(&entry(&[0, 3])), Some(1));
+
+        let unsorted = Labels::new(vec!["aa", "bb"], entry(&[2, 3, 0, 1, 4, 5])).unwrap();
+        assert!(!unsorted.is_sorted());
+        assert_eq!(unsorted.values(), entry(&[2, 3, 0, 1, 4, 5]));
+        assert_eq!(unsorted.position(&entry(&[0, 1])), Some(1));
+        assert_eq!(unsorted.position(&entry(&[4, 5])), Some(2));
+
+        let err = Labels::new(vec!["aa"], entry(&[1, 0, 1])).unwrap_err();
+        assert_eq!(
+            err.to_string(),
+            "invalid parameter: can not have the same label value multiple time: [1] is already present at position 0"
+        );
+
+        let err = Labels::new(vec!["aa", "bb"], entry(&[1, 0, 1])).unwrap_err();
+        assert_eq!(
+            err.to_string(),
+            "invalid parameter: the number of values (3) must be a multiple of the number of names (2)"
+        );
+
+        let empty = Labels::new(vec!["aa"], Vec::new()).unwrap();
+        assert_eq!(empty.count(), 0);
+        assert!(empty.is_sorted());
+    }
+
+    #[test]
+    fn names_are_shared() {
+        let first = LabelsBuilder::new(vec!["shared", "names"]).unwrap().finish();
+        let mut builder = LabelsBuilder::new(vec!["shared", "names"]).unwrap();
+        builder.add(&[1, 2]).unwrap();
+        let second = builder.finish();
+
+        assert_eq!(first.names(), ["shared", "names"]);
+        assert_eq!(first.c_names()[0].as_c_str().as_ptr(), second.c_names()[0].as_c_str().as_ptr());
+
+        let other = LabelsBuilder::new(vec!["names", "shared"]).unwrap().finish();
+        assert_eq!(other.names(), ["names", "shared"]);
+        assert_ne!(first.c_names().as_ptr(), other.c_names().as_ptr());
+    }
+
+    #[test]
+    fn index() {
+        let entry = |values: &[i32]| values.iter().copied().map(LabelValue::new).collect::<Vec<_>>();
+
+        let mut builder = LabelsBuilder::new(vec!["aa", "bb"]).unwrap();
+        builder.add(&[0, 1]).unwrap();
+        builder.add(&[0, 3]).unwrap();
+        builder.add(&[2, -1]).unwrap();
+        let sorted = builder.finish();
+
+        assert!(sorted.is_sorted());
+        assert_eq!(sorted.position(&entry(&[0, 1])), Some(0));
+        assert_eq!(sorted.position(&entry(&[0, 3])), Some(1));
+        assert_eq!(sorted.position(&entry(&[2, -1])), Some(2));
+        assert_eq!(sorted.position(&entry(&[0, 2])), None);
+        assert_eq!(sorted.position(&entry(&[3, 0])), None);
+        assert!(sorted.contains(&entry(&[0, 3])));
+        assert!(!sorted.contains(&entry(&[1, 3])));
+
+        let mut builder = LabelsBuilder::new(vec!["aa", "bb"]).unwrap();
+        builder.add(&[2, 3]).unwrap();
+        builder.add(&[0, 1]).unwrap();
+        builder.add(&[4, 5]).unwrap();
+        let unsorted = builder.finish();
+
+        assert!(!unsorted.is_sorted());
+        assert_eq!(unsorted.position(&entry(&[2, 3])), Some(0));
+        assert_eq!(unsorted.position(&entry(&[0, 1])), Some(1));
+        assert_eq!(unsorted.position(&entry(&[4, 5])), Some(2));
+        assert_eq!(unsorted.position(&entry(&[1, 1])), None);
+
+        // duplicated entries are detected with both kinds of index
+        let mut builder = LabelsBuilder::new(vec!["aa"]).unwrap();
+        builder.add(&[0]).unwrap();
+        builder.add(&[1]).unwrap();
+        let err = builder.add(&[1]).unwrap_err();
+        assert_eq!(
+            err.to_string(),
+            "invalid parameter: can not have the same label value multiple time: [1] is already present at position 1"
+        );
+        let err = builder.add(&[0]).unwrap_err();
+        assert_eq!(
+            err.to_string(),
+            "invalid parameter: can not have the same label value multiple time: [0] is already present at position 0"
+        );
+
+        let empty = LabelsBuilder::new(vec!["aa"]).unwrap().finish();
+        assert!(empty.is_sorted());
+        assert_eq!(empty.position(&entry(&[0])), None);
+    }
+
     #[test]
     fn union() {
         let mut builder = LabelsBuilder::new(vec!["aa", "bb"]).unwrap();
@@ -586,6 +1281,102 @@ mod tests {
         assert_eq!(second_mapping, &[]);
     }
 
+    #[test]
+    fn sorted_union() {
+        let mut builder = LabelsBuilder::new(vec!["aa", "bb"]).unwrap();
+        builder.add(&[0, 1]).unwrap();
+        builder.add(&[1, 2]).unwrap();
+        builder.add(&[3, 0]).unwrap();
+        let first = builder.finish();
+        assert!(first.is_sorted());
+
+        let mut builder = LabelsBuilder::new(vec!["aa", "bb"]).unwrap();
+        builder.add(&[1, 1]).unwrap();
+        builder.add(&[1, 2]).unwrap();
+        builder.add(&[4, 5]).unwrap();
+        let second = builder.finish();
+        assert!(second.is_sorted());
+
+        let first_mapping = &mut vec![0; first.count()];
+        let second_mapping = &mut vec![0; second.count()];
+
+        // new entries are added after the entries of `first`, as in the
+        // general case
+        let union = first.union(&second, first_mapping, second_mapping).unwrap();
+        assert_eq!(union.values, &[0, 1, 1, 2, 3, 0, 1, 1, 4, 5]);
+        assert_eq!(first_mapping, &[0, 1, 2]);
+        assert_eq!(second_mapping, &[3, 1, 4]);
+        assert!(!union.is_sorted());
+        assert_eq!(union.position(&[LabelValue::new(1), LabelValue::new(1)]), Some(3));
+
+        // the result stays sorted if all new entries are after the existing ones
+        let mut builder = LabelsBuilder::new(vec!["aa", "bb"]).unwrap();
+        builder.add(&[3, 0]).unwrap();
+        builder.add(&[5, 5]).unwrap();
+        let third = builder.finish();
+
+        let third_mapping = &mut vec![0; third.count()];
+        let union = first.union(&third, &mut [], third_mapping).unwrap();
+        assert_eq!(union.values, &[0, 1, 1, 2, 3, 0, 5, 5]);
+        assert_eq!(third_mapping, &[2, 3]);
+        assert!(union.is_sorted());
+    }
+
+    #[test]
+    fn union_many() {
+        let mut builder = LabelsBuilder::new(vec!["aa"]).unwrap();
+        builder.add(&[0]).unwrap();
+        builder.add(&[1]).unwrap();
+        let first = builder.finish();
+
+        let mut builder = LabelsBuilder::new(vec!["aa"]).unwrap();
+        builder.add(&[2]).unwrap();
+        builder.add(&[1]).unwrap();
+        let second = builder.finish();
+
+        let mut builder = LabelsBuilder::new(vec!["aa"]).unwrap();
+        builder.add(&[3]).unwrap();
+        builder.add(&[0]).unwrap();
+        builder.add(&[2]).unwrap();
+        let third = builder.finish();
+
+        let first_mapping = &mut vec![0; first.count()];
+        let third_mapping = &mut vec![0; third.count()];
+        let mut mappings = [&mut first_mapping[..], &mut [], &mut third_mapping[..]];
+
+        let union = Labels::union_many(&[&first, &second, &third], &mut mappings).unwrap();
+        assert_eq!(union.values, &[0, 1, 2, 3]);
+        assert_eq!(first_mapping, &[0, 1]);
+        assert_eq!(third_mapping, &[3, 0, 2]);
+
+        // same result as repeated calls to union
+        let expected = first.union(&second, &mut [], &mut []).unwrap();
+        let expected = expected.union(&third, &mut [], &mut []).unwrap();
+        assert_eq!(union, expected);
+
+        let union = Labels::union_many(&[&second], &mut []).unwrap();
+        assert_eq!(union, second);
+
+        let err = Labels::union_many(&[], &mut []).unwrap_err();
+        assert_eq!(
+            err.to_string(),
+            "invalid parameter: can not take the union of an empty list of Labels"
+        );
+
+        let labels = LabelsBuilder::new(vec!["bb"]).unwrap().finish();
+        let err = Labels::union_many(&[&first, &labels], &mut []).unwrap_err();
+        assert_eq!(
+            err.to_string(),
+            "invalid parameter: can not take the union of these Labels, they have different names"
+        );
+
+        let err = Labels::union_many(&[&first, &second], &mut [&mut []]).unwrap_err();
+        assert_eq!(
+            err.to_string(),
+            "invalid parameter: expected 2 mappings in Labels::union_many, got 1"
+        );
+    }
+
     #[test]
     fn intersection() {
         let mut builder = LabelsBuilder::new(vec!["aa", "bb"]).unwrap();
@@ -636,15 +1427,107 @@ mod tests {
         assert_eq!(second_mapping, &[]);
     }
 
+    #[test]
+    fn sorted_intersection() {
+        let mut builder = LabelsBuilder::new(vec!["aa", "bb"]).unwrap();
+        builder.add(&[0, 1]).unwrap();
+        builder.add(&[1, 2]).unwrap();
+        builder.add(&[3, 0]).unwrap();
+        let first = builder.finish();
+
+        let mut builder = LabelsBuilder::new(vec!["aa", "bb"]).unwrap();
+        builder.add(&[1, 1]).unwrap();
+        builder.add(&[1, 2]).unwrap();
+        builder.add(&[3, 0]).unwrap();
+        builder.add(&[4, 5]).unwrap();
+        let second = builder.finish();
+
+        let first_mapping = &mut vec![0; first.count()];
+        let second_mapping = &mut vec![0; second.count()];
+
+        let intersection = first.intersection(&second, first_mapping, second_mapping).unwrap();
+        assert_eq!(intersection.values, &[1, 2, 3, 0]);
+        assert!(intersection.is_sorted());
+        assert_eq!(first_mapping, &[-1, 0, 1]);
+        assert_eq!(second_mapping, &[-1, 0, 1, -1]);
+    }
+
+    #[test]
+    fn interner() {
+        let build = |values: &[[i32; 2]]| {
+            let mut builder = LabelsBuilder::new(vec!["aa", "bb"]).unwrap();
+            for entry in values {
+                builder.add(entry).unwrap();
+            }
+            Arc::new(builder.finish())
+        };
+
+        let interner = LabelsInterner::new();
+        let first = interner.intern(build(&[[0, 1], [1, 2], [3, 3]]));
+        let second = interner.intern(build(&[[0, 1], [1, 2], [3, 3]]));
+        assert!(Arc::ptr_eq(&first, &second));
+
+        // same hash (same first, middle and last entries), different content
+        let other = build(&[[0, 1], [1, 2], [2, 0], [3, 3]]);
+        let different = interner.intern(build(&[[0, 1], [1, 3], [2, 0], [3, 3]]));
+        assert!(!Arc::ptr_eq(&interner.intern(Arc::clone(&other)), &different));
+
+        // labels with user data are never replaced
+        let with_user_data = build(&[[0, 1], [1, 2], [3, 3]]);
+        with_user_data.set_user_data(42 as *mut c_void, None);
+        let interned = interner.intern(Arc::clone(&with_user_data));
+        assert!(Arc::ptr_eq(&interned, &with_user_data));
+
+        // and never given to other labels
+        let user_data_interner = LabelsInterner::new();
+        user_data_interner.intern(Arc::clone(&with_user_data));
+        let plain = build(&[[0, 1], [1, 2], [3, 3]]);
+        let interned = user_data_interner.intern(Arc::clone(&plain));
+        assert!(Arc::ptr_eq(&interned, &plain));
+        assert!(interned.user_data().is_null());
+
+        let values = [0, 1, 1, 2, 3, 3].iter().copied().map(LabelValue::new).collect::<Vec<_>>();
+        let built = interner.intern_with(&["aa", "bb"], &values, || unreachable!()).unwrap();
+        assert!(Arc::ptr_eq(&built, &first));
+
+        // the interner does not keep the labels alive
+        std::mem::drop((first, second, built));
+        let mut called = false;
+        let new = interner.intern_with(&["aa", "bb"], &values, || {
+            called = true;
+            Ok(Arc::try_unwrap(build(&[[0, 1], [1, 2], [3, 3]])).unwrap())
+        }).unwrap();
+        assert!(called);
+        assert_eq!(new.count(), 3);
+    }
+
+    #[test]
+    fn user_data() {
+        static DELETED: AtomicUsize = AtomicUsize::new(0);
+        unsafe extern fn delete(_: *mut c_void) {
+            DELETED.fetch_add(1, Ordering::SeqCst);
+        }
+
+        let labels = Labels::new(vec!["aa"], vec![LabelValue::new(0)]).unwrap();
+        assert!(labels.user_data().is_null());
+
+        labels.set_user_data(1 as *mut c_void, Some(delete));
+        labels.set_user_data(2 as *mut c_void, Some(delete));
+        assert_eq!(labels.user_data(), 2 as *mut c_void);
+
+        // replaced user data is kept alive until the labels are dropped,
+        // since other threads could still be using it
+        assert_eq!(DELETED.load(Ordering::SeqCst), 0);
+        std::mem::drop(labels);
+        assert_eq!(DELETED.load(Ordering::SeqCst), 2);
+    }
+
     #[test]
     fn marker_traits() {
-        // ensure Arc<Labels> is Send and Sync, assuming the user data is
+        // ensure Arc<Labels> is Send and Sync
         fn use_send(_: impl Send) {}
         fn use_sync(_: impl Sync) {}
 
-        unsafe impl Sync for UserData {}
-        unsafe impl Send for UserData {}
-
         let mut builder = LabelsBuilder::new(vec!["aa", "bb"]).unwrap();
         builder.add(&[0, 1]).unwrap();
         builder.add(&[1, 2]).unwrap();
@@ -11,6 +11,8 @@
 
 mod utils;
 
+mod profiling;
+
 mod labels;
 use self::labels::{LabelsBuilder, LabelValue, Labels};
 
@@ -22,7 +24,7 @@ mod blocks;
 use self::blocks::TensorBlock;
 
 mod tensor;
-use self::tensor::TensorMap;
+use self::tensor::{TensorMap, TensorMapBuilder};
 
 #[doc(hidden)]
 mod c_api;
@@ -0,0 +1,214 @@
+//! Low-overhead instrumentation of the main entry points of equistore.
+//!
+//! When no profiling callback is registered, the cost of instrumentation is a
+//! single relaxed atomic load per instrumented function. When a callback is
+//! registered, each instrumented function (see `span`) reports its wall time
+//! and the values of the counters below accumulated during the call.
+//!
+//! The counters are global, so when multiple threads call equistore
+//! functions at the same time, the values reported for one call can include
+//! work done by other calls.
+
+use std::os::raw::c_void;
+use std::sync::atomic::{AtomicBool, AtomicU64, Ordering};
+use std::sync::RwLock;
+use std::time::Instant;
+
+use once_cell::sync::Lazy;
+
+/// Data reported for a single call to an instrumented function.
+#[repr(C)]
+#[derive(Debug, Clone, Copy)]
+#[allow(non_camel_case_types)]
+pub struct eqs_profiling_event_t {
+    /// name of the instrumented function, as a NULL-terminated string with
+    /// static lifetime
+    pub name: *const std::os::raw::c_char,
+    /// wall time spent in the function, in nanoseconds
+    pub duration_ns: u64,
+    /// number of bytes of array data moved or (de)serialized during the call
+    pub bytes_moved: u64,
+    /// number of Labels entries inserted in or looked up from a hash table
+    /// during the call
+    pub labels_entries_hashed: u64,
+    /// number of calls to functions from `eqs_array_t` during the call
+    pub array_callbacks: u64,
+}
+
+/// Callback function used to report profiling events.
+#[allow(non_camel_case_types)]
+pub type eqs_profiling_callback_t = Option<unsafe extern fn(
+    user_data: *mut c_void,
+    event: *const eqs_profiling_event_t,
+)>;
+
+#[derive(Clone, Copy)]
+struct Callback {
+    function: unsafe extern fn(*mut c_void, *const eqs_profiling_event_t),
+    user_data: *mut c_void,
+}
+
+// the user is responsible for making `user_data` usable from any thread
+unsafe impl Send for Callback {}
+unsafe impl Sync for Callback {}
+
+static ENABLED: AtomicBool = AtomicBool::new(false);
+static CALLBACK: Lazy<RwLock<Option<Callback>>> = Lazy::new(|| RwLock::new(None));
+
+static BYTES_MOVED: AtomicU64 = AtomicU64::new(0);
+static LABELS_ENTRIES_HASHED: AtomicU64 = AtomicU64::new(0);
+static ARRAY_CALLBACKS: AtomicU64 = AtomicU64::new(0);
+
+/// Set the callback used to report profiling events, or disable profiling if
+/// `callback` is `None`.
+pub fn set_callback(callback: eqs_profiling_callback_t, user_data: *mut c_void) {
+    let mut guard = CALLBACK.write().expect("poisoned lock");
+    *guard = callback.map(|function| Callback { function, user_data });
+    ENABLED.store(guard.is_some(), Ordering::Release);
+}
+
+#[inline]
+fn enabled() -> bool {
+    ENABLED.load(Ordering::Relaxed)
+}
+
+/// Record that `count` bytes of data have been moved or (de)serialized
+#[inline]
+pub fn bytes_moved(count: usize) {
+    if enabled() {
+        BYTES_MOVED.fetch_add(count as u64, Ordering::Relaxed);
+    }
+}
+
+/// Record that `count` Labels entries have been inserted in or looked up from
+/// a hash table
+#[inline]
+pub fn labels_entries_hashed(count: usize) {
+    if enabled() {
+        LABELS_ENTRIES_HASHED.fetch_add(count as u64, Ordering::Relaxed);
+    }
+}
+
+/// Record a call to one of the functions in `eqs_array_t`
+#[inline]
+pub fn array_callback() {
+    if enabled() {
+        ARRAY_CALLBACKS.fetch_add(1, Ordering::Relaxed);
+    }
+}
+
+/// Returns true if the calls to `eqs_array_t` functions should compute the
+/// number of bytes they move. This allows to skip the additional calls to
+/// `eqs_array_t.shape` when profiling is disabled.
+#[inline]
+pub fn should_count_bytes() -> bool {
+    enabled()
+}
+
+/// Guard reporting a profiling event for the function `name` when dropped
+pub struct Span {
+    name: &'static [u8],
+    start: Instant,
+    bytes_moved: u64,
+    labels_entries_hashed: u64,
+    array_callbacks: u64,
+}
+
+/// Start instrumenting the function with the given `name`, which must be a
+/// NULL-terminated byte string. The event is reported when the returned value
+/// is dropped. This returns `None` if profiling is disabled.
+#[inline]
+pub fn span(name: &'static [u8]) -> Option<Span> {
+    if !enabled() {
+        return None;
+    }
+
+    debug_assert_eq!(name.last(), Some(&0));
+    return Some(Span {
+        name,
+        start: Instant::now(),
+        bytes_moved: BYTES_MOVED.load(Ordering::Relaxed),
+        labels_entries_hashed: LABELS_ENTRIES_HASHED.load(Ordering::Relaxed),
+        array_callbacks: ARRAY_CALLBACKS.load(Ordering::Relaxed),
+    });
+}
+
+impl Drop for Span {
+    fn drop(&mut self) {
+        let duration = self.start.elapsed();
+        let event = eqs_profiling_event_t {
+            name: self.name.as_ptr().cast(),
+            duration_ns: u64::try_from(duration.as_nanos()).unwrap_or(u64::MAX),
+            bytes_moved: BYTES_MOVED.load(Ordering::Relaxed).wrapping_sub(self.bytes_moved),
+            labels_entries_hashed: LABELS_ENTRIES_HASHED.load(Ordering::Relaxed).wrapping_sub(self.labels_entries_hashed),
+            array_callbacks: ARRAY_CALLBACKS.load(Ordering::Relaxed).wrapping_sub(self.array_callbacks),
+        };
+
+        // copy the callback out of the lock before calling it, since it might
+        // call back into equistore and create new spans, or change the callback
+        let callback = *CALLBACK.read().expect("poisoned lock");
+        if let Some(callback) = callback {
+            unsafe {
+                (callback.function)(callback.user_data, &event);
+            }
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    unsafe extern fn record(user_data: *mut c_void, event: *const eqs_profiling_event_t) {
+        // other tests running concurrently can also report events, only
+        // record the ones from this test
+        let name = std::ffi::CStr::from_ptr((*event).name);
+        if name.to_bytes() == b"test" {
+            let events = user_data.cast::<Vec<eqs_profiling_event_t>>();
+            (*events).push(*event);
+        }
+    }
+
+    unsafe extern fn disable(user_data: *mut c_void, event: *const eqs_profiling_event_t) {
+        let name = std::ffi::CStr::from_ptr((*event).name);
+        if name.to_bytes() == b"reentrant" {
+            *user_data.cast::<bool>() = true;
+            set_callback(None, std::ptr::null_mut());
+        }
+    }
+
+    #[test]
+    fn events() {
+        let mut events = Vec::<eqs_profiling_event_t>::new();
+
+        assert!(span(b"disabled\0").is_none());
+
+        let user_data = (&mut events as *mut Vec<eqs_profiling_event_t>).cast();
+        set_callback(Some(record), user_data);
+        {
+            let _span = span(b"test\0");
+            bytes_moved(16);
+            labels_entries_hashed(3);
+            array_callback();
+        }
+        set_callback(None, std::ptr::null_mut());
+
+        assert!(span(b"disabled again\0").is_none());
+
+        assert_eq!(events.len(), 1);
+        let event = events[0];
+        let name = unsafe { std::ffi::CStr::from_ptr(event.name) };
+        assert_eq!(name.to_str().unwrap(), "test");
+        // other tests can run concurrently and use labels/arrays
+        assert!(event.bytes_moved >= 16);
+        assert!(event.labels_entries_hashed >= 3);
+        assert!(event.array_callbacks >= 1);
+
+        // the callback can itself change the profiling callback
+        let mut called = false;
+        set_callback(Some(disable), (&mut called as *mut bool).cast());
+        drop(span(b"reentrant\0"));
+        assert!(called);
+        assert!(span(b"disabled\0").is_none());
+    }
+}
@@ -0,0 +1,347 @@
+use std::sync::Arc;
+
+use smallvec::SmallVec;
+
+use crate::labels::{Labels, LabelsBuilder, LabelValue, duplicated_entry};
+use crate::{Error, TensorBlock, eqs_array_t, get_data_origin};
+
+use super::TensorMap;
+use super::utils::contiguous_mapping;
+
+/// Incremental construction of a `TensorMap`.
+///
+/// Blocks are added one at a time with `add_block`. Adding a block with a key
+/// already present in the builder appends the samples of the new block (and
+/// of its gradients) to the existing block. The samples and keys labels are
+/// updated incrementally, so adding new entries does not index the existing
+/// ones again.
+///
+/// The data of appended blocks is kept in the arrays given to `add_block`
+/// until `finish` is called, and then copied once in the final array for the
+/// block. Blocks added only once are used directly without any copy.
+pub struct TensorMapBuilder {
+    keys: LabelsBuilder,
+    blocks: Vec<BlockBuilder>,
+}
+
+impl TensorMapBuilder {
+    /// Create a new empty `TensorMapBuilder`, for a tensor map with keys
+    /// using the given `names`
+    pub fn new(names: Vec<&str>) -> Result<TensorMapBuilder, Error> {
+        Ok(TensorMapBuilder {
+            keys: LabelsBuilder::new(names)?,
+            blocks: Vec::new(),
+        })
+    }
+
+    /// Add a `block` associated with the given `key` to this builder.
+    ///
+    /// If there is already a block for this `key`, the samples of the new
+    /// `block` are appended to the samples of the existing block. In this
+    /// case, both blocks must have the same components, properties and set
+    /// of gradients, and none of the new samples must already be present in
+    /// the existing block. The `"sample"` dimension of the gradients samples
+    /// is updated to refer to the position of the corresponding samples after
+    /// they are appended.
+    pub fn add_block(&mut self, key: &[LabelValue], block: TensorBlock) -> Result<(), Error> {
+        if key.len() != self.keys.size() {
+            return Err(Error::InvalidParameter(format!(
+                "invalid key: expected {} values, got {}",
+                self.keys.size(), key.len()
+            )));
+        }
+
+        if let Some(position) = self.keys.position(key) {
+            let existing = &mut self.blocks[position];
+            existing.check_append(&block, None)?;
+            existing.append(block, None);
+        } else {
+            self.keys.add(key)?;
+            self.blocks.push(BlockBuilder::new(block));
+        }
+
+        return Ok(());
+    }
+
+    /// Finish building the `TensorMap`, merging the data of blocks with
+    /// appended samples in a single array.
+    pub fn finish(self) -> Result<TensorMap, Error> {
+        let keys = Arc::new(self.keys.finish());
+        let blocks = self.blocks.into_iter()
+            .map(BlockBuilder::finish)
+            .collect::<Result<Vec<_>, _>>()?;
+
+        return TensorMap::new(keys, blocks);
+    }
+}
+
+/// Samples of a block in construction. Samples are only copied to a
+/// `LabelsBuilder` when new samples are appended to the block.
+enum SamplesBuilder {
+    Fixed(Arc<Labels>),
+    Growing(LabelsBuilder),
+}
+
+/// Data and metadata of a single block in construction
+struct BlockBuilder {
+    samples: SamplesBuilder,
+    components: Vec<Arc<Labels>>,
+    properties: Arc<Labels>,
+    /// Arrays containing the values for consecutive ranges of samples
+    values: Vec<eqs_array_t>,
+    gradients: Vec<(String, BlockBuilder)>,
+}
+
+impl BlockBuilder {
+    fn new(mut block: TensorBlock) -> BlockBuilder {
+        let gradients = block.take_gradients().into_iter()
+            .map(|(parameter, gradient)| (parameter, BlockBuilder::new(gradient)))
+            .collect();
+
+        BlockBuilder {
+            samples: SamplesBuilder::Fixed(block.samples),
+            components: block.components.to_vec(),
+            properties: block.properties,
+            values: vec![block.values],
+            gradients: gradients,
+        }
+    }
+
+    /// Get the number of samples in this block
+    fn count(&self) -> usize {
+        match self.samples {
+            SamplesBuilder::Fixed(ref samples) => samples.count(),
+            SamplesBuilder::Growing(ref samples) => samples.count(),
+        }
+    }
+
+    /// Get the position of the given sample in this block
+    fn position(&self, sample: &[LabelValue]) -> Option<usize> {
+        match self.samples {
+            SamplesBuilder::Fixed(ref samples) => samples.position(sample),
+            SamplesBuilder::Growing(ref samples) => samples.position(sample),
+        }
+    }
+
+    fn sample_names(&self) -> Vec<&str> {
+        match self.samples {
+            SamplesBuilder::Fixed(ref samples) => samples.names(),
+            SamplesBuilder::Growing(ref samples) => samples.names(),
+        }
+    }
+
+    /// Check that the samples from `block` can be appended to this block.
+    /// For gradients, `sample_offset` is the number of samples in the parent
+    /// block before appending the new samples.
+    fn check_append(&self, block: &TensorBlock, sample_offset: Option<usize>) -> Result<(), Error> {
+        if block.samples.names() != self.sample_names() {
+            return Err(Error::InvalidParameter(format!(
+                "can not append samples with names [{}] to a block with samples named [{}]",
+                block.samples.names().join(", "),
+                self.sample_names().join(", "),
+            )));
+        }
+
+        if *block.components != *self.components {
+            return Err(Error::InvalidParameter(
+                "can not append samples to a block with different components".into()
+            ));
+        }
+
+        if block.properties != self.properties {
+            return Err(Error::InvalidParameter(
+                "can not append samples to a block with different properties".into()
+            ));
+        }
+
+        let origin = self.values[0].origin()?;
+        if block.values.origin()? != origin {
+            return Err(Error::InvalidParameter(format!(
+                "can not append samples with a different data origin ('{}') than the existing block ('{}')",
+                get_data_origin(block.values.origin()?),
+                get_data_origin(origin),
+            )));
+        }
+
+        if block.gradients().len() != self.gradients.len() {
+            return Err(Error::InvalidParameter(
+                "can not append samples to a block with a different set of gradients".into()
+            ));
+        }
+
+        for sample in &*block.samples {
+            let sample = shift_sample(sample, sample_offset);
+            if let Some(existing) = self.position(&sample) {
+                return Err(duplicated_entry(&sample, existing));
+            }
+        }
+
+        for (parameter, gradient) in &self.gradients {
+            let new_gradient = block.gradient(parameter).ok_or_else(|| Error::InvalidParameter(
+                "can not append samples to a block with a different set of gradients".into()
+            ))?;
+            gradient.check_append(new_gradient, Some(self.count()))?;
+        }
+
+        return Ok(());
+    }
+
+    /// Append the samples from `block` to this block. This must be called
+    /// after `check_append` succeeded with the same parameters.
+    fn append(&mut self, mut block: TensorBlock, sample_offset: Option<usize>) {
+        let count_before = self.count();
+
+        if let SamplesBuilder::Fixed(ref existing) = self.samples {
+            self.samples = SamplesBuilder::Growing(LabelsBuilder::from_labels(existing));
+        }
+
+        let samples = match self.samples {
+            SamplesBuilder::Growing(ref mut samples) => samples,
+            SamplesBuilder::Fixed(_) => unreachable!(),
+        };
+
+        samples.reserve(block.samples.count());
+        for sample in &*block.samples {
+            let sample = shift_sample(sample, sample_offset);
+            samples.add(&sample).expect("duplicated sample after check_append");
+        }
+
+        for (parameter, new_gradient) in block.take_gradients() {
+            let gradient = self.gradients.iter_mut()
+                .find(|(existing, _)| *existing == parameter)
+                .map(|(_, gradient)| gradient)
+                .expect("missing gradient after check_append");
+
+            gradient.append(new_gradient, Some(count_before));
+        }
+
+        if block.samples.count() != 0 {
+            self.values.push(block.values);
+        }
+    }
+
+    /// Create the final `TensorBlock` from this builder
+    fn finish(mut self) -> Result<TensorBlock, Error> {
+        let samples = match self.samples {
+            SamplesBuilder::Fixed(samples) => samples,
+            SamplesBuilder::Growing(samples) => Arc::new(samples.finish()),
+        };
+
+        let values = if self.values.len() == 1 {
+            self.values.pop().expect("missing values")
+        } else {
+            let first = &self.values[0];
+            let mut shape = first.shape()?.to_vec();
+            shape[0] = samples.count();
+            // all the samples are set below
+            let mut values = first.create_uninit(&shape)?;
+
+            let mut offset = 0;
+            for array in &self.values {
+                let count = array.shape()?[0];
+                values.move_samples_from(
+                    array,
+                    &contiguous_mapping(count, offset),
+                    0..self.properties.count(),
+                )?;
+                offset += count;
+            }
+
+            values
+        };
+
+        let mut block = TensorBlock::new(values, samples, self.components, self.properties)?;
+        for (parameter, gradient) in self.gradients {
+            block.add_gradient(&parameter, gradient.finish()?)?;
+        }
+
+        return Ok(block);
+    }
+}
+
+/// Shift the first dimension of `sample` (the `"sample"` dimension for
+/// gradients) by `offset`, if any.
+fn shift_sample(sample: &[LabelValue], offset: Option<usize>) -> SmallVec<[LabelValue; 4]> {
+    let mut sample = SmallVec::<[LabelValue; 4]>::from_slice(sample);
+    if let Some(offset) = offset {
+        sample[0] = LabelValue::from(sample[0].usize() + offset);
+    }
+    return sample;
+}
+
+#[cfg(test)]
+mod tests {
+    use crate::data::TestArray;
+    use crate::{LabelValue, TensorBlock};
+
+    use super::*;
+    use super::super::utils::example_labels;
+
+    fn example_block(samples: Vec<[i32; 2]>, gradient_samples: Vec<[i32; 2]>) -> TensorBlock {
+        let n_samples = samples.len();
+        let n_gradients = gradient_samples.len();
+
+        let mut block = TensorBlock::new(
+            TestArray::new(vec![n_samples, 1, 3]),
+            example_labels(vec!["structure", "center"], samples),
+            vec![example_labels(vec!["component"], vec![[0]])],
+            example_labels(vec!["properties"], vec![[0], [1], [2]]),
+        ).unwrap();
+
+        let gradient = TensorBlock::new(
+            TestArray::new(vec![n_gradients, 1, 3]),
+            example_labels(vec!["sample", "atom"], gradient_samples),
+            vec![example_labels(vec!["component"], vec![[0]])],
+            example_labels(vec!["properties"], vec![[0], [1], [2]]),
+        ).unwrap();
+        block.add_gradient("positions", gradient).unwrap();
+
+        return block;
+    }
+
+    #[test]
+    fn append_samples() {
+        let mut builder = TensorMapBuilder::new(vec!["key"]).unwrap();
+
+        let key = |value: i32| [LabelValue::new(value)];
+        builder.add_block(&key(0), example_block(vec![[0, 0], [0, 1]], vec![[0, 0], [1, 1]])).unwrap();
+        builder.add_block(&key(1), example_block(vec![[0, 2]], vec![[0, 0]])).unwrap();
+        builder.add_block(&key(0), example_block(vec![[1, 0]], vec![[0, 0], [0, 1]])).unwrap();
+
+        let err = builder.add_block(&key(0), example_block(vec![[1, 0]], vec![])).unwrap_err();
+        assert_eq!(
+            err.to_string(),
+            "invalid parameter: can not have the same label value multiple time: [1, 0] is already present at position 2"
+        );
+
+        let err = builder.add_block(&[], example_block(vec![[1, 0]], vec![])).unwrap_err();
+        assert_eq!(err.to_string(), "invalid parameter: invalid key: expected 1 values, got 0");
+
+        let block = TensorBlock::new(
+            TestArray::new(vec![1, 3]),
+            example_labels(vec!["structure", "center"], vec![[2, 0]]),
+            vec![],
+            example_labels(vec!["properties"], vec![[0], [1], [2]]),
+        ).unwrap();
+        let err = builder.add_block(&key(1), block).unwrap_err();
+        assert_eq!(err.to_string(), "invalid parameter: can not append samples to a block with different components");
+
+        let tensor = builder.finish().unwrap();
+        assert_eq!(**tensor.keys(), *example_labels(vec!["key"], vec![[0], [1]]));
+
+        let block = &tensor.blocks()[0];
+        assert_eq!(*block.samples, *example_labels(vec!["structure", "center"], vec![[0, 0], [0, 1], [1, 0]]));
+        assert_eq!(block.values.shape().unwrap(), [3, 1, 3]);
+
+        // the "sample" dimension of gradients is shifted
+        let gradient = block.gradient("positions").unwrap();
+        assert_eq!(*gradient.samples, *example_labels(vec!["sample", "atom"], vec![
+            [0, 0], [1, 1], [2, 0], [2, 1],
+        ]));
+        assert_eq!(gradient.values.shape().unwrap(), [4, 1, 3]);
+
+        let block = &tensor.blocks()[1];
+        assert_eq!(*block.samples, *example_labels(vec!["structure", "center"], vec![[0, 2]]));
+        assert_eq!(block.values.shape().unwrap(), [1, 1, 3]);
+    }
+}
@@ -0,0 +1,321 @@
+use std::sync::Arc;
+
+use smallvec::SmallVec;
+
+use crate::labels::{Labels, LabelsBuilder, LabelValue};
+use crate::utils::{run_with_threads, try_map};
+use crate::{Error, TensorBlock};
+
+use super::TensorMap;
+use super::utils::{BlockToMerge, GradientSamples, contiguous_mapping, merge_gradients};
+
+impl TensorMap {
+    /// Concatenate the blocks of all the `tensors` along the samples axis.
+    ///
+    /// The keys of the result are the union of the keys of all `tensors`, and
+    /// each block of the result contains the samples of all the blocks with
+    /// the corresponding key, in the order of `tensors`. A new `"tensor"`
+    /// dimension is added to the samples, containing the index of the input
+    /// tensor map each sample comes from.
+    ///
+    /// This is equivalent to adding a `"tensor"` dimension to the keys of all
+    /// the inputs and then calling `keys_to_samples("tensor")` without sorting
+    /// the samples, but the output samples are computed directly, and each
+    /// input block is copied to the output with a single call to
+    /// `eqs_array_t.move_samples_from`.
+    ///
+    /// Blocks with the same key must have the same samples names, components,
+    /// properties, and set of gradients (including gradients of gradients).
+    ///
+    /// `threads` controls the number of threads used to join the blocks. If
+    /// it is 1, everything runs on the current thread; if it is 0 one thread
+    /// per CPU core is used. When running with multiple threads, independent
+    /// output blocks are created concurrently, and the data of the different
+    /// input blocks is moved concurrently inside each output block.
+    pub fn join_samples(tensors: &[&TensorMap], threads: usize) -> Result<TensorMap, Error> {
+        if tensors.is_empty() {
+            return Err(Error::InvalidParameter(
+                "can not join an empty list of TensorMap".into()
+            ));
+        }
+
+        let all_keys = tensors.iter().map(|tensor| &*tensor.keys).collect::<Vec<_>>();
+        let keys_names = all_keys[0].names();
+        for keys in &all_keys {
+            if keys.names() != keys_names {
+                return Err(Error::InvalidParameter(format!(
+                    "all tensors must have the same keys names in join_samples, got [{}] and [{}]",
+                    keys_names.join(", "),
+                    keys.names().join(", "),
+                )));
+            }
+        }
+
+        let mut keys_mappings = all_keys.iter()
+            .map(|keys| vec![0; keys.count()])
+            .collect::<Vec<_>>();
+        let new_keys = {
+            let mut mappings = keys_mappings.iter_mut()
+                .map(|mapping| &mut mapping[..])
+                .collect::<Vec<_>>();
+            Labels::union_many(&all_keys, &mut mappings)?
+        };
+
+        // for each of the new keys, list all the blocks to join together,
+        // together with the index of the tensor they come from
+        let mut blocks_to_join = vec![Vec::new(); new_keys.count()];
+        for (tensor_i, (tensor, mapping)) in tensors.iter().zip(&keys_mappings).enumerate() {
+            for (block, &new_key_i) in tensor.blocks.iter().zip(mapping) {
+                blocks_to_join[new_key_i as usize].push((tensor_i, block));
+            }
+        }
+
+        let new_blocks = run_with_threads(threads, |parallel| {
+            try_map(&blocks_to_join, parallel, |blocks| {
+                join_blocks_along_samples(blocks, parallel)
+            })
+        })?;
+
+        return TensorMap::new(Arc::new(new_keys), new_blocks);
+    }
+}
+
+/// Concatenate the given `blocks` along the samples axis. Each block comes
+/// with the index of the tensor map it belongs to, which is added to the
+/// samples of the result.
+///
+/// If `parallel` is true, the data of the different blocks is moved
+/// concurrently, using the current rayon thread pool.
+#[allow(clippy::too_many_lines)]
+fn join_blocks_along_samples(
+    blocks: &[(usize, &TensorBlock)],
+    parallel: bool,
+) -> Result<TensorBlock, Error> {
+    assert!(!blocks.is_empty());
+
+    let first_block = blocks[0].1;
+    let samples_names = first_block.samples.names();
+    for &(_, block) in blocks {
+        if block.samples.names() != samples_names {
+            return Err(Error::InvalidParameter(format!(
+                "can not join blocks along samples if they have different \
+                samples names, got [{}] and [{}]",
+                samples_names.join(", "),
+                block.samples.names().join(", "),
+            )));
+        }
+
+        if block.components != first_block.components {
+            return Err(Error::InvalidParameter(
+                "can not join blocks along samples if they have different \
+                components labels".into()
+            ));
+        }
+
+        if block.properties != first_block.properties {
+            return Err(Error::InvalidParameter(
+                "can not join blocks along samples if they have different \
+                properties labels".into()
+            ));
+        }
+
+        if block.gradients().len() != first_block.gradients().len() {
+            return Err(Error::InvalidParameter(
+                "can not join blocks along samples if they have different gradients".into()
+            ));
+        }
+
+        for (parameter, first_gradient) in first_block.gradients() {
+            match block.gradient(parameter) {
+                Some(gradient) => {
+                    if gradient.components != first_gradient.components {
+                        return Err(Error::InvalidParameter(format!(
+                            "can not join blocks along samples if the gradients \
+                            with respect to '{}' have different components labels",
+                            parameter
+                        )));
+                    }
+                }
+                None => {
+                    return Err(Error::InvalidParameter(
+                        "can not join blocks along samples if they have different gradients".into()
+                    ));
+                }
+            }
+        }
+    }
+
+    // the samples of the different blocks are disjoint since they come from
+    // different tensors, so the new samples are a concatenation of the
+    // existing ones, and each block ends up in a contiguous range.
+    let mut new_samples_names = samples_names.clone();
+    new_samples_names.push("tensor");
+    let mut new_samples = LabelsBuilder::new(new_samples_names)?;
+    new_samples.reserve(blocks.iter().map(|(_, block)| block.samples.count()).sum());
+
+    let mut samples_offsets = Vec::with_capacity(blocks.len());
+    for &(tensor_i, block) in blocks {
+        samples_offsets.push(new_samples.count());
+        for sample in block.samples.iter() {
+            let mut new_sample = sample.iter().copied().collect::<SmallVec<[LabelValue; 4]>>();
+            new_sample.push(LabelValue::from(tensor_i));
+            new_samples.add(&new_sample)?;
+        }
+    }
+    let new_samples = Arc::new(new_samples.finish());
+
+    let property_range = 0..first_block.properties.count();
+
+    let mut new_shape = first_block.values.shape()?.to_vec();
+    new_shape[0] = new_samples.count();
+    // all the samples in the new array are set below, so there is no need to
+    // initialize it
+    let new_values = first_block.values.create_uninit(&new_shape)?;
+
+    let blocks_data = blocks.iter()
+        .zip(&samples_offsets)
+        .map(|(&(_, block), &offset)| BlockToMerge {
+            block: block,
+            samples_mapping: contiguous_mapping(block.samples.count(), offset),
+            property_range: Some(property_range.clone()),
+        })
+        .collect::<Vec<_>>();
+
+    // the blocks are written to disjoint samples, so this can happen
+    // concurrently if the output array supports it.
+    let parallel_moves = parallel && new_values.supports_concurrent_move_samples();
+    try_map(&blocks_data, parallel_moves, |input| {
+        let mut output = new_values.raw_copy();
+        return output.move_samples_from(
+            &input.block.values,
+            &input.samples_mapping,
+            property_range.clone(),
+        );
+    })?;
+
+    let mut new_block = TensorBlock::new(
+        new_values,
+        new_samples,
+        first_block.components.to_vec(),
+        Arc::clone(&first_block.properties),
+    ).expect("invalid block");
+
+    // the gradients of different blocks are also disjoint, and are
+    // concatenated in the same order as the blocks. All the gradient samples
+    // are set, so the arrays don't need to be initialized.
+    merge_gradients(&mut new_block, &blocks_data, GradientSamples::Concatenated, true, parallel)?;
+
+    return Ok(new_block);
+}
+
+#[cfg(test)]
+mod tests {
+    use crate::data::TestArray;
+    use crate::{LabelValue, TensorBlock};
+
+    use super::*;
+    use super::super::utils::example_labels;
+
+    fn example_tensor(keys: Vec<[i32; 1]>, first_sample: i32) -> TensorMap {
+        example_tensor_with_hessian(keys, first_sample, false)
+    }
+
+    /// Same as `example_tensor`, optionally adding a gradient with respect to
+    /// `cell` to the gradients with respect to `positions`
+    fn example_tensor_with_hessian(keys: Vec<[i32; 1]>, first_sample: i32, hessian: bool) -> TensorMap {
+        let mut blocks = Vec::new();
+        for _ in &keys {
+            let mut block = TensorBlock::new(
+                TestArray::new(vec![2, 1, 3]),
+                example_labels(vec!["structure", "center"], vec![[first_sample, 0], [first_sample, 1]]),
+                vec![example_labels(vec!["component"], vec![[0]])],
+                example_labels(vec!["properties"], vec![[0], [1], [2]]),
+            ).unwrap();
+
+            let mut gradient = TensorBlock::new(
+                TestArray::new(vec![2, 1, 3]),
+                example_labels(vec!["sample", "atom"], vec![[0, 0], [1, 1]]),
+                vec![example_labels(vec!["component"], vec![[0]])],
+                example_labels(vec!["properties"], vec![[0], [1], [2]]),
+            ).unwrap();
+
+            if hessian {
+                let hessian = TensorBlock::new(
+                    TestArray::new(vec![3, 1, 3]),
+                    example_labels(vec!["sample", "cell"], vec![[0, 0], [1, 0], [1, 1]]),
+                    vec![example_labels(vec!["component"], vec![[0]])],
+                    example_labels(vec!["properties"], vec![[0], [1], [2]]),
+                ).unwrap();
+                gradient.add_gradient("cell", hessian).unwrap();
+            }
+
+            block.add_gradient("positions", gradient).unwrap();
+
+            blocks.push(block);
+        }
+
+        let keys = example_labels(vec!["key"], keys);
+        return TensorMap::new(keys, blocks).unwrap();
+    }
+
+    #[test]
+    fn join_samples() {
+        let first = example_tensor(vec![[0], [1]], 0);
+        let second = example_tensor(vec![[1], [2]], 1);
+
+        let joined = TensorMap::join_samples(&[&first, &second], 1).unwrap();
+        assert_eq!(*joined.keys, *example_labels(vec!["key"], vec![[0], [1], [2]]));
+
+        let block = &joined.blocks()[0];
+        assert_eq!(block.samples.names(), ["structure", "center", "tensor"]);
+        assert_eq!(*block.samples, *example_labels(vec!["structure", "center", "tensor"], vec![[0, 0, 0], [0, 1, 0]]));
+
+        let block = &joined.blocks()[1];
+        assert_eq!(*block.samples, *example_labels(vec!["structure", "center", "tensor"], vec![
+            [0, 0, 0], [0, 1, 0], [1, 0, 1], [1, 1, 1],
+        ]));
+        assert_eq!(block.values.shape().unwrap(), [4, 1, 3]);
+
+        let gradient = block.gradient("positions").unwrap();
+        assert_eq!(*gradient.samples, *example_labels(vec!["sample", "atom"], vec![
+            [0, 0], [1, 1], [2, 0], [3, 1],
+        ]));
+        assert_eq!(gradient.values.shape().unwrap(), [4, 1, 3]);
+
+        let block = &joined.blocks()[2];
+        assert_eq!(block.samples[0], [LabelValue::new(1), LabelValue::new(0), LabelValue::new(1)]);
+
+        let result = TensorMap::join_samples(&[], 1);
+        assert_eq!(
+            result.unwrap_err().to_string(),
+            "invalid parameter: can not join an empty list of TensorMap"
+        );
+    }
+
+    #[test]
+    fn gradient_of_gradients() {
+        let first = example_tensor_with_hessian(vec![[0], [1]], 0, true);
+        let second = example_tensor_with_hessian(vec![[1], [2]], 1, true);
+
+        let joined = TensorMap::join_samples(&[&first, &second], 1).unwrap();
+
+        let block = &joined.blocks()[1];
+        let gradient = block.gradient("positions").unwrap();
+        assert_eq!(gradient.gradient_parameters_c().len(), 1);
+
+        let hessian = gradient.gradient("cell").unwrap();
+        assert_eq!(*hessian.samples, *example_labels(vec!["sample", "cell"], vec![
+            [0, 0], [1, 0], [1, 1], [2, 0], [3, 0], [3, 1],
+        ]));
+        assert_eq!(hessian.values.shape().unwrap(), [6, 1, 3]);
+        assert_eq!(hessian.properties, block.properties);
+
+        // blocks with and without gradients of gradients can not be joined
+        let other = example_tensor(vec![[1]], 1);
+        let result = TensorMap::join_samples(&[&first, &other], 1);
+        assert_eq!(
+            result.unwrap_err().to_string(),
+            "invalid parameter: can not merge blocks with different gradients"
+        );
+    }
+}
@@ -0,0 +1,140 @@
+use std::collections::HashMap;
+
+use once_cell::sync::OnceCell;
+
+use crate::{Labels, LabelValue, Error};
+
+/// Secondary index on the keys of a `TensorMap`, used to find the blocks
+/// matching a selection on a subset of the keys dimensions without scanning
+/// all keys.
+///
+/// The index is built the first time it is needed, and then kept alive
+/// together with the keys.
+#[derive(Debug, Default)]
+pub(crate) struct KeysIndex {
+    /// For each dimension of the keys, map from the values taken by this
+    /// dimension to the (sorted) list of blocks with this value.
+    dimensions: OnceCell<Vec<HashMap<LabelValue, Vec<usize>>>>,
+}
+
+impl KeysIndex {
+    pub fn new() -> KeysIndex {
+        KeysIndex::default()
+    }
+
+    fn dimensions(&self, keys: &Labels) -> &[HashMap<LabelValue, Vec<usize>>] {
+        self.dimensions.get_or_init(|| {
+            crate::profiling::labels_entries_hashed(keys.count() * keys.size());
+
+            let mut dimensions = vec![HashMap::<LabelValue, Vec<usize>>::new(); keys.size()];
+            for (block_i, entry) in keys.iter().enumerate() {
+                for (dimension, &value) in dimensions.iter_mut().zip(entry) {
+                    dimension.entry(value).or_default().push(block_i);
+                }
+            }
+
+            return dimensions;
+        })
+    }
+
+    /// Get the list of block indexes in a tensor with the given `keys`
+    /// matching the `selection`. The selection should contain a single entry
+    /// defining the requested key or keys, or no dimensions at all to select
+    /// all blocks.
+    pub fn blocks_matching(&self, keys: &Labels, selection: &Labels) -> Result<Vec<usize>, Error> {
+        if selection.size() == 0 {
+            return Ok((0..keys.count()).collect());
+        }
+
+        if selection.count() != 1 {
+            return Err(Error::InvalidParameter(format!(
+                "block selection must contain exactly one entry, got {}",
+                selection.count()
+            )));
+        }
+
+        return self.blocks_matching_values(keys, &selection.names(), &selection[0]);
+    }
+
+    /// Get the list of block indexes in a tensor with the given `keys` where
+    /// the dimensions in `names` take the corresponding `values`.
+    pub fn blocks_matching_values(
+        &self,
+        keys: &Labels,
+        names: &[&str],
+        values: &[LabelValue],
+    ) -> Result<Vec<usize>, Error> {
+        if names.len() != values.len() {
+            return Err(Error::InvalidParameter(format!(
+                "expected the same number of names and values in block selection, got {} names and {} values",
+                names.len(), values.len()
+            )));
+        }
+
+        if names.is_empty() {
+            return Ok((0..keys.count()).collect());
+        }
+
+        let keys_names = keys.names();
+        let mut dimensions = Vec::with_capacity(names.len());
+        for (i, &requested) in names.iter().enumerate() {
+            if names[..i].contains(&requested) {
+                return Err(Error::InvalidParameter(format!(
+                    "'{}' is present multiple times in the block selection",
+                    requested
+                )));
+            }
+
+            match keys_names.iter().position(|&name| name == requested) {
+                Some(position) => dimensions.push(position),
+                None => {
+                    return Err(Error::InvalidParameter(format!(
+                        "'{}' is not part of the keys for this tensor",
+                        requested
+                    )));
+                }
+            }
+        }
+
+        if dimensions.len() == keys.size() {
+            // the selection contains all dimensions, use the main Labels
+            // index to find the (single) matching block
+            let mut entry = vec![LabelValue::new(0); keys.size()];
+            for (&dimension, &value) in dimensions.iter().zip(values) {
+                entry[dimension] = value;
+            }
+
+            return Ok(keys.position(&entry).into_iter().collect());
+        }
+
+        let index = self.dimensions(keys);
+
+        // start from the dimension with the fewest candidates, and check the
+        // other dimensions of these candidates one by one
+        let mut candidates: &[usize] = &[];
+        let mut candidates_dimension = 0;
+        for (i, (&dimension, value)) in dimensions.iter().zip(values).enumerate() {
+            match index[dimension].get(value) {
+                Some(blocks) => {
+                    if i == 0 || blocks.len() < candidates.len() {
+                        candidates = blocks;
+                        candidates_dimension = i;
+                    }
+                }
+                None => return Ok(Vec::new()),
+            }
+        }
+
+        let matching = candidates.iter()
+            .copied()
+            .filter(|&block_i| {
+                let entry = &keys[block_i];
+                dimensions.iter().zip(values).enumerate().all(|(i, (&dimension, &value))| {
+                    i == candidates_dimension || entry[dimension] == value
+                })
+            })
+            .collect();
+
+        return Ok(matching);
+    }
+}
@@ -3,12 +3,12 @@ use std::sync::Arc;
 use indexmap::IndexSet;
 
 use crate::labels::{Labels, LabelsBuilder};
+use crate::utils::{run_with_threads, try_map};
 use crate::{Error, TensorBlock};
 
-use crate::data::eqs_sample_mapping_t;
-
 use super::TensorMap;
-use super::utils::{KeyAndBlock, remove_dimensions_from_keys, merge_samples, merge_gradient_samples};
+use super::utils::{KeyAndBlock, remove_dimensions_from_keys, merge_samples};
+use super::utils::{BlockToMerge, GradientSamples, merge_gradients};
 
 
 impl TensorMap {
@@ -38,7 +38,13 @@ impl TensorMap {
     /// `sort_samples` is true, samples are re-ordered to keep them
     /// lexicographically sorted. Otherwise they are kept in the order in which
     /// they appear in the blocks.
-    pub fn keys_to_properties(&self, keys_to_move: &Labels, sort_samples: bool) -> Result<TensorMap, Error> {
+    ///
+    /// `threads` controls the number of threads used to merge the blocks. If
+    /// it is 1, everything runs on the current thread; if it is 0 one thread
+    /// per CPU core is used. When running with multiple threads, independent
+    /// output blocks are merged concurrently, and the data of the different
+    /// input blocks is moved concurrently inside each output block.
+    pub fn keys_to_properties(&self, keys_to_move: &Labels, sort_samples: bool, threads: usize) -> Result<TensorMap, Error> {
         if self.keys.is_empty() {
             return Err(Error::InvalidParameter(
                 "there are no keys to move in an empty TensorMap".into()
@@ -54,33 +60,36 @@ impl TensorMap {
             Some(keys_to_move)
         };
 
-        let mut new_blocks = Vec::new();
-        if splitted_keys.new_keys.count() == 1 {
-            // create a single block with everything
-            let blocks_to_merge = self.keys.iter()
-                .zip(&self.blocks)
-                .map(|(key, block)| {
-                    let mut moved_key = Vec::new();
-                    for &i in &splitted_keys.dimensions_positions {
-                        moved_key.push(key[i]);
-                    }
-
-                    KeyAndBlock {
-                        key: moved_key,
-                        block
-                    }
-                })
-                .collect::<Vec<_>>();
-
-            let block = merge_blocks_along_properties(
-                &blocks_to_merge,
-                keys_to_move,
-                &names_to_move,
-                sort_samples,
-            )?;
-            new_blocks.push(block);
-        } else {
-            for entry in splitted_keys.new_keys.iter() {
+        let new_blocks = run_with_threads(threads, |parallel| {
+            if splitted_keys.new_keys.count() == 1 {
+                // create a single block with everything
+                let blocks_to_merge = self.keys.iter()
+                    .zip(&self.blocks)
+                    .map(|(key, block)| {
+                        let mut moved_key = Vec::new();
+                        for &i in &splitted_keys.dimensions_positions {
+                            moved_key.push(key[i]);
+                        }
+
+                        KeyAndBlock {
+                            key: moved_key,
+                            block
+                        }
+                    })
+                    .collect::<Vec<_>>();
+
+                let block = merge_blocks_along_properties(
+                    &blocks_to_merge,
+                    keys_to_move,
+                    &names_to_move,
+                    sort_samples,
+                    parallel,
+                )?;
+                return Ok(vec![block]);
+            }
+
+            let new_keys = splitted_keys.new_keys.iter().collect::<Vec<_>>();
+            return try_map(&new_keys, parallel, |&entry| {
                 let mut selection = LabelsBuilder::new(splitted_keys.new_keys.names())?;
                 selection.add(entry)?;
 
@@ -101,39 +110,35 @@ impl TensorMap {
                     })
                     .collect::<Vec<_>>();
 
-                let block = merge_blocks_along_properties(
+                return merge_blocks_along_properties(
                     &blocks_to_merge,
                     keys_to_move,
                     &names_to_move,
                     sort_samples,
-                )?;
-                new_blocks.push(block);
-            }
-        }
+                    parallel,
+                );
+            });
+        })?;
 
         return TensorMap::new(Arc::new(splitted_keys.new_keys), new_blocks);
     }
 }
 
 /// Merge the given `blocks` along the property axis.
+///
+/// If `parallel` is true, the data of the different blocks is moved
+/// concurrently, using the current rayon thread pool.
 #[allow(clippy::too_many_lines)]
 fn merge_blocks_along_properties(
     blocks_to_merge: &[KeyAndBlock],
     keys_to_move: Option<&Labels>,
     extracted_names: &[&str],
     sort_samples: bool,
+    parallel: bool,
 ) -> Result<TensorBlock, Error> {
     assert!(!blocks_to_merge.is_empty());
 
     let first_block = blocks_to_merge[0].block;
-    for gradient in first_block.gradients().values() {
-        if !gradient.gradients().is_empty() {
-            return Err(Error::InvalidParameter(
-                "gradient of gradients are not supported yet in keys_to_properties".into()
-            ));
-        }
-    }
-
     let first_components_label = &first_block.components;
     let first_property_labels = &first_block.properties;
     for KeyAndBlock{block, ..} in blocks_to_merge {
@@ -205,7 +210,7 @@ fn merge_blocks_along_properties(
     new_shape[0] = merged_samples.count();
     let property_axis = new_shape.len() - 1;
     new_shape[property_axis] = new_properties_count;
-    let mut new_data = first_block.values.create(&new_shape)?;
+    let new_data = first_block.values.create(&new_shape)?;
 
     // compute the property range for each block, i.e. where we want to put
     // the corresponding data
@@ -237,16 +242,26 @@ fn merge_blocks_along_properties(
 
     debug_assert_eq!(blocks_to_merge.len(), samples_mappings.len());
     debug_assert_eq!(blocks_to_merge.len(), property_ranges.len());
-    // for each block, gather the data to be moved & send it in one go
-    for ((KeyAndBlock{block, ..}, samples_mapping), property_range) in blocks_to_merge.iter().zip(&samples_mappings).zip(&property_ranges) {
-        if let Some(property_range) = property_range {
-            new_data.move_samples_from(
-                &block.values,
-                samples_mapping,
-                property_range.clone()
-            )?;
-        }
-    }
+    let blocks_data = blocks_to_merge.iter()
+        .zip(&samples_mappings)
+        .zip(&property_ranges)
+        .filter_map(|((KeyAndBlock{block, ..}, samples_mapping), property_range)| {
+            property_range.as_ref().map(|range| (*block, samples_mapping, range.clone()))
+        })
+        .collect::<Vec<_>>();
+
+    // for each block, gather the data to be moved & send it in one go. The
+    // blocks are written to disjoint property ranges, so this can happen
+    // concurrently if the output array supports it.
+    let parallel_moves = parallel && new_data.supports_concurrent_move_samples();
+    try_map(&blocks_data, parallel_moves, |(block, samples_mapping, property_range)| {
+        let mut output = new_data.raw_copy();
+        return output.move_samples_from(
+            &block.values,
+            samples_mapping,
+            property_range.clone()
+        );
+    })?;
 
     let mut new_block = TensorBlock::new(
         new_data,
@@ -255,61 +270,87 @@ fn merge_blocks_along_properties(
         new_properties
     ).expect("constructed an invalid block");
 
-    // now collect & merge the different gradients
-    for (parameter, first_gradient) in first_block.gradients() {
-        let new_gradient_samples = merge_gradient_samples(
-            blocks_to_merge, parameter, &samples_mappings
-        )?;
-
-        let mut new_shape = first_gradient.values.shape()?.to_vec();
-        new_shape[0] = new_gradient_samples.count();
-        let property_axis = new_shape.len() - 1;
-        new_shape[property_axis] = new_properties_count;
-
-        let mut new_gradient = first_block.values.create(&new_shape)?;
-        let new_components = first_gradient.components.to_vec();
+    // now collect & merge the different gradients (and gradients of
+    // gradients), moving the data for all of them at once
+    let blocks = blocks_to_merge.iter()
+        .zip(samples_mappings)
+        .zip(property_ranges)
+        .map(|((KeyAndBlock{block, ..}, samples_mapping), property_range)| BlockToMerge {
+            block: block,
+            samples_mapping: samples_mapping,
+            property_range: property_range,
+        })
+        .collect::<Vec<_>>();
 
-        for ((KeyAndBlock{block, ..}, samples_mapping), property_range) in blocks_to_merge.iter().zip(&samples_mappings).zip(&property_ranges) {
-            if property_range.is_none() {
-                continue;
-            }
-            let property_range = property_range.as_ref().unwrap();
-
-            let gradient = block.gradient(parameter).expect("missing gradient");
-            debug_assert!(*gradient.components == *new_components);
-
-            let mut samples_to_move = Vec::new();
-            for (sample_i, grad_sample) in gradient.samples.iter().enumerate() {
-                // translate from the old sample id in gradients to the new ones
-                let mut grad_sample = grad_sample.to_vec();
-                let old_sample_i = grad_sample[0].usize();
-
-                let mapping = &samples_mapping[old_sample_i];
-                debug_assert_eq!(mapping.input, old_sample_i);
-                grad_sample[0] = mapping.output.into();
-
-                let new_sample_i = new_gradient_samples.position(&grad_sample).expect("missing entry in merged samples");
-                samples_to_move.push(eqs_sample_mapping_t {
-                    input: sample_i,
-                    output: new_sample_i,
-                });
-            }
-            new_gradient.move_samples_from(
-                &gradient.values,
-                &samples_to_move,
-                property_range.clone(),
-            )?;
-        }
+    merge_gradients(&mut new_block, &blocks, GradientSamples::SortedUnion, false, parallel)?;
 
-        let new_gradient = TensorBlock::new(
-            new_gradient,
-            new_gradient_samples,
-            new_components,
-            new_block.properties.clone()
-        ).expect("created invalid gradient");
+    return Ok(new_block);
+}
 
-        new_block.add_gradient(parameter, new_gradient).expect("could not add gradient");
+#[cfg(test)]
+mod tests {
+    use crate::data::TestArray;
+    use crate::TensorBlock;
+
+    use super::*;
+    use super::super::utils::example_labels;
+
+    fn example_block(gradient_samples: Vec<[i32; 2]>) -> TensorBlock {
+        let mut block = TensorBlock::new(
+            TestArray::new(vec![2, 1, 3]),
+            example_labels(vec!["structure"], vec![[0], [1]]),
+            vec![example_labels(vec!["component"], vec![[0]])],
+            example_labels(vec!["properties"], vec![[0], [1], [2]]),
+        ).unwrap();
+
+        let mut gradient = TensorBlock::new(
+            TestArray::new(vec![gradient_samples.len(), 1, 3]),
+            example_labels(vec!["sample", "atom"], gradient_samples),
+            vec![example_labels(vec!["component"], vec![[0]])],
+            example_labels(vec!["properties"], vec![[0], [1], [2]]),
+        ).unwrap();
+
+        let hessian = TensorBlock::new(
+            TestArray::new(vec![2, 1, 3]),
+            example_labels(vec!["sample", "cell"], vec![[0, 0], [1, 0]]),
+            vec![example_labels(vec!["component"], vec![[0]])],
+            example_labels(vec!["properties"], vec![[0], [1], [2]]),
+        ).unwrap();
+        gradient.add_gradient("cell", hessian).unwrap();
+
+        block.add_gradient("positions", gradient).unwrap();
+        return block;
     }
 
-    return Ok(new_block);
+    #[test]
+    fn gradient_of_gradients() {
+        let keys = example_labels(vec!["key"], vec![[0], [1]]);
+        let blocks = vec![
+            example_block(vec![[0, 0], [1, 1]]),
+            example_block(vec![[0, 0], [1, 2]]),
+        ];
+        let tensor = TensorMap::new(keys, blocks).unwrap();
+
+        let keys_to_move = Labels::new(vec!["key"], Vec::new()).unwrap();
+        let merged = tensor.keys_to_properties(&keys_to_move, true, 1).unwrap();
+        assert_eq!(merged.blocks().len(), 1);
+
+        let block = &merged.blocks()[0];
+        assert_eq!(block.values.shape().unwrap(), [2, 1, 6]);
+
+        let gradient = block.gradient("positions").unwrap();
+        assert_eq!(*gradient.samples, *example_labels(vec!["sample", "atom"], vec![
+            [0, 0], [1, 1], [1, 2],
+        ]));
+        assert_eq!(gradient.values.shape().unwrap(), [3, 1, 6]);
+
+        // the gradient samples of the second block are [0, 0] and [1, 2],
+        // i.e. 0 and 2 in the merged gradient samples
+        let hessian = gradient.gradient("cell").unwrap();
+        assert_eq!(*hessian.samples, *example_labels(vec!["sample", "cell"], vec![
+            [0, 0], [1, 0], [2, 0],
+        ]));
+        assert_eq!(hessian.values.shape().unwrap(), [3, 1, 6]);
+        assert_eq!(hessian.properties, block.properties);
+    }
 }
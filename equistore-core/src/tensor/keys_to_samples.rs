@@ -1,12 +1,12 @@
 use std::sync::Arc;
 
 use crate::labels::{Labels, LabelsBuilder};
+use crate::utils::{run_with_threads, try_map};
 use crate::{Error, TensorBlock};
 
-use crate::data::eqs_sample_mapping_t;
-
 use super::TensorMap;
-use super::utils::{KeyAndBlock, remove_dimensions_from_keys, merge_samples, merge_gradient_samples};
+use super::utils::{KeyAndBlock, remove_dimensions_from_keys, merge_samples};
+use super::utils::{BlockToMerge, GradientSamples, merge_gradients};
 
 impl TensorMap {
     /// Merge blocks with the same value for selected keys dimensions along the
@@ -28,7 +28,13 @@ impl TensorMap {
     ///
     /// This function is only implemented if all merged block have the same
     /// property labels.
-    pub fn keys_to_samples(&self, keys_to_move: &Labels, sort_samples: bool) -> Result<TensorMap, Error> {
+    ///
+    /// `threads` controls the number of threads used to merge the blocks. If
+    /// it is 1, everything runs on the current thread; if it is 0 one thread
+    /// per CPU core is used. When running with multiple threads, independent
+    /// output blocks are merged concurrently, and the data of the different
+    /// input blocks is moved concurrently inside each output block.
+    pub fn keys_to_samples(&self, keys_to_move: &Labels, sort_samples: bool, threads: usize) -> Result<TensorMap, Error> {
         if self.keys.is_empty() {
             return Err(Error::InvalidParameter(
                 "there are no keys to move in an empty TensorMap".into()
@@ -45,32 +51,35 @@ impl TensorMap {
         let names_to_move = keys_to_move.names();
         let splitted_keys = remove_dimensions_from_keys(&self.keys, &names_to_move)?;
 
-        let mut new_blocks = Vec::new();
-        if splitted_keys.new_keys.count() == 1 {
-            // create a single block with everything
-            let blocks_to_merge = self.keys.iter()
-                .zip(&self.blocks)
-                .map(|(key, block)| {
-                    let mut moved_key = Vec::new();
-                    for &i in &splitted_keys.dimensions_positions {
-                        moved_key.push(key[i]);
-                    }
-
-                    KeyAndBlock {
-                        key: moved_key,
-                        block
-                    }
-                })
-                .collect::<Vec<_>>();
-
-            let block = merge_blocks_along_samples(
-                &blocks_to_merge,
-                &names_to_move,
-                sort_samples,
-            )?;
-            new_blocks.push(block);
-        } else {
-            for entry in splitted_keys.new_keys.iter() {
+        let new_blocks = run_with_threads(threads, |parallel| {
+            if splitted_keys.new_keys.count() == 1 {
+                // create a single block with everything
+                let blocks_to_merge = self.keys.iter()
+                    .zip(&self.blocks)
+                    .map(|(key, block)| {
+                        let mut moved_key = Vec::new();
+                        for &i in &splitted_keys.dimensions_positions {
+                            moved_key.push(key[i]);
+                        }
+
+                        KeyAndBlock {
+                            key: moved_key,
+                            block
+                        }
+                    })
+                    .collect::<Vec<_>>();
+
+                let block = merge_blocks_along_samples(
+                    &blocks_to_merge,
+                    &names_to_move,
+                    sort_samples,
+                    parallel,
+                )?;
+                return Ok(vec![block]);
+            }
+
+            let new_keys = splitted_keys.new_keys.iter().collect::<Vec<_>>();
+            return try_map(&new_keys, parallel, |&entry| {
                 let mut selection = LabelsBuilder::new(splitted_keys.new_keys.names())?;
                 selection.add(entry)?;
 
@@ -91,35 +100,32 @@ impl TensorMap {
                     })
                     .collect::<Vec<_>>();
 
-                new_blocks.push(merge_blocks_along_samples(
+                return merge_blocks_along_samples(
                     &blocks_to_merge,
                     &names_to_move,
                     sort_samples,
-                )?);
-            }
-        }
+                    parallel,
+                );
+            });
+        })?;
 
         return TensorMap::new(Arc::new(splitted_keys.new_keys), new_blocks);
     }
 }
 
 /// Merge the given `blocks` along the sample axis.
+///
+/// If `parallel` is true, the data of the different blocks is moved
+/// concurrently, using the current rayon thread pool.
 fn merge_blocks_along_samples(
     blocks_to_merge: &[KeyAndBlock],
     extracted_names: &[&str],
     sort_samples: bool,
+    parallel: bool,
 ) -> Result<TensorBlock, Error> {
     assert!(!blocks_to_merge.is_empty());
 
     let first_block = blocks_to_merge[0].block;
-    for gradient in first_block.gradients().values() {
-        if !gradient.gradients().is_empty() {
-            return Err(Error::InvalidParameter(
-                "gradient of gradients are not supported yet in keys_to_samples".into()
-            ));
-        }
-    }
-
     let first_components_label = &first_block.components;
     let first_properties_label = &first_block.properties;
 
@@ -155,18 +161,29 @@ fn merge_blocks_along_samples(
 
     let mut new_shape = first_block.values.shape()?.to_vec();
     new_shape[0] = merged_samples.count();
-    let mut new_data = first_block.values.create(&new_shape)?;
+    // all the samples in the new array are set below, so there is no need to
+    // initialize it
+    let new_data = first_block.values.create_uninit(&new_shape)?;
 
     let property_range = 0..new_properties.count();
 
     debug_assert_eq!(blocks_to_merge.len(), samples_mappings.len());
-    for (KeyAndBlock{block, ..}, samples_mapping) in blocks_to_merge.iter().zip(&samples_mappings) {
-        new_data.move_samples_from(
+    let blocks_data = blocks_to_merge.iter()
+        .map(|KeyAndBlock{block, ..}| *block)
+        .zip(&samples_mappings)
+        .collect::<Vec<_>>();
+
+    // the blocks are written to disjoint samples, so this can happen
+    // concurrently if the output array supports it.
+    let parallel_moves = parallel && new_data.supports_concurrent_move_samples();
+    try_map(&blocks_data, parallel_moves, |(block, samples_mapping)| {
+        let mut output = new_data.raw_copy();
+        return output.move_samples_from(
             &block.values,
             samples_mapping,
             property_range.clone(),
-        )?;
-    }
+        );
+    })?;
 
     let mut new_block = TensorBlock::new(
         new_data,
@@ -175,53 +192,20 @@ fn merge_blocks_along_samples(
         new_properties
     ).expect("invalid block");
 
-    // now collect & merge the different gradients
-    for (parameter, first_gradient) in first_block.gradients() {
-        let new_gradient_samples = merge_gradient_samples(
-            blocks_to_merge, parameter, &samples_mappings
-        )?;
-
-        let mut new_shape = first_gradient.values.shape()?.to_vec();
-        new_shape[0] = new_gradient_samples.count();
-        let mut new_gradient = first_block.values.create(&new_shape)?;
-        let new_components = first_gradient.components.to_vec();
-
-        for (KeyAndBlock{block, ..}, samples_mapping) in blocks_to_merge.iter().zip(&samples_mappings) {
-            let gradient = block.gradient(parameter).expect("missing gradient");
-            debug_assert!(*gradient.components == *new_components);
-
-            let mut samples_to_move = Vec::new();
-            for (sample_i, grad_sample) in gradient.samples.iter().enumerate() {
-                // translate from the old sample id in gradients to the new ones
-                let mut grad_sample = grad_sample.to_vec();
-                let old_sample_i = grad_sample[0].usize();
-
-                let mapping = &samples_mapping[old_sample_i];
-                debug_assert_eq!(mapping.input, old_sample_i);
-                grad_sample[0] = mapping.output.into();
-
-                let new_sample_i = new_gradient_samples.position(&grad_sample).expect("missing entry in merged samples");
-                samples_to_move.push(eqs_sample_mapping_t {
-                    input: sample_i,
-                    output: new_sample_i,
-                });
-            }
-            new_gradient.move_samples_from(
-                &gradient.values,
-                &samples_to_move,
-                property_range.clone(),
-            )?;
-        }
-
-        let new_gradient = TensorBlock::new(
-            new_gradient,
-            new_gradient_samples,
-            new_components,
-            new_block.properties.clone()
-        ).expect("created invalid gradient");
-
-        new_block.add_gradient(parameter, new_gradient).expect("could not add gradient");
-    }
+    // now collect & merge the different gradients (and gradients of
+    // gradients), moving the data for all of them at once
+    let blocks = blocks_to_merge.iter()
+        .zip(samples_mappings)
+        .map(|(KeyAndBlock{block, ..}, samples_mapping)| BlockToMerge {
+            block: block,
+            samples_mapping: samples_mapping,
+            property_range: Some(property_range.clone()),
+        })
+        .collect::<Vec<_>>();
+
+    // all the gradient samples of the merged block are set, so there is no
+    // need to initialize the arrays either
+    merge_gradients(&mut new_block, &blocks, GradientSamples::SortedUnion, true, parallel)?;
 
     return Ok(new_block);
 }
@@ -2,13 +2,21 @@ use std::collections::HashMap;
 use std::sync::Arc;
 
 use crate::TensorBlock;
-use crate::{Labels, Error};
+use crate::{Labels, LabelValue, Error};
+use crate::labels::LabelsInterner;
 use crate::get_data_origin;
 
 mod utils;
 
 mod keys_to_samples;
 mod keys_to_properties;
+mod join_samples;
+
+mod builder;
+pub use self::builder::TensorMapBuilder;
+
+mod keys_index;
+pub(crate) use self::keys_index::KeysIndex;
 
 
 /// A tensor map is the main user-facing struct of this library, and can store
@@ -24,6 +32,8 @@ mod keys_to_properties;
 pub struct TensorMap {
     keys: Arc<Labels>,
     blocks: Vec<TensorBlock>,
+    /// secondary index on the keys, shared with all copies of this tensor map
+    keys_index: Arc<KeysIndex>,
     // TODO: arbitrary tensor-level metadata? e.g. using `HashMap<String, String>`
 }
 
@@ -122,8 +132,12 @@ impl TensorMap {
     /// The number of keys must match the number of blocks, and all the blocks
     /// must contain the same kind of data (same labels names, same gradients
     /// defined on all blocks).
+    ///
+    /// Equal samples, components or properties labels (without user data) in
+    /// different blocks and gradients are replaced by a single shared
+    /// instance.
     #[allow(clippy::similar_names)]
-    pub fn new(keys: Arc<Labels>, blocks: Vec<TensorBlock>) -> Result<TensorMap, Error> {
+    pub fn new(keys: Arc<Labels>, mut blocks: Vec<TensorBlock>) -> Result<TensorMap, Error> {
         if blocks.len() != keys.count() {
             return Err(Error::InvalidParameter(format!(
                 "expected the same number of blocks as the number of \
@@ -168,9 +182,17 @@ impl TensorMap {
             }
         }
 
+        // store equal metadata only once, blocks often share the same
+        // components and properties
+        let interner = LabelsInterner::new();
+        for block in &mut blocks {
+            block.intern_labels(&interner);
+        }
+
         Ok(TensorMap {
             keys: keys,
             blocks,
+            keys_index: Arc::new(KeysIndex::new()),
         })
     }
 
@@ -184,7 +206,8 @@ impl TensorMap {
 
         return Ok(TensorMap {
             keys: Arc::clone(&self.keys),
-            blocks
+            blocks,
+            keys_index: Arc::clone(&self.keys_index),
         });
     }
 
@@ -209,50 +232,19 @@ impl TensorMap {
     /// or keys. If the selection contains only a subset of the dimensions of the
     /// keys, there can be multiple matching blocks.
     pub fn blocks_matching(&self, selection: &Labels) -> Result<Vec<usize>, Error> {
-        if selection.size() == 0 {
-            return Ok((0..self.blocks().len()).collect());
-        }
-
-        if selection.count() != 1 {
-            return Err(Error::InvalidParameter(format!(
-                "block selection must contain exactly one entry, got {}",
-                selection.count()
-            )));
-        }
-
-        let mut dimensions = Vec::new();
-        'outer: for requested in selection.names() {
-            for (i, &name) in self.keys.names().iter().enumerate() {
-                if requested == name {
-                    dimensions.push(i);
-                    continue 'outer;
-                }
-            }
-
-            return Err(Error::InvalidParameter(format!(
-                "'{}' is not part of the keys for this tensor",
-                requested
-            )));
-        }
-
-        let mut matching = Vec::new();
-        let selection = selection.iter().next().expect("empty selection");
-
-        for (block_i, labels) in self.keys.iter().enumerate() {
-            let mut selected = true;
-            for (&requested_i, &value) in dimensions.iter().zip(selection) {
-                if labels[requested_i] != value {
-                    selected = false;
-                    break;
-                }
-            }
-
-            if selected {
-                matching.push(block_i);
-            }
-        }
+        return self.keys_index.blocks_matching(&self.keys, selection);
+    }
 
-        return Ok(matching);
+    /// Get the index of blocks where the keys dimensions in `names` take the
+    /// corresponding `values`.
+    ///
+    /// This is equivalent to `blocks_matching` with a selection containing a
+    /// single entry, without having to create the corresponding `Labels`.
+    /// The first call to this function (or to `blocks_matching`) builds an
+    /// index of the keys, making the following calls proportional to the
+    /// number of matching blocks instead of the number of keys.
+    pub fn blocks_matching_values(&self, names: &[&str], values: &[LabelValue]) -> Result<Vec<usize>, Error> {
+        return self.keys_index.blocks_matching_values(&self.keys, names, values);
     }
 
     /// Move the given dimensions from the component labels to the property labels
@@ -408,6 +400,43 @@ mod tests {
         // TODO: check error messages for gradients
     }
 
+    #[test]
+    fn shared_labels() {
+        let mut blocks = Vec::new();
+        for _ in 0..3 {
+            let mut block = TensorBlock::new(
+                TestArray::new(vec![1, 3, 2]),
+                example_labels(vec!["samples"], vec![[0]]),
+                vec![example_labels(vec!["component"], vec![[-1], [0], [1]])],
+                example_labels(vec!["properties"], vec![[0], [1]]),
+            ).unwrap();
+
+            let gradient = TensorBlock::new(
+                TestArray::new(vec![1, 3, 2]),
+                example_labels(vec!["sample", "parameter"], vec![[0, 0]]),
+                vec![example_labels(vec!["component"], vec![[-1], [0], [1]])],
+                Arc::clone(&block.properties),
+            ).unwrap();
+            block.add_gradient("parameter", gradient).unwrap();
+
+            blocks.push(block);
+        }
+
+        let keys = example_labels(vec!["keys"], vec![[0], [1], [2]]);
+        let tensor = TensorMap::new(keys, blocks).unwrap();
+
+        let first = &tensor.blocks()[0];
+        for block in tensor.blocks() {
+            assert!(Arc::ptr_eq(&block.samples, &first.samples));
+            assert!(Arc::ptr_eq(&block.components[0], &first.components[0]));
+            assert!(Arc::ptr_eq(&block.properties, &first.properties));
+
+            let gradient = block.gradient("parameter").unwrap();
+            assert!(Arc::ptr_eq(&gradient.components[0], &first.components[0]));
+            assert!(Arc::ptr_eq(&gradient.properties, &first.properties));
+        }
+    }
+
     #[test]
     fn blocks_matching() {
         let mut blocks = Vec::new();
@@ -464,5 +493,28 @@ mod tests {
             result.unwrap_err().to_string(),
             "invalid parameter: 'key_3' is not part of the keys for this tensor"
         );
+
+        // selection without going through Labels
+        let values = [LabelValue::new(1), LabelValue::new(2)];
+        assert_eq!(tensor.blocks_matching_values(&["key_1", "key_2"], &values).unwrap(), [3]);
+        assert_eq!(tensor.blocks_matching_values(&["key_2", "key_1"], &values).unwrap(), []);
+        let values_4 = [LabelValue::new(0), LabelValue::new(3)];
+        assert_eq!(tensor.blocks_matching_values(&["key_2", "key_1"], &values_4).unwrap(), [4]);
+        assert_eq!(tensor.blocks_matching_values(&["key_2"], &values[..1]).unwrap(), [0, 2]);
+        assert_eq!(tensor.blocks_matching_values(&["key_1"], &values[1..]).unwrap(), []);
+        assert_eq!(tensor.blocks_matching_values(&[], &[]).unwrap(), [0, 1, 2, 3, 4, 5]);
+
+        let result = tensor.blocks_matching_values(&["key_1", "key_1"], &values);
+        assert_eq!(
+            result.unwrap_err().to_string(),
+            "invalid parameter: 'key_1' is present multiple times in the block selection"
+        );
+
+        let result = tensor.blocks_matching_values(&["key_1"], &values);
+        assert_eq!(
+            result.unwrap_err().to_string(),
+            "invalid parameter: expected the same number of names and values in \
+            block selection, got 1 names and 2 values"
+        );
     }
 }
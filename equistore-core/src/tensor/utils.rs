@@ -1,10 +1,12 @@
 use std::collections::BTreeSet;
+use std::ops::Range;
 use std::sync::Arc;
 
 use indexmap::IndexSet;
 
 use crate::labels::{Labels, LabelsBuilder, LabelValue};
-use crate::{Error, TensorBlock, eqs_sample_mapping_t};
+use crate::utils::try_map;
+use crate::{Error, TensorBlock, eqs_array_t, eqs_sample_mapping_t};
 
 /// single block and part of the associated key, this is used for the various
 /// `keys_to_xxx` functions
@@ -80,42 +82,273 @@ pub fn remove_dimensions_from_keys(keys: &Labels, dimensions: &[&str]) -> Result
     });
 }
 
-pub fn merge_gradient_samples(
-    blocks: &[KeyAndBlock],
-    gradient_name: &str,
-    samples_mappings: &[Vec<eqs_sample_mapping_t>],
-) -> Result<Arc<Labels>, Error> {
-    let mut new_gradient_samples = BTreeSet::new();
-    let mut new_gradient_samples_names = None;
-    for (KeyAndBlock{block, ..}, samples_mapping) in blocks.iter().zip(samples_mappings) {
-        let gradient = block.gradient(gradient_name).expect("missing gradient");
+/// A block to merge with other blocks, together with the position of its
+/// samples and properties in the merged block
+pub struct BlockToMerge<'a> {
+    pub block: &'a TensorBlock,
+    /// Position of the samples of `block` in the merged block
+    pub samples_mapping: Vec<eqs_sample_mapping_t>,
+    /// Range of properties in the merged block where the data of `block`
+    /// should go, or `None` if the data of this block should not be moved
+    pub property_range: Option<Range<usize>>,
+}
+
+/// How `merge_gradients` should combine the samples of the gradients of
+/// different blocks
+#[derive(Debug, Clone, Copy)]
+pub enum GradientSamples {
+    /// Take the union of the gradient samples of all blocks, sorted in
+    /// lexicographic order
+    SortedUnion,
+    /// The gradient samples of different blocks are disjoint, and should be
+    /// concatenated in the order of the blocks
+    Concatenated,
+}
+
+/// A gradient of the merged block, together with the gradients of the input
+/// blocks to move into it and the merged gradients of gradients
+struct MergedGradient<'a> {
+    parameter: String,
+    values: eqs_array_t,
+    samples: Arc<Labels>,
+    components: Vec<Arc<Labels>>,
+    inputs: Vec<BlockToMerge<'a>>,
+    gradients: Vec<MergedGradient<'a>>,
+}
+
+/// All the data to move into a single merged gradient array
+struct GradientMoves<'a, 'b> {
+    output: &'b eqs_array_t,
+    /// Input blocks, and range of properties where they should be moved
+    inputs: Vec<(&'b BlockToMerge<'a>, &'b Range<usize>)>,
+}
+
+/// Merge the gradients (including gradients of gradients) of all `blocks`,
+/// and add them to `new_block`, which already contains the merged values.
+///
+/// The samples of all gradients are merged first, and then the data of all
+/// the gradients of all the blocks is moved in a single pass, concurrently if
+/// `parallel` is true. If `uninit` is true, the merged gradient arrays are
+/// created without initializing them, which is only valid if all their
+/// entries are going to be written.
+pub fn merge_gradients(
+    new_block: &mut TensorBlock,
+    blocks: &[BlockToMerge],
+    gradient_samples: GradientSamples,
+    uninit: bool,
+    parallel: bool,
+) -> Result<(), Error> {
+    let n_properties = new_block.properties.count();
+    let gradients = merge_gradients_samples(blocks, n_properties, gradient_samples, uninit)?;
+
+    let mut moves = Vec::new();
+    for gradient in &gradients {
+        gradient.collect_moves(&mut moves);
+    }
+
+    // different gradients are stored in different arrays, and can always be
+    // filled concurrently. The inputs are written to disjoint samples or
+    // properties of each gradient, so they can also be moved concurrently if
+    // the gradient array supports it.
+    try_map(&moves, parallel, |moves| {
+        let parallel_moves = parallel && moves.output.supports_concurrent_move_samples();
+        try_map(&moves.inputs, parallel_moves, |&(input, property_range)| {
+            let mut output = moves.output.raw_copy();
+            return output.move_samples_from(
+                &input.block.values,
+                &input.samples_mapping,
+                property_range.clone(),
+            );
+        })?;
+        return Ok(());
+    })?;
+
+    for gradient in gradients {
+        let (parameter, gradient) = gradient.into_block(&new_block.properties);
+        new_block.add_gradient(&parameter, gradient).expect("could not add gradient");
+    }
 
-        if new_gradient_samples_names.is_none() {
-            new_gradient_samples_names = Some(gradient.samples.names());
+    return Ok(());
+}
+
+/// Merge the samples of all the gradients of `blocks` (recursively) and
+/// create the corresponding arrays.
+fn merge_gradients_samples<'a>(
+    blocks: &[BlockToMerge<'a>],
+    n_properties: usize,
+    gradient_samples: GradientSamples,
+    uninit: bool,
+) -> Result<Vec<MergedGradient<'a>>, Error> {
+    let first_block = blocks[0].block;
+
+    let mut merged = Vec::new();
+    for parameter in first_block.gradient_parameters_c() {
+        let parameter = parameter.as_str();
+
+        let mut gradients = Vec::with_capacity(blocks.len());
+        for input in blocks {
+            if input.block.gradients().len() != first_block.gradients().len() {
+                return Err(Error::InvalidParameter(
+                    "can not merge blocks with different gradients".into()
+                ));
+            }
+
+            let gradient = input.block.gradient(parameter).ok_or_else(|| Error::InvalidParameter(format!(
+                "can not merge blocks with different gradients, the gradient \
+                with respect to '{}' is missing in some blocks", parameter
+            )))?;
+            gradients.push(gradient);
         }
 
+        let first_gradient = gradients[0];
+        for gradient in &gradients {
+            if gradient.components != first_gradient.components {
+                return Err(Error::InvalidParameter(format!(
+                    "can not merge blocks if the gradients with respect to '{}' \
+                    have different components labels", parameter
+                )));
+            }
+        }
+
+        let (samples, mappings) = match gradient_samples {
+            GradientSamples::SortedUnion => sorted_gradient_samples(blocks, &gradients)?,
+            GradientSamples::Concatenated => concatenated_gradient_samples(blocks, &gradients)?,
+        };
+
+        let mut new_shape = first_gradient.values.shape()?.to_vec();
+        new_shape[0] = samples.count();
+        let property_axis = new_shape.len() - 1;
+        new_shape[property_axis] = n_properties;
+
+        let values = if uninit {
+            first_block.values.create_uninit(&new_shape)?
+        } else {
+            first_block.values.create(&new_shape)?
+        };
+
+        let inputs = blocks.iter()
+            .zip(gradients)
+            .zip(mappings)
+            .map(|((input, gradient), samples_mapping)| BlockToMerge {
+                block: gradient,
+                samples_mapping: samples_mapping,
+                property_range: input.property_range.clone(),
+            })
+            .collect::<Vec<_>>();
+
+        let gradients = merge_gradients_samples(&inputs, n_properties, gradient_samples, uninit)?;
+
+        merged.push(MergedGradient {
+            parameter: parameter.to_owned(),
+            values: values,
+            samples: samples,
+            components: first_gradient.components.to_vec(),
+            inputs: inputs,
+            gradients: gradients,
+        });
+    }
+
+    return Ok(merged);
+}
+
+impl<'a> MergedGradient<'a> {
+    /// Collect all the data moves needed to fill this gradient and its own
+    /// gradients
+    fn collect_moves<'b>(&'b self, moves: &mut Vec<GradientMoves<'a, 'b>>) {
+        let inputs = self.inputs.iter()
+            .filter_map(|input| input.property_range.as_ref().map(|range| (input, range)))
+            .collect();
+        moves.push(GradientMoves {
+            output: &self.values,
+            inputs: inputs,
+        });
+
+        for gradient in &self.gradients {
+            gradient.collect_moves(moves);
+        }
+    }
+
+    /// Create the final gradient block, using the given `properties`
+    fn into_block(self, properties: &Arc<Labels>) -> (String, TensorBlock) {
+        let mut block = TensorBlock::new(
+            self.values,
+            self.samples,
+            self.components,
+            Arc::clone(properties),
+        ).expect("created invalid gradient");
+
+        for gradient in self.gradients {
+            let (parameter, gradient) = gradient.into_block(properties);
+            block.add_gradient(&parameter, gradient).expect("could not add gradient");
+        }
+
+        return (self.parameter, block);
+    }
+}
+
+/// Translate the first dimension of a gradient sample from the samples of the
+/// parent block to the samples of the merged parent block
+fn translate_gradient_sample(grad_sample: &[LabelValue], samples_mapping: &[eqs_sample_mapping_t]) -> Vec<LabelValue> {
+    let mut grad_sample = grad_sample.to_vec();
+    let old_sample_i = grad_sample[0].usize();
+
+    let mapping = &samples_mapping[old_sample_i];
+    debug_assert_eq!(mapping.input, old_sample_i);
+    grad_sample[0] = mapping.output.into();
+
+    return grad_sample;
+}
+
+type MergedGradientSamples = (Arc<Labels>, Vec<Vec<eqs_sample_mapping_t>>);
+
+/// Merge the samples of `gradients` (one for each block in `blocks`) in a
+/// single sorted set of labels, and get the position of each gradient sample
+/// in the merged labels
+fn sorted_gradient_samples(blocks: &[BlockToMerge], gradients: &[&TensorBlock]) -> Result<MergedGradientSamples, Error> {
+    let mut new_gradient_samples = BTreeSet::new();
+    for (input, gradient) in blocks.iter().zip(gradients) {
         for grad_sample in gradient.samples.iter() {
-            // translate from the old sample id in gradients to the new ones
-            let mut grad_sample = grad_sample.to_vec();
-            let old_sample_i = grad_sample[0].usize();
+            new_gradient_samples.insert(translate_gradient_sample(grad_sample, &input.samples_mapping));
+        }
+    }
 
-            let mapping = &samples_mapping[old_sample_i];
-            debug_assert_eq!(mapping.input, old_sample_i);
-            grad_sample[0] = mapping.output.into();
+    let values = new_gradient_samples.into_iter().flatten().collect();
+    let new_gradient_samples = Arc::new(Labels::new(gradients[0].samples.names(), values)?);
 
-            new_gradient_samples.insert(grad_sample);
+    let mut mappings = Vec::with_capacity(blocks.len());
+    for (input, gradient) in blocks.iter().zip(gradients) {
+        let mut samples_to_move = Vec::with_capacity(gradient.samples.count());
+        for (sample_i, grad_sample) in gradient.samples.iter().enumerate() {
+            let grad_sample = translate_gradient_sample(grad_sample, &input.samples_mapping);
+            let new_sample_i = new_gradient_samples.position(&grad_sample).expect("missing entry in merged samples");
+            samples_to_move.push(eqs_sample_mapping_t {
+                input: sample_i,
+                output: new_sample_i,
+            });
         }
+        mappings.push(samples_to_move);
     }
 
-    let mut new_gradient_samples_builder = LabelsBuilder::new(
-        new_gradient_samples_names.expect("missing gradient samples names")
-    )?;
+    return Ok((new_gradient_samples, mappings));
+}
+
+/// Concatenate the samples of `gradients` (one for each block in `blocks`),
+/// the gradients of different blocks being moved to contiguous ranges
+fn concatenated_gradient_samples(blocks: &[BlockToMerge], gradients: &[&TensorBlock]) -> Result<MergedGradientSamples, Error> {
+    let size = gradients[0].samples.size();
+    let count = gradients.iter().map(|gradient| gradient.samples.count()).sum::<usize>();
 
-    for sample in new_gradient_samples {
-        new_gradient_samples_builder.add(&sample)?;
+    let mut values = Vec::with_capacity(count * size);
+    let mut mappings = Vec::with_capacity(blocks.len());
+    for (input, gradient) in blocks.iter().zip(gradients) {
+        mappings.push(contiguous_mapping(gradient.samples.count(), values.len() / size));
+        for grad_sample in gradient.samples.iter() {
+            values.extend(translate_gradient_sample(grad_sample, &input.samples_mapping));
+        }
     }
 
-    return Ok(Arc::new(new_gradient_samples_builder.finish()));
+    let new_gradient_samples = Arc::new(Labels::new(gradients[0].samples.names(), values)?);
+    return Ok((new_gradient_samples, mappings));
 }
 
 pub fn merge_samples(
@@ -171,6 +404,15 @@ pub fn merge_samples(
     return (merged_samples, samples_mappings)
 }
 
+/// Get the mapping to move `count` consecutive samples from the start of an
+/// array to the position `offset` in another array
+pub fn contiguous_mapping(count: usize, offset: usize) -> Vec<eqs_sample_mapping_t> {
+    (0..count).map(|i| eqs_sample_mapping_t {
+        input: i,
+        output: offset + i,
+    }).collect()
+}
+
 /******************************************************************************/
 
 #[cfg(test)]
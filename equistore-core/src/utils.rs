@@ -1,4 +1,11 @@
+use std::collections::HashMap;
 use std::ffi::{CString, CStr};
+use std::sync::{Arc, Mutex};
+
+use once_cell::sync::Lazy;
+use rayon::prelude::*;
+
+use crate::Error;
 
 
 /// An analog to `std::ffi::CString` that is immutable & can be shared between
@@ -66,3 +73,72 @@ impl std::fmt::Debug for ConstCString {
         f.debug_tuple("ConstCString").field(&self.as_c_str()).finish()
     }
 }
+
+/// Thread pools used by `run_with_threads`, indexed by their number of
+/// threads. Creating a pool spawns all of its threads, so pools are created
+/// once and re-used for all later calls with the same number of threads.
+///
+/// Pools are never removed from the cache, so at most
+/// `MAX_CACHED_THREAD_POOLS` of them are stored, to limit the number of idle
+/// threads kept alive.
+static THREAD_POOLS: Lazy<Mutex<HashMap<usize, Arc<rayon::ThreadPool>>>> = Lazy::new(|| {
+    Mutex::new(HashMap::new())
+});
+
+/// Maximal number of different thread pools stored in `THREAD_POOLS`
+const MAX_CACHED_THREAD_POOLS: usize = 4;
+
+/// Run `function` with the requested number of `threads`.
+///
+/// If `threads` is 1, the function is executed directly on the current thread,
+/// and the `parallel` parameter of `function` is `false`. Otherwise `parallel`
+/// is `true`, and the function runs inside the global rayon thread pool (with
+/// one thread per CPU core) if `threads` is 0, or inside a thread pool with
+/// `threads` threads. This pool is created on the first call with a given
+/// number of threads, and kept alive for later calls; unless there are already
+/// `MAX_CACHED_THREAD_POOLS` pools alive, in which case a new pool is created
+/// for this call only.
+pub fn run_with_threads<T, F>(threads: usize, function: F) -> Result<T, Error>
+    where T: Send, F: FnOnce(bool) -> Result<T, Error> + Send
+{
+    if threads == 1 {
+        return function(false);
+    } else if threads == 0 {
+        return function(true);
+    }
+
+    let pool = {
+        let mut pools = THREAD_POOLS.lock().expect("mutex got poisoned");
+        if let Some(pool) = pools.get(&threads) {
+            Arc::clone(pool)
+        } else {
+            let pool = rayon::ThreadPoolBuilder::new()
+                .num_threads(threads)
+                .build()
+                .map_err(|e| Error::Internal(format!("failed to create thread pool: {}", e)))?;
+
+            let pool = Arc::new(pool);
+            if pools.len() < MAX_CACHED_THREAD_POOLS {
+                pools.insert(threads, Arc::clone(&pool));
+            }
+            pool
+        }
+    };
+
+    return pool.install(|| function(true));
+}
+
+/// Call `function` on all the elements of `items`, collecting the results.
+///
+/// If `parallel` is `true`, the calls are distributed over the current rayon
+/// thread pool (see `run_with_threads`), otherwise they are made sequentially
+/// on the current thread, in order. The first error is returned.
+pub fn try_map<I, T, F>(items: &[I], parallel: bool, function: F) -> Result<Vec<T>, Error>
+    where I: Sync, T: Send, F: Fn(&I) -> Result<T, Error> + Sync + Send
+{
+    if parallel {
+        return items.par_iter().map(function).collect();
+    } else {
+        return items.iter().map(function).collect();
+    }
+}
@@ -127,6 +127,6 @@ TEST_CASE("Blocks") {
             Labels({"properties"}, {{5}, {3}})
         );
 
-        CHECK_THROWS_WITH(block.clone(), "external error: calling eqs_array_t.create failed (status -1)");
+        CHECK_THROWS_WITH(block.clone(), "error in C++ callback: can not copy this!");
     }
 }
@@ -69,6 +69,10 @@ TEST_CASE("Data Array") {
         CHECK(shape[3] == 4);
     }
 
+    SECTION("concurrent move_samples_from") {
+        CHECK(array.concurrent_move_samples);
+    }
+
     SECTION("new arrays") {
         eqs_array_t new_array;
         std::memset(&new_array, 0, sizeof(new_array));
@@ -105,3 +109,338 @@ TEST_CASE("Data Array") {
 
     array.destroy(array.ptr);
 }
+
+TEST_CASE("SimpleDataArray") {
+    SECTION("move_samples_from") {
+        auto input = SimpleDataArray({3, 2, 2});
+        auto input_view = input.view();
+        for (size_t s=0; s<3; s++) {
+            for (size_t c=0; c<2; c++) {
+                for (size_t p=0; p<2; p++) {
+                    input_view(s, c, p) = static_cast<double>(100 * s + 10 * c + p);
+                }
+            }
+        }
+
+        // only some of the properties are written
+        auto output = SimpleDataArray({4, 2, 5});
+        auto samples = std::vector<eqs_sample_mapping_t>{
+            // consecutive samples are merged in a single copy
+            {0, 1}, {1, 2},
+            {2, 0},
+        };
+        output.move_samples_from(input, samples, 2, 4);
+
+        auto output_view = output.view();
+        for (size_t c=0; c<2; c++) {
+            for (size_t p=0; p<5; p++) {
+                CHECK(output_view(3, c, p) == 0.0);
+                if (p < 2 || p >= 4) {
+                    for (size_t s=0; s<3; s++) {
+                        CHECK(output_view(s, c, p) == 0.0);
+                    }
+                } else {
+                    CHECK(output_view(1, c, p) == static_cast<double>(10 * c + p - 2));
+                    CHECK(output_view(2, c, p) == static_cast<double>(100 + 10 * c + p - 2));
+                    CHECK(output_view(0, c, p) == static_cast<double>(200 + 10 * c + p - 2));
+                }
+            }
+        }
+
+        // all the properties are written
+        output = SimpleDataArray({4, 2, 2});
+        samples = std::vector<eqs_sample_mapping_t>{
+            {0, 2}, {1, 3}, {2, 0},
+        };
+        output.move_samples_from(input, samples, 0, 2);
+
+        output_view = output.view();
+        for (size_t c=0; c<2; c++) {
+            for (size_t p=0; p<2; p++) {
+                CHECK(output_view(0, c, p) == input_view(2, c, p));
+                CHECK(output_view(1, c, p) == 0.0);
+                CHECK(output_view(2, c, p) == input_view(0, c, p));
+                CHECK(output_view(3, c, p) == input_view(1, c, p));
+            }
+        }
+
+        // samples given as a pointer and length
+        output = SimpleDataArray({4, 2, 2});
+        output.move_samples_from(input, samples.data(), 2, 0, 2);
+
+        output_view = output.view();
+        for (size_t c=0; c<2; c++) {
+            for (size_t p=0; p<2; p++) {
+                CHECK(output_view(0, c, p) == 0.0);
+                CHECK(output_view(2, c, p) == input_view(0, c, p));
+                CHECK(output_view(3, c, p) == input_view(1, c, p));
+            }
+        }
+    }
+
+    SECTION("reshape") {
+        auto array = SimpleDataArray({3, 2, 2});
+
+        auto shape = std::vector<uintptr_t>{6, 2};
+        array.reshape(shape.data(), shape.size());
+        CHECK(array.shape() == shape);
+
+        CHECK_THROWS_WITH(array.reshape(shape.data(), 1), "invalid shape in reshape");
+    }
+
+    SECTION("create_uninit") {
+        auto array = SimpleDataArray({3, 2}, 1.0);
+        auto uninit = array.create_uninit({4, 5});
+        CHECK(uninit->shape() == std::vector<uintptr_t>{4, 5});
+
+        auto& uninit_array = dynamic_cast<SimpleDataArray&>(*uninit);
+        uninit_array.view()(3, 4) = 2.0;
+        CHECK(uninit_array.view()(3, 4) == 2.0);
+
+        auto direct = SimpleDataArray::uninit({2, 2});
+        CHECK(direct.shape() == std::vector<uintptr_t>{2, 2});
+    }
+
+    SECTION("swap_axes") {
+        auto array = SimpleDataArray({2, 3}, {
+            0.0, 1.0, 2.0,
+            3.0, 4.0, 5.0,
+        });
+        array.swap_axes(0, 1);
+        CHECK(array == SimpleDataArray({3, 2}, {
+            0.0, 3.0,
+            1.0, 4.0,
+            2.0, 5.0,
+        }));
+
+        array = SimpleDataArray({2, 2, 3}, {
+            0.0, 1.0, 2.0,
+            3.0, 4.0, 5.0,
+
+            6.0, 7.0, 8.0,
+            9.0, 10.0, 11.0,
+        });
+        array.swap_axes(0, 2);
+        CHECK(array == SimpleDataArray({3, 2, 2}, {
+            0.0, 6.0,
+            3.0, 9.0,
+
+            1.0, 7.0,
+            4.0, 10.0,
+
+            2.0, 8.0,
+            5.0, 11.0,
+        }));
+    }
+}
+
+TEST_CASE("SimpleDataArrayF32") {
+    auto data = std::unique_ptr<SimpleDataArrayF32>(new SimpleDataArrayF32({2, 3}, 1.5));
+    auto array = DataArrayBase::to_eqs_array_t(std::move(data));
+
+    eqs_data_origin_t origin = 0;
+    auto status = array.origin(array.ptr, &origin);
+    CHECK(status == EQS_SUCCESS);
+
+    char buffer[64] = {0};
+    status = eqs_get_data_origin(origin, buffer, 64);
+    CHECK(status == EQS_SUCCESS);
+    CHECK(std::string(buffer) == "equistore::SimpleDataArray<float>");
+
+    eqs_dtype_t dtype = 0;
+    status = array.dtype(array.ptr, &dtype);
+    CHECK(status == EQS_SUCCESS);
+    CHECK(dtype == EQS_DTYPE_FLOAT32);
+
+    void* raw_data = nullptr;
+    status = array.raw_data(array.ptr, &raw_data);
+    CHECK(status == EQS_SUCCESS);
+    CHECK(static_cast<float*>(raw_data)[4] == 1.5f);
+
+    // the data can not be accessed as double
+    double* data_ptr = nullptr;
+    status = array.data(array.ptr, &data_ptr);
+    CHECK(status != EQS_SUCCESS);
+
+    CHECK_THROWS_WITH(
+        SimpleDataArray::from_eqs_array(array),
+        "this array is not an equistore::SimpleDataArray"
+    );
+    CHECK(SimpleDataArrayF32::from_eqs_array(array).view()(1, 2) == 1.5f);
+
+    array.destroy(array.ptr);
+}
+
+TEST_CASE("SparseDataArray") {
+    SECTION("dense conversions") {
+        auto array = SparseDataArray({2, 2, 3}, {
+            0.0, 1.0, 0.0,
+            0.0, 0.0, 2.0,
+
+            0.0, 0.0, 0.0,
+            3.0, 0.0, 0.0,
+        });
+        CHECK(array.shape() == std::vector<uintptr_t>{2, 2, 3});
+        CHECK(array.non_zero_count() == 3);
+
+        auto dense = array.to_dense();
+        auto view = dense.view();
+        CHECK(view(0, 0, 1) == 1.0);
+        CHECK(view(0, 1, 2) == 2.0);
+        CHECK(view(1, 1, 0) == 3.0);
+        CHECK(view(1, 0, 0) == 0.0);
+
+        auto dense_view = dense.view();
+        auto dense_data = std::vector<double>(dense_view.data(), dense_view.data() + 12);
+        CHECK(array == SparseDataArray({2, 2, 3}, dense_data));
+        CHECK(array != SparseDataArray({2, 2, 3}));
+
+        CHECK_THROWS_WITH(
+            array.data(),
+            "can not access the data of a SparseDataArray as a dense array, use to_dense() instead"
+        );
+
+        CHECK_THROWS_WITH(
+            SparseDataArray({2, 2}, {1.0, 2.0}),
+            "the shape and size of the data don't match in SparseDataArray"
+        );
+    }
+
+    SECTION("eqs_array_t") {
+        auto data = std::unique_ptr<SparseDataArray>(new SparseDataArray({3, 2}, {
+            1.0, 0.0,
+            0.0, 0.0,
+            0.0, 4.0,
+        }));
+        auto array = DataArrayBase::to_eqs_array_t(std::move(data));
+
+        eqs_data_origin_t origin = 0;
+        auto status = array.origin(array.ptr, &origin);
+        CHECK(status == EQS_SUCCESS);
+
+        char buffer[64] = {0};
+        status = eqs_get_data_origin(origin, buffer, 64);
+        CHECK(status == EQS_SUCCESS);
+        CHECK(std::string(buffer) == "equistore::SparseDataArray");
+
+        // different threads could modify the same sparse row
+        CHECK_FALSE(array.concurrent_move_samples);
+
+        // the data is not stored as a dense array
+        double* data_ptr = nullptr;
+        status = array.data(array.ptr, &data_ptr);
+        CHECK(status != EQS_SUCCESS);
+
+        // but can be accessed a few samples at the time
+        REQUIRE(array.get_samples != nullptr);
+        REQUIRE(array.set_samples != nullptr);
+
+        auto values = std::vector<double>(4, 42.0);
+        status = array.get_samples(array.ptr, 1, 3, values.data());
+        CHECK(status == EQS_SUCCESS);
+        CHECK(values == std::vector<double>{0.0, 0.0, 0.0, 4.0});
+
+        values = {5.0, 0.0};
+        status = array.set_samples(array.ptr, 1, 2, values.data());
+        CHECK(status == EQS_SUCCESS);
+
+        status = array.get_samples(array.ptr, 3, 4, values.data());
+        CHECK(status != EQS_SUCCESS);
+
+        const auto& sparse = SparseDataArray::from_eqs_array(array);
+        CHECK(sparse.non_zero_count() == 3);
+        CHECK(sparse.to_dense() == SimpleDataArray({3, 2}, {1.0, 0.0, 5.0, 0.0, 0.0, 4.0}));
+
+        CHECK_THROWS_WITH(
+            SimpleDataArray::from_eqs_array(array),
+            "this array is not an equistore::SimpleDataArray"
+        );
+
+        array.destroy(array.ptr);
+
+        // dense arrays don't define these functions
+        array = DataArrayBase::to_eqs_array_t(std::unique_ptr<SimpleDataArray>(new SimpleDataArray({3, 2})));
+        CHECK(array.get_samples == nullptr);
+        CHECK(array.set_samples == nullptr);
+        array.destroy(array.ptr);
+    }
+
+    SECTION("move_samples_from") {
+        auto input_data = std::vector<double>(3 * 2 * 2, 0.0);
+        for (size_t s=0; s<3; s++) {
+            for (size_t c=0; c<2; c++) {
+                // only store a value for the second property
+                input_data[(s * 2 + c) * 2 + 1] = static_cast<double>(100 * s + 10 * c + 1);
+            }
+        }
+        auto input = SparseDataArray({3, 2, 2}, input_data);
+        auto dense_input = SimpleDataArray({3, 2, 2}, input_data);
+
+        // only some of the properties are written
+        auto output = SparseDataArray({4, 2, 5}, std::vector<double>(4 * 2 * 5, -1.0));
+        auto samples = std::vector<eqs_sample_mapping_t>{
+            {0, 1}, {1, 2}, {2, 0},
+        };
+        output.move_samples_from(input, samples, 2, 4);
+
+        auto dense_output = SimpleDataArray({4, 2, 5}, -1.0);
+        dense_output.move_samples_from(dense_input, samples, 2, 4);
+        CHECK(output.to_dense() == dense_output);
+        CHECK(output.non_zero_count() == 4 * 2 * 5 - 3 * 2);
+
+        // all the properties are written
+        output = SparseDataArray({4, 2, 2});
+        samples = std::vector<eqs_sample_mapping_t>{
+            {0, 2}, {1, 3}, {2, 0},
+        };
+        output.move_samples_from(input, samples.data(), samples.size(), 0, 2);
+
+        dense_output = SimpleDataArray({4, 2, 2});
+        dense_output.move_samples_from(dense_input, samples, 0, 2);
+        CHECK(output.to_dense() == dense_output);
+        CHECK(output.non_zero_count() == 3 * 2);
+
+        // sparse data can only be moved from other sparse arrays
+        CHECK_THROWS(output.move_samples_from(dense_input, samples, 0, 2));
+    }
+
+    SECTION("reshape and swap_axes") {
+        auto data = std::vector<double>(2 * 3 * 4, 0.0);
+        for (size_t i=0; i<data.size(); i++) {
+            if (i % 3 == 0) {
+                data[i] = static_cast<double>(i + 1);
+            }
+        }
+
+        auto array = SparseDataArray({2, 3, 4}, data);
+        auto dense = SimpleDataArray({2, 3, 4}, data);
+        array.swap_axes(0, 2);
+        dense.swap_axes(0, 2);
+        CHECK(array.shape() == std::vector<uintptr_t>{4, 3, 2});
+        CHECK(array.to_dense() == dense);
+
+        array.swap_axes(1, 2);
+        dense.swap_axes(1, 2);
+        CHECK(array.to_dense() == dense);
+
+        auto shape = std::vector<uintptr_t>{6, 2, 2};
+        array.reshape(shape);
+        dense.reshape(shape);
+        CHECK(array.shape() == shape);
+        CHECK(array.to_dense() == dense);
+
+        shape = std::vector<uintptr_t>{6, 4};
+        array.reshape(shape.data(), shape.size());
+        CHECK(array.shape() == shape);
+
+        CHECK_THROWS_WITH(array.reshape(shape.data(), 1), "invalid shape in reshape");
+        CHECK_THROWS_WITH(array.swap_axes(0, 2), "invalid axis in swap_axes");
+
+        auto copy = array.copy();
+        CHECK(dynamic_cast<SparseDataArray&>(*copy) == array);
+
+        auto created = array.create({3, 3});
+        CHECK(created->shape() == std::vector<uintptr_t>{3, 3});
+        CHECK(dynamic_cast<SparseDataArray&>(*created).non_zero_count() == 0);
+    }
+}
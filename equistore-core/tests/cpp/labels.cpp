@@ -35,6 +35,35 @@ TEST_CASE("Labels") {
         "invalid parameter: expected label of size 2 in eqs_labels_position, got size 3"
     );
 
+    CHECK(labels.positions({3, 4, 1, 4, 1, 2}) == std::vector<int64_t>{1, -1, 0});
+    CHECK(labels.positions(std::vector<int32_t>()).empty());
+    CHECK_THROWS_WITH(
+        labels.positions({3, 4, 5}),
+        "invalid number of values in Labels::positions: expected a multiple of 2, got 3"
+    );
+
+    // large batches of lookups are distributed over multiple threads
+    auto many_labels = std::vector<int32_t>();
+    for (int32_t i=0; i<100000; i++) {
+        many_labels.push_back(i);
+        many_labels.push_back(-i);
+    }
+    auto large = details::labels_from_cxx({"foo", "bar"}, NDArray<int32_t>(many_labels.data(), {100000, 2}));
+
+    auto entries = std::vector<int32_t>();
+    for (int32_t i=0; i<50000; i++) {
+        entries.push_back(2 * i);
+        entries.push_back(-2 * i);
+        entries.push_back(i);
+        entries.push_back(i + 1);
+    }
+    auto positions = large.positions(entries);
+    REQUIRE(positions.size() == 100000);
+    for (size_t i=0; i<50000; i++) {
+        CHECK(positions[2 * i] == static_cast<int64_t>(2 * i));
+        CHECK(positions[2 * i + 1] == -1);
+    }
+
     CHECK_THROWS_WITH(Labels({"foo"}, {{1}, {3, 4}}), "invalid size for row: expected 1 got 2");
 
     CHECK_THROWS_WITH(
@@ -43,6 +72,24 @@ TEST_CASE("Labels") {
     );
 }
 
+TEST_CASE("Copy Labels") {
+    auto labels = Labels({"foo", "bar"}, {{1, 2}, {3, 4}});
+
+    auto copy = labels;
+    CHECK(copy == labels);
+    CHECK(copy.size() == 2);
+    CHECK(copy.count() == 2);
+    CHECK(copy(1, 0) == 3);
+
+    // labels with the same names share the same strings
+    CHECK(copy.names() == labels.names());
+
+    auto other = Labels({"other"}, {{0}});
+    other = labels;
+    CHECK(other == labels);
+    CHECK(other.shape() == labels.shape());
+}
+
 
 TEST_CASE("Set operations") {
     SECTION("union") {
@@ -78,6 +125,26 @@ TEST_CASE("Set operations") {
         CHECK(second_mapping == expected);
     }
 
+    SECTION("union many") {
+        auto first = Labels({"aa", "bb"}, {{0, 1}, {1, 2}});
+        auto second = Labels({"aa", "bb"}, {{2, 3}, {1, 2}, {4, 5}});
+        auto third = Labels({"aa", "bb"}, {{4, 5}, {6, 7}});
+
+        auto mapping = std::vector<int64_t>(first.count() + second.count() + third.count());
+        auto union_ = Labels::set_union_many({first, second, third}, mapping);
+
+        CHECK(union_ == Labels({"aa", "bb"}, {{0, 1}, {1, 2}, {2, 3}, {4, 5}, {6, 7}}));
+        CHECK(union_ == first.set_union(second).set_union(third));
+
+        auto expected = std::vector<int64_t>{0, 1, 2, 1, 3, 3, 4};
+        CHECK(mapping == expected);
+
+        CHECK_THROWS_WITH(
+            Labels::set_union_many({}),
+            "invalid parameter: can not take the union of an empty list of Labels"
+        );
+    }
+
     SECTION("intersection") {
         auto first = Labels({"aa", "bb"}, {{0, 1}, {1, 2}});
         auto second = Labels({"aa", "bb"}, {{2, 3}, {1, 2}, {4, 5}});
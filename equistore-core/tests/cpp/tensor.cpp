@@ -1,5 +1,6 @@
 #include <fstream>
 #include <sstream>
+#include <cstdio>
 #include <cstdlib>
 
 #include <catch.hpp>
@@ -8,8 +9,11 @@
 using namespace equistore;
 
 static TensorMap test_tensor_map();
-static eqs_status_t custom_create_array(const uintptr_t* shape_ptr, uintptr_t shape_count, eqs_array_t *array);
+static eqs_status_t custom_create_array(void*, const uintptr_t* shape_ptr, uintptr_t shape_count, eqs_dtype_t dtype, eqs_array_t *array);
 static void check_loaded_tensor(equistore::TensorMap& tensor);
+static void check_same_tensor(TensorMap tensor, TensorMap reference);
+static TensorMap sparse_tensor_map(TensorMap& tensor);
+static void check_sparse_tensor(TensorMap sparse, TensorMap reference);
 
 static int CUSTOM_CREATE_ARRAY_CALL_COUNT = 0;
 
@@ -38,6 +42,20 @@ TEST_CASE("TensorMap") {
         CHECK(matching.size() == 2);
         CHECK(matching[0] == 0);
         CHECK(matching[1] == 1);
+
+        matching = tensor.blocks_matching({"key_2"}, {0});
+        CHECK(matching == std::vector<uintptr_t>{0, 1});
+
+        matching = tensor.blocks_matching({"key_1", "key_2"}, {1, 0});
+        CHECK(matching == std::vector<uintptr_t>{1});
+
+        matching = tensor.blocks_matching({"key_2"}, {42});
+        CHECK(matching.empty());
+
+        CHECK_THROWS_WITH(
+            tensor.blocks_matching({"key_2"}, {0, 1}),
+            "expected the same number of names and values in block selection, got 1 names and 2 values"
+        );
     }
 
     SECTION("keys_to_samples") {
@@ -157,6 +175,35 @@ TEST_CASE("TensorMap") {
         CHECK(values_3 == SimpleDataArray({4, 3, 1}, 4.0));
     }
 
+    SECTION("multi-threaded keys_to_xxx") {
+        auto tensor = test_tensor_map();
+        for (size_t threads: {0, 3}) {
+            check_same_tensor(
+                tensor.keys_to_properties("key_1", true, threads),
+                tensor.keys_to_properties("key_1", true, 1)
+            );
+
+            // all blocks are merged in a single block, which requires the
+            // blocks to have the same components
+            auto no_components = tensor.components_to_properties("component");
+            auto keys = std::vector<std::string>{"key_1", "key_2"};
+            check_same_tensor(
+                no_components.keys_to_properties(keys, true, threads),
+                no_components.keys_to_properties(keys, true, 1)
+            );
+
+            check_same_tensor(
+                tensor.keys_to_samples("key_2", true, threads),
+                tensor.keys_to_samples("key_2", true, 1)
+            );
+
+            check_same_tensor(
+                tensor.keys_to_samples("key_2", false, threads),
+                tensor.keys_to_samples("key_2", false, 1)
+            );
+        }
+    }
+
     SECTION("component_to_properties") {
         auto tensor = test_tensor_map().components_to_properties("component");
 
@@ -170,6 +217,122 @@ TEST_CASE("TensorMap") {
         CHECK(block.properties() == Labels({"component", "properties"}, {{0, 0}}));
     }
 
+    SECTION("join_samples") {
+        auto tensors = std::vector<TensorMap>();
+        tensors.emplace_back(test_tensor_map());
+        tensors.emplace_back(test_tensor_map());
+
+        auto tensor = TensorMap::join_samples(tensors);
+        CHECK(tensor.keys() == tensors[0].keys());
+
+        auto block = tensor.block_by_id(0);
+        CHECK(block.samples() == Labels({"samples", "tensor"}, {
+            {0, 0}, {2, 0}, {4, 0}, {0, 1}, {2, 1}, {4, 1}
+        }));
+
+        auto& values = SimpleDataArray::from_eqs_array(block.eqs_array());
+        CHECK(values == SimpleDataArray({6, 1, 1}, 1.0));
+
+        auto gradient = block.gradient("parameter");
+        CHECK(gradient.samples() == Labels({"sample", "parameter"}, {
+            {0, -2}, {2, 3}, {3, -2}, {5, 3}
+        }));
+
+        auto& gradient_values = SimpleDataArray::from_eqs_array(gradient.eqs_array());
+        CHECK(gradient_values == SimpleDataArray({4, 1, 1}, 11.0));
+
+        for (size_t threads: {0, 3}) {
+            check_same_tensor(
+                TensorMap::join_samples(tensors, threads),
+                TensorMap::join_samples(tensors, 1)
+            );
+        }
+
+        CHECK_THROWS_WITH(
+            TensorMap::join_samples(std::vector<TensorMap>()),
+            "invalid parameter: can not join an empty list of TensorMap"
+        );
+    }
+
+    SECTION("sparse data") {
+        auto tensor = test_tensor_map();
+        auto sparse = sparse_tensor_map(tensor);
+
+        for (size_t threads: {1, 3}) {
+            check_sparse_tensor(
+                sparse.keys_to_properties("key_1", true, threads),
+                tensor.keys_to_properties("key_1", true, threads)
+            );
+
+            check_sparse_tensor(
+                sparse.keys_to_samples("key_2", false, threads),
+                tensor.keys_to_samples("key_2", false, threads)
+            );
+        }
+
+        check_sparse_tensor(
+            sparse.components_to_properties("component"),
+            tensor.components_to_properties("component")
+        );
+    }
+
+    SECTION("TensorMapBuilder") {
+        auto create_block = [](Labels samples, double value) {
+            auto n_samples = samples.count();
+            auto block = TensorBlock(
+                std::unique_ptr<SimpleDataArray>(new SimpleDataArray({n_samples, 2}, value)),
+                std::move(samples),
+                {},
+                Labels({"properties"}, {{0}, {1}})
+            );
+
+            auto gradient = TensorBlock(
+                std::unique_ptr<SimpleDataArray>(new SimpleDataArray({1, 2}, -value)),
+                Labels({"sample", "atom"}, {{0, 1}}),
+                {},
+                Labels({"properties"}, {{0}, {1}})
+            );
+            block.add_gradient("positions", std::move(gradient));
+
+            return block;
+        };
+
+        auto builder = TensorMapBuilder({"keys"});
+        builder.add_block({0}, create_block(Labels({"samples"}, {{0}, {1}}), 1.0));
+        builder.add_block({1}, create_block(Labels({"samples"}, {{3}}), 2.0));
+        builder.add_block({0}, create_block(Labels({"samples"}, {{4}}), 3.0));
+
+        CHECK_THROWS_WITH(
+            builder.add_block({0}, create_block(Labels({"samples"}, {{4}}), 1.0)),
+            "invalid parameter: can not have the same label value multiple time: [4] is already present at position 2"
+        );
+
+        CHECK_THROWS_WITH(
+            builder.add_block({0, 1}, create_block(Labels({"samples"}, {{5}}), 1.0)),
+            "invalid parameter: invalid key: expected 1 values, got 2"
+        );
+
+        auto tensor = builder.finish();
+        CHECK(tensor.keys() == Labels({"keys"}, {{0}, {1}}));
+
+        auto block = tensor.block_by_id(0);
+        CHECK(block.samples() == Labels({"samples"}, {{0}, {1}, {4}}));
+
+        auto& values = SimpleDataArray::from_eqs_array(block.eqs_array());
+        CHECK(values == SimpleDataArray({3, 2}, {1.0, 1.0, 1.0, 1.0, 3.0, 3.0}));
+
+        auto gradient = block.gradient("positions");
+        CHECK(gradient.samples() == Labels({"sample", "atom"}, {{0, 1}, {2, 1}}));
+
+        auto& gradient_values = SimpleDataArray::from_eqs_array(gradient.eqs_array());
+        CHECK(gradient_values == SimpleDataArray({2, 2}, {-1.0, -1.0, -3.0, -3.0}));
+
+        block = tensor.block_by_id(1);
+        CHECK(block.samples() == Labels({"samples"}, {{3}}));
+
+        CHECK_THROWS_WITH(builder.finish(), "this TensorMapBuilder was already finished");
+    }
+
     SECTION("clone") {
         auto blocks = std::vector<TensorBlock>();
         blocks.push_back(TensorBlock(
@@ -201,7 +364,7 @@ TEST_CASE("TensorMap") {
         ));
         tensor = TensorMap(Labels({"keys"}, {{0}}), std::move(blocks));
 
-        CHECK_THROWS_WITH(tensor.clone(), "external error: calling eqs_array_t.create failed (status -1)");
+        CHECK_THROWS_WITH(tensor.clone(), "error in C++ callback: can not copy this!");
     }
 }
 
@@ -214,6 +377,23 @@ TEST_CASE("TensorMap serialization") {
         check_loaded_tensor(tensor);
     }
 
+    SECTION("loading file with multiple threads") {
+        auto reference = TensorMap::load(DATA_NPZ);
+        auto tensor = TensorMap::load(DATA_NPZ, details::default_create_array, 4);
+        check_loaded_tensor(tensor);
+
+        REQUIRE(tensor.keys() == reference.keys());
+        for (size_t i=0; i<reference.keys().count(); i++) {
+            auto block = tensor.block_by_id(i);
+            auto expected = reference.block_by_id(i);
+
+            CHECK(block.samples() == expected.samples());
+            CHECK(block.properties() == expected.properties());
+            CHECK(block.values() == expected.values());
+            CHECK(block.gradient("positions").values() == expected.gradient("positions").values());
+        }
+    }
+
     SECTION("loading file with custom array creation") {
         CHECK(CUSTOM_CREATE_ARRAY_CALL_COUNT == 0);
         auto tensor = TensorMap::load(DATA_NPZ, custom_create_array);
@@ -221,6 +401,132 @@ TEST_CASE("TensorMap serialization") {
         CHECK(CUSTOM_CREATE_ARRAY_CALL_COUNT == 27 * 2);
     }
 
+    SECTION("loading a subset of the file") {
+        auto reference = TensorMap::load(DATA_NPZ);
+        auto expected = reference.block_by_id(21);
+        auto expected_properties = expected.properties();
+
+        auto samples = Labels({"structure"}, {{0}, {2}});
+        auto n_0 = expected_properties(0, 0);
+        auto n_2 = expected_properties(2, 0);
+        auto properties = Labels({"n"}, {{n_2}, {n_0}});
+        auto tensor = TensorMap::load_selected(DATA_NPZ, &samples, &properties);
+        REQUIRE(tensor.keys() == reference.keys());
+
+        auto block = tensor.block_by_id(21);
+        auto block_samples = block.samples();
+        REQUIRE(block_samples.count() > 0);
+        CHECK(block_samples.count() < expected.samples().count());
+        // properties are kept in the same order as in the file
+        CHECK(block.properties() == Labels({"n"}, {{n_0}, {n_2}}));
+
+        auto values = block.values();
+        auto expected_values = expected.values();
+        CHECK(values.shape() == std::vector<size_t>{block_samples.count(), 5, 2});
+        for (size_t i=0; i<block_samples.count(); i++) {
+            auto structure = block_samples(i, 0);
+            CHECK((structure == 0 || structure == 2));
+
+            auto position = expected.samples().position({structure, block_samples(i, 1)});
+            REQUIRE(position >= 0);
+            for (size_t c=0; c<5; c++) {
+                CHECK(values(i, c, 0) == expected_values(static_cast<size_t>(position), c, 0));
+                CHECK(values(i, c, 1) == expected_values(static_cast<size_t>(position), c, 2));
+            }
+        }
+
+        // gradients only refer to the loaded samples
+        auto gradient = block.gradient("positions");
+        auto gradient_samples = gradient.samples();
+        CHECK(gradient.values().shape()[3] == 2);
+        for (size_t i=0; i<gradient_samples.count(); i++) {
+            CHECK(gradient_samples(i, 0) < static_cast<int32_t>(block_samples.count()));
+        }
+
+        // without selection, this is the same as a full load
+        tensor = TensorMap::load_selected(DATA_NPZ, nullptr, nullptr);
+        check_same_tensor(std::move(tensor), std::move(reference));
+
+        CHECK_THROWS_WITH(
+            TensorMap::load_selected(DATA_NPZ, &samples, &samples),
+            "invalid parameter: 'structure' is not part of the properties for this tensor map"
+        );
+    }
+
+    SECTION("loading file with memory mapping") {
+        auto tensor = TensorMap::load_mmap(DATA_NPZ);
+        check_loaded_tensor(tensor);
+
+        auto reference = TensorMap::load(DATA_NPZ);
+        for (size_t i=0; i<reference.keys().count(); i++) {
+            auto block = tensor.block_by_id(i);
+            auto expected = reference.block_by_id(i);
+
+            // files created by equistore can be used without copies
+            const auto& values = MmapDataArray::from_eqs_array(block.eqs_array());
+            CHECK(values.is_mapped());
+            CHECK(values.view() == SimpleDataArray::from_eqs_array(expected.eqs_array()).view());
+
+            auto gradient = block.gradient("positions");
+            const auto& gradient_values = MmapDataArray::from_eqs_array(gradient.eqs_array());
+            CHECK(gradient_values.is_mapped());
+            CHECK(gradient_values.view() == SimpleDataArray::from_eqs_array(expected.gradient("positions").eqs_array()).view());
+        }
+
+        // modifications are not written back to the file
+        auto values = tensor.block_by_id(0).values();
+        auto initial = values(0, 0, 0);
+        values(0, 0, 0) = initial + 42.0;
+        CHECK(tensor.block_by_id(0).values()(0, 0, 0) == initial + 42.0);
+        CHECK(TensorMap::load_mmap(DATA_NPZ).block_by_id(0).values()(0, 0, 0) == initial);
+
+        // operations creating new arrays work with memory-mapped data
+        auto moved = tensor.keys_to_properties("neighbor_species");
+        const auto& moved_values = MmapDataArray::from_eqs_array(moved.block_by_id(0).eqs_array());
+        CHECK_FALSE(moved_values.is_mapped());
+    }
+
+    SECTION("lazy loading") {
+        auto lazy = LazyTensorMap(DATA_NPZ, /* max_blocks */ 2);
+        auto reference = TensorMap::load(DATA_NPZ);
+
+        CHECK(lazy.keys() == reference.keys());
+        CHECK(lazy.loaded_blocks() == 0);
+
+        auto selection = Labels({"spherical_harmonics_l"}, {{1}});
+        CHECK(lazy.blocks_matching(selection) == reference.blocks_matching(selection));
+        CHECK(lazy.loaded_blocks() == 0);
+
+        auto block = lazy.block_by_id(21);
+        auto expected = reference.block_by_id(21);
+        CHECK(block->samples() == expected.samples());
+        CHECK(block->properties() == expected.properties());
+        CHECK(SimpleDataArray::from_eqs_array(block->eqs_array()) == SimpleDataArray::from_eqs_array(expected.eqs_array()));
+        CHECK(block->gradients_list() == expected.gradients_list());
+        CHECK(lazy.loaded_blocks() == 1);
+
+        // loaded blocks are re-used
+        CHECK(lazy.block_by_id(21) == block);
+
+        // only the most recently used blocks are kept in memory
+        auto other = lazy.block_by_id(3);
+        lazy.block_by_id(5);
+        CHECK(lazy.loaded_blocks() == 2);
+        CHECK(lazy.block_by_id(5) != block);
+        CHECK(lazy.block_by_id(3) == other);
+
+        // released blocks stay valid
+        CHECK(block->values().shape() == std::vector<size_t>{9, 5, 3});
+
+        lazy.clear();
+        CHECK(lazy.loaded_blocks() == 0);
+
+        CHECK_THROWS_WITH(
+            lazy.block_by_id(27),
+            "invalid parameter: block index out of bounds: we have 27 blocks but the index is 27"
+        );
+    }
+
     SECTION("Load/Save with buffers") {
         // read the whole file into a buffer
         std::ifstream file(DATA_NPZ, std::ios::binary);
@@ -253,6 +559,106 @@ TEST_CASE("TensorMap serialization") {
 
         std::free(raw_buffer);
     }
+
+    SECTION("Load/Save with 32-bit floats") {
+        auto blocks = std::vector<TensorBlock>();
+        blocks.emplace_back(TensorBlock(
+            std::unique_ptr<SimpleDataArrayF32>(new SimpleDataArrayF32({2, 3}, {1, 2, 3, 4, 5, 6.5})),
+            Labels({"samples"}, {{0}, {1}}),
+            {},
+            Labels({"properties"}, {{0}, {1}, {2}})
+        ));
+        auto tensor = TensorMap(Labels({"key"}, {{0}}), std::move(blocks));
+
+        auto buffer = TensorMap::save_buffer(tensor);
+
+        // by default, the data is loaded in the precision of the file
+        auto loaded = TensorMap::load_buffer(buffer);
+        auto block = loaded.block_by_id(0);
+        auto& values_f32 = SimpleDataArrayF32::from_eqs_array(block.eqs_array());
+        CHECK(values_f32 == SimpleDataArrayF32::from_eqs_array(tensor.block_by_id(0).eqs_array()));
+        CHECK(TensorMap::save_buffer(loaded) == buffer);
+
+        // the data is converted to the precision of the arrays created by the
+        // `create_array` callback
+        auto create_f64 = [](void* user_data, const uintptr_t* shape_ptr, uintptr_t shape_count, eqs_dtype_t dtype, eqs_array_t *array) {
+            *static_cast<size_t*>(user_data) += 1;
+            CHECK(dtype == EQS_DTYPE_FLOAT32);
+            auto shape = std::vector<size_t>(shape_ptr, shape_ptr + shape_count);
+            auto cxx_array = std::unique_ptr<DataArrayBase>(new SimpleDataArray(shape));
+            *array = DataArrayBase::to_eqs_array_t(std::move(cxx_array));
+            return EQS_SUCCESS;
+        };
+
+        size_t create_f64_calls = 0;
+        loaded = TensorMap::load_buffer(buffer, create_f64, &create_f64_calls);
+        CHECK(create_f64_calls == 1);
+        block = loaded.block_by_id(0);
+        CHECK(block.values() == NDArray<double>({1, 2, 3, 4, 5, 6.5}, {2, 3}));
+    }
+
+    SECTION("Load/Save sparse data") {
+        auto tensor = TensorMap::load(DATA_NPZ);
+        auto sparse = sparse_tensor_map(tensor);
+
+        // sparse data is saved in the same format as dense data
+        auto buffer = TensorMap::save_buffer(sparse);
+        CHECK(buffer == TensorMap::save_buffer(tensor));
+
+        auto loaded = TensorMap::load_buffer(buffer, details::sparse_create_array);
+        check_sparse_tensor(loaded.clone(), tensor.clone());
+
+        TensorMap::save("sparse.npz", sparse);
+        loaded = TensorMap::load("sparse.npz", details::sparse_create_array, 4);
+        check_sparse_tensor(loaded.clone(), tensor.clone());
+
+        auto samples = Labels({"structure"}, {{0}, {2}});
+        loaded = TensorMap::load_selected("sparse.npz", &samples, nullptr, details::sparse_create_array);
+        check_sparse_tensor(
+            std::move(loaded),
+            TensorMap::load_selected("sparse.npz", &samples, nullptr)
+        );
+
+        std::remove("sparse.npz");
+    }
+
+    SECTION("Save compressed") {
+        auto tensor = TensorMap::load(DATA_NPZ);
+        TensorMap::save_compressed("compressed.npz", tensor);
+
+        auto loaded = TensorMap::load("compressed.npz");
+        check_loaded_tensor(loaded);
+        CHECK(TensorMap::save_string_buffer(loaded) == TensorMap::save_string_buffer(tensor));
+
+        // compressed data is copied when memory-mapping the file
+        loaded = TensorMap::load_mmap("compressed.npz");
+        check_loaded_tensor(loaded);
+
+        std::remove("compressed.npz");
+    }
+
+    SECTION("Save to a stream") {
+        auto tensor = TensorMap::load(DATA_NPZ);
+        auto expected = TensorMap::save_string_buffer(tensor);
+
+        auto stream = std::ostringstream();
+        TensorMap::save(stream, tensor);
+        CHECK(stream.str() == expected);
+
+        // data is written starting at the current position of the stream
+        stream = std::ostringstream();
+        stream << "prefix";
+        TensorMap::save(stream, tensor);
+        CHECK(stream.str() == "prefix" + expected);
+
+        // errors from the stream are reported
+        stream = std::ostringstream();
+        stream.setstate(std::ios::badbit);
+        CHECK_THROWS_WITH(
+            TensorMap::save(stream, tensor),
+            Catch::Matchers::Contains("stream")
+        );
+    }
 }
 
 
@@ -337,13 +743,14 @@ TensorMap test_tensor_map() {
 }
 
 
-eqs_status_t custom_create_array(const uintptr_t* shape_ptr, uintptr_t shape_count, eqs_array_t *array) {
+eqs_status_t custom_create_array(void*, const uintptr_t* shape_ptr, uintptr_t shape_count, eqs_dtype_t dtype, eqs_array_t *array) {
     auto shape = std::vector<size_t>();
     for (size_t i=0; i<shape_count; i++) {
         shape.push_back(static_cast<size_t>(shape_ptr[i]));
     }
 
     CUSTOM_CREATE_ARRAY_CALL_COUNT += 1;
+    CHECK(dtype == EQS_DTYPE_FLOAT64);
 
     auto cxx_array = std::unique_ptr<DataArrayBase>(new SimpleDataArray(shape));
     *array = DataArrayBase::to_eqs_array_t(std::move(cxx_array));
@@ -377,3 +784,71 @@ void check_loaded_tensor(equistore::TensorMap& tensor) {
 
     CHECK(gradient.values().shape() == std::vector<size_t>{59, 3, 5, 3});
 }
+
+void check_same_tensor(TensorMap tensor, TensorMap reference) {
+    CHECK(tensor.keys() == reference.keys());
+    for (size_t i=0; i<reference.keys().count(); i++) {
+        auto block = tensor.block_by_id(i);
+        auto expected = reference.block_by_id(i);
+
+        CHECK(block.samples() == expected.samples());
+        CHECK(block.properties() == expected.properties());
+        CHECK(SimpleDataArray::from_eqs_array(block.eqs_array()) == SimpleDataArray::from_eqs_array(expected.eqs_array()));
+
+        CHECK(block.gradients_list() == expected.gradients_list());
+        for (const auto& parameter: expected.gradients_list()) {
+            auto gradient = block.gradient(parameter);
+            auto expected_gradient = expected.gradient(parameter);
+
+            CHECK(gradient.samples() == expected_gradient.samples());
+            CHECK(SimpleDataArray::from_eqs_array(gradient.eqs_array()) == SimpleDataArray::from_eqs_array(expected_gradient.eqs_array()));
+        }
+    }
+}
+
+TensorMap sparse_tensor_map(TensorMap& tensor) {
+    auto to_sparse = [](TensorBlock& block) {
+        auto values = block.values();
+        auto data = std::vector<double>(values.data(), values.data() + details::product(values.shape()));
+        return TensorBlock(
+            std::unique_ptr<SparseDataArray>(new SparseDataArray(values.shape(), data)),
+            block.samples(),
+            block.components(),
+            block.properties()
+        );
+    };
+
+    auto blocks = std::vector<TensorBlock>();
+    for (size_t i=0; i<tensor.keys().count(); i++) {
+        auto block = tensor.block_by_id(i);
+        auto sparse = to_sparse(block);
+        for (const auto& parameter: block.gradients_list()) {
+            auto gradient = block.gradient(parameter);
+            sparse.add_gradient(parameter, to_sparse(gradient));
+        }
+        blocks.emplace_back(std::move(sparse));
+    }
+
+    return TensorMap(tensor.keys(), std::move(blocks));
+}
+
+void check_sparse_tensor(TensorMap sparse, TensorMap reference) {
+    CHECK(sparse.keys() == reference.keys());
+    for (size_t i=0; i<reference.keys().count(); i++) {
+        auto block = sparse.block_by_id(i);
+        auto expected = reference.block_by_id(i);
+
+        CHECK(block.samples() == expected.samples());
+        CHECK(block.properties() == expected.properties());
+        CHECK(SparseDataArray::from_eqs_array(block.eqs_array()).to_dense() == SimpleDataArray::from_eqs_array(expected.eqs_array()));
+
+        CHECK(block.gradients_list() == expected.gradients_list());
+        for (const auto& parameter: expected.gradients_list()) {
+            auto gradient = block.gradient(parameter);
+            auto expected_gradient = expected.gradient(parameter);
+
+            CHECK(gradient.samples() == expected_gradient.samples());
+            CHECK(SparseDataArray::from_eqs_array(gradient.eqs_array()).to_dense() == SimpleDataArray::from_eqs_array(expected_gradient.eqs_array()));
+        }
+    }
+}
@@ -0,0 +1,149 @@
+#include <atomic>
+#include <thread>
+
+#include <catch.hpp>
+
+#include <equistore.hpp>
+using namespace equistore;
+
+static const size_t N_THREADS = 8;
+
+static eqs_status_t failing_create_array(void*, const uintptr_t*, uintptr_t, eqs_dtype_t, eqs_array_t*) {
+    return details::catch_exceptions([]() -> eqs_status_t {
+        throw std::runtime_error("failed to create array");
+    });
+}
+
+TEST_CASE("Concurrent read access") {
+    SECTION("blocks and labels") {
+        // DATA_NPZ is defined by cmake and expand to the path of tests/data.npz
+        auto tensor = TensorMap::load(DATA_NPZ);
+        auto n_blocks = tensor.keys().count();
+
+        // reference data, computed on a single thread
+        auto samples_count = std::vector<size_t>();
+        auto gradient_samples_count = std::vector<size_t>();
+        auto values_sum = std::vector<double>();
+        for (size_t i=0; i<n_blocks; i++) {
+            auto block = tensor.block_by_id(i);
+            samples_count.push_back(block.samples().count());
+            gradient_samples_count.push_back(block.gradient("positions").samples().count());
+
+            auto values = block.values();
+            auto sum = 0.0;
+            for (size_t j=0; j<details::product(values.shape()); j++) {
+                sum += values.data()[j];
+            }
+            values_sum.push_back(sum);
+        }
+
+        // Catch assertions are not thread-safe, so we count the errors and
+        // check them on the main thread
+        std::atomic<size_t> errors(0);
+        auto read_blocks = [&](size_t thread_id) {
+            for (size_t iteration=0; iteration<20; iteration++) {
+                for (size_t j=0; j<n_blocks; j++) {
+                    // start at a different block in each thread
+                    auto i = (j + thread_id) % n_blocks;
+                    auto block = tensor.block_by_id(i);
+
+                    if (block.samples().count() != samples_count[i]) {
+                        errors += 1;
+                    }
+
+                    if (block.components().size() + 2 != block.values().shape().size()) {
+                        errors += 1;
+                    }
+
+                    if (block.properties().count() != block.values().shape().back()) {
+                        errors += 1;
+                    }
+
+                    auto values = block.values();
+                    auto sum = 0.0;
+                    for (size_t k=0; k<details::product(values.shape()); k++) {
+                        sum += values.data()[k];
+                    }
+                    if (sum != values_sum[i]) {
+                        errors += 1;
+                    }
+
+                    if (block.gradients_list() != std::vector<std::string>{"positions"}) {
+                        errors += 1;
+                    }
+
+                    auto gradient = block.gradient("positions");
+                    if (gradient.samples().count() != gradient_samples_count[i]) {
+                        errors += 1;
+                    }
+                }
+            }
+        };
+
+        auto threads = std::vector<std::thread>();
+        for (size_t i=0; i<N_THREADS; i++) {
+            threads.emplace_back(read_blocks, i);
+        }
+
+        for (auto& thread: threads) {
+            thread.join();
+        }
+
+        CHECK(errors == 0);
+    }
+
+    SECTION("labels user data") {
+        auto labels = Labels({"a", "b"}, {{0, 1}, {1, 2}, {2, 3}});
+        labels.set_user_data(LabelsUserData(new size_t(0), [](void* data) {
+            delete static_cast<size_t*>(data);
+        }));
+
+        std::atomic<size_t> errors(0);
+        std::atomic<bool> done(false);
+
+        // readers keep using the data while it is being replaced
+        auto read_user_data = [&](Labels shared) {
+            while (!done) {
+                auto* data = static_cast<size_t*>(shared.user_data());
+                if (data == nullptr || *data > 1000) {
+                    errors += 1;
+                }
+
+                if (shared.position({1, 2}) != 1) {
+                    errors += 1;
+                }
+            }
+        };
+
+        auto threads = std::vector<std::thread>();
+        for (size_t i=0; i<N_THREADS; i++) {
+            // each thread gets its own reference to the same labels
+            threads.emplace_back(read_user_data, labels);
+        }
+
+        for (size_t i=1; i<=1000; i++) {
+            labels.set_user_data(LabelsUserData(new size_t(i), [](void* data) {
+                delete static_cast<size_t*>(data);
+            }));
+        }
+        done = true;
+
+        for (auto& thread: threads) {
+            thread.join();
+        }
+
+        CHECK(errors == 0);
+        CHECK(*static_cast<size_t*>(labels.user_data()) == 1000);
+    }
+
+    SECTION("errors in callbacks") {
+        // the callbacks are running on other threads, but the error message
+        // should still be available on this thread
+        for (size_t i=0; i<3; i++) {
+            CHECK_THROWS_WITH(
+                TensorMap::load(DATA_NPZ, failing_create_array, 3),
+                "error in C++ callback: failed to create array"
+            );
+        }
+    }
+}
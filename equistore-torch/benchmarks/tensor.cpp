@@ -0,0 +1,163 @@
+#include <benchmark/benchmark.h>
+
+#include <torch/torch.h>
+
+#include <equistore/torch.hpp>
+using namespace equistore_torch;
+
+// QM7_POWER_SPECTRUM and QM7_SPHERICAL_EXPANSION are defined by cmake, and
+// expand to the path of the corresponding files in
+// python/equistore-operations/tests/data
+
+// Create a (n_entries x 3) tensor of labels values, looking like samples in a
+// block (structure, center, neighbor), starting at structure `first`
+static torch::Tensor labels_values(int64_t n_entries, int32_t first = 0) {
+    auto i = torch::arange(n_entries, torch::TensorOptions().dtype(torch::kInt32));
+    return torch::stack({
+        first + torch::div(i, 100, /*rounding_mode=*/"floor"),
+        torch::div(i, 10, /*rounding_mode=*/"floor").remainder(10),
+        i.remainder(10),
+    }, 1);
+}
+
+static void labels_create(benchmark::State& state) {
+    auto values = labels_values(state.range(0));
+    for (auto _: state) {
+        auto labels = torch::make_intrusive<LabelsHolder>(
+            std::vector<std::string>{"structure", "center", "neighbor"},
+            values
+        );
+        benchmark::DoNotOptimize(labels->count());
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+static void labels_positions(benchmark::State& state) {
+    auto values = labels_values(state.range(0));
+    auto labels = torch::make_intrusive<LabelsHolder>(
+        std::vector<std::string>{"structure", "center", "neighbor"},
+        values
+    );
+
+    for (auto _: state) {
+        auto positions = labels->positions(values);
+        benchmark::DoNotOptimize(positions.data_ptr());
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+static void labels_union(benchmark::State& state) {
+    auto n_entries = state.range(0);
+    auto first = torch::make_intrusive<LabelsHolder>(
+        std::vector<std::string>{"structure", "center", "neighbor"},
+        labels_values(n_entries)
+    );
+    auto second = torch::make_intrusive<LabelsHolder>(
+        std::vector<std::string>{"structure", "center", "neighbor"},
+        labels_values(n_entries, static_cast<int32_t>(n_entries / 200))
+    );
+
+    for (auto _: state) {
+        auto result = first->set_union(second);
+        benchmark::DoNotOptimize(result->count());
+    }
+
+    state.SetItemsProcessed(2 * state.iterations() * state.range(0));
+}
+
+static void tensor_load(benchmark::State& state, const char* path) {
+    for (auto _: state) {
+        auto tensor = equistore_torch::load(path, state.range(0));
+        benchmark::DoNotOptimize(tensor->keys()->count());
+    }
+}
+
+static void keys_to_properties(benchmark::State& state, const char* path, std::vector<std::string> keys) {
+    auto tensor = equistore_torch::load(path);
+    for (auto _: state) {
+        auto result = tensor->keys_to_properties(keys, /*sort_samples=*/true, state.range(0));
+        benchmark::DoNotOptimize(result->keys()->count());
+    }
+}
+
+static void keys_to_samples(benchmark::State& state, const char* path, std::vector<std::string> keys) {
+    auto tensor = equistore_torch::load(path);
+    for (auto _: state) {
+        auto result = tensor->keys_to_samples(keys, /*sort_samples=*/true, state.range(0));
+        benchmark::DoNotOptimize(result->keys()->count());
+    }
+}
+
+static void components_to_properties(benchmark::State& state) {
+    auto tensor = equistore_torch::load(QM7_SPHERICAL_EXPANSION);
+    for (auto _: state) {
+        auto result = tensor->components_to_properties("spherical_harmonics_m");
+        benchmark::DoNotOptimize(result->keys()->count());
+    }
+}
+
+static void blocks_matching(benchmark::State& state) {
+    auto tensor = equistore_torch::load(QM7_SPHERICAL_EXPANSION);
+    auto centers = tensor->keys()->column("species_center");
+
+    auto selections = std::vector<TorchLabels>();
+    for (int64_t i=0; i<centers.size(0); i++) {
+        selections.emplace_back(torch::make_intrusive<LabelsHolder>(
+            std::vector<std::string>{"species_center"},
+            centers.narrow(0, i, 1).reshape({1, 1})
+        ));
+    }
+
+    for (auto _: state) {
+        for (const auto& selection: selections) {
+            benchmark::DoNotOptimize(tensor->blocks_matching(selection).size());
+        }
+    }
+
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * selections.size()));
+}
+
+// Access the metadata of all blocks, as TorchScript models typically do when
+// iterating over a TensorMap
+static void metadata_access(benchmark::State& state) {
+    auto tensor = equistore_torch::load(QM7_SPHERICAL_EXPANSION);
+    auto n_blocks = tensor->keys()->count();
+
+    for (auto _: state) {
+        for (int64_t i=0; i<n_blocks; i++) {
+            auto block = tensor->block_by_id(i);
+            benchmark::DoNotOptimize(block->samples()->count());
+            benchmark::DoNotOptimize(block->components().size());
+            benchmark::DoNotOptimize(block->properties()->count());
+            benchmark::DoNotOptimize(tensor->keys()->count());
+        }
+    }
+
+    state.SetItemsProcessed(state.iterations() * n_blocks);
+}
+
+#define LABELS_ARGS RangeMultiplier(10)->Range(1000, 1000000)
+
+BENCHMARK(labels_create)->LABELS_ARGS;
+BENCHMARK(labels_positions)->LABELS_ARGS;
+BENCHMARK(labels_union)->LABELS_ARGS;
+
+BENCHMARK_CAPTURE(tensor_load, power_spectrum, QM7_POWER_SPECTRUM)->Arg(1)->Arg(0);
+BENCHMARK_CAPTURE(tensor_load, spherical_expansion, QM7_SPHERICAL_EXPANSION)->Arg(1)->Arg(0);
+
+// braces can not be used inside the BENCHMARK_CAPTURE macro
+static const std::vector<std::string> PS_NEIGHBORS = {"species_neighbor_1", "species_neighbor_2"};
+static const std::vector<std::string> SE_NEIGHBORS = {"species_neighbor"};
+static const std::vector<std::string> CENTERS = {"species_center"};
+
+BENCHMARK_CAPTURE(keys_to_properties, power_spectrum, QM7_POWER_SPECTRUM, PS_NEIGHBORS)->Arg(1)->Arg(0);
+BENCHMARK_CAPTURE(keys_to_properties, spherical_expansion, QM7_SPHERICAL_EXPANSION, SE_NEIGHBORS)->Arg(1)->Arg(0);
+
+BENCHMARK_CAPTURE(keys_to_samples, power_spectrum, QM7_POWER_SPECTRUM, CENTERS)->Arg(1)->Arg(0);
+BENCHMARK_CAPTURE(keys_to_samples, spherical_expansion, QM7_SPHERICAL_EXPANSION, CENTERS)->Arg(1)->Arg(0);
+
+BENCHMARK(components_to_properties);
+BENCHMARK(blocks_matching);
+BENCHMARK(metadata_access);
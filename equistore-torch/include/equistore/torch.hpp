@@ -4,4 +4,6 @@
 #include "equistore/torch/labels.hpp"
 #include "equistore/torch/block.hpp"
 #include "equistore/torch/tensor.hpp"
+#include "equistore/torch/lazy.hpp"
 #include "equistore/torch/misc.hpp"
+#include "equistore/torch/operations.hpp"
@@ -1,6 +1,8 @@
 #ifndef EQUISTORE_TORCH_ARRAY_HPP
 #define EQUISTORE_TORCH_ARRAY_HPP
 
+#include <memory>
+#include <mutex>
 #include <vector>
 
 #include <torch/script.h>
@@ -15,7 +17,12 @@ namespace equistore_torch {
 extern eqs_data_origin_t TORCH_DATA_ORIGIN;
 
 /// An `equistore::DataArrayBase` implementation using `torch::Tensor` to store
-/// the data
+/// the data.
+///
+/// Tensors which are not on CPU are saved and loaded a few samples at the
+/// time (see `get_samples()` and `set_samples()`), going through pinned host
+/// memory for CUDA devices. This allows saving and loading such tensors
+/// without moving all of them to CPU first.
 class EQUISTORE_TORCH_EXPORT TorchDataArray: public equistore::DataArrayBase {
 public:
     /// Create a `TorchDataArray` containing the given `tensor`
@@ -24,9 +31,9 @@ public:
     virtual ~TorchDataArray() override = default;
 
     /// TorchDataArray can be copy-constructed
-    TorchDataArray(const TorchDataArray&) = default;
+    TorchDataArray(const TorchDataArray& other);
     /// TorchDataArray can be copy-assigned
-    TorchDataArray& operator=(const TorchDataArray&) = default;
+    TorchDataArray& operator=(const TorchDataArray& other);
     /// TorchDataArray can be move-constructed
     TorchDataArray(TorchDataArray&&) noexcept = default;
     /// TorchDataArray can be move-assigned
@@ -50,12 +57,21 @@ public:
 
     std::unique_ptr<equistore::DataArrayBase> copy() const override;
 
+    using equistore::DataArrayBase::create;
     std::unique_ptr<equistore::DataArrayBase> create(std::vector<uintptr_t> shape) const override;
 
+    using equistore::DataArrayBase::create_uninit;
+    std::unique_ptr<equistore::DataArrayBase> create_uninit(std::vector<uintptr_t> shape) const override;
+
     double* data() override;
 
+    eqs_dtype_t dtype() const override;
+
+    void* raw_data() override;
+
     const std::vector<uintptr_t>& shape() const override;
 
+    using equistore::DataArrayBase::reshape;
     void reshape(std::vector<uintptr_t> shape) override;
 
     void swap_axes(uintptr_t axis_1, uintptr_t axis_2) override;
@@ -67,6 +83,39 @@ public:
         uintptr_t property_end
     ) override;
 
+    /// Runs of consecutive input and output samples are copied directly
+    /// between views of the tensors, if there are only a few of them or if
+    /// they are long enough. Otherwise, the mapping is uploaded to the device
+    /// and used with `index_copy_`. When the input samples are not
+    /// contiguous, this last case gathers them in a temporary tensor first.
+    void move_samples_from(
+        const equistore::DataArrayBase& input,
+        const eqs_sample_mapping_t* samples,
+        size_t samples_count,
+        uintptr_t property_start,
+        uintptr_t property_end
+    ) override;
+
+    /// Only tensors on CPU give direct access to their data, tensors on other
+    /// devices are saved and loaded through `get_samples()` and
+    /// `set_samples()`
+    bool raw_data_available() const override;
+
+    /// Copy the samples from `sample_start` to `sample_end` to `data`, going
+    /// through a pinned host buffer for CUDA tensors.
+    ///
+    /// This function is called for consecutive ranges of samples when saving
+    /// a tensor, so it also starts copying the next range of samples to the
+    /// host, which will then be ready on the next call.
+    void get_samples(uintptr_t sample_start, uintptr_t sample_end, void* data) const override;
+
+    /// Set the samples from `sample_start` to `sample_end` from `data`.
+    ///
+    /// For CUDA tensors, the data is copied to a pinned host buffer and then
+    /// asynchronously to the device, so the next range of samples can be read
+    /// from the file while the previous one is being copied.
+    void set_samples(uintptr_t sample_start, uintptr_t sample_end, const void* data) override;
+
 private:
     // cache the array shape as a vector of unsigned integers (as expected by
     // equistore) instead of signed integer (as stored in torch::Tensor::sizes)
@@ -75,6 +124,25 @@ private:
 
     // the actual data
     torch::Tensor tensor_;
+
+    /// Host copy of a range of samples, started by `get_samples()` for the
+    /// next call
+    struct Prefetch {
+        std::mutex mutex;
+        uintptr_t sample_start = 0;
+        uintptr_t sample_end = 0;
+        // version counter of `tensor_` when the copy was started
+        int64_t version = 0;
+        torch::Tensor host;
+    };
+    // this is never shared between arrays, and is reset when the tensor
+    // changes
+    std::unique_ptr<Prefetch> prefetch_;
+
+    /// Start copying the samples from `sample_start` to `sample_end` to a new
+    /// host tensor
+    torch::Tensor copy_samples_to_host(uintptr_t sample_start, uintptr_t sample_end) const;
+    void reset_prefetch();
 };
 
 }
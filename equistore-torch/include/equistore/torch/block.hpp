@@ -1,6 +1,8 @@
 #ifndef EQUISTORE_TORCH_BLOCK_HPP
 #define EQUISTORE_TORCH_BLOCK_HPP
 
+#include <mutex>
+#include <unordered_map>
 #include <vector>
 
 #include <torch/script.h>
@@ -21,6 +23,11 @@ using TorchTensorBlock = torch::intrusive_ptr<TensorBlockHolder>;
 /// Python/TorchScript code will typically manipulate
 /// `torch::intrusive_ptr<TensorBlockHolder>` (i.e. `TorchTensorBlock`) instead
 /// of instances of `TensorBlockHolder`.
+///
+/// The `TorchLabels` returned by `samples()`, `components()` and
+/// `properties()` and the `TorchTensorBlock` returned by `gradient()` are
+/// created on first access and then cached, so repeated accesses return the
+/// same objects without calling into equistore again.
 class EQUISTORE_TORCH_EXPORT TensorBlockHolder: public torch::CustomClassHolder {
 public:
     /// Create a new TensorBlockHolder with the given data and metadata
@@ -41,9 +48,7 @@ public:
     /// Get a view in the values in this block
     torch::Tensor values();
 
-    /// Get the labels in this block associated with either `"values"` or one
-    /// gradient (by setting `values_gradients` to the gradient parameter); in
-    /// the given `axis`.
+    /// Get the labels in this block associated with the given `axis`.
     TorchLabels labels(uintptr_t axis) const;
 
     /// Access the sample `Labels` for this block.
@@ -58,16 +63,7 @@ public:
     ///
     /// The entries in these labels describe intermediate dimensions of the
     /// `values()` array.
-    std::vector<TorchLabels> components() const {
-        auto shape = this->block_.values_shape();
-
-        auto result = std::vector<TorchLabels>();
-        for (size_t i=1; i<shape.size() - 1; i++) {
-            result.emplace_back(this->labels(i));
-        }
-
-        return result;
-    }
+    std::vector<TorchLabels> components() const;
 
     /// Access the property `Labels` for this block.
     ///
@@ -75,8 +71,7 @@ public:
     /// `values()` array. The properties are guaranteed to be the same for
     /// values and gradients in the same block.
     TorchLabels properties() const {
-        auto shape = this->block_.values_shape();
-        return this->labels(shape.size() - 1);
+        return this->labels(labels_.size() - 1);
     }
 
     /// Add a set of gradients with respect to `parameters` in this block.
@@ -128,6 +123,14 @@ private:
     /// If this TensorBlock contains gradients, these are gradients w.r.t. this
     /// parameter
     std::string parameter_;
+
+    /// Protects the caches below, which can be filled concurrently from
+    /// different threads
+    mutable std::mutex cache_mutex_;
+    /// Labels for each axis of the values, `nullptr` until first accessed
+    mutable std::vector<TorchLabels> labels_;
+    /// Gradients of this block already accessed through `gradient()`
+    mutable std::unordered_map<std::string, TorchTensorBlock> gradients_;
 };
 
 }
@@ -2,6 +2,7 @@
 #define EQUISTORE_TORCH_LABELS_HPP
 
 #include <c10/core/Device.h>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -46,6 +47,22 @@ public:
     /// and the values should be a 2D tensor of integers.
     LabelsHolder(torch::IValue names, torch::Tensor values);
 
+    /// Construct `LabelsHolder` from a set of names and the corresponding
+    /// values, deferring the creation of the underlying `equistore::Labels`
+    /// until a function actually needs them.
+    ///
+    /// This only checks the type and shape of `values`, and never accesses the
+    /// data. In particular, the values are not copied to the CPU and the
+    /// uniqueness of the entries is only checked when the `equistore::Labels`
+    /// are created (i.e. when calling `as_equistore()`, `position()`, using
+    /// the labels in a `TensorBlock`, *etc.*). Use `has_unique_entries()` to
+    /// check the entries on the same device as the values.
+    static TorchLabels deferred(torch::IValue names, torch::Tensor values);
+
+    /// Copy an existing `LabelsHolder`, sharing the values and the underlying
+    /// `equistore::Labels` if they have been created
+    LabelsHolder(const LabelsHolder& other);
+
     /// Convenience constructor for building `LabelsHolder` in C++, similar to
     /// `equistore::Labels`.
     static TorchLabels create(
@@ -110,6 +127,23 @@ public:
     ///    - a tuple of integers;
     torch::optional<int64_t> position(torch::IValue entry) const;
 
+    /// Get the positions of all the `entries` in this set of Labels in a
+    /// single call. `entries` should be a 2-D tensor of integers with one
+    /// entry per row.
+    ///
+    /// The positions are returned as a 1-D tensor of 64-bit integers on the
+    /// same device as `entries`, containing -1 for entries which are not part
+    /// of these labels.
+    torch::Tensor positions(torch::Tensor entries) const;
+
+    /// Check if all the entries in these Labels are unique, using only
+    /// operations running on the same device as `values()`.
+    ///
+    /// The result is returned as a 0-D boolean tensor on the same device as
+    /// `values()`, and no synchronization with the device is required to
+    /// compute it.
+    torch::Tensor has_unique_entries() const;
+
     /// Print the names and values of these Labels to a string, including at
     /// most `max_entries` entries (set this to -1 to print all entries), and
     /// indenting all lines after the first with `indent` spaces.
@@ -126,7 +160,7 @@ public:
 
     /// Is this a view inside existing Labels or an owned Labels?
     bool is_view() const {
-        return !labels_.has_value();
+        return is_view_;
     }
 
     /// Transform a view of Labels into owned Labels, which can be further given
@@ -135,7 +169,7 @@ public:
 
     // A view is created by the `view` function (also `__getitem__` in Python),
     // and does not have a corresponding `equistore::Labels` (`labels_` is
-    // `nullopt`)
+    // always `nullopt`)
     LabelsHolder to_owned() const;
 
     /// Get the union of `this` and `other`
@@ -146,6 +180,16 @@ public:
     /// output.
     std::tuple<TorchLabels, torch::Tensor, torch::Tensor> union_and_mapping(const TorchLabels& other) const;
 
+    /// Get the union of all the `labels` in a single pass. The result contains
+    /// the entries of `labels[0]`, followed by the new entries of
+    /// `labels[1]`, etc.
+    static TorchLabels union_many(const std::vector<TorchLabels>& labels);
+
+    /// Get the union of all the `labels` in a single pass, as well as the
+    /// mapping from positions of entries in each input to the position of
+    /// entries in the output.
+    static std::tuple<TorchLabels, std::vector<torch::Tensor>> union_many_and_mapping(const std::vector<TorchLabels>& labels);
+
     /// Get the intersection of `this` and `other`
     TorchLabels set_intersection(const TorchLabels& other) const;
 
@@ -162,6 +206,13 @@ private:
     /// Create a view for an existing `LabelsHolder`
     LabelsHolder(std::vector<std::string> names, torch::Tensor values, CreateView);
 
+    /// marker type to differentiate the private constructor below from the main
+    /// one
+    struct CreateDeferred {};
+
+    /// Create owned labels without creating the underlying `equistore::Labels`
+    LabelsHolder(std::vector<std::string> names, torch::Tensor values, CreateDeferred);
+
     friend class torch::intrusive_ptr<LabelsHolder>;
 
     /// names of the Labels, stored here for easier retrieval from Python
@@ -170,9 +221,16 @@ private:
     /// Keep the values of the Labels inside a Tensor as well
     torch::Tensor values_;
 
+    /// Is this a view (with selected columns) into another Labels?
+    bool is_view_;
+
     /// Underlying equistore labels, this is undefined when the Labels is
-    /// actually a view (with selected columns) into another Labels
-    torch::optional<equistore::Labels> labels_;
+    /// actually a view into another Labels, or when the creation of the
+    /// labels was deferred and they have not been needed yet
+    mutable torch::optional<equistore::Labels> labels_;
+
+    /// Protects the deferred creation of `labels_`
+    mutable std::mutex labels_mutex_;
 };
 
 /// Check two `LabelsHolder` for equality
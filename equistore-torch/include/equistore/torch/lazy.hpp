@@ -0,0 +1,66 @@
+#ifndef EQUISTORE_TORCH_LAZY_HPP
+#define EQUISTORE_TORCH_LAZY_HPP
+
+#include <mutex>
+#include <vector>
+
+#include <torch/script.h>
+
+#include <equistore.hpp>
+
+#include "equistore/torch/exports.h"
+#include "equistore/torch/labels.hpp"
+#include "equistore/torch/block.hpp"
+
+namespace equistore_torch {
+
+class LazyTensorMapHolder;
+/// TorchScript will always manipulate `LazyTensorMapHolder` through a `torch::intrusive_ptr`
+using TorchLazyTensorMap = torch::intrusive_ptr<LazyTensorMapHolder>;
+
+/// Wrapper around `equistore::LazyTensorMap` for integration with TorchScript
+///
+/// Blocks are loaded from the file the first time they are requested, using
+/// torch tensors to store the data. Loaded blocks are kept in memory to be
+/// re-used later, optionally keeping only the most recently used ones.
+class EQUISTORE_TORCH_EXPORT LazyTensorMapHolder: public torch::CustomClassHolder {
+public:
+    /// Open the `TensorMap` saved at `path`, keeping at most `max_blocks`
+    /// loaded blocks in memory. Use 0 to keep all loaded blocks in memory.
+    LazyTensorMapHolder(const std::string& path, int64_t max_blocks);
+
+    /// Get the keys for this `TensorMap`
+    TorchLabels keys() const {
+        return keys_;
+    }
+
+    /// Get a (possibly empty) list of block indexes matching the `selection`
+    std::vector<int64_t> blocks_matching(const TorchLabels& selection) const;
+
+    /// Get a block inside this `TensorMap` by it's index/the index of the
+    /// corresponding key, loading it from the file if needed.
+    TorchTensorBlock block_by_id(int64_t index);
+
+    /// Get the number of blocks currently kept in memory
+    int64_t loaded_blocks() const;
+
+    /// Release all the blocks kept in memory. Blocks previously returned by
+    /// `block_by_id` stay valid.
+    void clear();
+
+private:
+    /// Underlying lazy tensor map, only used to load blocks without caching
+    equistore::LazyTensorMap lazy_;
+    /// Keys of the tensor map, read when opening the file
+    TorchLabels keys_;
+
+    /// Protects `cache_`, since TorchScript code might call `block_by_id`
+    /// from multiple threads
+    mutable std::mutex mutex_;
+    /// Cache of the already loaded blocks
+    equistore::details::LruCache<TorchTensorBlock> cache_;
+};
+
+}
+
+#endif
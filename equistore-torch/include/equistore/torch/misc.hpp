@@ -10,23 +10,49 @@
 
 #include "equistore/torch/exports.h"
 #include "equistore/torch/tensor.hpp"
+#include "equistore/torch/lazy.hpp"
 
 namespace equistore_torch {
 
 namespace details {
     /// Function to be used as `eqs_create_array_callback_t` to load data in
-    /// torch Tensor.
+    /// torch Tensor, using the same dtype as the data in the file. If
+    /// `user_data` is not `nullptr`, it should point to the `torch::Device`
+    /// on which the tensors are created. Tensors are created on CPU otherwise.
     EQUISTORE_TORCH_EXPORT eqs_status_t create_torch_array(
+        void* user_data,
         const uintptr_t* shape_ptr,
         uintptr_t shape_count,
+        eqs_dtype_t dtype,
         eqs_array_t* array
     );
 }
 
-/// Load a previously saved `TensorMap` from the given path.
-EQUISTORE_TORCH_EXPORT TorchTensorMap load(const std::string& path);
-
-/// Save the given `TensorMap` to a file at `path`
+/// Load a previously saved `TensorMap` from the given path, decoding the
+/// blocks with the given number of `threads` (0 means one thread per CPU core).
+///
+/// The values and gradients are created directly on the given `device`
+/// (default to CPU), without creating a copy of the whole `TensorMap` on CPU
+/// first. For CUDA devices, data is read from the file a few samples at the
+/// time, and copied to the device through pinned host memory while the next
+/// samples are read.
+EQUISTORE_TORCH_EXPORT TorchTensorMap load(
+    const std::string& path,
+    int64_t threads = 1,
+    torch::optional<torch::Device> device = torch::nullopt
+);
+
+/// Open a previously saved `TensorMap` from the given path, loading blocks
+/// only when they are accessed. At most `max_blocks` loaded blocks are kept
+/// in memory, use 0 to keep all of them.
+EQUISTORE_TORCH_EXPORT TorchLazyTensorMap load_lazy(const std::string& path, int64_t max_blocks = 0);
+
+/// Save the given `TensorMap` to a file at `path`.
+///
+/// The values and gradients can be on any device. Data which is not on CPU is
+/// copied to the host a few samples at the time (through pinned memory for
+/// CUDA devices) while the previous samples are written to the file, instead
+/// of moving the whole `TensorMap` to CPU first.
 EQUISTORE_TORCH_EXPORT void save(const std::string& path, TorchTensorMap tensor);
 
 }
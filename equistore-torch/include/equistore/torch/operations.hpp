@@ -0,0 +1,79 @@
+#ifndef EQUISTORE_TORCH_OPERATIONS_HPP
+#define EQUISTORE_TORCH_OPERATIONS_HPP
+
+#include <string>
+#include <vector>
+
+#include <torch/script.h>
+
+#include <equistore.hpp>
+
+#include "equistore/torch/exports.h"
+#include "equistore/torch/labels.hpp"
+#include "equistore/torch/tensor.hpp"
+
+namespace equistore_torch {
+
+/// Get a new `TensorMap` with the values being the sum of `A` and `B`.
+///
+/// `B` can either be a scalar (`float` or `int`), or a `TorchTensorMap` with
+/// the same metadata as `A` (including gradients). Gradients are propagated to
+/// the result, but gradients of gradients are not supported.
+EQUISTORE_TORCH_EXPORT TorchTensorMap add(TorchTensorMap A, torch::IValue B);
+
+/// Get a new `TensorMap` with the values being the element-wise product of
+/// `A` and `B`.
+///
+/// `B` can either be a scalar (`float` or `int`), or a `TorchTensorMap` with
+/// the same metadata as `A` (including gradients). Gradients are propagated to
+/// the result using the product rule, but gradients of gradients are not
+/// supported.
+EQUISTORE_TORCH_EXPORT TorchTensorMap multiply(TorchTensorMap A, torch::IValue B);
+
+/// Compute the dot product of two `TensorMap` with the same keys.
+///
+/// The values of each block in the result are `A.values @ B.values.T`. Blocks
+/// in `A` and `B` with the same key must have the same properties, and the
+/// blocks in `B` should not have components or gradients. The samples of the
+/// blocks in `B` become the properties of the result.
+EQUISTORE_TORCH_EXPORT TorchTensorMap dot(TorchTensorMap A, TorchTensorMap B);
+
+/// Sum the values of all blocks in `tensor` over the given `sample_names`,
+/// which can be a single string or a list/tuple of strings.
+///
+/// The samples of the result only contain the remaining dimensions, and
+/// gradients are propagated to the result.
+EQUISTORE_TORCH_EXPORT TorchTensorMap sum_over_samples(TorchTensorMap tensor, torch::IValue sample_names);
+
+/// Same as `sum_over_samples`, but computing the mean of the values
+EQUISTORE_TORCH_EXPORT TorchTensorMap mean_over_samples(TorchTensorMap tensor, torch::IValue sample_names);
+
+/// Same as `sum_over_samples`, but computing the variance of the values
+EQUISTORE_TORCH_EXPORT TorchTensorMap var_over_samples(TorchTensorMap tensor, torch::IValue sample_names);
+
+/// Same as `sum_over_samples`, but computing the standard deviation of the
+/// values
+EQUISTORE_TORCH_EXPORT TorchTensorMap std_over_samples(TorchTensorMap tensor, torch::IValue sample_names);
+
+/// Slice all the blocks in `tensor` along the given `axis` (either
+/// `"samples"` or `"properties"`), keeping only the entries matching one of
+/// the entries in `labels`.
+///
+/// `labels` can contain a subset of the dimensions of the corresponding axis,
+/// and the entries are matched on these dimensions only. The result contains
+/// the same keys as `tensor`, and blocks can end up with no samples or no
+/// properties.
+EQUISTORE_TORCH_EXPORT TorchTensorMap slice(TorchTensorMap tensor, std::string axis, TorchLabels labels);
+
+/// Join a list of `TensorMap` with the same keys along the given `axis`
+/// (either `"samples"` or `"properties"`).
+///
+/// A new `"tensor"` dimension, containing the index of the corresponding
+/// `TensorMap` in `tensors`, is added to the samples or properties. When
+/// joining along properties with different property names, the properties
+/// are replaced by a single `"property"` dimension.
+EQUISTORE_TORCH_EXPORT TorchTensorMap join(const std::vector<TorchTensorMap>& tensors, std::string axis);
+
+}
+
+#endif
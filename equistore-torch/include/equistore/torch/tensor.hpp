@@ -1,6 +1,7 @@
 #ifndef EQUISTORE_TORCH_TENSOR_HPP
 #define EQUISTORE_TORCH_TENSOR_HPP
 
+#include <mutex>
 #include <vector>
 
 #include <torch/script.h>
@@ -22,6 +23,11 @@ using TorchTensorMap = torch::intrusive_ptr<TensorMapHolder>;
 /// Python/TorchScript code will typically manipulate
 /// `torch::intrusive_ptr<TensorMapHolder>` (i.e. `TorchTensorMap`) instead
 /// of instances of `TensorMapHolder`.
+///
+/// The keys and the blocks are wrapped into `TorchLabels` and
+/// `TorchTensorBlock` on first access and then cached, so repeated calls to
+/// `keys()` or `block_by_id()` return the same objects without calling into
+/// equistore again.
 class EQUISTORE_TORCH_EXPORT TensorMapHolder: public torch::CustomClassHolder {
 public:
     /// Wrap an existing `equistore::TensorMap` into a `TensorMapHolder`
@@ -95,8 +101,10 @@ public:
     /// this function.
     ///
     /// The input `torch::IValue` can be a single string, a list/tuple of
-    /// strings, or a `TorchLabels` instance.
-    TorchTensorMap keys_to_properties(torch::IValue keys_to_move, bool sort_samples) const;
+    /// strings, or a `TorchLabels` instance. `threads` is the number of threads
+    /// to use when merging blocks (1 to run on the current thread, 0 for one
+    /// thread per CPU core).
+    TorchTensorMap keys_to_properties(torch::IValue keys_to_move, bool sort_samples, int64_t threads = 1) const;
 
     /// Merge blocks with the same value for selected keys dimensions along the
     /// sample axis.
@@ -105,8 +113,17 @@ public:
     /// this function.
     ///
     /// The input `torch::IValue` can be a single string, a list/tuple of
-    /// strings, or a `TorchLabels` instance.
-    TorchTensorMap keys_to_samples(torch::IValue keys_to_move, bool sort_samples) const;
+    /// strings, or a `TorchLabels` instance. `threads` is the number of threads
+    /// to use when merging blocks (1 to run on the current thread, 0 for one
+    /// thread per CPU core).
+    TorchTensorMap keys_to_samples(torch::IValue keys_to_move, bool sort_samples, int64_t threads = 1) const;
+
+    /// Concatenate the blocks of all the `tensors` along the samples axis.
+    ///
+    /// See `equistore::TensorMap::join_samples` for more information on this
+    /// function. `threads` is the number of threads to use when joining
+    /// blocks (1 to run on the current thread, 0 for one thread per CPU core).
+    static TorchTensorMap join_samples(const std::vector<TorchTensorMap>& tensors, int64_t threads = 1);
 
     /// Move the given `dimensions` from the component labels to the property
     /// labels for each block.
@@ -140,8 +157,50 @@ public:
     }
 
 private:
+    /// Get the single block where the keys dimensions in `names` take the
+    /// corresponding `values`, without creating temporary `Labels`
+    TorchTensorBlock block_matching(const std::vector<std::string>& names, const std::vector<int32_t>& values);
+
     /// Underlying equistore TensorMap
     equistore::TensorMap tensor_;
+
+    /// Protects the caches below, which can be filled concurrently from
+    /// different threads
+    mutable std::mutex cache_mutex_;
+    /// Keys of the TensorMap, `nullptr` until first accessed
+    mutable TorchLabels keys_;
+    /// Blocks of the TensorMap, each one is `nullptr` until first accessed
+    std::vector<TorchTensorBlock> blocks_;
+};
+
+class TensorMapBuilderHolder;
+/// TorchScript will always manipulate `TensorMapBuilderHolder` through a `torch::intrusive_ptr`
+using TorchTensorMapBuilder = torch::intrusive_ptr<TensorMapBuilderHolder>;
+
+/// Wrapper around `equistore::TensorMapBuilder` for integration with
+/// TorchScript
+///
+/// Blocks can be added one at a time to the builder, appending their samples
+/// to the existing block when adding a block with the same key multiple times.
+class EQUISTORE_TORCH_EXPORT TensorMapBuilderHolder: public torch::CustomClassHolder {
+public:
+    /// Create a new empty builder, for a `TensorMap` with the given key names
+    TensorMapBuilderHolder(const std::vector<std::string>& names);
+
+    /// Add a `block` associated with the given `key` to this builder, or
+    /// append the samples of `block` to an existing block with the same key.
+    ///
+    /// See `equistore::TensorMapBuilder::add_block` for more information on
+    /// this function.
+    void add_block(const std::vector<int64_t>& key, const TorchTensorBlock& block);
+
+    /// Assemble all the blocks added so far into a `TensorMap`. The builder
+    /// can not be used after calling this function.
+    TorchTensorMap finish();
+
+private:
+    /// Underlying equistore builder
+    equistore::TensorMapBuilder builder_;
 };
 
 
@@ -1,7 +1,11 @@
+#include <algorithm>
 #include <vector>
 #include <cstdint>
+#include <cstring>
 
 #include <torch/script.h>
+#include <ATen/record_function.h>
+#include <c10/core/impl/VirtualGuardImpl.h>
 
 #include <equistore.hpp>
 
@@ -25,10 +29,28 @@ struct EqsOriginRegistration {
 };
 
 
-TorchDataArray::TorchDataArray(torch::Tensor tensor): tensor_(std::move(tensor)) {
+TorchDataArray::TorchDataArray(torch::Tensor tensor):
+    tensor_(std::move(tensor)),
+    prefetch_(new Prefetch())
+{
     this->update_shape();
 }
 
+TorchDataArray::TorchDataArray(const TorchDataArray& other):
+    shape_(other.shape_),
+    tensor_(other.tensor_),
+    prefetch_(new Prefetch())
+{}
+
+TorchDataArray& TorchDataArray::operator=(const TorchDataArray& other) {
+    if (this != &other) {
+        shape_ = other.shape_;
+        tensor_ = other.tensor_;
+        prefetch_.reset(new Prefetch());
+    }
+    return *this;
+}
+
 eqs_data_origin_t TorchDataArray::origin() const {
     // eqs_data_origin registration in a thread-safe way through C++11 static
     // initialization of a class with a constructor.
@@ -56,6 +78,22 @@ std::unique_ptr<equistore::DataArrayBase> TorchDataArray::create(std::vector<uin
     ));
 }
 
+std::unique_ptr<equistore::DataArrayBase> TorchDataArray::create_uninit(std::vector<uintptr_t> shape) const {
+    auto sizes = std::vector<int64_t>();
+    for (auto size: shape) {
+        sizes.push_back(static_cast<int64_t>(size));
+    }
+
+    return std::unique_ptr<DataArrayBase>(new TorchDataArray(
+        torch::empty(
+            sizes,
+            torch::TensorOptions()
+                .dtype(this->tensor().dtype())
+                .device(this->tensor().device())
+        )
+    ));
+}
+
 double* TorchDataArray::data() {
     if (!this->tensor_.device().is_cpu()) {
         C10_THROW_ERROR(ValueError, "can not access the data of a torch::Tensor not on CPU");
@@ -75,6 +113,36 @@ double* TorchDataArray::data() {
     return static_cast<double*>(this->tensor_.data_ptr());
 }
 
+eqs_dtype_t TorchDataArray::dtype() const {
+    auto dtype = this->tensor_.scalar_type();
+    if (dtype == torch::kF64) {
+        return EQS_DTYPE_FLOAT64;
+    } else if (dtype == torch::kF32) {
+        return EQS_DTYPE_FLOAT32;
+    } else if (dtype == torch::kF16) {
+        return EQS_DTYPE_FLOAT16;
+    } else {
+        C10_THROW_ERROR(ValueError,
+            "unsupported dtype for equistore: " + std::string(this->tensor_.dtype().name())
+        );
+    }
+}
+
+void* TorchDataArray::raw_data() {
+    if (!this->tensor_.device().is_cpu()) {
+        C10_THROW_ERROR(ValueError, "can not access the data of a torch::Tensor not on CPU");
+    }
+
+    if (!this->tensor_.is_contiguous()) {
+        C10_THROW_ERROR(ValueError, "can not access the data of a non contiguous torch::Tensor");
+    }
+
+    // check that the dtype is supported
+    this->dtype();
+
+    return this->tensor_.data_ptr();
+}
+
 const std::vector<uintptr_t>& TorchDataArray::shape() const {
     return shape_;
 }
@@ -88,42 +156,128 @@ void TorchDataArray::reshape(std::vector<uintptr_t> shape) {
     this->tensor_ = this->tensor().reshape(sizes).contiguous();
 
     this->update_shape();
+    this->reset_prefetch();
 }
 
 void TorchDataArray::swap_axes(uintptr_t axis_1, uintptr_t axis_2) {
     this->tensor_ = this->tensor().swapaxes(axis_1, axis_2).contiguous();
 
     this->update_shape();
+    this->reset_prefetch();
 }
 
 void TorchDataArray::move_samples_from(
-    const equistore::DataArrayBase& raw_input,
+    const equistore::DataArrayBase& input,
     std::vector<eqs_sample_mapping_t> samples,
     uintptr_t property_start,
     uintptr_t property_end
 ) {
-    const auto& input = dynamic_cast<const TorchDataArray&>(raw_input);
-    auto input_tensor = input.tensor();
+    this->move_samples_from(input, samples.data(), samples.size(), property_start, property_end);
+}
 
-    auto input_samples = std::vector<int64_t>();
-    input_samples.reserve(samples.size());
-    auto output_samples = std::vector<int64_t>();
-    output_samples.reserve(samples.size());
+/// A run of consecutive samples, moved from `input` to `output`
+struct SamplesRun {
+    int64_t input;
+    int64_t output;
+    int64_t length;
+};
 
-    for (const auto& sample: samples) {
-        input_samples.push_back(static_cast<int64_t>(sample.input));
-        output_samples.push_back(static_cast<int64_t>(sample.output));
+/// Samples split in at most this many runs are always copied run by run
+static constexpr size_t MAX_RUNS_WITHOUT_INDEX = 4;
+/// Otherwise, the samples are copied run by run only if the runs contain on
+/// average this many samples. Shorter runs are copied with index tensors,
+/// which use a few operations on the whole data instead of one per run.
+static constexpr int64_t MIN_AVERAGE_RUN_LENGTH = 16;
+
+void TorchDataArray::move_samples_from(
+    const equistore::DataArrayBase& raw_input,
+    const eqs_sample_mapping_t* samples,
+    size_t samples_count,
+    uintptr_t property_start,
+    uintptr_t property_end
+) {
+    static_assert(
+        sizeof(eqs_sample_mapping_t) == 2 * sizeof(int64_t),
+        "eqs_sample_mapping_t should be made of two 64-bit integers"
+    );
+
+    RECORD_FUNCTION("equistore::TorchDataArray::move_samples_from", std::vector<c10::IValue>());
+
+    if (samples_count == 0) {
+        return;
     }
 
-    using torch::indexing::Slice;
-    using torch::indexing::Ellipsis;
-    auto output_tensor = this->tensor();
+    this->reset_prefetch();
+
+    const auto& input = dynamic_cast<const TorchDataArray&>(raw_input);
+    auto input_tensor = input.tensor();
 
     // output[output_samples, ..., properties] = input[input_samples, ..., :]
-    output_tensor.index_put_(
-        {torch::tensor(std::move(output_samples)), Ellipsis, Slice(property_start, property_end)},
-        input_tensor.index({torch::tensor(std::move(input_samples)), Ellipsis, Slice()})
+    auto output_tensor = this->tensor().narrow(
+        -1,
+        static_cast<int64_t>(property_start),
+        static_cast<int64_t>(property_end - property_start)
     );
+
+    // split the samples into runs of consecutive input and output samples,
+    // which can be copied with views instead of index tensors
+    auto runs = std::vector<SamplesRun>();
+    auto input_contiguous = true;
+    auto first = samples[0];
+    for (size_t i=0; i<samples_count; i++) {
+        input_contiguous = input_contiguous && samples[i].input == first.input + i;
+
+        auto input_sample = static_cast<int64_t>(samples[i].input);
+        auto output_sample = static_cast<int64_t>(samples[i].output);
+        if (!runs.empty()) {
+            auto& last = runs.back();
+            if (input_sample == last.input + last.length && output_sample == last.output + last.length) {
+                last.length += 1;
+                continue;
+            }
+        }
+
+        runs.emplace_back(SamplesRun{input_sample, output_sample, 1});
+    }
+
+    auto count = static_cast<int64_t>(samples_count);
+    if (runs.size() <= MAX_RUNS_WITHOUT_INDEX || count >= MIN_AVERAGE_RUN_LENGTH * static_cast<int64_t>(runs.size())) {
+        // a few (or long enough) runs: copy each one directly
+        for (const auto& run: runs) {
+            output_tensor.narrow(0, run.output, run.length).copy_(
+                input_tensor.narrow(0, run.input, run.length)
+            );
+        }
+        return;
+    }
+
+    // Upload the whole mapping to the device of the data at once, as a
+    // (samples x 2) array of {input, output} indexes.
+    // `from_blob` only needs a mutable pointer to allow in-place operations
+    // on the tensor, which we don't do here.
+    auto mapping = torch::from_blob(
+        const_cast<eqs_sample_mapping_t*>(samples),
+        {count, 2},
+        torch::TensorOptions().dtype(torch::kInt64)
+    ).to(output_tensor.device());
+
+    auto output_samples = mapping.select(1, 1).contiguous();
+    if (input_contiguous) {
+        output_tensor.index_copy_(
+            0,
+            output_samples,
+            input_tensor.narrow(0, static_cast<int64_t>(first.input), count)
+        );
+    } else {
+        // this gathers the input samples in a temporary tensor, before
+        // scattering them in the output
+        auto input_samples = mapping.select(1, 0).contiguous();
+        output_tensor.index_copy_(
+            0,
+            output_samples,
+            input_tensor.index_select(0, input_samples)
+        );
+    }
 }
 
 void TorchDataArray::update_shape() {
@@ -132,3 +286,118 @@ void TorchDataArray::update_shape() {
         shape_.push_back(static_cast<uintptr_t>(size));
     }
 }
+
+bool TorchDataArray::raw_data_available() const {
+    return this->tensor_.device().is_cpu();
+}
+
+torch::Tensor TorchDataArray::copy_samples_to_host(uintptr_t sample_start, uintptr_t sample_end) const {
+    auto samples = this->tensor_.narrow(
+        0,
+        static_cast<int64_t>(sample_start),
+        static_cast<int64_t>(sample_end - sample_start)
+    );
+
+    // pinned memory allows the copy to run asynchronously with respect to
+    // the host
+    auto options = torch::TensorOptions()
+        .dtype(samples.dtype())
+        .device(torch::kCPU)
+        .pinned_memory(samples.device().is_cuda());
+
+    auto host = torch::empty(samples.sizes(), options);
+    host.copy_(samples, /*non_blocking=*/true);
+    return host;
+}
+
+/// Wait for all the operations (including copies) on the current stream of
+/// the given `device` to finish
+static void synchronize_device(torch::Device device) {
+    if (device.is_cpu()) {
+        return;
+    }
+
+    c10::impl::VirtualGuardImpl guard(device.type());
+    guard.getStream(device).synchronize();
+}
+
+void TorchDataArray::get_samples(uintptr_t sample_start, uintptr_t sample_end, void* data) const {
+    RECORD_FUNCTION("equistore::TorchDataArray::get_samples", std::vector<c10::IValue>());
+
+    if (sample_start > sample_end || sample_end > shape_[0]) {
+        C10_THROW_ERROR(ValueError, "invalid samples range in TorchDataArray::get_samples");
+    }
+
+    // check that the dtype is supported
+    this->dtype();
+
+    std::lock_guard<std::mutex> lock(prefetch_->mutex);
+
+    // the tensor can be modified in-place between two calls (e.g. in between
+    // two saves), which makes the prefetched samples outdated. In-place
+    // operations increase the version counter of the tensor.
+    auto version = this->tensor_._version();
+
+    torch::Tensor host;
+    if (prefetch_->host.defined() && prefetch_->version == version &&
+        prefetch_->sample_start == sample_start && prefetch_->sample_end == sample_end) {
+        host = std::move(prefetch_->host);
+    } else {
+        host = this->copy_samples_to_host(sample_start, sample_end);
+    }
+    prefetch_->host = torch::Tensor();
+
+    // wait for the copy to the host to finish. This must happen before
+    // starting the next copy, otherwise we would also wait for it here.
+    synchronize_device(this->tensor_.device());
+
+    // start copying the next range of samples of the same size, which will
+    // happen while the caller writes the current one
+    auto next_end = std::min(sample_end + (sample_end - sample_start), shape_[0]);
+    if (!this->tensor_.device().is_cpu() && sample_end < next_end) {
+        prefetch_->host = this->copy_samples_to_host(sample_end, next_end);
+        prefetch_->sample_start = sample_end;
+        prefetch_->sample_end = next_end;
+        prefetch_->version = version;
+    }
+
+    host = host.contiguous();
+    std::memcpy(data, host.data_ptr(), host.nbytes());
+}
+
+void TorchDataArray::set_samples(uintptr_t sample_start, uintptr_t sample_end, const void* data) {
+    RECORD_FUNCTION("equistore::TorchDataArray::set_samples", std::vector<c10::IValue>());
+
+    if (sample_start > sample_end || sample_end > shape_[0]) {
+        C10_THROW_ERROR(ValueError, "invalid samples range in TorchDataArray::set_samples");
+    }
+
+    // check that the dtype is supported
+    this->dtype();
+    this->reset_prefetch();
+
+    auto samples = this->tensor_.narrow(
+        0,
+        static_cast<int64_t>(sample_start),
+        static_cast<int64_t>(sample_end - sample_start)
+    );
+
+    auto options = torch::TensorOptions()
+        .dtype(samples.dtype())
+        .device(torch::kCPU)
+        .pinned_memory(samples.device().is_cuda());
+
+    auto host = torch::empty(samples.sizes(), options);
+    std::memcpy(host.data_ptr(), data, host.nbytes());
+
+    // the copy from pinned memory is asynchronous, and torch's caching host
+    // allocator keeps `host` alive until it is done
+    samples.copy_(host, /*non_blocking=*/true);
+}
+
+void TorchDataArray::reset_prefetch() {
+    if (prefetch_ != nullptr) {
+        std::lock_guard<std::mutex> lock(prefetch_->mutex);
+        prefetch_->host = torch::Tensor();
+    }
+}
@@ -28,16 +28,25 @@ TensorBlockHolder::TensorBlockHolder(
         components_from_torch(components),
         properties->as_equistore()
     )
-{}
+{
+    // we already have all the labels, no need to re-create them
+    labels_.push_back(std::move(samples));
+    for (auto& component: components) {
+        labels_.push_back(std::move(component));
+    }
+    labels_.push_back(std::move(properties));
+}
 
 
 TensorBlockHolder::TensorBlockHolder(equistore::TensorBlock block):
-    block_(std::move(block))
+    block_(std::move(block)),
+    labels_(block_.values_shape().size())
 {}
 
 TensorBlockHolder::TensorBlockHolder(equistore::TensorBlock block, std::string parameter):
     block_(std::move(block)),
-    parameter_(std::move(parameter))
+    parameter_(std::move(parameter)),
+    labels_(block_.values_shape().size())
 {}
 
 torch::intrusive_ptr<TensorBlockHolder> TensorBlockHolder::copy() const {
@@ -67,23 +76,56 @@ torch::Tensor TensorBlockHolder::values() {
 }
 
 TorchLabels TensorBlockHolder::labels(uintptr_t axis) const {
-    return torch::make_intrusive<LabelsHolder>(block_.labels(axis));
+    if (axis >= labels_.size()) {
+        // let equistore produce the error message
+        return torch::make_intrusive<LabelsHolder>(block_.labels(axis));
+    }
+
+    std::lock_guard<std::mutex> lock(cache_mutex_);
+    auto& labels = labels_[axis];
+    if (!labels) {
+        labels = torch::make_intrusive<LabelsHolder>(block_.labels(axis));
+    }
+    return labels;
+}
+
+std::vector<TorchLabels> TensorBlockHolder::components() const {
+    auto result = std::vector<TorchLabels>();
+    for (size_t i=1; i<labels_.size() - 1; i++) {
+        result.emplace_back(this->labels(i));
+    }
+    return result;
 }
 
 
+/// Create a new `equistore::TensorBlock` sharing the values and metadata of
+/// `block`, as well as all its gradients (recursively).
+static equistore::TensorBlock block_from_torch(const TorchTensorBlock& block) {
+    auto result = equistore::TensorBlock(
+        std::make_unique<TorchDataArray>(block->values()),
+        block->samples()->as_equistore(),
+        components_from_torch(block->components()),
+        block->properties()->as_equistore()
+    );
+
+    for (const auto& parameter: block->gradients_list()) {
+        result.add_gradient(parameter, block_from_torch(block->gradient(parameter)));
+    }
+
+    return result;
+}
+
 void TensorBlockHolder::add_gradient(const std::string& parameter, TorchTensorBlock gradient) {
     // we need to move the tensor block in `add_gradient`, but we can not move
     // out of the `torch::intrusive_ptr` in `TorchTensorBlock`. So we create a
     // new temporary block, increasing the reference count to the values and
-    // metadata of gradient.
-    auto gradient_block = equistore::TensorBlock(
-        std::make_unique<TorchDataArray>(gradient->values()),
-        gradient->samples()->as_equistore(),
-        components_from_torch(gradient->components()),
-        gradient->properties()->as_equistore()
-    );
+    // metadata of gradient (and of the gradients of the gradient).
+    block_.add_gradient(parameter, block_from_torch(gradient));
 
-    block_.add_gradient(parameter, std::move(gradient_block));
+    // adding a gradient can move the existing ones inside equistore, so
+    // we need to get them again
+    std::lock_guard<std::mutex> lock(cache_mutex_);
+    gradients_.clear();
 }
 
 bool TensorBlockHolder::has_gradient(const std::string& parameter) const {
@@ -101,7 +143,15 @@ TorchTensorBlock TensorBlockHolder::gradient(const std::string& parameter) const
         gradient_parameter = parameter;
     }
 
-    return torch::make_intrusive<TensorBlockHolder>(block_.gradient(parameter), gradient_parameter);
+    std::lock_guard<std::mutex> lock(cache_mutex_);
+    auto it = gradients_.find(parameter);
+    if (it != gradients_.end()) {
+        return it->second;
+    }
+
+    auto gradient = torch::make_intrusive<TensorBlockHolder>(block_.gradient(parameter), gradient_parameter);
+    gradients_.emplace(parameter, gradient);
+    return gradient;
 }
 
 std::unordered_map<std::string, TorchTensorBlock> TensorBlockHolder::gradients() {
@@ -1,6 +1,8 @@
 #include <cassert>
+#include <mutex>
 
 #include <torch/torch.h>
+#include <ATen/record_function.h>
 
 #include <equistore.hpp>
 
@@ -126,14 +128,39 @@ static std::vector<std::string> names_from_equistore(const equistore::Labels& la
 }
 
 
+/// User data registered with equistore Labels, containing the values of the
+/// labels as a torch tensor.
+///
+/// equistore keeps all the user data registered with a set of Labels alive
+/// until the Labels are freed, so this is only registered once per Labels.
+/// Moving the labels to another device then replaces the tensor stored here.
+class LabelsValuesUserData {
+public:
+    explicit LabelsValuesUserData(torch::Tensor values): values_(std::move(values)) {}
+
+    torch::Tensor get() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return values_;
+    }
+
+    void set(torch::Tensor values) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        values_ = std::move(values);
+    }
+
+private:
+    std::mutex mutex_;
+    torch::Tensor values_;
+};
+
 static torch::Tensor values_from_equistore(equistore::Labels& labels) {
     // check if the labels are already associated with a tensor
     auto user_data = labels.user_data();
     if (user_data != nullptr) {
         // if we start using user_data for more than this exact case (storing
         // tensors inside Labels), this code might fails and will need to start
-        // checking that `user_data` is actually a tensor.
-        return *static_cast<torch::Tensor*>(user_data);
+        // checking that `user_data` is actually a `LabelsValuesUserData`.
+        return static_cast<LabelsValuesUserData*>(user_data)->get();
     }
 
     // otherwise create a new tensor
@@ -152,18 +179,59 @@ static torch::Tensor values_from_equistore(equistore::Labels& labels) {
     );
 }
 
+static void set_values_user_data(equistore::Labels& labels, torch::Tensor values) {
+    auto user_data = labels.user_data();
+    if (user_data != nullptr) {
+        // update the existing user data instead of registering a new one
+        static_cast<LabelsValuesUserData*>(user_data)->set(std::move(values));
+        return;
+    }
+
+    // register the torch tensor as a custom user data in the labels
+    auto new_user_data = equistore::LabelsUserData(
+        new LabelsValuesUserData(std::move(values)),
+        [](void* data) { delete static_cast<LabelsValuesUserData*>(data); }
+    );
+
+    labels.set_user_data(std::move(new_user_data));
+}
+
 LabelsHolder::LabelsHolder(torch::IValue names, torch::Tensor values):
     names_(details::normalize_names(names, "names")),
     values_(normalize_int32_tensor(std::move(values), 2, "Labels values")),
+    is_view_(false),
     labels_(equistore::Labels(labels_from_torch(names_, values_.to(torch::kCPU).contiguous())))
 {
-    // register the torch tensor as a custom user data in the labels
-    auto user_data = equistore::LabelsUserData(
-        new torch::Tensor(values_),
-        [](void* tensor) { delete static_cast<torch::Tensor*>(tensor); }
+    set_values_user_data(labels_.value(), values_);
+}
+
+LabelsHolder::LabelsHolder(std::vector<std::string> names, torch::Tensor values, CreateDeferred):
+    names_(std::move(names)),
+    values_(std::move(values)),
+    is_view_(false)
+{
+    if (values_.size(1) != static_cast<int64_t>(names_.size())) {
+        C10_THROW_ERROR(ValueError,
+            "invalid Labels: the names must have an entry for each column of the array"
+        );
+    }
+}
+
+TorchLabels LabelsHolder::deferred(torch::IValue names, torch::Tensor values) {
+    return torch::make_intrusive<LabelsHolder>(
+        details::normalize_names(names, "names"),
+        normalize_int32_tensor(std::move(values), 2, "Labels values"),
+        CreateDeferred{}
     );
+}
 
-    labels_->set_user_data(std::move(user_data));
+LabelsHolder::LabelsHolder(const LabelsHolder& other):
+    names_(other.names_),
+    values_(other.values_),
+    is_view_(other.is_view_)
+{
+    std::lock_guard<std::mutex> lock(other.labels_mutex_);
+    labels_ = other.labels_;
 }
 
 TorchLabels LabelsHolder::create(
@@ -179,7 +247,8 @@ TorchLabels LabelsHolder::create(
 
 LabelsHolder::LabelsHolder(std::vector<std::string> names, torch::Tensor values, CreateView):
     names_(std::move(names)),
-    values_(std::move(values))
+    values_(std::move(values)),
+    is_view_(true)
 {}
 
 TorchLabels LabelsHolder::view(const TorchLabels& labels, std::vector<std::string> names) {
@@ -209,6 +278,7 @@ TorchLabels LabelsHolder::view(const TorchLabels& labels, std::vector<std::strin
 LabelsHolder::LabelsHolder(equistore::Labels labels):
     names_(names_from_equistore(labels)),
     values_(values_from_equistore(labels)),
+    is_view_(false),
     labels_(std::move(labels))
 {}
 
@@ -248,20 +318,27 @@ torch::Tensor LabelsHolder::column(std::string dimension) {
 }
 
 const equistore::Labels& LabelsHolder::as_equistore() const {
-    if (!labels_.has_value()) {
+    if (is_view_) {
         C10_THROW_ERROR(ValueError,
             "can not call this function on Labels view, call to_owned first"
         );
     }
 
+    std::lock_guard<std::mutex> lock(labels_mutex_);
+    if (!labels_.has_value()) {
+        // the creation of these labels was deferred, and we need them now
+        labels_ = equistore::Labels(labels_from_torch(names_, values_.to(torch::kCPU).contiguous()));
+        set_values_user_data(labels_.value(), values_);
+    }
+
     return labels_.value();
 }
 
 LabelsHolder LabelsHolder::to_owned() const {
-    if (labels_.has_value()) {
-        return *this;
-    } else {
+    if (is_view_) {
         return LabelsHolder(this->names_, values_);
+    } else {
+        return *this;
     }
 }
 
@@ -270,13 +347,12 @@ void LabelsHolder::to(torch::Device device) {
     values_ = values_.to(device);
 
     // then make sure that when accessing these labels again we still have the
-    // values on the same device by updating the registered user data
-    auto user_data = equistore::LabelsUserData(
-        new torch::Tensor(values_),
-        [](void* tensor) { delete static_cast<torch::Tensor*>(tensor); }
-    );
-
-    labels_->set_user_data(std::move(user_data));
+    // values on the same device by updating the registered user data. Labels
+    // which have not been created yet will use the new values directly.
+    std::lock_guard<std::mutex> lock(labels_mutex_);
+    if (labels_.has_value()) {
+        set_values_user_data(labels_.value(), values_);
+    }
 }
 
 torch::optional<int64_t> LabelsHolder::position(torch::IValue entry) const {
@@ -343,30 +419,76 @@ torch::optional<int64_t> LabelsHolder::position(torch::IValue entry) const {
     }
 }
 
-TorchLabels LabelsHolder::set_union(const TorchLabels& other) const {
-    if (!labels_.has_value() || !other->labels_.has_value()) {
+torch::Tensor LabelsHolder::positions(torch::Tensor entries) const {
+    RECORD_FUNCTION("equistore::Labels::positions", std::vector<c10::IValue>());
+
+    entries = normalize_int32_tensor(std::move(entries), 2, "entries passed to Labels::positions");
+    if (entries.size(1) != this->size()) {
         C10_THROW_ERROR(ValueError,
-            "can not call this function on Labels view, call to_owned first"
+            "entries passed to Labels::positions must have " + std::to_string(this->size()) +
+            " values per entry, got " + std::to_string(entries.size(1))
         );
     }
 
-    auto result = labels_->set_union(other->labels_.value());
+    auto device = entries.device();
+    auto cpu_entries = entries.to(torch::kCPU).contiguous();
+
+    auto count = cpu_entries.size(0);
+    auto options = torch::TensorOptions().dtype(torch::kInt64).device(torch::kCPU);
+    auto positions = torch::empty({count}, options);
+
+    this->as_equistore().positions(
+        static_cast<const int32_t*>(cpu_entries.data_ptr()),
+        static_cast<size_t>(count),
+        static_cast<int64_t*>(positions.data_ptr())
+    );
+
+    return positions.to(device);
+}
+
+torch::Tensor LabelsHolder::has_unique_entries() const {
+    auto device = values_.device();
+    auto count = this->count();
+    if (count < 2 || this->size() == 0) {
+        return torch::ones({}, torch::TensorOptions().dtype(torch::kBool).device(device));
+    }
+
+    // sort the entries in lexicographic order, using one stable sort per
+    // dimension starting with the last one. Duplicated entries will then be
+    // next to each other.
+    auto order = torch::arange(count, torch::TensorOptions().dtype(torch::kInt64).device(device));
+    for (auto dimension = this->size() - 1; dimension >= 0; dimension--) {
+        auto column = values_.select(1, dimension).index_select(0, order);
+        auto sorted = std::get<1>(torch::sort(column, /*stable=*/true, /*dim=*/0, /*descending=*/false));
+        order = order.index_select(0, sorted);
+    }
+
+    auto sorted_values = values_.index_select(0, order);
+    auto duplicated = (sorted_values.slice(0, 1) == sorted_values.slice(0, 0, count - 1)).all(1);
+
+    return duplicated.any().logical_not();
+}
+
+TorchLabels LabelsHolder::set_union(const TorchLabels& other) const {
+    RECORD_FUNCTION("equistore::Labels::union", std::vector<c10::IValue>());
+
+    const auto& labels = this->as_equistore();
+    const auto& other_labels = other->as_equistore();
+
+    auto result = labels.set_union(other_labels);
     return torch::make_intrusive<LabelsHolder>(std::move(result));
 }
 
 std::tuple<TorchLabels, torch::Tensor, torch::Tensor> LabelsHolder::union_and_mapping(const TorchLabels& other) const {
-    if (!labels_.has_value() || !other->labels_.has_value()) {
-        C10_THROW_ERROR(ValueError,
-            "can not call this function on Labels view, call to_owned first"
-        );
-    }
+    const auto& labels = this->as_equistore();
+    const auto& other_labels = other->as_equistore();
 
     auto options = torch::TensorOptions().dtype(torch::kInt64).device(torch::kCPU);
     auto first_mapping = torch::zeros({this->count()}, options);
     auto second_mapping = torch::zeros({other->count()}, options);
 
-    auto result = labels_->set_union(
-        other->labels_.value(),
+    auto result = labels.set_union(
+        other_labels,
         first_mapping.data_ptr<int64_t>(),
         first_mapping.size(0),
         second_mapping.data_ptr<int64_t>(),
@@ -382,30 +504,69 @@ std::tuple<TorchLabels, torch::Tensor, torch::Tensor> LabelsHolder::union_and_ma
     );
 }
 
-TorchLabels LabelsHolder::set_intersection(const TorchLabels& other) const {
-    if (!labels_.has_value() || !other->labels_.has_value()) {
-        C10_THROW_ERROR(ValueError,
-            "can not call this function on Labels view, call to_owned first"
-        );
+static std::vector<equistore::Labels> all_as_equistore(const std::vector<TorchLabels>& labels) {
+    auto result = std::vector<equistore::Labels>();
+    result.reserve(labels.size());
+    for (const auto& l: labels) {
+        result.push_back(l->as_equistore());
     }
+    return result;
+}
+
+TorchLabels LabelsHolder::union_many(const std::vector<TorchLabels>& labels) {
+    RECORD_FUNCTION("equistore::Labels::union_many", std::vector<c10::IValue>());
 
-    auto result = labels_->set_intersection(other->labels_.value());
+    auto result = equistore::Labels::set_union_many(all_as_equistore(labels));
     return torch::make_intrusive<LabelsHolder>(std::move(result));
 }
 
-std::tuple<TorchLabels, torch::Tensor, torch::Tensor> LabelsHolder::intersection_and_mapping(const TorchLabels& other) const {
-    if (!labels_.has_value() || !other->labels_.has_value()) {
-        C10_THROW_ERROR(ValueError,
-            "can not call this function on Labels view, call to_owned first"
-        );
+std::tuple<TorchLabels, std::vector<torch::Tensor>> LabelsHolder::union_many_and_mapping(const std::vector<TorchLabels>& labels) {
+    RECORD_FUNCTION("equistore::Labels::union_many", std::vector<c10::IValue>());
+
+    int64_t total_count = 0;
+    auto counts = std::vector<int64_t>();
+    counts.reserve(labels.size());
+    for (const auto& l: labels) {
+        counts.push_back(l->count());
+        total_count += l->count();
     }
 
+    auto options = torch::TensorOptions().dtype(torch::kInt64).device(torch::kCPU);
+    auto mapping = torch::zeros({total_count}, options);
+
+    auto result = equistore::Labels::set_union_many(
+        all_as_equistore(labels),
+        mapping.data_ptr<int64_t>(),
+        static_cast<size_t>(total_count)
+    );
+    auto torch_result = torch::make_intrusive<LabelsHolder>(std::move(result));
+
+    return std::make_tuple<TorchLabels, std::vector<torch::Tensor>>(
+        std::move(torch_result),
+        mapping.split_with_sizes(counts)
+    );
+}
+
+TorchLabels LabelsHolder::set_intersection(const TorchLabels& other) const {
+    RECORD_FUNCTION("equistore::Labels::intersection", std::vector<c10::IValue>());
+
+    const auto& labels = this->as_equistore();
+    const auto& other_labels = other->as_equistore();
+
+    auto result = labels.set_intersection(other_labels);
+    return torch::make_intrusive<LabelsHolder>(std::move(result));
+}
+
+std::tuple<TorchLabels, torch::Tensor, torch::Tensor> LabelsHolder::intersection_and_mapping(const TorchLabels& other) const {
+    const auto& labels = this->as_equistore();
+    const auto& other_labels = other->as_equistore();
+
     auto options = torch::TensorOptions().dtype(torch::kInt64).device(torch::kCPU);
     auto first_mapping = torch::zeros({this->count()}, options);
     auto second_mapping = torch::zeros({other->count()}, options);
 
-    auto result = labels_->set_intersection(
-        other->labels_.value(),
+    auto result = labels.set_intersection(
+        other_labels,
         first_mapping.data_ptr<int64_t>(),
         first_mapping.size(0),
         second_mapping.data_ptr<int64_t>(),
@@ -567,7 +728,7 @@ std::string LabelsHolder::print(int64_t max_entries, int64_t indent) const {
 
 std::string LabelsHolder::__str__() const {
     auto output = std::ostringstream();
-    if (labels_.has_value()) {
+    if (!is_view_) {
         output << "Labels(\n   ";
     } else {
         output << "LabelsView(\n   ";
@@ -579,7 +740,7 @@ std::string LabelsHolder::__str__() const {
 
 std::string LabelsHolder::__repr__() const {
     auto output = std::ostringstream();
-    if (labels_.has_value()) {
+    if (!is_view_) {
         output << "Labels(\n   ";
     } else {
         output << "LabelsView(\n   ";
@@ -0,0 +1,63 @@
+#include <torch/torch.h>
+
+#include <equistore.hpp>
+
+#include "equistore/torch/lazy.hpp"
+#include "equistore/torch/misc.hpp"
+
+using namespace equistore_torch;
+
+static size_t checked_max_blocks(int64_t max_blocks) {
+    if (max_blocks < 0) {
+        C10_THROW_ERROR(ValueError,
+            "LazyTensorMap `max_blocks` must be positive or zero, got " + std::to_string(max_blocks)
+        );
+    }
+    return static_cast<size_t>(max_blocks);
+}
+
+LazyTensorMapHolder::LazyTensorMapHolder(const std::string& path, int64_t max_blocks):
+    // blocks are cached as `TorchTensorBlock` in `cache_`, do not keep a
+    // second copy of them inside of `lazy_`
+    lazy_(path, 0, details::create_torch_array),
+    cache_(checked_max_blocks(max_blocks))
+{
+    keys_ = torch::make_intrusive<LabelsHolder>(lazy_.keys());
+}
+
+std::vector<int64_t> LazyTensorMapHolder::blocks_matching(const TorchLabels& selection) const {
+    auto results = lazy_.blocks_matching(selection->as_equistore());
+
+    auto results_int64 = std::vector<int64_t>();
+    results_int64.reserve(results.size());
+    for (auto matching: results) {
+        results_int64.push_back(static_cast<int64_t>(matching));
+    }
+
+    return results_int64;
+}
+
+TorchTensorBlock LazyTensorMapHolder::block_by_id(int64_t index) {
+    if (index < 0 || index >= keys_->count()) {
+        // this needs to be an IndexError to enable iteration over a LazyTensorMap
+        C10_THROW_ERROR(IndexError,
+            "block index out of bounds: we have " + std::to_string(keys_->count())
+            + " blocks but the index is " + std::to_string(index)
+        );
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    return cache_.get_or_load(static_cast<size_t>(index), [this](size_t block_index) {
+        return torch::make_intrusive<TensorBlockHolder>(lazy_.load_block(block_index));
+    });
+}
+
+int64_t LazyTensorMapHolder::loaded_blocks() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return static_cast<int64_t>(cache_.size());
+}
+
+void LazyTensorMapHolder::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    cache_.clear();
+}
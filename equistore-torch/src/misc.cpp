@@ -1,4 +1,5 @@
 #include <torch/torch.h>
+#include <ATen/record_function.h>
 
 #include <equistore.hpp>
 #include <torch/types.h>
@@ -9,39 +10,84 @@
 using namespace equistore_torch;
 
 
+/// Get the torch dtype corresponding to the equistore `dtype`
+static torch::Dtype torch_dtype(eqs_dtype_t dtype) {
+    if (dtype == EQS_DTYPE_FLOAT64) {
+        return torch::kF64;
+    } else if (dtype == EQS_DTYPE_FLOAT32) {
+        return torch::kF32;
+    } else if (dtype == EQS_DTYPE_FLOAT16) {
+        return torch::kF16;
+    } else {
+        C10_THROW_ERROR(ValueError,
+            "unknown equistore data type: " + std::to_string(dtype)
+        );
+    }
+}
+
 eqs_status_t equistore_torch::details::create_torch_array(
+    void* user_data,
     const uintptr_t* shape_ptr,
     uintptr_t shape_count,
+    eqs_dtype_t dtype,
     eqs_array_t* array
 ) {
     return equistore::details::catch_exceptions([](
+        void* user_data,
         const uintptr_t* shape_ptr,
         uintptr_t shape_count,
+        eqs_dtype_t dtype,
         eqs_array_t* array
     ) {
+        auto device = torch::Device(torch::kCPU);
+        if (user_data != nullptr) {
+            device = *static_cast<const torch::Device*>(user_data);
+        }
+
         auto sizes = std::vector<int64_t>();
         for (size_t i=0; i<shape_count; i++) {
             sizes.push_back(static_cast<int64_t>(shape_ptr[i]));
         }
 
-        auto options = torch::TensorOptions().device(torch::kCPU).dtype(torch::kF64);
-        auto tensor = torch::zeros(sizes, options);
+        auto options = torch::TensorOptions().device(device).dtype(torch_dtype(dtype));
+        // the data will be fully overwritten by equistore, no need to
+        // initialize it
+        auto tensor = torch::empty(sizes, options);
 
         auto cxx_array = std::unique_ptr<equistore::DataArrayBase>(new TorchDataArray(tensor));
         *array = equistore::DataArrayBase::to_eqs_array_t(std::move(cxx_array));
 
         return EQS_SUCCESS;
-    }, shape_ptr, shape_count, array);
+    }, user_data, shape_ptr, shape_count, dtype, array);
+}
+
+
+TorchTensorMap equistore_torch::load(const std::string& path, int64_t threads, torch::optional<torch::Device> device) {
+    RECORD_FUNCTION("equistore::load", std::vector<c10::IValue>());
+
+    if (threads < 0) {
+        C10_THROW_ERROR(ValueError,
+            "load `threads` must be positive or zero, got " + std::to_string(threads)
+        );
+    }
+
+    auto load_device = device.value_or(torch::Device(torch::kCPU));
+    return torch::make_intrusive<TensorMapHolder>(equistore::TensorMap::load(
+        path,
+        details::create_torch_array,
+        static_cast<size_t>(threads),
+        &load_device
+    ));
 }
 
 
-TorchTensorMap equistore_torch::load(const std::string& path) {
-    return torch::make_intrusive<TensorMapHolder>(
-        equistore::TensorMap::load(path, details::create_torch_array)
-    );
+TorchLazyTensorMap equistore_torch::load_lazy(const std::string& path, int64_t max_blocks) {
+    return torch::make_intrusive<LazyTensorMapHolder>(path, max_blocks);
 }
 
 
 void equistore_torch::save(const std::string& path, TorchTensorMap tensor) {
+    RECORD_FUNCTION("equistore::save", std::vector<c10::IValue>());
+
     equistore::TensorMap::save(path, tensor->as_equistore());
 }
@@ -0,0 +1,875 @@
+#include <algorithm>
+#include <set>
+
+#include <torch/torch.h>
+#include <ATen/record_function.h>
+
+#include <equistore.hpp>
+
+#include "equistore/torch/array.hpp"
+#include "equistore/torch/operations.hpp"
+
+using namespace equistore_torch;
+
+static std::vector<std::string> labels_names(const equistore::Labels& labels) {
+    auto names = std::vector<std::string>();
+    for (const auto name: labels.names()) {
+        names.push_back(std::string(name));
+    }
+    return names;
+}
+
+static std::string format_names(const std::vector<std::string>& names) {
+    auto output = std::string("[");
+    for (size_t i=0; i<names.size(); i++) {
+        output += "'" + names[i] + "'";
+        if (i < names.size() - 1) {
+            output += ", ";
+        }
+    }
+    output += "]";
+    return output;
+}
+
+/// Get a copy of the values of `labels` as a CPU tensor of 32-bit integers
+static torch::Tensor labels_values(const equistore::Labels& labels) {
+    auto options = torch::TensorOptions().dtype(torch::kInt32).device(torch::kCPU);
+    auto count = static_cast<int64_t>(labels.count());
+    auto size = static_cast<int64_t>(labels.size());
+    if (count == 0) {
+        return torch::zeros({0, size}, options);
+    }
+
+    return torch::from_blob(
+        const_cast<int32_t*>(labels.data()),
+        {count, size},
+        options
+    ).clone();
+}
+
+/// Create new `equistore::Labels` with the given `names` and `values`,
+/// registering `values` as the corresponding torch tensor.
+static equistore::Labels create_labels(const std::vector<std::string>& names, torch::Tensor values) {
+    return LabelsHolder(torch::IValue(names), std::move(values)).as_equistore();
+}
+
+/// Create a new block containing the given `values` and metadata
+static equistore::TensorBlock create_block(
+    torch::Tensor values,
+    const equistore::Labels& samples,
+    const std::vector<equistore::Labels>& components,
+    const equistore::Labels& properties
+) {
+    return equistore::TensorBlock(
+        std::make_unique<TorchDataArray>(std::move(values)),
+        samples,
+        components,
+        properties
+    );
+}
+
+/// Create a new block containing the given `values`, and the same metadata as
+/// `block`
+static equistore::TensorBlock block_like(torch::Tensor values, const equistore::TensorBlock& block) {
+    return create_block(std::move(values), block.samples(), block.components(), block.properties());
+}
+
+/// Create a new `TorchTensorMap` with the same keys as `tensor`, containing
+/// the given `blocks`
+static TorchTensorMap tensor_like(const TorchTensorMap& tensor, std::vector<equistore::TensorBlock> blocks) {
+    auto result = equistore::TensorMap(tensor->as_equistore().keys(), std::move(blocks));
+    return torch::make_intrusive<TensorMapHolder>(std::move(result));
+}
+
+static int64_t blocks_count(const TorchTensorMap& tensor) {
+    return static_cast<int64_t>(tensor->as_equistore().keys().count());
+}
+
+static void check_no_gradients_of_gradients(const TorchTensorBlock& gradient) {
+    if (!gradient->gradients_list().empty()) {
+        C10_THROW_ERROR(NotImplementedError, "gradients of gradients are not supported");
+    }
+}
+
+/// Check that `A` and `B` have the same keys, and get the position in `B` of
+/// the block with the same key as each block of `A`
+static std::vector<int64_t> matching_blocks(const TorchTensorMap& A, const TorchTensorMap& B, const std::string& fname) {
+    auto keys_a = A->as_equistore().keys();
+    auto keys_b = B->as_equistore().keys();
+
+    auto names_a = labels_names(keys_a);
+    auto names_b = labels_names(keys_b);
+    if (names_a != names_b) {
+        C10_THROW_ERROR(ValueError,
+            "inputs to " + fname + " should have the same keys names, got '" +
+            format_names(names_a) + "' and '" + format_names(names_b) + "'"
+        );
+    }
+
+    if (keys_a.count() != keys_b.count()) {
+        C10_THROW_ERROR(ValueError,
+            "inputs to " + fname + " should have the same number of blocks, got " +
+            std::to_string(keys_a.count()) + " and " + std::to_string(keys_b.count())
+        );
+    }
+
+    auto positions = std::vector<int64_t>(keys_a.count(), -1);
+    if (keys_a.count() != 0) {
+        keys_b.positions(keys_a.data(), keys_a.count(), positions.data());
+    }
+
+    for (auto position: positions) {
+        if (position < 0) {
+            C10_THROW_ERROR(ValueError, "inputs to " + fname + " should have the same keys");
+        }
+    }
+
+    return positions;
+}
+
+static void check_same_labels(
+    const equistore::Labels& a,
+    const equistore::Labels& b,
+    const std::string& fname,
+    const std::string& kind
+) {
+    if (a == b) {
+        return;
+    }
+
+    if (labels_names(a) != labels_names(b)) {
+        C10_THROW_ERROR(ValueError,
+            "inputs to " + fname + " should have the same " + kind + ": " +
+            kind + " names are not the same or not in the same order"
+        );
+    }
+
+    C10_THROW_ERROR(ValueError,
+        "inputs to " + fname + " should have the same " + kind + ": " +
+        kind + " are not the same or not in the same order"
+    );
+}
+
+static void check_same_metadata(
+    const equistore::TensorBlock& a,
+    const equistore::TensorBlock& b,
+    const std::string& fname,
+    const std::string& context
+) {
+    check_same_labels(a.samples(), b.samples(), fname, context + "samples");
+
+    auto components_a = a.components();
+    auto components_b = b.components();
+    if (components_a.size() != components_b.size()) {
+        C10_THROW_ERROR(ValueError,
+            "inputs to " + fname + " should have the same " + context + "components: " +
+            "they have a different number of components"
+        );
+    }
+
+    for (size_t i=0; i<components_a.size(); i++) {
+        check_same_labels(components_a[i], components_b[i], fname, context + "components");
+    }
+
+    check_same_labels(a.properties(), b.properties(), fname, context + "properties");
+}
+
+/// Check that `a` and `b` have the same metadata, including the same
+/// gradients with the same metadata
+static void check_same_block(const TorchTensorBlock& a, const TorchTensorBlock& b, const std::string& fname) {
+    check_same_metadata(a->as_equistore(), b->as_equistore(), fname, "");
+
+    auto parameters_a = a->gradients_list();
+    auto parameters_b = b->gradients_list();
+    std::sort(std::begin(parameters_a), std::end(parameters_a));
+    std::sort(std::begin(parameters_b), std::end(parameters_b));
+    if (parameters_a != parameters_b) {
+        C10_THROW_ERROR(ValueError,
+            "inputs to " + fname + " should have the same gradient parameters"
+        );
+    }
+
+    for (const auto& parameter: parameters_a) {
+        auto gradient_a = a->gradient(parameter);
+        auto gradient_b = b->gradient(parameter);
+        check_no_gradients_of_gradients(gradient_a);
+        check_no_gradients_of_gradients(gradient_b);
+
+        check_same_metadata(
+            gradient_a->as_equistore(),
+            gradient_b->as_equistore(),
+            fname,
+            "gradient '" + parameter + "' "
+        );
+    }
+}
+
+/// Get the scalar value inside `B` for binary operations, or `nullopt` if `B`
+/// is a `TensorMap`
+static torch::optional<double> scalar_argument(const torch::IValue& B, const std::string& fname) {
+    if (B.isDouble()) {
+        return B.toDouble();
+    } else if (B.isInt()) {
+        return static_cast<double>(B.toInt());
+    } else if (B.isCustomClass()) {
+        return torch::nullopt;
+    } else {
+        C10_THROW_ERROR(TypeError,
+            "B should be a TensorMap or a scalar value in " + fname + ", got '" +
+            B.type()->str() + "' instead"
+        );
+    }
+}
+
+/// Get the "sample" dimension of the gradient samples (i.e. the index of the
+/// corresponding row in the values) as a tensor of 64-bit integers on `device`
+static torch::Tensor gradient_sample_index(const equistore::TensorBlock& gradient, torch::Device device) {
+    auto samples = labels_values(gradient.samples());
+    return samples.select(1, 0).to(torch::TensorOptions().dtype(torch::kInt64).device(device));
+}
+
+/// Select the rows of `values` at `index`, adding dimensions after the first
+/// one to allow broadcasting the result with `gradient`, which can have more
+/// components than `values`.
+static torch::Tensor values_for_gradient(const torch::Tensor& values, const torch::Tensor& index, const torch::Tensor& gradient) {
+    auto result = values.index_select(0, index);
+    for (int64_t i=0; i<gradient.dim() - values.dim(); i++) {
+        result = result.unsqueeze(1);
+    }
+    return result;
+}
+
+/// Reshape the 1-D `tensor` to allow broadcasting it along the first dimension
+/// of a tensor with `n_dimensions` dimensions
+static torch::Tensor reshape_for_broadcast(const torch::Tensor& tensor, int64_t n_dimensions) {
+    auto shape = std::vector<int64_t>(static_cast<size_t>(n_dimensions), 1);
+    shape[0] = -1;
+    return tensor.reshape(shape);
+}
+
+/******************************************************************************/
+
+TorchTensorMap equistore_torch::add(TorchTensorMap A, torch::IValue B) {
+    RECORD_FUNCTION("equistore::add", std::vector<c10::IValue>());
+
+    auto constant = scalar_argument(B, "add");
+
+    auto blocks = std::vector<equistore::TensorBlock>();
+    if (constant.has_value()) {
+        for (int64_t i=0; i<blocks_count(A); i++) {
+            auto block = A->block_by_id(i);
+            auto result = block_like(block->values() + constant.value(), block->as_equistore());
+
+            for (const auto& parameter: block->gradients_list()) {
+                auto gradient = block->gradient(parameter);
+                check_no_gradients_of_gradients(gradient);
+                result.add_gradient(parameter, block_like(gradient->values(), gradient->as_equistore()));
+            }
+
+            blocks.emplace_back(std::move(result));
+        }
+    } else {
+        auto tensor_B = B.toCustomClass<TensorMapHolder>();
+        auto positions = matching_blocks(A, tensor_B, "add");
+
+        for (int64_t i=0; i<blocks_count(A); i++) {
+            auto block_A = A->block_by_id(i);
+            auto block_B = tensor_B->block_by_id(positions[i]);
+            check_same_block(block_A, block_B, "add");
+
+            auto result = block_like(block_A->values() + block_B->values(), block_A->as_equistore());
+            for (const auto& parameter: block_A->gradients_list()) {
+                auto gradient_A = block_A->gradient(parameter);
+                auto gradient_B = block_B->gradient(parameter);
+
+                result.add_gradient(parameter, block_like(
+                    gradient_A->values() + gradient_B->values(),
+                    gradient_A->as_equistore()
+                ));
+            }
+
+            blocks.emplace_back(std::move(result));
+        }
+    }
+
+    return tensor_like(A, std::move(blocks));
+}
+
+TorchTensorMap equistore_torch::multiply(TorchTensorMap A, torch::IValue B) {
+    RECORD_FUNCTION("equistore::multiply", std::vector<c10::IValue>());
+
+    auto constant = scalar_argument(B, "multiply");
+
+    auto blocks = std::vector<equistore::TensorBlock>();
+    if (constant.has_value()) {
+        for (int64_t i=0; i<blocks_count(A); i++) {
+            auto block = A->block_by_id(i);
+            auto result = block_like(block->values() * constant.value(), block->as_equistore());
+
+            for (const auto& parameter: block->gradients_list()) {
+                auto gradient = block->gradient(parameter);
+                check_no_gradients_of_gradients(gradient);
+                result.add_gradient(parameter, block_like(
+                    gradient->values() * constant.value(),
+                    gradient->as_equistore()
+                ));
+            }
+
+            blocks.emplace_back(std::move(result));
+        }
+    } else {
+        auto tensor_B = B.toCustomClass<TensorMapHolder>();
+        auto positions = matching_blocks(A, tensor_B, "multiply");
+
+        for (int64_t i=0; i<blocks_count(A); i++) {
+            auto block_A = A->block_by_id(i);
+            auto block_B = tensor_B->block_by_id(positions[i]);
+            check_same_block(block_A, block_B, "multiply");
+
+            auto values_A = block_A->values();
+            auto values_B = block_B->values();
+            auto result = block_like(values_A * values_B, block_A->as_equistore());
+
+            for (const auto& parameter: block_A->gradients_list()) {
+                auto gradient_A = block_A->gradient(parameter);
+                auto gradient_B = block_B->gradient(parameter);
+                auto gradient_values_A = gradient_A->values();
+                auto gradient_values_B = gradient_B->values();
+
+                // both gradients have the same samples, so we can use the
+                // same index for both
+                auto index = gradient_sample_index(gradient_A->as_equistore(), values_A.device());
+                auto gradient_values = values_for_gradient(values_A, index, gradient_values_B) * gradient_values_B
+                                     + gradient_values_A * values_for_gradient(values_B, index, gradient_values_A);
+
+                result.add_gradient(parameter, block_like(
+                    std::move(gradient_values),
+                    gradient_A->as_equistore()
+                ));
+            }
+
+            blocks.emplace_back(std::move(result));
+        }
+    }
+
+    return tensor_like(A, std::move(blocks));
+}
+
+TorchTensorMap equistore_torch::dot(TorchTensorMap A, TorchTensorMap B) {
+    RECORD_FUNCTION("equistore::dot", std::vector<c10::IValue>());
+
+    auto positions = matching_blocks(A, B, "dot");
+
+    auto blocks = std::vector<equistore::TensorBlock>();
+    for (int64_t i=0; i<blocks_count(A); i++) {
+        auto block_A = A->block_by_id(i);
+        auto block_B = B->block_by_id(positions[i]);
+        const auto& equistore_A = block_A->as_equistore();
+        const auto& equistore_B = block_B->as_equistore();
+
+        if (equistore_A.properties() != equistore_B.properties()) {
+            C10_THROW_ERROR(ValueError, "TensorBlocks in `dot` should have the same properties");
+        }
+
+        if (!equistore_B.components().empty()) {
+            C10_THROW_ERROR(ValueError, "the second TensorMap in `dot` should not have components");
+        }
+
+        if (!block_B->gradients_list().empty()) {
+            C10_THROW_ERROR(ValueError, "the second TensorMap in `dot` should not have gradients");
+        }
+
+        auto values_B_transposed = block_B->values().t();
+        auto properties = equistore_B.samples();
+
+        auto result = create_block(
+            torch::matmul(block_A->values(), values_B_transposed),
+            equistore_A.samples(),
+            equistore_A.components(),
+            properties
+        );
+
+        for (const auto& parameter: block_A->gradients_list()) {
+            auto gradient = block_A->gradient(parameter);
+            check_no_gradients_of_gradients(gradient);
+            const auto& equistore_gradient = gradient->as_equistore();
+
+            result.add_gradient(parameter, create_block(
+                torch::matmul(gradient->values(), values_B_transposed),
+                equistore_gradient.samples(),
+                equistore_gradient.components(),
+                properties
+            ));
+        }
+
+        blocks.emplace_back(std::move(result));
+    }
+
+    return tensor_like(A, std::move(blocks));
+}
+
+/******************************************************************************/
+
+enum class Reduction {
+    Sum,
+    Mean,
+    Variance,
+    StandardDeviation,
+};
+
+static equistore::TensorBlock reduce_block_over_samples(
+    const TorchTensorBlock& block,
+    const std::vector<std::string>& remaining_names,
+    const torch::Tensor& remaining_dimensions,
+    Reduction reduction
+) {
+    const auto& equistore_block = block->as_equistore();
+    auto values = block->values();
+    auto device = values.device();
+    auto samples = labels_values(equistore_block.samples());
+
+    if (samples.size(0) == 0) {
+        // there is nothing to reduce, and the gradients are left unchanged
+        auto options = torch::TensorOptions().dtype(torch::kInt32).device(torch::kCPU);
+        auto new_samples = create_labels(
+            remaining_names,
+            torch::zeros({0, static_cast<int64_t>(remaining_names.size())}, options)
+        );
+
+        auto result = create_block(values, new_samples, equistore_block.components(), equistore_block.properties());
+        for (const auto& parameter: block->gradients_list()) {
+            auto gradient = block->gradient(parameter);
+            check_no_gradients_of_gradients(gradient);
+            result.add_gradient(parameter, block_like(gradient->values(), gradient->as_equistore()));
+        }
+
+        return result;
+    }
+
+    // find the samples remaining after the reduction, and where each of the
+    // existing sample should go
+    auto new_samples = torch::Tensor();
+    auto index = torch::Tensor();
+    auto counts = torch::Tensor();
+    if (remaining_names.empty()) {
+        auto options = torch::TensorOptions().dtype(torch::kInt32).device(torch::kCPU);
+        new_samples = torch::zeros({1, 1}, options);
+        index = torch::zeros({samples.size(0)}, options.dtype(torch::kInt64));
+        counts = torch::full({1}, samples.size(0), options.dtype(torch::kInt64));
+    } else {
+        std::tie(new_samples, index, counts) = torch::unique_dim(
+            samples.index_select(1, remaining_dimensions),
+            /*dim=*/0,
+            /*sorted=*/true,
+            /*return_inverse=*/true,
+            /*return_counts=*/true
+        );
+    }
+
+    auto index_device = index.to(device);
+    auto shape = values.sizes().vec();
+    shape[0] = counts.size(0);
+
+    auto result_values = torch::zeros(shape, values.options()).index_add_(0, index_device, values);
+    auto mean_values = torch::Tensor();
+    if (reduction != Reduction::Sum) {
+        auto counts_values = reshape_for_broadcast(counts.to(values.options()), values.dim());
+        result_values = result_values / counts_values;
+
+        if (reduction == Reduction::Variance || reduction == Reduction::StandardDeviation) {
+            auto squares = torch::zeros(shape, values.options()).index_add_(0, index_device, values * values);
+            mean_values = result_values;
+            result_values = squares / counts_values - mean_values * mean_values;
+
+            if (reduction == Reduction::StandardDeviation) {
+                result_values = torch::sqrt(result_values);
+            }
+        }
+    }
+
+    auto result_samples = remaining_names.empty() ?
+        create_labels({"_"}, new_samples) :
+        create_labels(remaining_names, new_samples);
+
+    auto result = create_block(result_values, result_samples, equistore_block.components(), equistore_block.properties());
+
+    for (const auto& parameter: block->gradients_list()) {
+        auto gradient = block->gradient(parameter);
+        check_no_gradients_of_gradients(gradient);
+        const auto& equistore_gradient = gradient->as_equistore();
+        auto gradient_values = gradient->values();
+
+        auto gradient_samples = labels_values(equistore_gradient.samples());
+        if (gradient_samples.size(0) == 0) {
+            // all gradients are zero, and stay zero after the reduction
+            result.add_gradient(parameter, block_like(gradient_values, equistore_gradient));
+            continue;
+        }
+
+        // update the "sample" dimension of the gradient samples to refer to
+        // the new samples, and find the corresponding new gradient samples
+        auto original_sample = gradient_samples.select(1, 0).to(torch::kInt64);
+        gradient_samples.select(1, 0).copy_(index.index_select(0, original_sample));
+
+        auto new_gradient_samples = torch::Tensor();
+        auto gradient_index = torch::Tensor();
+        auto gradient_counts = torch::Tensor();
+        std::tie(new_gradient_samples, gradient_index, gradient_counts) = torch::unique_dim(
+            gradient_samples,
+            /*dim=*/0,
+            /*sorted=*/true,
+            /*return_inverse=*/true,
+            /*return_counts=*/true
+        );
+
+        auto gradient_index_device = gradient_index.to(device);
+        auto gradient_shape = gradient_values.sizes().vec();
+        gradient_shape[0] = gradient_counts.size(0);
+
+        auto gradient_result = torch::zeros(gradient_shape, gradient_values.options())
+            .index_add_(0, gradient_index_device, gradient_values);
+
+        if (reduction != Reduction::Sum) {
+            auto counts_gradient = reshape_for_broadcast(
+                gradient_counts.to(gradient_values.options()),
+                gradient_values.dim()
+            );
+            gradient_result = gradient_result / counts_gradient;
+
+            if (reduction == Reduction::Variance || reduction == Reduction::StandardDeviation) {
+                auto values_times_gradient = gradient_values * values_for_gradient(
+                    values, original_sample.to(device), gradient_values
+                );
+                auto values_gradient_result = torch::zeros(gradient_shape, gradient_values.options())
+                    .index_add_(0, gradient_index_device, values_times_gradient) / counts_gradient;
+
+                auto new_sample = new_gradient_samples.select(1, 0).to(
+                    torch::TensorOptions().dtype(torch::kInt64).device(device)
+                );
+                auto mean_times_gradient = gradient_result * values_for_gradient(mean_values, new_sample, gradient_result);
+
+                if (reduction == Reduction::Variance) {
+                    gradient_result = 2 * (values_gradient_result - mean_times_gradient);
+                } else {
+                    gradient_result = (values_gradient_result - mean_times_gradient) / values_for_gradient(
+                        result_values, new_sample, gradient_result
+                    );
+                    gradient_result = torch::nan_to_num(gradient_result, 0.0, 0.0, 0.0);
+                }
+            }
+        }
+
+        result.add_gradient(parameter, create_block(
+            gradient_result,
+            create_labels(labels_names(equistore_gradient.samples()), new_gradient_samples),
+            equistore_gradient.components(),
+            equistore_gradient.properties()
+        ));
+    }
+
+    return result;
+}
+
+static TorchTensorMap reduce_over_samples(TorchTensorMap tensor, torch::IValue sample_names, Reduction reduction) {
+    auto names = details::normalize_names(std::move(sample_names), "sample_names");
+    auto tensor_names = tensor->sample_names();
+
+    for (const auto& name: names) {
+        if (std::find(std::begin(tensor_names), std::end(tensor_names), name) == std::end(tensor_names)) {
+            C10_THROW_ERROR(ValueError,
+                "one of the requested sample name (" + name + ") is not part of this TensorMap"
+            );
+        }
+    }
+
+    auto remaining_names = std::vector<std::string>();
+    auto remaining_dimensions = std::vector<int64_t>();
+    for (size_t i=0; i<tensor_names.size(); i++) {
+        if (std::find(std::begin(names), std::end(names), tensor_names[i]) == std::end(names)) {
+            remaining_names.push_back(tensor_names[i]);
+            remaining_dimensions.push_back(static_cast<int64_t>(i));
+        }
+    }
+    auto remaining_dimensions_tensor = torch::tensor(
+        remaining_dimensions,
+        torch::TensorOptions().dtype(torch::kInt64)
+    );
+
+    auto blocks = std::vector<equistore::TensorBlock>();
+    for (int64_t i=0; i<blocks_count(tensor); i++) {
+        blocks.emplace_back(reduce_block_over_samples(
+            tensor->block_by_id(i),
+            remaining_names,
+            remaining_dimensions_tensor,
+            reduction
+        ));
+    }
+
+    return tensor_like(tensor, std::move(blocks));
+}
+
+TorchTensorMap equistore_torch::sum_over_samples(TorchTensorMap tensor, torch::IValue sample_names) {
+    RECORD_FUNCTION("equistore::sum_over_samples", std::vector<c10::IValue>());
+
+    return reduce_over_samples(std::move(tensor), std::move(sample_names), Reduction::Sum);
+}
+
+TorchTensorMap equistore_torch::mean_over_samples(TorchTensorMap tensor, torch::IValue sample_names) {
+    RECORD_FUNCTION("equistore::mean_over_samples", std::vector<c10::IValue>());
+
+    return reduce_over_samples(std::move(tensor), std::move(sample_names), Reduction::Mean);
+}
+
+TorchTensorMap equistore_torch::var_over_samples(TorchTensorMap tensor, torch::IValue sample_names) {
+    RECORD_FUNCTION("equistore::var_over_samples", std::vector<c10::IValue>());
+
+    return reduce_over_samples(std::move(tensor), std::move(sample_names), Reduction::Variance);
+}
+
+TorchTensorMap equistore_torch::std_over_samples(TorchTensorMap tensor, torch::IValue sample_names) {
+    RECORD_FUNCTION("equistore::std_over_samples", std::vector<c10::IValue>());
+
+    return reduce_over_samples(std::move(tensor), std::move(sample_names), Reduction::StandardDeviation);
+}
+
+/******************************************************************************/
+
+static equistore::TensorBlock slice_block(
+    const TorchTensorBlock& block,
+    bool samples_axis,
+    const equistore::Labels& selection,
+    const std::vector<std::string>& selection_names
+) {
+    const auto& equistore_block = block->as_equistore();
+    auto values = block->values();
+    auto device = values.device();
+
+    auto axis_labels = samples_axis ? equistore_block.samples() : equistore_block.properties();
+    auto axis_names = labels_names(axis_labels);
+    auto axis_values = labels_values(axis_labels);
+
+    // only keep the dimensions present in the selection
+    auto dimensions = std::vector<int64_t>();
+    for (const auto& name: selection_names) {
+        auto it = std::find(std::begin(axis_names), std::end(axis_names), name);
+        dimensions.push_back(static_cast<int64_t>(std::distance(std::begin(axis_names), it)));
+    }
+    auto entries = axis_values.index_select(
+        1, torch::tensor(dimensions, torch::TensorOptions().dtype(torch::kInt64))
+    ).contiguous();
+
+    auto count = entries.size(0);
+    auto positions = torch::empty({count}, torch::TensorOptions().dtype(torch::kInt64));
+    if (count != 0) {
+        selection.positions(
+            entries.data_ptr<int32_t>(),
+            static_cast<size_t>(count),
+            positions.data_ptr<int64_t>()
+        );
+    }
+
+    auto mask = positions >= 0;
+    auto kept = torch::nonzero(mask).reshape({-1});
+    auto kept_device = kept.to(device);
+    auto new_labels = create_labels(axis_names, axis_values.index_select(0, kept));
+
+    if (samples_axis) {
+        auto result = create_block(
+            values.index_select(0, kept_device),
+            new_labels,
+            equistore_block.components(),
+            equistore_block.properties()
+        );
+
+        // position of the old samples in the new samples, only valid for the
+        // samples we are keeping
+        auto new_position = torch::cumsum(mask.to(torch::kInt64), 0) - 1;
+
+        for (const auto& parameter: block->gradients_list()) {
+            auto gradient = block->gradient(parameter);
+            check_no_gradients_of_gradients(gradient);
+            const auto& equistore_gradient = gradient->as_equistore();
+
+            auto gradient_samples = labels_values(equistore_gradient.samples());
+            auto gradient_sample = gradient_samples.select(1, 0).to(torch::kInt64);
+            auto gradient_kept = torch::nonzero(mask.index_select(0, gradient_sample)).reshape({-1});
+
+            auto new_gradient_samples = gradient_samples.index_select(0, gradient_kept);
+            new_gradient_samples.select(1, 0).copy_(
+                new_position.index_select(0, gradient_sample.index_select(0, gradient_kept))
+            );
+
+            result.add_gradient(parameter, create_block(
+                gradient->values().index_select(0, gradient_kept.to(device)),
+                create_labels(labels_names(equistore_gradient.samples()), new_gradient_samples),
+                equistore_gradient.components(),
+                equistore_block.properties()
+            ));
+        }
+
+        return result;
+    } else {
+        auto result = create_block(
+            values.index_select(-1, kept_device),
+            equistore_block.samples(),
+            equistore_block.components(),
+            new_labels
+        );
+
+        for (const auto& parameter: block->gradients_list()) {
+            auto gradient = block->gradient(parameter);
+            check_no_gradients_of_gradients(gradient);
+            const auto& equistore_gradient = gradient->as_equistore();
+
+            result.add_gradient(parameter, create_block(
+                gradient->values().index_select(-1, kept_device),
+                equistore_gradient.samples(),
+                equistore_gradient.components(),
+                new_labels
+            ));
+        }
+
+        return result;
+    }
+}
+
+TorchTensorMap equistore_torch::slice(TorchTensorMap tensor, std::string axis, TorchLabels labels) {
+    RECORD_FUNCTION("equistore::slice", std::vector<c10::IValue>());
+
+    if (axis != "samples" && axis != "properties") {
+        C10_THROW_ERROR(ValueError,
+            "`axis`: " + axis + " is not known as a slicing axis. Please use "
+            "'samples' or 'properties'"
+        );
+    }
+    auto samples_axis = axis == "samples";
+
+    const auto& selection = labels->as_equistore();
+    const auto& selection_names = labels->names();
+
+    if (blocks_count(tensor) != 0) {
+        auto names = samples_axis ? tensor->sample_names() : tensor->property_names();
+        for (const auto& name: selection_names) {
+            if (std::find(std::begin(names), std::end(names), name) == std::end(names)) {
+                C10_THROW_ERROR(ValueError,
+                    "invalid " + std::string(samples_axis ? "sample" : "property") +
+                    " name '" + name + "' which is not part of the input"
+                );
+            }
+        }
+    }
+
+    auto blocks = std::vector<equistore::TensorBlock>();
+    for (int64_t i=0; i<blocks_count(tensor); i++) {
+        blocks.emplace_back(slice_block(tensor->block_by_id(i), samples_axis, selection, selection_names));
+    }
+
+    return tensor_like(tensor, std::move(blocks));
+}
+
+/******************************************************************************/
+
+TorchTensorMap equistore_torch::join(const std::vector<TorchTensorMap>& tensors, std::string axis) {
+    RECORD_FUNCTION("equistore::join", std::vector<c10::IValue>());
+
+    if (tensors.empty()) {
+        C10_THROW_ERROR(ValueError, "provide at least one `TensorMap` for joining");
+    }
+
+    if (axis != "samples" && axis != "properties") {
+        C10_THROW_ERROR(ValueError,
+            "Only `'properties'` or `'samples'` are valid values for the `axis` parameter."
+        );
+    }
+    auto samples_axis = axis == "samples";
+
+    if (tensors.size() == 1) {
+        return tensors[0];
+    }
+
+    for (size_t i=1; i<tensors.size(); i++) {
+        matching_blocks(tensors[0], tensors[i], "join");
+    }
+
+    // check if the samples/properties names are the same in all tensors
+    auto all_names = std::vector<std::vector<std::string>>();
+    auto unique_names = std::set<std::string>();
+    for (const auto& tensor: tensors) {
+        auto names = samples_axis ? tensor->sample_names() : tensor->property_names();
+        unique_names.insert(std::begin(names), std::end(names));
+        all_names.emplace_back(std::move(names));
+    }
+
+    auto names_are_same = true;
+    for (const auto& names: all_names) {
+        if (names.size() != unique_names.size()) {
+            names_are_same = false;
+        }
+    }
+
+    // it's fine to lose metadata on the property axis, less so on the sample axis
+    if (samples_axis && !names_are_same) {
+        C10_THROW_ERROR(ValueError,
+            "Sample names are not the same! Joining along samples with different "
+            "sample names will loose information and is not supported."
+        );
+    }
+
+    auto keys_names = std::vector<std::string>{"tensor"};
+    for (const auto& name: labels_names(tensors[0]->as_equistore().keys())) {
+        keys_names.push_back(name);
+    }
+
+    auto keys_values = std::vector<torch::Tensor>();
+    auto blocks = std::vector<equistore::TensorBlock>();
+    for (size_t i=0; i<tensors.size(); i++) {
+        const auto& tensor = tensors[i];
+
+        auto values = labels_values(tensor->as_equistore().keys());
+        auto tensor_index = torch::full({values.size(0), 1}, static_cast<int64_t>(i), values.options());
+        keys_values.emplace_back(torch::cat({tensor_index, values}, 1));
+
+        for (int64_t block_i=0; block_i<blocks_count(tensor); block_i++) {
+            auto block = tensor->block_by_id(block_i);
+            const auto& equistore_block = block->as_equistore();
+
+            auto properties = equistore_block.properties();
+            if (!names_are_same) {
+                auto options = torch::TensorOptions().dtype(torch::kInt32).device(torch::kCPU);
+                auto count = static_cast<int64_t>(properties.count());
+                properties = create_labels({"property"}, torch::arange(count, options).reshape({count, 1}));
+            }
+
+            auto result = create_block(
+                block->values(),
+                equistore_block.samples(),
+                equistore_block.components(),
+                properties
+            );
+
+            for (const auto& parameter: block->gradients_list()) {
+                auto gradient = block->gradient(parameter);
+                check_no_gradients_of_gradients(gradient);
+                const auto& equistore_gradient = gradient->as_equistore();
+
+                result.add_gradient(parameter, create_block(
+                    gradient->values(),
+                    equistore_gradient.samples(),
+                    equistore_gradient.components(),
+                    properties
+                ));
+            }
+
+            blocks.emplace_back(std::move(result));
+        }
+    }
+
+    auto keys = create_labels(keys_names, torch::cat(keys_values, 0));
+    auto joined = equistore::TensorMap(std::move(keys), std::move(blocks));
+
+    if (samples_axis) {
+        return torch::make_intrusive<TensorMapHolder>(joined.keys_to_samples(std::string("tensor")));
+    } else {
+        return torch::make_intrusive<TensorMapHolder>(joined.keys_to_properties(std::string("tensor")));
+    }
+}
@@ -5,10 +5,24 @@
 #include "equistore/torch/labels.hpp"
 #include "equistore/torch/block.hpp"
 #include "equistore/torch/tensor.hpp"
+#include "equistore/torch/lazy.hpp"
 #include "equistore/torch/misc.hpp"
+#include "equistore/torch/operations.hpp"
 
 using namespace equistore_torch;
 
+// Pickle state of a `TensorBlock`: values, samples, components, properties
+// and the list of (parameter, gradient) pairs. The values (and the values of
+// the Labels) are stored as separate tensors, letting torch handle the
+// storage sharing (shared memory in DataLoader workers, CUDA IPC, etc.)
+using TensorBlockState = std::tuple<
+    torch::Tensor,
+    TorchLabels,
+    std::vector<TorchLabels>,
+    TorchLabels,
+    std::vector<std::tuple<std::string, TorchTensorBlock>>
+>;
+
 
 static TorchLabelsEntry labels_entry(const TorchLabels& self, int64_t index) {
     return torch::make_intrusive<LabelsEntryHolder>(self, index);
@@ -87,6 +101,7 @@ TORCH_LIBRARY(equistore, m) {
         .def_static("single", &LabelsHolder::single)
         .def_static("empty", &LabelsHolder::empty)
         .def_static("range", &LabelsHolder::range)
+        .def_static("deferred", &LabelsHolder::deferred)
         .def("entry", labels_entry, DOCSTRING, {torch::arg("index")})
         .def("column", &LabelsHolder::column, DOCSTRING, {torch::arg("dimension")})
         .def("view", [](const TorchLabels& self, torch::IValue names) {
@@ -101,6 +116,10 @@ TORCH_LIBRARY(equistore, m) {
         .def("position", &LabelsHolder::position, DOCSTRING,
             {torch::arg("entry")}
         )
+        .def("positions", &LabelsHolder::positions, DOCSTRING,
+            {torch::arg("entries")}
+        )
+        .def("has_unique_entries", &LabelsHolder::has_unique_entries)
         .def("print", &LabelsHolder::print, DOCSTRING,
             {torch::arg("max_entries"), torch::arg("indent") = 0}
         )
@@ -108,8 +127,22 @@ TORCH_LIBRARY(equistore, m) {
         .def("to_owned", [](const TorchLabels& self){ return torch::make_intrusive<LabelsHolder>(self->to_owned()); })
         .def("union", &LabelsHolder::set_union, DOCSTRING, {torch::arg("other")})
         .def("union_and_mapping", &LabelsHolder::union_and_mapping, DOCSTRING, {torch::arg("other")})
+        .def_static("union_many", &LabelsHolder::union_many)
+        .def_static("union_many_and_mapping", &LabelsHolder::union_many_and_mapping)
         .def("intersection", &LabelsHolder::set_intersection, DOCSTRING, {torch::arg("other")})
         .def("intersection_and_mapping", &LabelsHolder::intersection_and_mapping, DOCSTRING, {torch::arg("other")})
+        .def_pickle(
+            // __getstate__
+            [](const TorchLabels& self) -> std::tuple<std::vector<std::string>, torch::Tensor> {
+                return {self->names(), self->values()};
+            },
+            // __setstate__
+            [](std::tuple<std::vector<std::string>, torch::Tensor> state) -> TorchLabels {
+                return torch::make_intrusive<LabelsHolder>(
+                    std::move(std::get<0>(state)),
+                    std::move(std::get<1>(state))
+                );
+            })
         ;
 
     m.class_<TensorBlockHolder>("TensorBlock")
@@ -135,6 +168,37 @@ TORCH_LIBRARY(equistore, m) {
             {torch::arg("parameter")}
         )
         .def("gradients", &TensorBlockHolder::gradients)
+        .def_pickle(
+            // __getstate__
+            [](const TorchTensorBlock& self) -> TensorBlockState {
+                auto gradients = std::vector<std::tuple<std::string, TorchTensorBlock>>();
+                for (const auto& parameter: self->gradients_list()) {
+                    gradients.emplace_back(parameter, self->gradient(parameter));
+                }
+
+                return {
+                    self->values(),
+                    self->samples(),
+                    self->components(),
+                    self->properties(),
+                    std::move(gradients),
+                };
+            },
+            // __setstate__
+            [](TensorBlockState state) -> TorchTensorBlock {
+                auto block = torch::make_intrusive<TensorBlockHolder>(
+                    std::move(std::get<0>(state)),
+                    std::move(std::get<1>(state)),
+                    std::move(std::get<2>(state)),
+                    std::move(std::get<3>(state))
+                );
+
+                for (auto& gradient: std::get<4>(state)) {
+                    block->add_gradient(std::get<0>(gradient), std::move(std::get<1>(gradient)));
+                }
+
+                return block;
+            })
         ;
 
     m.class_<TensorMapHolder>("TensorMap")
@@ -167,14 +231,15 @@ TORCH_LIBRARY(equistore, m) {
             {torch::arg("selection") = torch::IValue()}
         )
         .def("keys_to_samples", &TensorMapHolder::keys_to_samples, DOCSTRING,
-            {torch::arg("keys_to_move"), torch::arg("sort_samples") = true}
+            {torch::arg("keys_to_move"), torch::arg("sort_samples") = true, torch::arg("threads") = 1}
         )
         .def("keys_to_properties", &TensorMapHolder::keys_to_properties, DOCSTRING,
-            {torch::arg("keys_to_move"), torch::arg("sort_samples") = true}
+            {torch::arg("keys_to_move"), torch::arg("sort_samples") = true, torch::arg("threads") = 1}
         )
         .def("components_to_properties", &TensorMapHolder::components_to_properties, DOCSTRING,
             {torch::arg("dimensions")}
         )
+        .def_static("join_samples", &TensorMapHolder::join_samples)
         .def_property("sample_names", &TensorMapHolder::sample_names)
         .def_property("components_names", &TensorMapHolder::components_names)
         .def_property("property_names", &TensorMapHolder::property_names)
@@ -183,39 +248,90 @@ TORCH_LIBRARY(equistore, m) {
         )
         .def_pickle(
             // __getstate__
-            [](const TorchTensorMap& self) -> torch::Tensor {
-                auto buffer = equistore::TensorMap::save_buffer(self->as_equistore());
-                // move the buffer to the heap so it can escape this function
-                // `torch::from_blob` does not take ownership of the data,
-                // so we need to register a custom deleter to clean up when
-                // the tensor is no longer used
-                auto buffer_data = new std::vector<uint8_t>(std::move(buffer));
-
-                auto options = torch::TensorOptions().dtype(torch::kU8).device(torch::kCPU);
-                auto deleter = [=](void* data) {
-                    delete buffer_data;
-                };
-
-                // use a tensor of bytes to store the data
-                return torch::from_blob(
-                    buffer_data->data(),
-                    {static_cast<int64_t>(buffer_data->size())},
-                    deleter,
-                    options
-                );
+            [](const TorchTensorMap& self) -> std::tuple<TorchLabels, std::vector<TorchTensorBlock>> {
+                return {self->keys(), self->blocks()};
             },
             // __setstate__
-            [](torch::Tensor buffer) -> TorchTensorMap {
+            [](std::tuple<TorchLabels, std::vector<TorchTensorBlock>> state) -> TorchTensorMap {
                 return torch::make_intrusive<TensorMapHolder>(
-                    equistore::TensorMap::load_buffer(
-                        buffer.data_ptr<uint8_t>(),
-                        buffer.size(0),
-                        details::create_torch_array
-                    )
+                    std::move(std::get<0>(state)),
+                    std::move(std::get<1>(state))
                 );
             })
         ;
 
-    m.def("load", equistore_torch::load);
+    m.class_<TensorMapBuilderHolder>("TensorMapBuilder")
+        .def(
+            torch::init<std::vector<std::string>>(), DOCSTRING,
+            {torch::arg("names")}
+        )
+        .def("add_block", &TensorMapBuilderHolder::add_block, DOCSTRING,
+            {torch::arg("key"), torch::arg("block")}
+        )
+        .def("finish", &TensorMapBuilderHolder::finish)
+        ;
+
+    m.class_<LazyTensorMapHolder>("LazyTensorMap")
+        .def(
+            torch::init<std::string, int64_t>(), DOCSTRING,
+            {torch::arg("path"), torch::arg("max_blocks") = 0}
+        )
+        .def("__len__", [](const TorchLazyTensorMap& self){ return self->keys()->count(); })
+        .def_property("keys", &LazyTensorMapHolder::keys)
+        .def("blocks_matching", &LazyTensorMapHolder::blocks_matching, DOCSTRING,
+            {torch::arg("selection")}
+        )
+        .def("block_by_id", &LazyTensorMapHolder::block_by_id, DOCSTRING,
+            {torch::arg("index")}
+        )
+        .def("loaded_blocks", &LazyTensorMapHolder::loaded_blocks)
+        .def("clear", &LazyTensorMapHolder::clear)
+        ;
+
+    m.def(
+        "load(str path, int threads=1, Device? device=None) -> __torch__.torch.classes.equistore.TensorMap",
+        equistore_torch::load
+    );
+    m.def(
+        "load_lazy(str path, int max_blocks=0) -> __torch__.torch.classes.equistore.LazyTensorMap",
+        equistore_torch::load_lazy
+    );
     m.def("save", equistore_torch::save);
+
+    m.def(
+        "add(__torch__.torch.classes.equistore.TensorMap A, Any B) -> __torch__.torch.classes.equistore.TensorMap",
+        equistore_torch::add
+    );
+    m.def(
+        "multiply(__torch__.torch.classes.equistore.TensorMap A, Any B) -> __torch__.torch.classes.equistore.TensorMap",
+        equistore_torch::multiply
+    );
+    m.def(
+        "dot(__torch__.torch.classes.equistore.TensorMap A, __torch__.torch.classes.equistore.TensorMap B) -> __torch__.torch.classes.equistore.TensorMap",
+        equistore_torch::dot
+    );
+    m.def(
+        "sum_over_samples(__torch__.torch.classes.equistore.TensorMap tensor, Any sample_names) -> __torch__.torch.classes.equistore.TensorMap",
+        equistore_torch::sum_over_samples
+    );
+    m.def(
+        "mean_over_samples(__torch__.torch.classes.equistore.TensorMap tensor, Any sample_names) -> __torch__.torch.classes.equistore.TensorMap",
+        equistore_torch::mean_over_samples
+    );
+    m.def(
+        "var_over_samples(__torch__.torch.classes.equistore.TensorMap tensor, Any sample_names) -> __torch__.torch.classes.equistore.TensorMap",
+        equistore_torch::var_over_samples
+    );
+    m.def(
+        "std_over_samples(__torch__.torch.classes.equistore.TensorMap tensor, Any sample_names) -> __torch__.torch.classes.equistore.TensorMap",
+        equistore_torch::std_over_samples
+    );
+    m.def(
+        "slice(__torch__.torch.classes.equistore.TensorMap tensor, str axis, __torch__.torch.classes.equistore.Labels labels) -> __torch__.torch.classes.equistore.TensorMap",
+        equistore_torch::slice
+    );
+    m.def(
+        "join(__torch__.torch.classes.equistore.TensorMap[] tensors, str axis) -> __torch__.torch.classes.equistore.TensorMap",
+        equistore_torch::join
+    );
 }
@@ -1,3 +1,7 @@
+#include <unordered_map>
+
+#include <ATen/record_function.h>
+
 #include <equistore.hpp>
 
 #include "equistore/torch/tensor.hpp"
@@ -6,25 +10,84 @@
 
 using namespace equistore_torch;
 
-TensorMapHolder::TensorMapHolder(equistore::TensorMap tensor): tensor_(std::move(tensor)) {}
+TensorMapHolder::TensorMapHolder(equistore::TensorMap tensor):
+    tensor_(std::move(tensor)),
+    blocks_(tensor_.keys().count())
+{}
+
+/// Share equal `Labels` between the blocks of a `TensorMap`, so the metadata
+/// is only stored and indexed once. Labels are grouped by a cheap hash (names,
+/// number of entries and a couple of entries), and then compared in full.
+///
+/// The Labels interning in equistore-core does not apply here, since the
+/// values tensor is attached to each Labels as user data.
+class LabelsInterner {
+public:
+    const equistore::Labels& intern(const TorchLabels& labels) {
+        const auto& equistore_labels = labels->as_equistore();
+
+        auto& candidates = labels_[content_hash(equistore_labels)];
+        for (const auto& candidate: candidates) {
+            if (candidate.get() == labels.get()) {
+                return equistore_labels;
+            }
+
+            // the values tensor of the shared labels will be used for all
+            // blocks, so it must live on the same device
+            if (candidate->values().device() == labels->values().device() &&
+                candidate->as_equistore() == equistore_labels) {
+                return candidate->as_equistore();
+            }
+        }
+
+        candidates.push_back(labels);
+        return equistore_labels;
+    }
 
-static equistore::TensorBlock block_from_torch(const TorchTensorBlock& block) {
+private:
+    static size_t content_hash(const equistore::Labels& labels) {
+        size_t hash = 0;
+        auto combine = [&hash](size_t value) {
+            hash ^= value + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+        };
+
+        for (const auto* name: labels.names()) {
+            combine(std::hash<std::string>()(name));
+        }
+
+        auto count = labels.count();
+        combine(count);
+        if (count != 0 && labels.size() != 0) {
+            for (auto i: {size_t(0), count / 2, count - 1}) {
+                for (size_t j=0; j<labels.size(); j++) {
+                    combine(std::hash<int32_t>()(labels(i, j)));
+                }
+            }
+        }
+
+        return hash;
+    }
+
+    std::unordered_map<size_t, std::vector<TorchLabels>> labels_;
+};
+
+static equistore::TensorBlock block_from_torch(const TorchTensorBlock& block, LabelsInterner& interner) {
     auto components = std::vector<equistore::Labels>();
     for (const auto& component: block->components()) {
-        components.push_back(component->as_equistore());
+        components.push_back(interner.intern(component));
     }
 
     // use copy constructors of everything here, incrementing reference count
     // of the data and metadata
     auto result = equistore::TensorBlock(
         std::make_unique<TorchDataArray>(block->values()),
-        block->samples()->as_equistore(),
+        interner.intern(block->samples()),
         components,
-        block->properties()->as_equistore()
+        interner.intern(block->properties())
     );
 
     for (const auto& parameter: block->gradients_list()) {
-        auto gradient = block_from_torch(block->gradient(parameter));
+        auto gradient = block_from_torch(block->gradient(parameter), interner);
         result.add_gradient(parameter, std::move(gradient));
     }
 
@@ -32,27 +95,38 @@ static equistore::TensorBlock block_from_torch(const TorchTensorBlock& block) {
 }
 
 static std::vector<equistore::TensorBlock> blocks_from_torch(const std::vector<TorchTensorBlock>& blocks) {
+    auto interner = LabelsInterner();
     auto results = std::vector<equistore::TensorBlock>();
     for (const auto& block: blocks) {
-        results.emplace_back(block_from_torch(block));
+        results.emplace_back(block_from_torch(block, interner));
     }
     return results;
 }
 
 
 TensorMapHolder::TensorMapHolder(TorchLabels keys, const std::vector<TorchTensorBlock>& blocks):
-    tensor_(keys->as_equistore(), blocks_from_torch(std::move(blocks)))
+    tensor_(keys->as_equistore(), blocks_from_torch(std::move(blocks))),
+    keys_(std::move(keys)),
+    blocks_(blocks.size())
 {}
 
 TorchTensorMap TensorMapHolder::copy() const {
+    RECORD_FUNCTION("equistore::TensorMap::copy", std::vector<c10::IValue>());
+
     return torch::make_intrusive<TensorMapHolder>(this->tensor_.clone());
 }
 
 TorchLabels TensorMapHolder::keys() const {
-    return torch::make_intrusive<LabelsHolder>(this->tensor_.keys());
+    std::lock_guard<std::mutex> lock(cache_mutex_);
+    if (!keys_) {
+        keys_ = torch::make_intrusive<LabelsHolder>(this->tensor_.keys());
+    }
+    return keys_;
 }
 
 std::vector<int64_t> TensorMapHolder::blocks_matching(const TorchLabels& selection) const {
+    RECORD_FUNCTION("equistore::TensorMap::blocks_matching", std::vector<c10::IValue>());
+
     auto results = tensor_.blocks_matching(selection->as_equistore());
 
     auto results_int64 = std::vector<int64_t>();
@@ -65,16 +139,43 @@ std::vector<int64_t> TensorMapHolder::blocks_matching(const TorchLabels& selecti
 }
 
 TorchTensorBlock TensorMapHolder::block_by_id(int64_t index) {
-    if (index >= this->keys()->count()) {
+    auto count = static_cast<int64_t>(blocks_.size());
+    if (index < 0 || index >= count) {
         // this needs to be an IndexError to enable iteration over a TensorMap
         C10_THROW_ERROR(IndexError,
-            "block index out of bounds: we have " + std::to_string(this->keys()->count())
+            "block index out of bounds: we have " + std::to_string(count)
             + " blocks but the index is " + std::to_string(index)
         );
     }
-    return torch::make_intrusive<TensorBlockHolder>(tensor_.block_by_id(index));
+
+    std::lock_guard<std::mutex> lock(cache_mutex_);
+    auto& block = blocks_[static_cast<size_t>(index)];
+    if (!block) {
+        block = torch::make_intrusive<TensorBlockHolder>(tensor_.block_by_id(static_cast<uintptr_t>(index)));
+    }
+    return block;
+}
+
+
+/// Format a selection the same way as `LabelsEntryHolder::print`
+static std::string print_selection(const std::vector<std::string>& names, const std::vector<int32_t>& values) {
+    auto output = std::string("(");
+    for (size_t i=0; i<names.size(); i++) {
+        output += names[i] + "=" + std::to_string(values[i]);
+        if (i < names.size() - 1) {
+            output += ", ";
+        }
+    }
+    output += ")";
+    return output;
 }
 
+/// Get the values of a `LabelsEntry` as a vector on CPU
+static std::vector<int32_t> entry_values(const TorchLabelsEntry& entry) {
+    auto cpu_values = entry->values().to(torch::kCPU).contiguous();
+    const auto* data = cpu_values.data_ptr<int32_t>();
+    return std::vector<int32_t>(data, data + cpu_values.numel());
+}
 
 TorchTensorBlock TensorMapHolder::block(const std::map<std::string, int32_t>& selection_dict) {
     auto names = std::vector<std::string>();
@@ -84,8 +185,7 @@ TorchTensorBlock TensorMapHolder::block(const std::map<std::string, int32_t>& se
         values.push_back(static_cast<int32_t>(it.second));
     }
 
-    auto selection = equistore::Labels(names, values.data(), 1);
-    return this->block(torch::make_intrusive<LabelsHolder>(std::move(selection)));
+    return this->block_matching(names, values);
 }
 
 TorchTensorBlock TensorMapHolder::block(TorchLabels selection) {
@@ -99,24 +199,23 @@ TorchTensorBlock TensorMapHolder::block(TorchLabels selection) {
 }
 
 TorchTensorBlock TensorMapHolder::block(TorchLabelsEntry torch_selection) {
-    auto cpu_values = torch_selection->values().to(torch::kCPU);
-    auto selection = equistore::Labels(
-        torch_selection->names(), cpu_values.data_ptr<int32_t>(), 1
-    );
+    return this->block_matching(torch_selection->names(), entry_values(torch_selection));
+}
 
-    auto matching = tensor_.blocks_matching(selection);
+TorchTensorBlock TensorMapHolder::block_matching(const std::vector<std::string>& names, const std::vector<int32_t>& values) {
+    auto matching = tensor_.blocks_matching(names, values);
     if (matching.size() == 0) {
         C10_THROW_ERROR(ValueError,
-            "could not find blocks matching the selection " + torch_selection->print()
+            "could not find blocks matching the selection " + print_selection(names, values)
         );
     } else if (matching.size() != 1) {
         C10_THROW_ERROR(ValueError,
-            "got more than one matching block for " + torch_selection->print() +
+            "got more than one matching block for " + print_selection(names, values) +
             ", use the `blocks` function to select more than one block"
         );
     }
 
-    return this->block_by_id(matching[0]);
+    return this->block_by_id(static_cast<int64_t>(matching[0]));
 }
 
 TorchTensorBlock TensorMapHolder::block_torch(torch::IValue index) {
@@ -181,8 +280,8 @@ std::vector<TorchTensorBlock> TensorMapHolder::blocks_by_id(const std::vector<in
 
 std::vector<TorchTensorBlock> TensorMapHolder::blocks() {
     auto result = std::vector<TorchTensorBlock>();
-    for (size_t i=0; i<tensor_.keys().count(); i++) {
-        result.push_back(this->block_by_id(i));
+    for (size_t i=0; i<blocks_.size(); i++) {
+        result.push_back(this->block_by_id(static_cast<int64_t>(i)));
     }
     return result;
 }
@@ -196,8 +295,12 @@ std::vector<TorchTensorBlock> TensorMapHolder::blocks(const std::map<std::string
         values.push_back(static_cast<int32_t>(it.second));
     }
 
-    auto selection = equistore::Labels(names, values.data(), 1);
-    return this->blocks(torch::make_intrusive<LabelsHolder>(std::move(selection)));
+    auto matching = std::vector<int64_t>();
+    for (auto m: tensor_.blocks_matching(names, values)) {
+        matching.push_back(static_cast<int64_t>(m));
+    }
+
+    return this->blocks_by_id(matching);
 }
 
 
@@ -213,13 +316,8 @@ std::vector<TorchTensorBlock> TensorMapHolder::blocks(TorchLabels selection) {
 
 
 std::vector<TorchTensorBlock> TensorMapHolder::blocks(TorchLabelsEntry torch_selection) {
-    auto cpu_values = torch_selection->values().to(torch::kCPU);
-    auto selection = equistore::Labels(
-        torch_selection->names(), cpu_values.data_ptr<int32_t>(), 1
-    );
-
     auto matching = std::vector<int64_t>();
-    for (auto m: tensor_.blocks_matching(selection)) {
+    for (auto m: tensor_.blocks_matching(torch_selection->names(), entry_values(torch_selection))) {
         matching.push_back(static_cast<int64_t>(m));
     }
 
@@ -318,14 +416,22 @@ static std::vector<std::string> extract_list_str(const torch::IValue& keys_to_mo
     }
 }
 
-TorchTensorMap TensorMapHolder::keys_to_properties(torch::IValue keys_to_move, bool sort_samples) const {
+TorchTensorMap TensorMapHolder::keys_to_properties(torch::IValue keys_to_move, bool sort_samples, int64_t threads) const {
+    RECORD_FUNCTION("equistore::TensorMap::keys_to_properties", std::vector<c10::IValue>());
+
+    if (threads < 0) {
+        C10_THROW_ERROR(ValueError,
+            "TensorMap::keys_to_properties `threads` must be positive or zero, got " + std::to_string(threads)
+        );
+    }
+
     if (keys_to_move.isString() || keys_to_move.isList() || keys_to_move.isTuple()) {
         auto selection = extract_list_str(keys_to_move, "TensorMap::keys_to_properties first argument");
-        auto tensor = tensor_.keys_to_properties(selection, sort_samples);
+        auto tensor = tensor_.keys_to_properties(selection, sort_samples, static_cast<size_t>(threads));
         return torch::make_intrusive<TensorMapHolder>(std::move(tensor));
     } else if (keys_to_move.isCustomClass()) {
         auto selection = keys_to_move.toCustomClass<LabelsHolder>();
-        auto tensor = tensor_.keys_to_properties(selection->as_equistore(), sort_samples);
+        auto tensor = tensor_.keys_to_properties(selection->as_equistore(), sort_samples, static_cast<size_t>(threads));
         return torch::make_intrusive<TensorMapHolder>(std::move(tensor));
     } else {
         C10_THROW_ERROR(TypeError,
@@ -334,14 +440,22 @@ TorchTensorMap TensorMapHolder::keys_to_properties(torch::IValue keys_to_move, b
     }
 }
 
-TorchTensorMap TensorMapHolder::keys_to_samples(torch::IValue keys_to_move, bool sort_samples) const {
+TorchTensorMap TensorMapHolder::keys_to_samples(torch::IValue keys_to_move, bool sort_samples, int64_t threads) const {
+    RECORD_FUNCTION("equistore::TensorMap::keys_to_samples", std::vector<c10::IValue>());
+
+    if (threads < 0) {
+        C10_THROW_ERROR(ValueError,
+            "TensorMap::keys_to_samples `threads` must be positive or zero, got " + std::to_string(threads)
+        );
+    }
+
     if (keys_to_move.isString() || keys_to_move.isList() || keys_to_move.isTuple()) {
         auto selection = extract_list_str(keys_to_move, "TensorMap::keys_to_samples first argument");
-        auto tensor = tensor_.keys_to_samples(selection, sort_samples);
+        auto tensor = tensor_.keys_to_samples(selection, sort_samples, static_cast<size_t>(threads));
         return torch::make_intrusive<TensorMapHolder>(std::move(tensor));
     } else if (keys_to_move.isCustomClass()) {
         auto selection = keys_to_move.toCustomClass<LabelsHolder>();
-        auto tensor = tensor_.keys_to_samples(selection->as_equistore(), sort_samples);
+        auto tensor = tensor_.keys_to_samples(selection->as_equistore(), sort_samples, static_cast<size_t>(threads));
         return torch::make_intrusive<TensorMapHolder>(std::move(tensor));
     } else {
         C10_THROW_ERROR(TypeError,
@@ -350,40 +464,47 @@ TorchTensorMap TensorMapHolder::keys_to_samples(torch::IValue keys_to_move, bool
     }
 }
 
-TorchTensorMap TensorMapHolder::components_to_properties(torch::IValue dimensions) const {
-    auto selection = extract_list_str(dimensions, "TensorMap::components_to_properties argument");
-    auto tensor = this->tensor_.components_to_properties(selection);
-    return torch::make_intrusive<TensorMapHolder>(std::move(tensor));
-}
+TorchTensorMap TensorMapHolder::join_samples(const std::vector<TorchTensorMap>& tensors, int64_t threads) {
+    RECORD_FUNCTION("equistore::TensorMap::join_samples", std::vector<c10::IValue>());
 
-static std::vector<std::string> labels_names(const equistore::TensorBlock& block, size_t dimension) {
-    auto result = std::vector<std::string>();
+    if (threads < 0) {
+        C10_THROW_ERROR(ValueError,
+            "TensorMap::join_samples `threads` must be positive or zero, got " + std::to_string(threads)
+        );
+    }
 
-    auto labels = block.labels(dimension);
-    for (const auto& name: labels.names()) {
-        result.push_back(std::string(name));
+    auto pointers = std::vector<const equistore::TensorMap*>();
+    pointers.reserve(tensors.size());
+    for (const auto& tensor: tensors) {
+        pointers.push_back(&tensor->as_equistore());
     }
 
-    return result;
+    auto tensor = equistore::TensorMap::join_samples(pointers, static_cast<size_t>(threads));
+    return torch::make_intrusive<TensorMapHolder>(std::move(tensor));
+}
+
+TorchTensorMap TensorMapHolder::components_to_properties(torch::IValue dimensions) const {
+    RECORD_FUNCTION("equistore::TensorMap::components_to_properties", std::vector<c10::IValue>());
+
+    auto selection = extract_list_str(dimensions, "TensorMap::components_to_properties argument");
+    auto tensor = this->tensor_.components_to_properties(selection);
+    return torch::make_intrusive<TensorMapHolder>(std::move(tensor));
 }
 
 std::vector<std::string> TensorMapHolder::sample_names() {
-    if (tensor_.keys().count() == 0) {
+    if (blocks_.empty()) {
         return {};
     }
 
-    return labels_names(this->block_by_id(0)->as_equistore(), 0);
+    return this->block_by_id(0)->samples()->names();
 }
 
 std::vector<std::vector<std::string>> TensorMapHolder::components_names() {
     auto result = std::vector<std::vector<std::string>>();
 
-    if (tensor_.keys().count() != 0) {
-        auto block = this->block_by_id(0);
-        auto n_dimensions = block->values().sizes().size();
-
-        for (size_t dimension=1; dimension<n_dimensions-1; dimension++) {
-            result.push_back(labels_names(block->as_equistore(), dimension));
+    if (!blocks_.empty()) {
+        for (const auto& component: this->block_by_id(0)->components()) {
+            result.push_back(component->names());
         }
     }
 
@@ -391,14 +512,11 @@ std::vector<std::vector<std::string>> TensorMapHolder::components_names() {
 }
 
 std::vector<std::string> TensorMapHolder::property_names() {
-    if (tensor_.keys().count() == 0) {
+    if (blocks_.empty()) {
         return {};
     }
 
-    auto block = this->block_by_id(0);
-    auto n_dimensions = block->values().sizes().size();
-
-    return labels_names(block->as_equistore(), n_dimensions - 1);
+    return this->block_by_id(0)->properties()->names();
 }
 
 std::vector<std::tuple<TorchLabelsEntry, TorchTensorBlock>> TensorMapHolder::items() {
@@ -422,3 +540,27 @@ std::string TensorMapHolder::print(int64_t max_keys) const {
     output << "keys:" << keys->print(max_keys, 5);
     return output.str();
 }
+
+
+TensorMapBuilderHolder::TensorMapBuilderHolder(const std::vector<std::string>& names):
+    builder_(names)
+{}
+
+void TensorMapBuilderHolder::add_block(const std::vector<int64_t>& key, const TorchTensorBlock& block) {
+    RECORD_FUNCTION("equistore::TensorMapBuilder::add_block", std::vector<c10::IValue>());
+
+    auto key_int32 = std::vector<int32_t>();
+    key_int32.reserve(key.size());
+    for (auto value: key) {
+        key_int32.push_back(static_cast<int32_t>(value));
+    }
+
+    auto interner = LabelsInterner();
+    builder_.add_block(key_int32, block_from_torch(block, interner));
+}
+
+TorchTensorMap TensorMapBuilderHolder::finish() {
+    RECORD_FUNCTION("equistore::TensorMapBuilder::finish", std::vector<c10::IValue>());
+
+    return torch::make_intrusive<TensorMapHolder>(builder_.finish());
+}
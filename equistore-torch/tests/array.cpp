@@ -18,6 +18,26 @@ TEST_CASE("Arrays") {
         CHECK(std::string(buffer) == "equistore_torch::TorchDataArray");
     }
 
+    SECTION("dtype") {
+        CHECK(array.dtype() == EQS_DTYPE_FLOAT64);
+        CHECK(array.raw_data() == static_cast<void*>(array.data()));
+
+        auto array_f32 = TorchDataArray(torch::ones({2, 3}, torch::kF32));
+        CHECK(array_f32.dtype() == EQS_DTYPE_FLOAT32);
+        CHECK(static_cast<float*>(array_f32.raw_data())[5] == 1.0f);
+        CHECK_THROWS_WITH(array_f32.data(), Catch::Matchers::StartsWith(
+            "can not access the data of this torch::Tensor: expected a dtype of float64"
+        ));
+
+        auto array_f16 = TorchDataArray(torch::ones({2, 3}, torch::kF16));
+        CHECK(array_f16.dtype() == EQS_DTYPE_FLOAT16);
+
+        auto array_i32 = TorchDataArray(torch::ones({2, 3}, torch::kInt32));
+        CHECK_THROWS_WITH(array_i32.dtype(), Catch::Matchers::StartsWith(
+            "unsupported dtype for equistore: int"
+        ));
+    }
+
     SECTION("shape") {
         auto shape = array.shape();
         CHECK(shape.size() == 3);
@@ -61,5 +81,97 @@ TEST_CASE("Arrays") {
 
         CHECK((created_ptr->tensor().sizes() == std::vector<int64_t>{5, 6}));
         CHECK(created_ptr->tensor().dtype() == torch::kF64);
+
+        auto uninit = array.create_uninit({3, 2});
+        auto uninit_ptr = dynamic_cast<TorchDataArray*>(uninit.get());
+
+        CHECK((uninit_ptr->tensor().sizes() == std::vector<int64_t>{3, 2}));
+        CHECK(uninit_ptr->tensor().dtype() == torch::kF64);
+    }
+
+    SECTION("move samples") {
+        auto input = TorchDataArray(torch::arange(12, torch::kF64).reshape({4, 1, 3}));
+        auto output = TorchDataArray(torch::zeros({4, 1, 5}, torch::kF64));
+
+        // contiguous input and output samples
+        output.move_samples_from(input, {{0, 1}, {1, 2}}, 0, 3);
+        CHECK(torch::all(output.tensor()[1].narrow(-1, 0, 3) == input.tensor()[0]).item<bool>());
+        CHECK(torch::all(output.tensor()[2].narrow(-1, 0, 3) == input.tensor()[1]).item<bool>());
+        CHECK(torch::all(output.tensor()[0].narrow(-1, 0, 3) == 0).item<bool>());
+
+        // contiguous input samples only
+        output.move_samples_from(input, {{2, 3}, {3, 0}}, 2, 5);
+        CHECK(torch::all(output.tensor()[3].narrow(-1, 2, 3) == input.tensor()[2]).item<bool>());
+        CHECK(torch::all(output.tensor()[0].narrow(-1, 2, 3) == input.tensor()[3]).item<bool>());
+
+        // scattered input and output samples
+        auto scattered = TorchDataArray(torch::zeros({4, 1, 3}, torch::kF64));
+        scattered.move_samples_from(input, {{3, 0}, {0, 2}, {2, 1}}, 0, 3);
+        CHECK(torch::all(scattered.tensor()[0] == input.tensor()[3]).item<bool>());
+        CHECK(torch::all(scattered.tensor()[1] == input.tensor()[2]).item<bool>());
+        CHECK(torch::all(scattered.tensor()[2] == input.tensor()[0]).item<bool>());
+        CHECK(torch::all(scattered.tensor()[3] == 0).item<bool>());
+
+        // many short runs are moved with index tensors
+        auto large_input = TorchDataArray(torch::arange(64, torch::kF64).reshape({32, 1, 2}));
+        auto mapping = std::vector<eqs_sample_mapping_t>();
+        for (uintptr_t i=0; i<32; i++) {
+            mapping.push_back({i, 31 - i});
+        }
+        auto reversed = TorchDataArray(torch::zeros({32, 1, 2}, torch::kF64));
+        reversed.move_samples_from(large_input, mapping, 0, 2);
+        CHECK(torch::all(reversed.tensor() == large_input.tensor().flip(0)).item<bool>());
+
+        mapping.clear();
+        for (uintptr_t i=0; i<32; i++) {
+            mapping.push_back({31 - i, (7 * i) % 32});
+        }
+        auto permuted = TorchDataArray(torch::zeros({32, 1, 2}, torch::kF64));
+        permuted.move_samples_from(large_input, mapping, 0, 2);
+        for (const auto& sample: mapping) {
+            auto input_sample = large_input.tensor()[static_cast<int64_t>(sample.input)];
+            auto output_sample = permuted.tensor()[static_cast<int64_t>(sample.output)];
+            CHECK(torch::all(output_sample == input_sample).item<bool>());
+        }
+    }
+
+    SECTION("samples access") {
+        auto devices = std::vector<torch::Device>{torch::kCPU};
+        if (torch::cuda::is_available()) {
+            devices.emplace_back(torch::kCUDA);
+        }
+
+        for (auto device: devices) {
+            auto values = torch::arange(24, torch::kF64).reshape({4, 2, 3});
+            auto input = TorchDataArray(values.to(device));
+            CHECK(input.raw_data_available() == device.is_cpu());
+
+            // consecutive ranges, the second one is copied in advance
+            auto data = std::vector<double>(6, 0.0);
+            input.get_samples(1, 2, data.data());
+            CHECK(data == std::vector<double>{6, 7, 8, 9, 10, 11});
+            input.get_samples(2, 3, data.data());
+            CHECK(data == std::vector<double>{12, 13, 14, 15, 16, 17});
+
+            // modifying the array discards data copied in advance
+            input.set_samples(3, 4, std::vector<double>(6, -1.0).data());
+            input.get_samples(3, 4, data.data());
+            CHECK(data == std::vector<double>(6, -1.0));
+
+            auto output = TorchDataArray(torch::zeros({4, 2, 3}, torch::TensorOptions().dtype(torch::kF64).device(device)));
+            auto all = std::vector<double>(24, 0.0);
+            input.get_samples(0, 4, all.data());
+            output.set_samples(0, 2, all.data());
+            output.set_samples(2, 4, all.data() + 12);
+
+            auto expected = values.clone();
+            expected[3] = -1.0;
+            CHECK(torch::all(output.tensor().to(torch::kCPU) == expected).item<bool>());
+
+            CHECK_THROWS_WITH(
+                input.get_samples(3, 5, data.data()),
+                Catch::Matchers::StartsWith("invalid samples range in TorchDataArray::get_samples")
+            );
+        }
     }
 }
@@ -77,4 +77,35 @@ TEST_CASE("Blocks") {
             CHECK(entry.first == "g");
         }
     }
+
+    SECTION("gradients of gradients") {
+        auto block = TensorBlockHolder(
+            torch::full({3, 2}, 11.0),
+            LabelsHolder::create({"s"}, {{0}, {2}, {1}}),
+            {},
+            LabelsHolder::create({"p"}, {{0}, {1}})
+        );
+
+        auto gradient = torch::make_intrusive<TensorBlockHolder>(
+            torch::full({1, 2}, 1.0),
+            LabelsHolder::create({"sample", "g"}, {{0, 1}}),
+            std::vector<TorchLabels>{},
+            block.properties()
+        );
+
+        gradient->add_gradient("h", torch::make_intrusive<TensorBlockHolder>(
+            torch::full({1, 2}, 2.0),
+            LabelsHolder::create({"sample", "h"}, {{0, 3}}),
+            std::vector<TorchLabels>{},
+            block.properties()
+        ));
+
+        // the gradients of the gradient are kept when adding it to the block
+        block.add_gradient("g", gradient);
+        CHECK((block.gradient("g")->gradients_list() == std::vector<std::string>{"h"}));
+
+        auto nested = block.gradient("g")->gradient("h");
+        CHECK(*nested->samples() == equistore::Labels({"sample", "h"}, {{0, 3}}));
+        CHECK(torch::all(nested->values() == 2.0).item<bool>());
+    }
 }
@@ -44,6 +44,46 @@ TEST_CASE("Labels") {
         CHECK_FALSE(i.has_value());
     }
 
+    SECTION("positions") {
+        auto labels = LabelsHolder::create({"a", "bb"}, {{0, 0}, {1, 0}, {0, 1}, {1, 1}});
+
+        auto entries = torch::tensor({0, 1, 0, 4, 1, 1}, torch::kInt32).reshape({3, 2});
+        auto positions = labels->positions(entries);
+        CHECK(positions.scalar_type() == torch::kInt64);
+        CHECK(torch::all(positions == torch::tensor({2, -1, 3}, torch::kInt64)).item<bool>());
+
+        CHECK_THROWS_WITH(
+            labels->positions(torch::tensor({0, 1, 0}, torch::kInt32).reshape({1, 3})),
+            Catch::Matchers::Contains("entries passed to Labels::positions must have 2 values per entry, got 3")
+        );
+    }
+
+    SECTION("deferred creation") {
+        auto values = torch::tensor({0, 1, 2, 3, 0, 1}, torch::kInt32).reshape({3, 2});
+        auto labels = LabelsHolder::deferred(std::vector<std::string>{"a", "b"}, values);
+        CHECK(labels->count() == 3);
+        CHECK(labels->size() == 2);
+        CHECK_FALSE(labels->is_view());
+        CHECK_FALSE(labels->has_unique_entries().item<bool>());
+
+        // duplicated entries are only detected when creating equistore::Labels
+        CHECK_THROWS_WITH(
+            labels->position(std::vector<int64_t>{0, 1}),
+            Catch::Matchers::Contains("can not have the same label value multiple time")
+        );
+
+        values = torch::tensor({0, 1, 2, 3, 0, 2}, torch::kInt32).reshape({3, 2});
+        labels = LabelsHolder::deferred(std::vector<std::string>{"a", "b"}, values);
+        CHECK(labels->has_unique_entries().item<bool>());
+        CHECK(labels->position(std::vector<int64_t>{0, 2}).value() == 2);
+        CHECK(labels->as_equistore()(1, 0) == 2);
+
+        CHECK_THROWS_WITH(
+            LabelsHolder::deferred(std::vector<std::string>{"a"}, values),
+            Catch::Matchers::Contains("invalid Labels: the names must have an entry for each column of the array")
+        );
+    }
+
     SECTION("print") {
         auto labels = LabelsHolder::create({"aaa", "bbb"}, {{1, 2}, {3, 4}});
 
@@ -142,6 +182,19 @@ TEST_CASE("Labels") {
 
         CHECK(labels.values().data_ptr<int32_t>() == values.data_ptr<int32_t>());
     }
+
+    SECTION("moving Labels does not accumulate user data") {
+        auto labels = LabelsHolder::create({"a", "b"}, {{0, 1}, {1, 0}});
+        auto& equistore_labels = const_cast<equistore::Labels&>(labels->as_equistore());
+
+        auto user_data = equistore_labels.user_data();
+        CHECK(user_data != nullptr);
+
+        for (size_t i=0; i<3; i++) {
+            labels->to(torch::kCPU);
+            CHECK(equistore_labels.user_data() == user_data);
+        }
+    }
 }
 
 
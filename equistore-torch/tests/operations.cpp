@@ -0,0 +1,180 @@
+#include <torch/torch.h>
+
+#include <equistore/torch.hpp>
+using namespace equistore_torch;
+
+#include <catch.hpp>
+
+static TorchTensorMap test_tensor_map(bool gradients = true);
+
+TEST_CASE("Operations") {
+    SECTION("add") {
+        auto tensor = test_tensor_map();
+
+        auto result = equistore_torch::add(tensor, 1.5);
+        auto block = result->block_by_id(0);
+        CHECK(*block->samples() == *tensor->block_by_id(0)->samples());
+        CHECK(torch::all(block->values() == tensor->block_by_id(0)->values() + 1.5).item<bool>());
+        CHECK(torch::all(block->gradient("positions")->values() == 1.0).item<bool>());
+
+        result = equistore_torch::add(tensor, tensor);
+        block = result->block_by_id(1);
+        CHECK(torch::all(block->values() == 2 * tensor->block_by_id(1)->values()).item<bool>());
+        CHECK(torch::all(block->gradient("positions")->values() == 2.0).item<bool>());
+
+        CHECK_THROWS_WITH(
+            equistore_torch::add(tensor, test_tensor_map(/*gradients=*/false)),
+            Catch::Matchers::Contains("inputs to add should have the same gradient parameters")
+        );
+
+        CHECK_THROWS_WITH(
+            equistore_torch::add(tensor, "not a tensor"),
+            Catch::Matchers::Contains("B should be a TensorMap or a scalar value in add")
+        );
+    }
+
+    SECTION("multiply") {
+        auto tensor = test_tensor_map();
+
+        auto result = equistore_torch::multiply(tensor, 3);
+        auto block = result->block_by_id(0);
+        CHECK(torch::all(block->values() == 3 * tensor->block_by_id(0)->values()).item<bool>());
+        CHECK(torch::all(block->gradient("positions")->values() == 3.0).item<bool>());
+
+        result = equistore_torch::multiply(tensor, tensor);
+        block = result->block_by_id(0);
+        auto values = tensor->block_by_id(0)->values();
+        CHECK(torch::all(block->values() == values * values).item<bool>());
+
+        // d(A * A) = 2 * A * dA, with gradient samples referring to samples 0 and 2
+        auto expected = torch::tensor({0.0, 2.0, 0.0, 2.0, 0.0, 2.0, 8.0, 10.0, 8.0, 10.0, 8.0, 10.0}, torch::kF64);
+        CHECK(torch::all(block->gradient("positions")->values() == expected.reshape({2, 3, 2})).item<bool>());
+    }
+
+    SECTION("dot") {
+        auto tensor = test_tensor_map();
+        auto other = test_tensor_map(/*gradients=*/false);
+
+        auto result = equistore_torch::dot(tensor, other);
+        auto block = result->block_by_id(0);
+        CHECK(*block->properties() == *other->block_by_id(0)->samples());
+
+        auto values = tensor->block_by_id(0)->values();
+        CHECK(torch::all(block->values() == torch::matmul(values, values.t())).item<bool>());
+        CHECK((block->gradient("positions")->values().sizes() == std::vector<int64_t>{2, 3, 3}));
+
+        CHECK_THROWS_WITH(
+            equistore_torch::dot(other, tensor),
+            Catch::Matchers::Contains("the second TensorMap in `dot` should not have gradients")
+        );
+    }
+
+    SECTION("reduce over samples") {
+        auto tensor = test_tensor_map();
+
+        auto result = equistore_torch::sum_over_samples(tensor, "center");
+        auto block = result->block_by_id(0);
+        CHECK(*block->samples() == equistore::Labels({"structure"}, {{0}, {1}}));
+        auto expected = torch::tensor({2.0, 4.0, 4.0, 5.0}, torch::kF64).reshape({2, 2});
+        CHECK(torch::all(block->values() == expected).item<bool>());
+
+        auto gradient = block->gradient("positions");
+        CHECK(*gradient->samples() == equistore::Labels({"sample", "structure", "atom"}, {{0, 0, 0}, {1, 1, 0}}));
+        CHECK(torch::all(gradient->values() == 1.0).item<bool>());
+
+        result = equistore_torch::mean_over_samples(tensor, std::vector<std::string>{"center"});
+        block = result->block_by_id(0);
+        expected = torch::tensor({1.0, 2.0, 4.0, 5.0}, torch::kF64).reshape({2, 2});
+        CHECK(torch::all(block->values() == expected).item<bool>());
+
+        result = equistore_torch::var_over_samples(tensor, std::vector<std::string>{"structure", "center"});
+        block = result->block_by_id(0);
+        CHECK(*block->samples() == equistore::Labels({"_"}, {{0}}));
+        expected = torch::var(tensor->block_by_id(0)->values(), 0, /*unbiased=*/false).reshape({1, 2});
+        CHECK(torch::allclose(block->values(), expected));
+
+        CHECK_THROWS_WITH(
+            equistore_torch::sum_over_samples(tensor, "not there"),
+            Catch::Matchers::Contains("one of the requested sample name (not there) is not part of this TensorMap")
+        );
+    }
+
+    SECTION("slice") {
+        auto tensor = test_tensor_map();
+
+        auto selection = LabelsHolder::create({"structure"}, {{1}});
+        auto result = equistore_torch::slice(tensor, "samples", selection);
+        auto block = result->block_by_id(0);
+        CHECK(*block->samples() == equistore::Labels({"structure", "center"}, {{1, 0}}));
+        CHECK(torch::all(block->values() == tensor->block_by_id(0)->values()[2]).item<bool>());
+
+        auto gradient = block->gradient("positions");
+        CHECK(*gradient->samples() == equistore::Labels({"sample", "structure", "atom"}, {{0, 1, 0}}));
+
+        selection = LabelsHolder::create({"p"}, {{1}});
+        result = equistore_torch::slice(tensor, "properties", selection);
+        block = result->block_by_id(1);
+        CHECK(*block->properties() == equistore::Labels({"p"}, {{1}}));
+        CHECK((block->values().sizes() == std::vector<int64_t>{3, 1}));
+        CHECK((block->gradient("positions")->values().sizes() == std::vector<int64_t>{2, 3, 1}));
+
+        CHECK_THROWS_WITH(
+            equistore_torch::slice(tensor, "components", selection),
+            Catch::Matchers::Contains("is not known as a slicing axis")
+        );
+
+        selection = LabelsHolder::create({"not_there"}, {{1}});
+        CHECK_THROWS_WITH(
+            equistore_torch::slice(tensor, "samples", selection),
+            Catch::Matchers::Contains("invalid sample name 'not_there' which is not part of the input")
+        );
+    }
+
+    SECTION("join") {
+        auto tensor = test_tensor_map();
+
+        auto result = equistore_torch::join({tensor, tensor}, "properties");
+        CHECK(*result->keys() == *tensor->keys());
+
+        auto block = result->block_by_id(0);
+        CHECK(*block->properties() == equistore::Labels({"tensor", "p"}, {{0, 0}, {0, 1}, {1, 0}, {1, 1}}));
+        CHECK((block->values().sizes() == std::vector<int64_t>{3, 4}));
+
+        result = equistore_torch::join({tensor, tensor}, "samples");
+        block = result->block_by_id(0);
+        CHECK(block->samples()->count() == 6);
+        CHECK(block->samples()->names()[0] == "structure");
+
+        CHECK_THROWS_WITH(
+            equistore_torch::join({}, "samples"),
+            Catch::Matchers::Contains("provide at least one `TensorMap` for joining")
+        );
+    }
+}
+
+TorchTensorMap test_tensor_map(bool gradients) {
+    auto blocks = std::vector<TorchTensorBlock>();
+    for (int64_t i=0; i<2; i++) {
+        auto block = torch::make_intrusive<TensorBlockHolder>(
+            torch::arange(6, torch::kF64).reshape({3, 2}) + static_cast<double>(i),
+            LabelsHolder::create({"structure", "center"}, {{0, 0}, {0, 1}, {1, 0}}),
+            std::vector<TorchLabels>{},
+            LabelsHolder::create({"p"}, {{0}, {1}})
+        );
+
+        if (gradients) {
+            auto gradient = torch::make_intrusive<TensorBlockHolder>(
+                torch::ones({2, 3, 2}, torch::kF64),
+                LabelsHolder::create({"sample", "structure", "atom"}, {{0, 0, 0}, {2, 1, 0}}),
+                std::vector<TorchLabels>{LabelsHolder::create({"xyz"}, {{0}, {1}, {2}})},
+                LabelsHolder::create({"p"}, {{0}, {1}})
+            );
+            block->add_gradient("positions", gradient);
+        }
+
+        blocks.emplace_back(std::move(block));
+    }
+
+    auto keys = LabelsHolder::create({"key"}, {{0}, {1}});
+    return torch::make_intrusive<TensorMapHolder>(std::move(keys), std::move(blocks));
+}
@@ -1,3 +1,5 @@
+#include <cstdio>
+
 #include <torch/torch.h>
 
 #include <equistore/torch.hpp>
@@ -36,6 +38,33 @@ TEST_CASE("TensorMap") {
         CHECK(matching[1] == 1);
     }
 
+    SECTION("cached metadata") {
+        auto tensor = test_tensor_map();
+
+        // the same objects are returned on every access
+        CHECK(tensor->keys().get() == tensor->keys().get());
+        CHECK(tensor->block_by_id(0).get() == tensor->block_by_id(0).get());
+        CHECK(tensor->blocks()[1].get() == tensor->block_by_id(1).get());
+
+        auto selection = LabelsHolder::create({"key_1", "key_2"}, {{2, 2}});
+        CHECK(tensor->block(selection).get() == tensor->block_by_id(2).get());
+
+        auto block = tensor->block_by_id(0);
+        CHECK(block->samples().get() == block->samples().get());
+        CHECK(block->properties().get() == block->properties().get());
+        CHECK(block->components()[0].get() == block->components()[0].get());
+        CHECK(block->gradient("parameter").get() == block->gradient("parameter").get());
+
+        auto gradient = block->gradient("parameter");
+        CHECK(gradient->samples().get() == gradient->samples().get());
+        CHECK(*gradient->samples() == equistore::Labels({"sample", "parameter"}, {{0, -2}, {2, 3}}));
+
+        CHECK_THROWS_WITH(
+            tensor->block_by_id(-1),
+            Catch::Matchers::Contains("block index out of bounds: we have 4 blocks but the index is -1")
+        );
+    }
+
     SECTION("keys_to_samples") {
         auto tensor = test_tensor_map()->keys_to_samples("key_2", /* sort_samples */ true);
 
@@ -144,6 +173,37 @@ TEST_CASE("TensorMap") {
         CHECK(torch::all(block->values() == torch::full({4, 3, 1}, 4.0)).item<bool>());
     }
 
+    SECTION("multi-threaded keys_to_xxx") {
+        auto tensor = test_tensor_map();
+
+        auto reference = tensor->keys_to_properties("key_1", /*sort_samples*/ true, /*threads*/ 1);
+        auto parallel = tensor->keys_to_properties("key_1", /*sort_samples*/ true, /*threads*/ 3);
+        CHECK(*parallel->keys() == *reference->keys());
+        for (int64_t i=0; i<reference->keys()->count(); i++) {
+            auto block = parallel->block_by_id(i);
+            auto expected = reference->block_by_id(i);
+            CHECK(*block->samples() == *expected->samples());
+            CHECK(torch::all(block->values() == expected->values()).item<bool>());
+            CHECK(torch::all(block->gradient("parameter")->values() == expected->gradient("parameter")->values()).item<bool>());
+        }
+
+        reference = tensor->keys_to_samples("key_2", /*sort_samples*/ false, /*threads*/ 1);
+        parallel = tensor->keys_to_samples("key_2", /*sort_samples*/ false, /*threads*/ 0);
+        CHECK(*parallel->keys() == *reference->keys());
+        for (int64_t i=0; i<reference->keys()->count(); i++) {
+            auto block = parallel->block_by_id(i);
+            auto expected = reference->block_by_id(i);
+            CHECK(*block->samples() == *expected->samples());
+            CHECK(torch::all(block->values() == expected->values()).item<bool>());
+            CHECK(torch::all(block->gradient("parameter")->values() == expected->gradient("parameter")->values()).item<bool>());
+        }
+
+        CHECK_THROWS_WITH(
+            tensor->keys_to_samples("key_2", /*sort_samples*/ false, /*threads*/ -2),
+            Catch::Matchers::Contains("`threads` must be positive or zero, got -2")
+        );
+    }
+
     SECTION("component_to_properties") {
         auto tensor = test_tensor_map()->components_to_properties("component");
 
@@ -156,6 +216,56 @@ TEST_CASE("TensorMap") {
 
         CHECK(*block->properties() == equistore::Labels({"component", "properties"}, {{0, 0}}));
     }
+
+    SECTION("shared labels") {
+        // equal labels created separately for different blocks are only
+        // stored once in the TensorMap
+        auto tensor = test_tensor_map();
+
+        auto labels_ptr = [](const TorchLabels& labels) {
+            return labels->as_equistore().as_eqs_labels_t().internal_ptr_;
+        };
+
+        auto block_1 = tensor->block_by_id(0);
+        auto block_3 = tensor->block_by_id(2);
+        CHECK(labels_ptr(block_1->properties()) == labels_ptr(block_3->properties()));
+        CHECK(labels_ptr(block_1->properties()) == labels_ptr(block_1->gradient("parameter")->properties()));
+        CHECK(labels_ptr(block_1->components()[0]) == labels_ptr(block_1->gradient("parameter")->components()[0]));
+
+        // different labels are kept separate
+        CHECK(labels_ptr(block_1->samples()) != labels_ptr(block_3->samples()));
+    }
+
+    SECTION("TensorMapBuilder") {
+        auto create_block = [](std::vector<std::initializer_list<int32_t>> samples, double value) {
+            auto n_samples = static_cast<int64_t>(samples.size());
+            return torch::make_intrusive<TensorBlockHolder>(
+                torch::full({n_samples, 2}, value),
+                LabelsHolder::create({"samples"}, samples),
+                std::vector<TorchLabels>{},
+                LabelsHolder::create({"properties"}, {{0}, {1}})
+            );
+        };
+
+        auto builder = torch::make_intrusive<TensorMapBuilderHolder>(std::vector<std::string>{"keys"});
+        builder->add_block({0}, create_block({{0}, {1}}, 1.0));
+        builder->add_block({1}, create_block({{3}}, 2.0));
+        builder->add_block({0}, create_block({{4}}, 3.0));
+
+        CHECK_THROWS_WITH(
+            builder->add_block({0}, create_block({{4}}, 1.0)),
+            Catch::Matchers::Contains("[4] is already present at position 2")
+        );
+
+        auto tensor = builder->finish();
+        CHECK(*tensor->keys() == equistore::Labels({"keys"}, {{0}, {1}}));
+
+        auto block = tensor->block_by_id(0);
+        CHECK(*block->samples() == equistore::Labels({"samples"}, {{0}, {1}, {4}}));
+
+        auto expected = torch::tensor(std::vector<double>{1.0, 1.0, 1.0, 1.0, 3.0, 3.0}).reshape({3, 2});
+        CHECK(torch::all(block->values() == expected).item<bool>());
+    }
 }
 
 TEST_CASE("TensorMap serialization") {
@@ -188,6 +298,81 @@ TEST_CASE("TensorMap serialization") {
 
         CHECK(gradient->values().sizes() == std::vector<int64_t>{59, 3, 5, 3});
     }
+
+    SECTION("loading file with multiple threads") {
+        auto reference = equistore_torch::load(DATA_NPZ);
+        auto tensor = equistore_torch::load(DATA_NPZ, /*threads*/ 3);
+
+        CHECK(*tensor->keys() == *reference->keys());
+        for (int64_t i=0; i<reference->keys()->count(); i++) {
+            auto block = tensor->block_by_id(i);
+            auto expected = reference->block_by_id(i);
+            CHECK(*block->samples() == *expected->samples());
+            CHECK(torch::all(block->values() == expected->values()).item<bool>());
+        }
+
+        CHECK_THROWS_WITH(
+            equistore_torch::load(DATA_NPZ, -1),
+            Catch::Matchers::Contains("load `threads` must be positive or zero, got -1")
+        );
+    }
+
+    SECTION("loading and saving on devices") {
+        auto devices = std::vector<torch::Device>{torch::kCPU};
+        if (torch::cuda::is_available()) {
+            devices.emplace_back(torch::kCUDA);
+        }
+
+        auto reference = equistore_torch::load(DATA_NPZ);
+        for (auto device: devices) {
+            auto tensor = equistore_torch::load(DATA_NPZ, /*threads*/ 2, device);
+
+            auto block = tensor->block_by_id(21);
+            CHECK(block->values().device() == device);
+            CHECK(block->gradient("positions")->values().device() == device);
+
+            // data on the device can be saved directly
+            equistore_torch::save("torch-device-save.npz", tensor);
+            auto loaded = equistore_torch::load("torch-device-save.npz");
+
+            for (int64_t i=0; i<reference->keys()->count(); i++) {
+                auto expected = reference->block_by_id(i);
+                CHECK(torch::all(tensor->block_by_id(i)->values().to(torch::kCPU) == expected->values()).item<bool>());
+                CHECK(torch::all(loaded->block_by_id(i)->values() == expected->values()).item<bool>());
+
+                auto gradient = loaded->block_by_id(i)->gradient("positions");
+                CHECK(torch::all(gradient->values() == expected->gradient("positions")->values()).item<bool>());
+            }
+        }
+
+        std::remove("torch-device-save.npz");
+    }
+
+    SECTION("lazy loading") {
+        auto lazy = equistore_torch::load_lazy(DATA_NPZ, 2);
+        CHECK(lazy->keys()->count() == 27);
+        CHECK(lazy->loaded_blocks() == 0);
+
+        auto block = lazy->block_by_id(21);
+        CHECK(block->values().sizes() == std::vector<int64_t>{9, 5, 3});
+        CHECK(lazy->loaded_blocks() == 1);
+
+        // the same block is returned when it is still in memory
+        CHECK(lazy->block_by_id(21).get() == block.get());
+
+        lazy->block_by_id(0);
+        lazy->block_by_id(1);
+        CHECK(lazy->loaded_blocks() == 2);
+        CHECK(block->values().sizes() == std::vector<int64_t>{9, 5, 3});
+
+        lazy->clear();
+        CHECK(lazy->loaded_blocks() == 0);
+
+        CHECK_THROWS_WITH(
+            lazy->block_by_id(27),
+            Catch::Matchers::Contains("block index out of bounds: we have 27 blocks but the index is 27")
+        );
+    }
 }
 
 
@@ -14,6 +14,9 @@ pub const EQS_IO_ERROR: i32 = 2;
 pub const EQS_SERIALIZATION_ERROR: i32 = 3;
 pub const EQS_BUFFER_SIZE_ERROR: i32 = 254;
 pub const EQS_INTERNAL_ERROR: i32 = 255;
+pub const EQS_DTYPE_FLOAT64: i32 = 1;
+pub const EQS_DTYPE_FLOAT32: i32 = 2;
+pub const EQS_DTYPE_FLOAT16: i32 = 3;
 #[repr(C)]
 #[derive(Debug, Copy, Clone)]
 pub struct eqs_block_t {
@@ -21,6 +24,16 @@ pub struct eqs_block_t {
 }
 #[repr(C)]
 #[derive(Debug, Copy, Clone)]
+pub struct eqs_lazy_tensormap_t {
+    _unused: [u8; 0],
+}
+#[repr(C)]
+#[derive(Debug, Copy, Clone)]
+pub struct eqs_tensormap_builder_t {
+    _unused: [u8; 0],
+}
+#[repr(C)]
+#[derive(Debug, Copy, Clone)]
 pub struct eqs_tensormap_t {
     _unused: [u8; 0],
 }
@@ -100,6 +113,7 @@ fn bindgen_test_layout_eqs_labels_t() {
     );
 }
 pub type eqs_data_origin_t = u64;
+pub type eqs_dtype_t = i32;
 #[repr(C)]
 #[derive(Debug, Copy, Clone)]
 pub struct eqs_sample_mapping_t {
@@ -203,6 +217,43 @@ pub struct eqs_array_t {
             property_end: usize,
         ) -> eqs_status_t,
     >,
+    pub create_uninit: ::std::option::Option<
+        unsafe extern "C" fn(
+            array: *const ::std::os::raw::c_void,
+            shape: *const usize,
+            shape_count: usize,
+            new_array: *mut eqs_array_t,
+        ) -> eqs_status_t,
+    >,
+    pub dtype: ::std::option::Option<
+        unsafe extern "C" fn(
+            array: *const ::std::os::raw::c_void,
+            dtype: *mut eqs_dtype_t,
+        ) -> eqs_status_t,
+    >,
+    pub raw_data: ::std::option::Option<
+        unsafe extern "C" fn(
+            array: *mut ::std::os::raw::c_void,
+            data: *mut *mut ::std::os::raw::c_void,
+        ) -> eqs_status_t,
+    >,
+    pub get_samples: ::std::option::Option<
+        unsafe extern "C" fn(
+            array: *const ::std::os::raw::c_void,
+            sample_start: usize,
+            sample_end: usize,
+            data: *mut ::std::os::raw::c_void,
+        ) -> eqs_status_t,
+    >,
+    pub set_samples: ::std::option::Option<
+        unsafe extern "C" fn(
+            array: *mut ::std::os::raw::c_void,
+            sample_start: usize,
+            sample_end: usize,
+            data: *const ::std::os::raw::c_void,
+        ) -> eqs_status_t,
+    >,
+    pub concurrent_move_samples: bool,
 }
 #[test]
 fn bindgen_test_layout_eqs_array_t() {
@@ -210,7 +261,7 @@ fn bindgen_test_layout_eqs_array_t() {
     let ptr = UNINIT.as_ptr();
     assert_eq!(
         ::std::mem::size_of::<eqs_array_t>(),
-        80usize,
+        128usize,
         concat!("Size of: ", stringify!(eqs_array_t))
     );
     assert_eq!(
@@ -318,14 +369,123 @@ fn bindgen_test_layout_eqs_array_t() {
             stringify!(move_samples_from)
         )
     );
+    assert_eq!(
+        unsafe { ::std::ptr::addr_of!((*ptr).create_uninit) as usize - ptr as usize },
+        80usize,
+        concat!(
+            "Offset of field: ",
+            stringify!(eqs_array_t),
+            "::",
+            stringify!(create_uninit)
+        )
+    );
+    assert_eq!(
+        unsafe { ::std::ptr::addr_of!((*ptr).dtype) as usize - ptr as usize },
+        88usize,
+        concat!(
+            "Offset of field: ",
+            stringify!(eqs_array_t),
+            "::",
+            stringify!(dtype)
+        )
+    );
+    assert_eq!(
+        unsafe { ::std::ptr::addr_of!((*ptr).raw_data) as usize - ptr as usize },
+        96usize,
+        concat!(
+            "Offset of field: ",
+            stringify!(eqs_array_t),
+            "::",
+            stringify!(raw_data)
+        )
+    );
+    assert_eq!(
+        unsafe { ::std::ptr::addr_of!((*ptr).get_samples) as usize - ptr as usize },
+        104usize,
+        concat!(
+            "Offset of field: ",
+            stringify!(eqs_array_t),
+            "::",
+            stringify!(get_samples)
+        )
+    );
+    assert_eq!(
+        unsafe { ::std::ptr::addr_of!((*ptr).set_samples) as usize - ptr as usize },
+        112usize,
+        concat!(
+            "Offset of field: ",
+            stringify!(eqs_array_t),
+            "::",
+            stringify!(set_samples)
+        )
+    );
+    assert_eq!(
+        unsafe { ::std::ptr::addr_of!((*ptr).concurrent_move_samples) as usize - ptr as usize },
+        120usize,
+        concat!(
+            "Offset of field: ",
+            stringify!(eqs_array_t),
+            "::",
+            stringify!(concurrent_move_samples)
+        )
+    );
 }
 pub type eqs_create_array_callback_t = ::std::option::Option<
     unsafe extern "C" fn(
+        user_data: *mut ::std::os::raw::c_void,
+        shape: *const usize,
+        shape_count: usize,
+        dtype: eqs_dtype_t,
+        array: *mut eqs_array_t,
+    ) -> eqs_status_t,
+>;
+pub type eqs_create_array_view_callback_t = ::std::option::Option<
+    unsafe extern "C" fn(
+        user_data: *mut ::std::os::raw::c_void,
         shape: *const usize,
         shape_count: usize,
+        data: *const f64,
         array: *mut eqs_array_t,
     ) -> eqs_status_t,
 >;
+pub type eqs_write_callback_t = ::std::option::Option<
+    unsafe extern "C" fn(
+        user_data: *mut ::std::os::raw::c_void,
+        data: *const u8,
+        count: usize,
+    ) -> eqs_status_t,
+>;
+pub type eqs_seek_callback_t = ::std::option::Option<
+    unsafe extern "C" fn(user_data: *mut ::std::os::raw::c_void, position: u64) -> eqs_status_t,
+>;
+#[repr(C)]
+#[derive(Debug, Copy, Clone)]
+pub struct eqs_profiling_event_t {
+    pub name: *const ::std::os::raw::c_char,
+    pub duration_ns: u64,
+    pub bytes_moved: u64,
+    pub labels_entries_hashed: u64,
+    pub array_callbacks: u64,
+}
+#[test]
+fn bindgen_test_layout_eqs_profiling_event_t() {
+    assert_eq!(
+        ::std::mem::size_of::<eqs_profiling_event_t>(),
+        40usize,
+        concat!("Size of: ", stringify!(eqs_profiling_event_t))
+    );
+    assert_eq!(
+        ::std::mem::align_of::<eqs_profiling_event_t>(),
+        8usize,
+        concat!("Alignment of ", stringify!(eqs_profiling_event_t))
+    );
+}
+pub type eqs_profiling_callback_t = ::std::option::Option<
+    unsafe extern "C" fn(
+        user_data: *mut ::std::os::raw::c_void,
+        event: *const eqs_profiling_event_t,
+    ),
+>;
 extern "C" {
     pub fn eqs_disable_panic_printing();
     pub fn eqs_version() -> *const ::std::os::raw::c_char;
@@ -338,6 +498,13 @@ extern "C" {
         result: *mut i64,
     ) -> eqs_status_t;
     #[must_use]
+    pub fn eqs_labels_positions(
+        labels: eqs_labels_t,
+        values: *const i32,
+        count: usize,
+        result: *mut i64,
+    ) -> eqs_status_t;
+    #[must_use]
     pub fn eqs_labels_create(labels: *mut eqs_labels_t) -> eqs_status_t;
     #[must_use]
     pub fn eqs_labels_set_user_data(
@@ -365,6 +532,14 @@ extern "C" {
         second_mapping_count: usize,
     ) -> eqs_status_t;
     #[must_use]
+    pub fn eqs_labels_union_many(
+        labels: *const eqs_labels_t,
+        labels_count: usize,
+        result: *mut eqs_labels_t,
+        mapping: *mut i64,
+        mapping_count: usize,
+    ) -> eqs_status_t;
+    #[must_use]
     pub fn eqs_labels_intersection(
         first: eqs_labels_t,
         second: eqs_labels_t,
@@ -449,10 +624,20 @@ extern "C" {
         count: *mut usize,
         selection: eqs_labels_t,
     ) -> eqs_status_t;
+    #[must_use]
+    pub fn eqs_tensormap_blocks_matching_values(
+        tensor: *const eqs_tensormap_t,
+        block_indexes: *mut usize,
+        count: *mut usize,
+        names: *const *const ::std::os::raw::c_char,
+        values: *const i32,
+        size: usize,
+    ) -> eqs_status_t;
     pub fn eqs_tensormap_keys_to_properties(
         tensor: *const eqs_tensormap_t,
         keys_to_move: eqs_labels_t,
         sort_samples: bool,
+        threads: usize,
     ) -> *mut eqs_tensormap_t;
     pub fn eqs_tensormap_components_to_properties(
         tensor: *mut eqs_tensormap_t,
@@ -463,22 +648,95 @@ extern "C" {
         tensor: *const eqs_tensormap_t,
         keys_to_move: eqs_labels_t,
         sort_samples: bool,
+        threads: usize,
+    ) -> *mut eqs_tensormap_t;
+    pub fn eqs_tensormap_join_samples(
+        tensors: *const *const eqs_tensormap_t,
+        tensors_count: usize,
+        threads: usize,
     ) -> *mut eqs_tensormap_t;
+    pub fn eqs_tensormap_builder(
+        names: *const *const ::std::os::raw::c_char,
+        names_count: usize,
+    ) -> *mut eqs_tensormap_builder_t;
+    pub fn eqs_tensormap_builder_add_block(
+        builder: *mut eqs_tensormap_builder_t,
+        key: *const i32,
+        key_count: usize,
+        block: *mut eqs_block_t,
+    ) -> eqs_status_t;
+    pub fn eqs_tensormap_builder_finish(
+        builder: *mut eqs_tensormap_builder_t,
+    ) -> *mut eqs_tensormap_t;
+    pub fn eqs_tensormap_builder_free(builder: *mut eqs_tensormap_builder_t) -> eqs_status_t;
     pub fn eqs_tensormap_load(
         path: *const ::std::os::raw::c_char,
         create_array: eqs_create_array_callback_t,
+        user_data: *mut ::std::os::raw::c_void,
+        threads: usize,
+    ) -> *mut eqs_tensormap_t;
+    pub fn eqs_tensormap_load_selected(
+        path: *const ::std::os::raw::c_char,
+        create_array: eqs_create_array_callback_t,
+        user_data: *mut ::std::os::raw::c_void,
+        samples: *const eqs_labels_t,
+        properties: *const eqs_labels_t,
+        threads: usize,
     ) -> *mut eqs_tensormap_t;
     pub fn eqs_tensormap_load_buffer(
         buffer: *const u8,
         buffer_count: usize,
         create_array: eqs_create_array_callback_t,
+        user_data: *mut ::std::os::raw::c_void,
+    ) -> *mut eqs_tensormap_t;
+    pub fn eqs_tensormap_load_buffer_view(
+        buffer: *const u8,
+        buffer_count: usize,
+        create_array: eqs_create_array_callback_t,
+        user_data: *mut ::std::os::raw::c_void,
+        create_array_view: eqs_create_array_view_callback_t,
     ) -> *mut eqs_tensormap_t;
+    pub fn eqs_lazy_tensormap_open(
+        path: *const ::std::os::raw::c_char,
+    ) -> *mut eqs_lazy_tensormap_t;
+    #[must_use]
+    pub fn eqs_lazy_tensormap_free(lazy: *mut eqs_lazy_tensormap_t) -> eqs_status_t;
+    #[must_use]
+    pub fn eqs_lazy_tensormap_keys(
+        lazy: *const eqs_lazy_tensormap_t,
+        keys: *mut eqs_labels_t,
+    ) -> eqs_status_t;
+    #[must_use]
+    pub fn eqs_lazy_tensormap_blocks_matching(
+        lazy: *const eqs_lazy_tensormap_t,
+        block_indexes: *mut usize,
+        count: *mut usize,
+        selection: eqs_labels_t,
+    ) -> eqs_status_t;
+    pub fn eqs_lazy_tensormap_load_block(
+        lazy: *const eqs_lazy_tensormap_t,
+        index: usize,
+        create_array: eqs_create_array_callback_t,
+        user_data: *mut ::std::os::raw::c_void,
+    ) -> *mut eqs_block_t;
     #[must_use]
     pub fn eqs_tensormap_save(
         path: *const ::std::os::raw::c_char,
         tensor: *const eqs_tensormap_t,
     ) -> eqs_status_t;
     #[must_use]
+    pub fn eqs_tensormap_save_compressed(
+        path: *const ::std::os::raw::c_char,
+        tensor: *const eqs_tensormap_t,
+    ) -> eqs_status_t;
+    #[must_use]
+    pub fn eqs_tensormap_save_stream(
+        user_data: *mut ::std::os::raw::c_void,
+        write: eqs_write_callback_t,
+        seek: eqs_seek_callback_t,
+        tensor: *const eqs_tensormap_t,
+    ) -> eqs_status_t;
+    #[must_use]
     pub fn eqs_tensormap_save_buffer(
         buffer: *mut *mut u8,
         buffer_count: *mut usize,
@@ -492,4 +750,9 @@ extern "C" {
         >,
         tensor: *const eqs_tensormap_t,
     ) -> eqs_status_t;
+    #[must_use]
+    pub fn eqs_set_profiling_callback(
+        callback: eqs_profiling_callback_t,
+        user_data: *mut ::std::os::raw::c_void,
+    ) -> eqs_status_t;
 }
@@ -83,6 +83,13 @@ impl From<Box<dyn Array>> for eqs_array_t {
             copy: Some(rust_array_copy),
             destroy: Some(rust_array_destroy),
             move_samples_from: Some(rust_array_move_samples_from),
+            // `Array::create` is used to create uninitialized arrays
+            create_uninit: None,
+            dtype: None,
+            raw_data: None,
+            get_samples: None,
+            set_samples: None,
+            concurrent_move_samples: false,
         }
     }
 }
@@ -261,6 +261,12 @@ impl eqs_array_t {
             copy: None,
             destroy: None,
             move_samples_from: None,
+            create_uninit: None,
+            dtype: None,
+            raw_data: None,
+            get_samples: None,
+            set_samples: None,
+            concurrent_move_samples: false,
         }
     }
 
@@ -372,7 +378,13 @@ impl eqs_array_t {
             create: None,
             copy: None,
             destroy: None,
-            move_samples_from: None
+            move_samples_from: None,
+            create_uninit: None,
+            dtype: None,
+            raw_data: None,
+            get_samples: None,
+            set_samples: None,
+            concurrent_move_samples: false,
         };
         unsafe {
             check_status_external(
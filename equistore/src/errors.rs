@@ -5,7 +5,7 @@ use std::cell::RefCell;
 use crate::c_api::{eqs_status_t, EQS_SUCCESS, eqs_last_error};
 
 /// Error code used to indicate failure of a Rust function
-const RUST_FUNCTION_FAILED_ERROR_CODE: i32 = -4242;
+pub(crate) const RUST_FUNCTION_FAILED_ERROR_CODE: i32 = -4242;
 
 thread_local! {
     /// Storage for the last error coming from a Rust function
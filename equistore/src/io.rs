@@ -3,9 +3,9 @@
 use std::ffi::CString;
 use std::os::raw::c_void;
 
-use crate::c_api::{eqs_array_t, eqs_status_t, EQS_SUCCESS};
-use crate::errors::{check_status, check_ptr};
-use crate::{TensorMap, Error, Array};
+use crate::c_api::{eqs_array_t, eqs_dtype_t, eqs_status_t, EQS_SUCCESS};
+use crate::errors::{check_status, check_ptr, LAST_RUST_ERROR, RUST_FUNCTION_FAILED_ERROR_CODE};
+use crate::{TensorMap, Labels, Error, Array};
 
 /// Load the serialized tensor map from the given path.
 ///
@@ -19,7 +19,8 @@ use crate::{TensorMap, Error, Array};
 /// We add other restriction on top of these formats when saving/loading data.
 /// First, `Labels` instances are saved as structured array, see the `labels`
 /// module for more information. Only 32-bit integers are supported for Labels,
-/// and only 64-bit floats are supported for data (values and gradients).
+/// and 64-bit, 32-bit or 16-bit floats are supported for data (values and
+/// gradients). The data is always loaded as 64-bit floats.
 ///
 /// Second, the path of the files in the archive also carry meaning. The keys of
 /// the `TensorMap` are stored in `/keys.npy`, and then different blocks are
@@ -47,7 +48,45 @@ pub fn load(path: impl AsRef<std::path::Path>) -> Result<TensorMap, Error> {
     let ptr = unsafe {
         crate::c_api::eqs_tensormap_load(
             path.as_ptr(),
-            Some(create_ndarray)
+            Some(create_ndarray),
+            std::ptr::null_mut(),
+            1,
+        )
+    };
+
+    check_ptr(ptr)?;
+
+    return Ok(unsafe { TensorMap::from_raw(ptr) });
+}
+
+/// Load a subset of the serialized tensor map from the given path, keeping
+/// only the samples and properties matching the `samples` and `properties`
+/// selections. Using `None` for a selection keeps all the corresponding
+/// entries.
+///
+/// Only the data for the selected samples and properties is read from the
+/// file. The kept entries stay in the same order as in the file, and the
+/// samples of gradients are renumbered to refer to the kept samples. See the
+/// [`load`] function for more information on the data format.
+pub fn load_selected(
+    path: impl AsRef<std::path::Path>,
+    samples: Option<&Labels>,
+    properties: Option<&Labels>,
+) -> Result<TensorMap, Error> {
+    let path = path.as_ref().as_os_str().to_str().expect("this path is not valid UTF8");
+    let path = CString::new(path).expect("this path contains a NULL byte");
+
+    let samples = samples.map(Labels::as_eqs_labels_t);
+    let properties = properties.map(Labels::as_eqs_labels_t);
+
+    let ptr = unsafe {
+        crate::c_api::eqs_tensormap_load_selected(
+            path.as_ptr(),
+            Some(create_ndarray),
+            std::ptr::null_mut(),
+            samples.as_ref().map_or(std::ptr::null(), |s| s),
+            properties.as_ref().map_or(std::ptr::null(), |p| p),
+            1,
         )
     };
 
@@ -64,7 +103,8 @@ pub fn load_buffer(buffer: &[u8]) -> Result<TensorMap, Error> {
         crate::c_api::eqs_tensormap_load_buffer(
             buffer.as_ptr(),
             buffer.len(),
-            Some(create_ndarray)
+            Some(create_ndarray),
+            std::ptr::null_mut(),
         )
     };
 
@@ -86,55 +126,132 @@ pub fn save(path: impl AsRef<std::path::Path>, tensor: &TensorMap) -> Result<(),
     }
 }
 
+/// Save the given tensor to a file, compressing the data with DEFLATE.
+///
+/// The format is the same as [`save`], with all the files in the archive
+/// compressed using the fastest compression level. The resulting file can be
+/// loaded with [`load`].
+pub fn save_compressed(path: impl AsRef<std::path::Path>, tensor: &TensorMap) -> Result<(), Error> {
+    let path = path.as_ref().as_os_str().to_str().expect("this path is not valid UTF8");
+    let path = CString::new(path).expect("this path contains a NULL byte");
+
+    unsafe {
+        check_status(crate::c_api::eqs_tensormap_save_compressed(path.as_ptr(), tensor.ptr))
+    }
+}
+
+
+/// Writer used as `user_data` for the callbacks in `save_writer`
+struct WriterSink<W> {
+    writer: W,
+    /// position of the writer when we started writing the `TensorMap`
+    start: u64,
+}
+
+/// Store the `std::io::Error` inside `result` (if any) as the last Rust error,
+/// and convert `result` to an `eqs_status_t`
+fn io_result_to_status(result: std::io::Result<()>) -> eqs_status_t {
+    match result {
+        Ok(()) => EQS_SUCCESS,
+        Err(e) => {
+            LAST_RUST_ERROR.with(|last_error| {
+                let mut last_error = last_error.borrow_mut();
+                *last_error = Error { code: None, message: e.to_string() };
+            });
+
+            RUST_FUNCTION_FAILED_ERROR_CODE
+        }
+    }
+}
+
+/// Implementation of `eqs_write_callback_t` for any `std::io::Write`, used in
+/// `save_writer`
+unsafe extern fn write_callback<W: std::io::Write>(user_data: *mut c_void, data: *const u8, count: usize) -> eqs_status_t {
+    let mut result = Ok(());
+    let unwind_wrapper = std::panic::AssertUnwindSafe(&mut result);
+
+    let status = crate::errors::catch_unwind(move || {
+        let sink = &mut *user_data.cast::<WriterSink<W>>();
+        let data = std::slice::from_raw_parts(data, count);
+
+        // force the closure to capture the full unwind_wrapper, not just
+        // unwind_wrapper.0
+        let _ = &unwind_wrapper;
+        *(unwind_wrapper.0) = sink.writer.write_all(data);
+    });
 
-/// Implementation of realloc for `Vec<u8>`, used in `save_buffer`
-unsafe extern fn realloc_vec(user_data: *mut c_void, _ptr: *mut u8, new_size: usize) -> *mut u8 {
-    let mut result = std::ptr::null_mut();
+    if status != EQS_SUCCESS {
+        return status;
+    }
+
+    return io_result_to_status(result);
+}
+
+/// Implementation of `eqs_seek_callback_t` for any `std::io::Seek`, used in
+/// `save_writer`
+unsafe extern fn seek_callback<W: std::io::Seek>(user_data: *mut c_void, position: u64) -> eqs_status_t {
+    let mut result = Ok(());
     let unwind_wrapper = std::panic::AssertUnwindSafe(&mut result);
 
     let status = crate::errors::catch_unwind(move || {
-        let vector = &mut *user_data.cast::<Vec<u8>>();
-        vector.resize(new_size, 0);
+        let sink = &mut *user_data.cast::<WriterSink<W>>();
+        let position = std::io::SeekFrom::Start(sink.start + position);
 
         // force the closure to capture the full unwind_wrapper, not just
         // unwind_wrapper.0
         let _ = &unwind_wrapper;
-        *(unwind_wrapper.0) = vector.as_mut_ptr();
+        *(unwind_wrapper.0) = sink.writer.seek(position).map(|_| ());
     });
 
     if status != EQS_SUCCESS {
-        return std::ptr::null_mut();
+        return status;
     }
 
-    return result;
+    return io_result_to_status(result);
 }
 
-/// Save the given `tensor` to an in-memory `buffer`.
+/// Save the given `tensor` to any `writer`, starting at the current position
+/// of the writer.
 ///
-/// This function will grow the buffer as required to fit the whole tensor.
-pub fn save_buffer(tensor: &TensorMap, buffer: &mut Vec<u8>) -> Result<(), Error> {
-    let mut buffer_ptr = buffer.as_mut_ptr();
-    let mut buffer_count = buffer.len();
+/// The data is written as it is produced, without holding the whole
+/// serialized tensor map in memory.
+pub fn save_writer<W: std::io::Write + std::io::Seek>(mut writer: W, tensor: &TensorMap) -> Result<(), Error> {
+    let start = writer.stream_position().map_err(|e| Error { code: None, message: e.to_string() })?;
+    let mut sink = WriterSink { writer, start };
 
     unsafe {
-        check_status(crate::c_api::eqs_tensormap_save_buffer(
-            &mut buffer_ptr,
-            &mut buffer_count,
-            (buffer as *mut Vec<u8>).cast(),
-            Some(realloc_vec),
+        check_status(crate::c_api::eqs_tensormap_save_stream(
+            (&mut sink as *mut WriterSink<W>).cast(),
+            Some(write_callback::<W>),
+            Some(seek_callback::<W>),
             tensor.ptr,
         ))?;
     }
 
-    buffer.resize(buffer_count, 0);
+    sink.writer.flush().map_err(|e| Error { code: None, message: e.to_string() })?;
 
     Ok(())
 }
 
-/// callback used to create `ndarray::ArrayD` when loading a `TensorMap`
+/// Save the given `tensor` to an in-memory `buffer`.
+///
+/// This function will grow the buffer as required to fit the whole tensor,
+/// replacing any existing content.
+pub fn save_buffer(tensor: &TensorMap, buffer: &mut Vec<u8>) -> Result<(), Error> {
+    buffer.clear();
+    // writing through a cursor grows the vector geometrically, without
+    // filling the new memory with zeros before writing to it
+    return save_writer(std::io::Cursor::new(buffer), tensor);
+}
+
+/// callback used to create `ndarray::ArrayD` when loading a `TensorMap`. The
+/// arrays always contain 64-bit floats, and the data in the file is converted
+/// if needed.
 unsafe extern fn create_ndarray(
+    _: *mut c_void,
     shape_ptr: *const usize,
     shape_count: usize,
+    _: eqs_dtype_t,
     c_array: *mut eqs_array_t,
 ) -> eqs_status_t {
     crate::errors::catch_unwind(|| {
@@ -305,6 +305,37 @@ impl TensorMap {
                 self.ptr,
                 keys_to_move.as_eqs_labels_t(),
                 sort_samples,
+                // run on the current thread
+                1,
+            )
+        };
+
+        check_ptr(ptr)?;
+        return Ok(unsafe { TensorMap::from_raw(ptr) });
+    }
+
+    /// Concatenate the blocks of all the `tensors` along the samples axis.
+    ///
+    /// The keys of the result are the union of the keys of all `tensors`, and
+    /// each block contains the samples of all the blocks with the
+    /// corresponding key, in the order of `tensors`. A new `"tensor"`
+    /// dimension is added to the samples, containing the index in `tensors`
+    /// of the tensor map each sample comes from.
+    ///
+    /// Blocks with the same key must have the same samples names, components,
+    /// properties, and set of gradients.
+    #[inline]
+    pub fn join_samples(tensors: &[&TensorMap]) -> Result<TensorMap, Error> {
+        let pointers = tensors.iter()
+            .map(|tensor| tensor.ptr as *const _)
+            .collect::<Vec<_>>();
+
+        let ptr = unsafe {
+            crate::c_api::eqs_tensormap_join_samples(
+                pointers.as_ptr(),
+                pointers.len(),
+                // run on the current thread
+                1,
             )
         };
 
@@ -345,6 +376,8 @@ impl TensorMap {
                 self.ptr,
                 keys_to_move.as_eqs_labels_t(),
                 sort_samples,
+                // run on the current thread
+                1,
             )
         };
 
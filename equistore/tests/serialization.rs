@@ -1,6 +1,6 @@
 use std::io::Read;
 
-use equistore::TensorMap;
+use equistore::{TensorMap, Labels};
 
 #[test]
 fn load_file() {
@@ -33,6 +33,79 @@ fn save_buffer() {
     assert_eq!(buffer, saved);
 }
 
+#[test]
+fn save_writer() {
+    let mut file = std::fs::File::open("./tests/data.npz").unwrap();
+    let mut buffer = Vec::new();
+    file.read_to_end(&mut buffer).unwrap();
+
+    let tensor = equistore::io::load_buffer(&buffer).unwrap();
+
+    // the data is written starting at the current position of the writer
+    let mut saved = b"prefix".to_vec();
+    let mut cursor = std::io::Cursor::new(&mut saved);
+    cursor.set_position(6);
+    equistore::io::save_writer(&mut cursor, &tensor).unwrap();
+
+    assert_eq!(&saved[..6], b"prefix");
+    assert_eq!(buffer, &saved[6..]);
+}
+
+#[test]
+fn save_compressed() {
+    let mut file = std::fs::File::open("./tests/data.npz").unwrap();
+    let mut buffer = Vec::new();
+    file.read_to_end(&mut buffer).unwrap();
+
+    let tensor = equistore::io::load_buffer(&buffer).unwrap();
+
+    let path = std::env::temp_dir().join("equistore-save-compressed.npz");
+    equistore::io::save_compressed(&path, &tensor).unwrap();
+
+    let loaded = equistore::io::load(&path).unwrap();
+    std::fs::remove_file(&path).unwrap();
+    check_tensor(&loaded);
+
+    // saving again without compression gives back the initial file
+    let mut saved = Vec::new();
+    equistore::io::save_buffer(&loaded, &mut saved).unwrap();
+    assert_eq!(buffer, saved);
+}
+
+#[test]
+fn load_selected() {
+    let reference = equistore::io::load("./tests/data.npz").unwrap();
+
+    let samples = Labels::new(["structure"], &[[1], [3]]);
+    let properties = Labels::new(["n"], &[[0]]);
+    let tensor = equistore::io::load_selected("./tests/data.npz", Some(&samples), Some(&properties)).unwrap();
+    assert_eq!(tensor.keys(), reference.keys());
+
+    let block = tensor.block_by_id(13);
+    let expected = reference.block_by_id(13);
+    assert_eq!(block.properties(), properties);
+
+    let values = block.values();
+    let values = values.as_array();
+    let expected_values = expected.values();
+    let expected_values = expected_values.as_array();
+    assert_eq!(values.shape()[1..], [3, 1]);
+    for (i, sample) in block.samples().iter().enumerate() {
+        assert!(sample[0] == 1 || sample[0] == 3);
+        let position = expected.samples().position(sample).unwrap();
+        assert_eq!(values.index_axis(ndarray::Axis(0), i), expected_values.index_axis(ndarray::Axis(0), position));
+    }
+
+    let gradient = block.gradient("positions").unwrap();
+    assert_eq!(gradient.values().as_array().shape()[3], 1);
+    for sample in gradient.samples().iter() {
+        assert!(sample[0].usize() < block.samples().count());
+    }
+
+    let tensor = equistore::io::load_selected("./tests/data.npz", None, None).unwrap();
+    check_tensor(&tensor);
+}
+
 
 fn check_tensor(tensor: &TensorMap) {
     assert_eq!(tensor.keys().names(), ["spherical_harmonics_l", "center_species", "neighbor_species"]);
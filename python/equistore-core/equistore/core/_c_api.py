@@ -26,16 +26,28 @@ EQS_IO_ERROR = 2
 EQS_SERIALIZATION_ERROR = 3
 EQS_BUFFER_SIZE_ERROR = 254
 EQS_INTERNAL_ERROR = 255
+EQS_DTYPE_FLOAT64 = 1
+EQS_DTYPE_FLOAT32 = 2
+EQS_DTYPE_FLOAT16 = 3
 
 
 eqs_status_t = ctypes.c_int32
 eqs_data_origin_t = ctypes.c_uint64
+eqs_dtype_t = ctypes.c_int32
 
 
 class eqs_block_t(ctypes.Structure):
     pass
 
 
+class eqs_lazy_tensormap_t(ctypes.Structure):
+    pass
+
+
+class eqs_tensormap_builder_t(ctypes.Structure):
+    pass
+
+
 class eqs_tensormap_t(ctypes.Structure):
     pass
 
@@ -75,10 +87,35 @@ eqs_array_t._fields_ = [
     ("copy", CFUNCTYPE(eqs_status_t, ctypes.c_void_p, POINTER(eqs_array_t))),
     ("destroy", CFUNCTYPE(None, ctypes.c_void_p)),
     ("move_samples_from", CFUNCTYPE(eqs_status_t, ctypes.c_void_p, ctypes.c_void_p, POINTER(eqs_sample_mapping_t), c_uintptr_t, c_uintptr_t, c_uintptr_t)),
+    ("create_uninit", CFUNCTYPE(eqs_status_t, ctypes.c_void_p, POINTER(c_uintptr_t), c_uintptr_t, POINTER(eqs_array_t))),
+    ("dtype", CFUNCTYPE(eqs_status_t, ctypes.c_void_p, POINTER(eqs_dtype_t))),
+    ("raw_data", CFUNCTYPE(eqs_status_t, ctypes.c_void_p, POINTER(ctypes.c_void_p))),
+    ("get_samples", CFUNCTYPE(eqs_status_t, ctypes.c_void_p, c_uintptr_t, c_uintptr_t, ctypes.c_void_p)),
+    ("set_samples", CFUNCTYPE(eqs_status_t, ctypes.c_void_p, c_uintptr_t, c_uintptr_t, ctypes.c_void_p)),
+    ("concurrent_move_samples", ctypes.c_bool),
 ]
 
 
-eqs_create_array_callback_t = CFUNCTYPE(eqs_status_t, POINTER(c_uintptr_t), c_uintptr_t, POINTER(eqs_array_t))
+eqs_create_array_callback_t = CFUNCTYPE(eqs_status_t, ctypes.c_void_p, POINTER(c_uintptr_t), c_uintptr_t, eqs_dtype_t, POINTER(eqs_array_t))
+eqs_create_array_view_callback_t = CFUNCTYPE(eqs_status_t, ctypes.c_void_p, POINTER(c_uintptr_t), c_uintptr_t, POINTER(ctypes.c_double), POINTER(eqs_array_t))
+
+eqs_write_callback_t = CFUNCTYPE(eqs_status_t, ctypes.c_void_p, POINTER(ctypes.c_uint8), c_uintptr_t)
+
+eqs_seek_callback_t = CFUNCTYPE(eqs_status_t, ctypes.c_void_p, ctypes.c_uint64)
+
+
+class eqs_profiling_event_t(ctypes.Structure):
+    pass
+
+eqs_profiling_event_t._fields_ = [
+    ("name", ctypes.c_char_p),
+    ("duration_ns", ctypes.c_uint64),
+    ("bytes_moved", ctypes.c_uint64),
+    ("labels_entries_hashed", ctypes.c_uint64),
+    ("array_callbacks", ctypes.c_uint64),
+]
+
+eqs_profiling_callback_t = CFUNCTYPE(None, ctypes.c_void_p, POINTER(eqs_profiling_event_t))
 
 
 def setup_functions(lib):
@@ -104,6 +141,14 @@ def setup_functions(lib):
     ]
     lib.eqs_labels_position.restype = _check_status
 
+    lib.eqs_labels_positions.argtypes = [
+        eqs_labels_t,
+        POINTER(ctypes.c_int32),
+        c_uintptr_t,
+        POINTER(ctypes.c_int64),
+    ]
+    lib.eqs_labels_positions.restype = _check_status
+
     lib.eqs_labels_create.argtypes = [
         POINTER(eqs_labels_t),
     ]
@@ -139,6 +184,15 @@ def setup_functions(lib):
     ]
     lib.eqs_labels_union.restype = _check_status
 
+    lib.eqs_labels_union_many.argtypes = [
+        POINTER(eqs_labels_t),
+        c_uintptr_t,
+        POINTER(eqs_labels_t),
+        POINTER(ctypes.c_int64),
+        c_uintptr_t,
+    ]
+    lib.eqs_labels_union_many.restype = _check_status
+
     lib.eqs_labels_intersection.argtypes = [
         eqs_labels_t,
         eqs_labels_t,
@@ -259,10 +313,21 @@ def setup_functions(lib):
     ]
     lib.eqs_tensormap_blocks_matching.restype = _check_status
 
+    lib.eqs_tensormap_blocks_matching_values.argtypes = [
+        POINTER(eqs_tensormap_t),
+        POINTER(c_uintptr_t),
+        POINTER(c_uintptr_t),
+        POINTER(ctypes.c_char_p),
+        POINTER(ctypes.c_int32),
+        c_uintptr_t,
+    ]
+    lib.eqs_tensormap_blocks_matching_values.restype = _check_status
+
     lib.eqs_tensormap_keys_to_properties.argtypes = [
         POINTER(eqs_tensormap_t),
         eqs_labels_t,
         ctypes.c_bool,
+        c_uintptr_t,
     ]
     lib.eqs_tensormap_keys_to_properties.restype = POINTER(eqs_tensormap_t)
 
@@ -277,28 +342,128 @@ def setup_functions(lib):
         POINTER(eqs_tensormap_t),
         eqs_labels_t,
         ctypes.c_bool,
+        c_uintptr_t,
     ]
     lib.eqs_tensormap_keys_to_samples.restype = POINTER(eqs_tensormap_t)
 
+    lib.eqs_tensormap_join_samples.argtypes = [
+        POINTER(POINTER(eqs_tensormap_t)),
+        c_uintptr_t,
+        c_uintptr_t,
+    ]
+    lib.eqs_tensormap_join_samples.restype = POINTER(eqs_tensormap_t)
+
+    lib.eqs_tensormap_builder.argtypes = [
+        POINTER(ctypes.c_char_p),
+        c_uintptr_t,
+    ]
+    lib.eqs_tensormap_builder.restype = POINTER(eqs_tensormap_builder_t)
+
+    lib.eqs_tensormap_builder_add_block.argtypes = [
+        POINTER(eqs_tensormap_builder_t),
+        POINTER(ctypes.c_int32),
+        c_uintptr_t,
+        POINTER(eqs_block_t),
+    ]
+    lib.eqs_tensormap_builder_add_block.restype = _check_status
+
+    lib.eqs_tensormap_builder_finish.argtypes = [
+        POINTER(eqs_tensormap_builder_t),
+    ]
+    lib.eqs_tensormap_builder_finish.restype = POINTER(eqs_tensormap_t)
+
+    lib.eqs_tensormap_builder_free.argtypes = [
+        POINTER(eqs_tensormap_builder_t),
+    ]
+    lib.eqs_tensormap_builder_free.restype = _check_status
+
     lib.eqs_tensormap_load.argtypes = [
         ctypes.c_char_p,
         eqs_create_array_callback_t,
+        ctypes.c_void_p,
+        c_uintptr_t,
     ]
     lib.eqs_tensormap_load.restype = POINTER(eqs_tensormap_t)
 
+    lib.eqs_tensormap_load_selected.argtypes = [
+        ctypes.c_char_p,
+        eqs_create_array_callback_t,
+        ctypes.c_void_p,
+        POINTER(eqs_labels_t),
+        POINTER(eqs_labels_t),
+        c_uintptr_t,
+    ]
+    lib.eqs_tensormap_load_selected.restype = POINTER(eqs_tensormap_t)
+
     lib.eqs_tensormap_load_buffer.argtypes = [
         ctypes.c_char_p,
         c_uintptr_t,
         eqs_create_array_callback_t,
+        ctypes.c_void_p,
     ]
     lib.eqs_tensormap_load_buffer.restype = POINTER(eqs_tensormap_t)
 
+    lib.eqs_tensormap_load_buffer_view.argtypes = [
+        ctypes.c_char_p,
+        c_uintptr_t,
+        eqs_create_array_callback_t,
+        ctypes.c_void_p,
+        eqs_create_array_view_callback_t,
+    ]
+    lib.eqs_tensormap_load_buffer_view.restype = POINTER(eqs_tensormap_t)
+
+    lib.eqs_lazy_tensormap_open.argtypes = [
+        ctypes.c_char_p,
+    ]
+    lib.eqs_lazy_tensormap_open.restype = POINTER(eqs_lazy_tensormap_t)
+
+    lib.eqs_lazy_tensormap_free.argtypes = [
+        POINTER(eqs_lazy_tensormap_t),
+    ]
+    lib.eqs_lazy_tensormap_free.restype = _check_status
+
+    lib.eqs_lazy_tensormap_keys.argtypes = [
+        POINTER(eqs_lazy_tensormap_t),
+        POINTER(eqs_labels_t),
+    ]
+    lib.eqs_lazy_tensormap_keys.restype = _check_status
+
+    lib.eqs_lazy_tensormap_blocks_matching.argtypes = [
+        POINTER(eqs_lazy_tensormap_t),
+        POINTER(c_uintptr_t),
+        POINTER(c_uintptr_t),
+        eqs_labels_t,
+    ]
+    lib.eqs_lazy_tensormap_blocks_matching.restype = _check_status
+
+    lib.eqs_lazy_tensormap_load_block.argtypes = [
+        POINTER(eqs_lazy_tensormap_t),
+        c_uintptr_t,
+        eqs_create_array_callback_t,
+        ctypes.c_void_p,
+    ]
+    lib.eqs_lazy_tensormap_load_block.restype = POINTER(eqs_block_t)
+
     lib.eqs_tensormap_save.argtypes = [
         ctypes.c_char_p,
         POINTER(eqs_tensormap_t),
     ]
     lib.eqs_tensormap_save.restype = _check_status
 
+    lib.eqs_tensormap_save_compressed.argtypes = [
+        ctypes.c_char_p,
+        POINTER(eqs_tensormap_t),
+    ]
+    lib.eqs_tensormap_save_compressed.restype = _check_status
+
+    lib.eqs_tensormap_save_stream.argtypes = [
+        ctypes.c_void_p,
+        eqs_write_callback_t,
+        eqs_seek_callback_t,
+        POINTER(eqs_tensormap_t),
+    ]
+    lib.eqs_tensormap_save_stream.restype = _check_status
+
     lib.eqs_tensormap_save_buffer.argtypes = [
         POINTER(ctypes.c_char_p),
         POINTER(c_uintptr_t),
@@ -307,3 +472,9 @@ def setup_functions(lib):
         POINTER(eqs_tensormap_t),
     ]
     lib.eqs_tensormap_save_buffer.restype = _check_status
+
+    lib.eqs_set_profiling_callback.argtypes = [
+        eqs_profiling_callback_t,
+        ctypes.c_void_p,
+    ]
+    lib.eqs_set_profiling_callback.restype = _check_status
@@ -2,7 +2,14 @@ import ctypes
 
 import numpy as np
 
-from .._c_api import c_uintptr_t, eqs_array_t, eqs_data_origin_t
+from .._c_api import (
+    EQS_DTYPE_FLOAT16,
+    EQS_DTYPE_FLOAT32,
+    EQS_DTYPE_FLOAT64,
+    c_uintptr_t,
+    eqs_array_t,
+    eqs_data_origin_t,
+)
 from ..utils import catch_exceptions
 
 
@@ -82,6 +89,8 @@ class ArrayWrapper:
         eqs_array.origin = eqs_array.origin.__class__(eqs_array_origin)
 
         eqs_array.data = eqs_array.data.__class__(_eqs_array_data)
+        eqs_array.dtype = eqs_array.dtype.__class__(_eqs_array_dtype)
+        eqs_array.raw_data = eqs_array.raw_data.__class__(_eqs_array_raw_data)
 
         eqs_array.shape = eqs_array.shape.__class__(_eqs_array_shape)
         eqs_array.reshape = eqs_array.reshape.__class__(_eqs_array_reshape)
@@ -94,6 +103,9 @@ class ArrayWrapper:
         eqs_array.move_samples_from = eqs_array.move_samples_from.__class__(
             _eqs_array_move_samples_from
         )
+        eqs_array.create_uninit = eqs_array.create_uninit.__class__(
+            _eqs_array_create_uninit
+        )
 
         self._eqs_array = eqs_array
 
@@ -118,10 +130,11 @@ def _object_from_ptr(ptr):
     return ctypes.cast(ptr, ctypes.POINTER(ctypes.py_object)).contents.value
 
 
-@catch_exceptions
-def _eqs_array_data(this, data):
-    storage = _object_from_ptr(this)
-
+def _cpu_numpy_array(storage):
+    """
+    Get the data of the array in ``storage`` as a contiguous numpy array,
+    sharing memory with the original array.
+    """
     if _is_numpy_array(storage.array):
         array = storage.array
 
@@ -140,12 +153,60 @@ def _eqs_array_data(this, data):
     if not array.data.c_contiguous:
         raise ValueError("can not get data pointer for non contiguous array")
 
+    return array
+
+
+_EQS_DTYPES = {
+    np.dtype(np.float64): EQS_DTYPE_FLOAT64,
+    np.dtype(np.float32): EQS_DTYPE_FLOAT32,
+    np.dtype(np.float16): EQS_DTYPE_FLOAT16,
+}
+
+if HAS_TORCH:
+    _EQS_TORCH_DTYPES = {
+        torch.float64: EQS_DTYPE_FLOAT64,
+        torch.float32: EQS_DTYPE_FLOAT32,
+        torch.float16: EQS_DTYPE_FLOAT16,
+    }
+
+
+@catch_exceptions
+def _eqs_array_data(this, data):
+    storage = _object_from_ptr(this)
+    array = _cpu_numpy_array(storage)
+
     if not array.dtype == np.float64:
         raise ValueError(f"can not get data pointer for array type {array.dtype}")
 
     data[0] = array.ctypes.data_as(ctypes.POINTER(ctypes.c_double))
 
 
+@catch_exceptions
+def _eqs_array_dtype(this, dtype):
+    storage = _object_from_ptr(this)
+
+    if _is_numpy_array(storage.array):
+        eqs_dtype = _EQS_DTYPES.get(storage.array.dtype)
+    elif _is_torch_array(storage.array):
+        eqs_dtype = _EQS_TORCH_DTYPES.get(storage.array.dtype)
+
+    if eqs_dtype is None:
+        raise ValueError(f"unsupported array type {storage.array.dtype}")
+
+    dtype[0] = eqs_dtype
+
+
+@catch_exceptions
+def _eqs_array_raw_data(this, data):
+    storage = _object_from_ptr(this)
+    array = _cpu_numpy_array(storage)
+
+    if array.dtype not in _EQS_DTYPES:
+        raise ValueError(f"can not get data pointer for array type {array.dtype}")
+
+    data[0] = array.ctypes.data
+
+
 @catch_exceptions
 def _eqs_array_shape(this, shape_ptr, shape_count):
     wrapper = _object_from_ptr(this)
@@ -188,6 +249,28 @@ def _eqs_array_create(this, shape_ptr, shape_count, new_array):
         array = np.zeros(shape, dtype=dtype)
     elif _is_torch_array(wrapper.array):
         array = torch.zeros(shape, dtype=dtype, device=wrapper.array.device)
+    else:
+        raise ValueError(f"unknown array type: {type(wrapper.array)}")
+
+    new_wrapper = ArrayWrapper(array)
+    new_array[0] = new_wrapper.into_eqs_array()
+
+
+@catch_exceptions
+def _eqs_array_create_uninit(this, shape_ptr, shape_count, new_array):
+    wrapper = _object_from_ptr(this)
+
+    shape = []
+    for i in range(shape_count):
+        shape.append(shape_ptr[i])
+    dtype = wrapper.array.dtype
+
+    if _is_numpy_array(wrapper.array):
+        array = np.empty(shape, dtype=dtype)
+    elif _is_torch_array(wrapper.array):
+        array = torch.empty(shape, dtype=dtype, device=wrapper.array.device)
+    else:
+        raise ValueError(f"unknown array type: {type(wrapper.array)}")
 
     new_wrapper = ArrayWrapper(array)
     new_array[0] = new_wrapper.into_eqs_array()
@@ -201,6 +284,8 @@ def _eqs_array_copy(this, new_array):
         array = wrapper.array.copy()
     elif _is_torch_array(wrapper.array):
         array = wrapper.array.clone()
+    else:
+        raise ValueError(f"unknown array type: {type(wrapper.array)}")
 
     new_wrapper = ArrayWrapper(array)
     new_array[0] = new_wrapper.into_eqs_array()
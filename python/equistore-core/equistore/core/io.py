@@ -1,11 +1,21 @@
 import ctypes
 import pathlib
 import warnings
-from typing import BinaryIO, Callable, Union
+from typing import BinaryIO, Callable, Optional, Union
 
 import numpy as np
 
-from ._c_api import c_uintptr_t, eqs_array_t, eqs_create_array_callback_t
+from ._c_api import (
+    EQS_DTYPE_FLOAT16,
+    EQS_DTYPE_FLOAT32,
+    EQS_DTYPE_FLOAT64,
+    c_uintptr_t,
+    eqs_array_t,
+    eqs_dtype_t,
+    eqs_create_array_callback_t,
+    eqs_seek_callback_t,
+    eqs_write_callback_t,
+)
 from ._c_lib import _get_library
 from .block import TensorBlock
 from .data.array import ArrayWrapper, _is_numpy_array, _is_torch_array
@@ -15,36 +25,50 @@ from .tensor import TensorMap
 from .utils import catch_exceptions
 
 
+_NUMPY_DTYPES = {
+    EQS_DTYPE_FLOAT64: np.float64,
+    EQS_DTYPE_FLOAT32: np.float32,
+    EQS_DTYPE_FLOAT16: np.float16,
+}
+
+
 @catch_exceptions
-def create_numpy_array(shape_ptr, shape_count, array):
+def create_numpy_array(_user_data, shape_ptr, shape_count, dtype, array):
     """
     Callback function that can be used with
     :py:func:`equistore.core.io.load_custom_array` to load data in numpy arrays.
+    The arrays use the same dtype as the data in the file.
     """
     shape = []
     for i in range(shape_count):
         shape.append(shape_ptr[i])
 
-    data = np.empty(shape, dtype=np.float64)
+    data = np.empty(shape, dtype=_NUMPY_DTYPES[dtype])
     wrapper = ArrayWrapper(data)
     array[0] = wrapper.into_eqs_array()
 
 
 @catch_exceptions
-def create_torch_array(shape_ptr, shape_count, array):
+def create_torch_array(_user_data, shape_ptr, shape_count, dtype, array):
     """
     Callback function that can be used with
     :py:func:`equistore.core.io.load_custom_array` to load data in torch
-    tensors. The resulting tensors are stored on CPU, and their dtype is
-    ``torch.float64``.
+    tensors. The resulting tensors are stored on CPU, and use the same dtype as
+    the data in the file.
     """
     import torch
 
+    torch_dtypes = {
+        EQS_DTYPE_FLOAT64: torch.float64,
+        EQS_DTYPE_FLOAT32: torch.float32,
+        EQS_DTYPE_FLOAT16: torch.float16,
+    }
+
     shape = []
     for i in range(shape_count):
         shape.append(shape_ptr[i])
 
-    data = torch.empty(shape, dtype=torch.float64, device="cpu")
+    data = torch.empty(shape, dtype=torch_dtypes[dtype], device="cpu")
     wrapper = ArrayWrapper(data)
     array[0] = wrapper.into_eqs_array()
 
@@ -62,8 +86,8 @@ def load(file: Union[str, pathlib.Path, BinaryIO], use_numpy=False) -> TensorMap
         opened in binary mode.
     :param use_numpy: should we use numpy or the native implementation? Numpy should be
         able to process more dtypes than the native implementation, which is limited to
-        float64, but the native implementation is usually faster than going through
-        numpy.
+        float64, float32 and float16, but the native implementation is usually faster
+        than going through numpy.
     """
     if use_numpy:
         return _read_npz(file)
@@ -79,7 +103,14 @@ def load(file: Union[str, pathlib.Path, BinaryIO], use_numpy=False) -> TensorMap
 
 
 CreateArrayCallback = Callable[
-    [ctypes.POINTER(c_uintptr_t), c_uintptr_t, ctypes.POINTER(eqs_array_t)], None
+    [
+        ctypes.c_void_p,
+        ctypes.POINTER(c_uintptr_t),
+        c_uintptr_t,
+        eqs_dtype_t,
+        ctypes.POINTER(eqs_array_t),
+    ],
+    None,
 ]
 
 
@@ -94,9 +125,11 @@ def load_custom_array(
     This is an advanced functionality, which should not be needed by most users.
 
     This function allows to specify the kind of array to use when loading the data
-    through the ``create_array`` callback. This callback should take three arguments: a
-    pointer to the shape, the number of elements in the shape, and a pointer to the
-    ``eqs_array_t`` to be filled.
+    through the ``create_array`` callback. This callback should take five arguments:
+    a user data pointer (always ``None`` when called from Python), a pointer to the
+    shape, the number of elements in the shape, the dtype of the data in the file (one
+    of the ``EQS_DTYPE_XXX`` constants), and a pointer to the ``eqs_array_t`` to be
+    filled. The data is converted to the dtype of the created arrays if needed.
 
     :py:func:`equistore.core.io.create_numpy_array` and
     :py:func:`equistore.core.io.create_torch_array` can be used to load data into numpy
@@ -113,7 +146,70 @@ def load_custom_array(
     elif isinstance(path, pathlib.Path):
         path = bytes(path)
 
-    ptr = lib.eqs_tensormap_load(path, eqs_create_array_callback_t(create_array))
+    # always use a single thread, since the callback would serialize the
+    # threads on the GIL anyway
+    threads = 1
+    ptr = lib.eqs_tensormap_load(
+        path, eqs_create_array_callback_t(create_array), None, threads
+    )
+
+    return TensorMap._from_ptr(ptr)
+
+
+def load_selected(
+    path: Union[str, pathlib.Path],
+    samples: Optional[Labels] = None,
+    properties: Optional[Labels] = None,
+    create_array: CreateArrayCallback = create_numpy_array,
+) -> TensorMap:
+    """
+    Load a subset of a previously saved :py:class:`TensorMap` from the given path,
+    keeping only the samples and properties matching the given selections.
+
+    The labels of each block are read first, and then only the data for the selected
+    samples and properties is read from the file. For files saved without
+    compression, loading a small subset (for example a validation set) only reads
+    the corresponding part of the file.
+
+    The selections can contain a subset of the dimensions of the samples or
+    properties, and an entry is kept if its values for these dimensions are part of
+    the selection. The kept entries stay in the same order as in the file, and all
+    blocks are kept, even if no sample or property matches the selection. The
+    samples of gradients are renumbered to only refer to the kept samples.
+
+    :param path: path of the file to load
+    :param samples: selection for the samples of the blocks, or ``None`` to keep all
+        the samples
+    :param properties: selection for the properties of the blocks, or ``None`` to
+        keep all the properties
+    :param create_array: callback used to create arrays as needed, see
+        :py:func:`equistore.core.io.load_custom_array`
+    """
+
+    lib = _get_library()
+
+    if isinstance(path, str):
+        path = path.encode("utf8")
+    elif isinstance(path, pathlib.Path):
+        path = bytes(path)
+
+    if samples is not None:
+        samples = ctypes.byref(samples._as_eqs_labels_t())
+
+    if properties is not None:
+        properties = ctypes.byref(properties._as_eqs_labels_t())
+
+    # always use a single thread, since the callback would serialize the
+    # threads on the GIL anyway
+    threads = 1
+    ptr = lib.eqs_tensormap_load_selected(
+        path,
+        eqs_create_array_callback_t(create_array),
+        None,
+        samples,
+        properties,
+        threads,
+    )
 
     return TensorMap._from_ptr(ptr)
 
@@ -129,9 +225,11 @@ def load_buffer_custom_array(
     This is an advanced functionality, which should not be needed by most users.
 
     This function allows to specify the kind of array to use when loading the data
-    through the ``create_array`` callback. This callback should take three arguments: a
-    pointer to the shape, the number of elements in the shape, and a pointer to the
-    ``eqs_array_t`` to be filled.
+    through the ``create_array`` callback. This callback should take five arguments:
+    a user data pointer (always ``None`` when called from Python), a pointer to the
+    shape, the number of elements in the shape, the dtype of the data in the file (one
+    of the ``EQS_DTYPE_XXX`` constants), and a pointer to the ``eqs_array_t`` to be
+    filled. The data is converted to the dtype of the created arrays if needed.
 
     :py:func:`equistore.core.io.create_numpy_array` and
     :py:func:`equistore.core.io.create_torch_array` can be used to load data into numpy
@@ -151,6 +249,7 @@ def load_buffer_custom_array(
         buffer,
         len(buffer),
         eqs_create_array_callback_t(create_array),
+        None,
     )
 
     return TensorMap._from_ptr(ptr)
@@ -160,6 +259,7 @@ def save(
     file: Union[str, pathlib.Path, BinaryIO],
     tensor: TensorMap,
     use_numpy=False,
+    compressed=False,
 ):
     """Save the given :py:class:`TensorMap` to a ``file``.
 
@@ -173,8 +273,13 @@ def save(
     :param tensor: tensor to save
     :param use_numpy: should we use numpy or the native implementation? Numpy should be
         able to process more dtypes than the native implementation, which is limited to
-        float64, but the native implementation is usually faster than going through
-        numpy.
+        float64, float32 and float16, but the native implementation is usually faster
+        than going through numpy.
+    :param compressed: should the data be compressed? This uses DEFLATE compression
+        for all the files in the archive (the same format as
+        :py:func:`numpy.savez_compressed`), and the resulting files can be loaded with
+        :py:func:`load`. When saving to a file-like object, compression always goes
+        through numpy.
     """
     if not isinstance(tensor, TensorMap):
         raise TypeError(f"tensor should be a 'TensorMap', not {type(tensor)}")
@@ -187,19 +292,57 @@ def save(
                 stacklevel=1,
             )
 
-    if use_numpy:
+    is_path = isinstance(file, (str, pathlib.Path))
+    if use_numpy or (compressed and not is_path):
         all_entries = _tensor_map_to_dict(tensor)
-        np.savez(file, **all_entries)
+        if compressed:
+            np.savez_compressed(file, **all_entries)
+        else:
+            np.savez(file, **all_entries)
     else:
         lib = _get_library()
+        if compressed:
+            lib_save = lib.eqs_tensormap_save_compressed
+        else:
+            lib_save = lib.eqs_tensormap_save
+
         if isinstance(file, str):
-            lib.eqs_tensormap_save(file.encode("utf8"), tensor._ptr)
+            lib_save(file.encode("utf8"), tensor._ptr)
         elif isinstance(file, pathlib.Path):
-            lib.eqs_tensormap_save(bytes(file), tensor._ptr)
+            lib_save(bytes(file), tensor._ptr)
         else:
             # assume we have a file-like object
-            buffer = save_buffer_raw_(tensor)
-            file.write(buffer.raw)
+            if hasattr(file, "seekable") and file.seekable():
+                _save_stream(file, tensor)
+            else:
+                buffer = save_buffer_raw_(tensor)
+                file.write(buffer.raw)
+
+
+def _save_stream(file: BinaryIO, tensor: TensorMap):
+    """
+    Save a TensorMap to a seekable file-like object, writing the data as it is
+    produced instead of going through an in-memory buffer.
+    """
+    lib = _get_library()
+
+    # positions given to `seek` are relative to the start of the TensorMap data
+    start = file.tell()
+
+    @catch_exceptions
+    def write(_user_data, data, count):
+        file.write(ctypes.string_at(data, count))
+
+    @catch_exceptions
+    def seek(_user_data, position):
+        file.seek(start + position)
+
+    lib.eqs_tensormap_save_stream(
+        None,
+        eqs_write_callback_t(write),
+        eqs_seek_callback_t(seek),
+        tensor._ptr,
+    )
 
 
 def save_buffer_raw_(tensor: TensorMap):
@@ -438,8 +438,10 @@ class TensorMap:
         """
         keys_to_move = _normalize_keys_to_move(keys_to_move)
 
+        # the arrays are manipulated through Python callbacks, which would
+        # all need the GIL: use a single thread
         ptr = self._lib.eqs_tensormap_keys_to_samples(
-            self._ptr, keys_to_move._as_eqs_labels_t(), sort_samples
+            self._ptr, keys_to_move._as_eqs_labels_t(), sort_samples, 1
         )
         return TensorMap._from_ptr(ptr)
 
@@ -506,8 +508,10 @@ class TensorMap:
         :return: a new :py:class:`TensorMap` with merged blocks
         """
         keys_to_move = _normalize_keys_to_move(keys_to_move)
+        # the arrays are manipulated through Python callbacks, which would
+        # all need the GIL: use a single thread
         ptr = self._lib.eqs_tensormap_keys_to_properties(
-            self._ptr, keys_to_move._as_eqs_labels_t(), sort_samples
+            self._ptr, keys_to_move._as_eqs_labels_t(), sort_samples, 1
         )
         return TensorMap._from_ptr(ptr)
 
@@ -100,6 +100,26 @@ class ArrayWrapperMixin:
 
         free_eqs_array(new_eqs_array)
 
+    def test_create_uninit(self):
+        array = self.create_array((2, 3, 4))
+        wrapper = equistore.core.data.ArrayWrapper(array)
+        eqs_array = wrapper.into_eqs_array()
+
+        new_eqs_array = eqs_array_t()
+        new_shape = ctypes.ARRAY(c_uintptr_t, 2)(18, 4)
+        status = eqs_array.create_uninit(
+            eqs_array.ptr, new_shape, len(new_shape), new_eqs_array
+        )
+        assert status == EQS_SUCCESS
+
+        new_array = equistore.core.data.eqs_array_to_python_array(new_eqs_array)
+        assert id(new_array) != id(array)
+        assert new_array.shape == (18, 4)
+        assert new_array.dtype == array.dtype
+
+        free_eqs_array(eqs_array)
+        free_eqs_array(new_eqs_array)
+
     def test_copy(self):
         array = self.create_array((2, 3, 4))
         array[1, :, :] = 3
@@ -203,7 +223,7 @@ equistore.core.data.register_external_data_wrapper(
 
 
 @equistore.core.utils.catch_exceptions
-def create_test_array(shape_ptr, shape_count, array):
+def create_test_array(_user_data, shape_ptr, shape_count, dtype, array):
     shape = []
     for i in range(shape_count):
         shape.append(shape_ptr[i])
@@ -2,6 +2,7 @@ import io
 import os
 import pickle
 import sys
+import zipfile
 
 import numpy as np
 import pytest
@@ -61,6 +62,51 @@ def test_load(use_numpy, memory_buffer):
     assert gradient.values.shape == (59, 3, 5, 3)
 
 
+def test_load_selected():
+    path = os.path.join(
+        os.path.dirname(__file__),
+        "..",
+        "..",
+        "..",
+        "equistore",
+        "tests",
+        "data.npz",
+    )
+
+    reference = equistore.core.load(path)
+
+    samples = Labels(["structure"], np.array([[1], [3]], dtype=np.int32))
+    properties = Labels(["n"], np.array([[0]], dtype=np.int32))
+    tensor = equistore.core.io.load_selected(path, samples, properties)
+    assert tensor.keys == reference.keys
+
+    block = tensor.block(spherical_harmonics_l=2, center_species=6, neighbor_species=1)
+    expected = reference.block(
+        spherical_harmonics_l=2, center_species=6, neighbor_species=1
+    )
+    assert block.properties == properties
+    assert block.values.shape[1:] == (5, 1)
+
+    property = expected.properties.position([0])
+    for i, sample in enumerate(block.samples):
+        assert sample["structure"] in (1, 3)
+        position = expected.samples.position(sample)
+        np.testing.assert_equal(
+            block.values[i], expected.values[position][:, property : property + 1]
+        )
+
+    gradient = block.gradient("positions")
+    assert gradient.values.shape[3] == 1
+    assert np.all(gradient.samples["sample"] < len(block.samples))
+
+    tensor = equistore.core.io.load_selected(path)
+    assert tensor.block(0).values.shape == reference.block(0).values.shape
+
+    message = "'structure' is not part of the properties for this tensor map"
+    with pytest.raises(equistore.core.EquistoreError, match=message):
+        equistore.core.io.load_selected(path, properties=samples)
+
+
 # using tmpdir as pytest-built-in fixture
 # https://docs.pytest.org/en/7.1.x/how-to/tmp_path.html#the-tmpdir-and-tmpdir-factory-fixtures
 @pytest.mark.parametrize("use_numpy", (True, False))
@@ -100,6 +146,39 @@ def test_save(use_numpy, memory_buffer, tmpdir, tensor):
             assert _npz_labels(data[f"{prefix}/components/0"]) == gradient.components[0]
 
 
+@pytest.mark.parametrize("use_numpy", (True, False))
+@pytest.mark.parametrize("memory_buffer", (True, False))
+def test_save_compressed(use_numpy, memory_buffer, tmpdir, tensor):
+    if memory_buffer:
+        file = io.BytesIO()
+    else:
+        file = "serialize-compressed.npz"
+
+    with tmpdir.as_cwd():
+        equistore.core.save(file, tensor, use_numpy=use_numpy, compressed=True)
+        if memory_buffer:
+            file.seek(0)
+
+        with zipfile.ZipFile(file) as archive:
+            for info in archive.infolist():
+                assert info.compress_type == zipfile.ZIP_DEFLATED
+
+        if memory_buffer:
+            file.seek(0)
+        loaded = equistore.core.load(file)
+
+    assert loaded.keys == tensor.keys
+    for key, block in tensor.items():
+        loaded_block = loaded.block(key)
+        np.testing.assert_equal(loaded_block.values, block.values)
+        assert loaded_block.samples == block.samples
+
+        for parameter, gradient in block.gradients():
+            loaded_gradient = loaded_block.gradient(parameter)
+            np.testing.assert_equal(loaded_gradient.values, gradient.values)
+            assert loaded_gradient.samples == gradient.samples
+
+
 def test_save_warning_errors(tmpdir, tensor):
     # does not have .npz ending and causes warning
     tmpfile = "serialize-test"
@@ -257,6 +336,31 @@ def test_nested_gradients(tmpdir, use_numpy):
                 assert grad_grad.properties == loaded_grad_grad.properties
 
 
+@pytest.mark.parametrize("dtype", (np.float32, np.float16))
+def test_save_reduced_precision(tmpdir, dtype):
+    block = TensorBlock(
+        values=np.random.rand(3, 4).astype(dtype),
+        samples=Labels.range("s", 3),
+        components=[],
+        properties=Labels.range("p", 4),
+    )
+    tensor = TensorMap(Labels.single(), [block])
+
+    tmpfile = "reduced-precision.npz"
+    with tmpdir.as_cwd():
+        equistore.core.save(tmpfile, tensor)
+
+        # the data is saved in its native precision
+        data = np.load(tmpfile)
+        assert data["blocks/0/values"].dtype == dtype
+        np.testing.assert_equal(data["blocks/0/values"], block.values)
+
+        # and loaded back in the same precision
+        loaded = equistore.core.load(tmpfile)
+        assert loaded.block(0).values.dtype == dtype
+        np.testing.assert_equal(loaded.block(0).values, block.values)
+
+
 def _npz_labels(data):
     names = data.dtype.names
     return Labels(names=names, values=data.view(dtype=np.int32).reshape(-1, len(names)))
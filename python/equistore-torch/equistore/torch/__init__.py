@@ -18,20 +18,39 @@ else:
 
 if os.environ.get("EQUISTORE_IMPORT_FOR_SPHINX") is not None:
     from .documentation import Labels, LabelsEntry, TensorBlock, TensorMap
-    from .documentation import load, save
+    from .documentation import LazyTensorMap, TensorMapBuilder
+    from .documentation import load, load_lazy, save
+    from .documentation import add, multiply, dot, slice, join
+    from .documentation import sum_over_samples, mean_over_samples
+    from .documentation import var_over_samples, std_over_samples
 else:
     _load_library()
     Labels = torch.classes.equistore.Labels
     LabelsEntry = torch.classes.equistore.LabelsEntry
     TensorBlock = torch.classes.equistore.TensorBlock
     TensorMap = torch.classes.equistore.TensorMap
+    LazyTensorMap = torch.classes.equistore.LazyTensorMap
+    TensorMapBuilder = torch.classes.equistore.TensorMapBuilder
 
     load = torch.ops.equistore.load
+    load_lazy = torch.ops.equistore.load_lazy
     save = torch.ops.equistore.save
 
+    add = torch.ops.equistore.add
+    multiply = torch.ops.equistore.multiply
+    dot = torch.ops.equistore.dot
+    sum_over_samples = torch.ops.equistore.sum_over_samples
+    mean_over_samples = torch.ops.equistore.mean_over_samples
+    var_over_samples = torch.ops.equistore.var_over_samples
+    std_over_samples = torch.ops.equistore.std_over_samples
+    slice = torch.ops.equistore.slice
+    join = torch.ops.equistore.join
+
 
 __all__ = [
     "Labels",
     "TensorBlock",
     "TensorMap",
+    "LazyTensorMap",
+    "TensorMapBuilder",
 ]
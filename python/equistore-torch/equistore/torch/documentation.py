@@ -258,6 +258,33 @@ class Labels:
                 [6]], dtype=torch.int32)
         """
 
+    @staticmethod
+    def deferred(names: StrSequence, values: torch.Tensor) -> "Labels":
+        """
+        Create :py:class:`Labels` with the given ``names`` and ``values``,
+        deferring the creation of the underlying equistore labels until a
+        function needs them.
+
+        Only the type and shape of ``values`` are checked, the data is never
+        accessed or copied to the CPU by this function. The uniqueness of the
+        entries is checked when the equistore labels are created, for example
+        when calling :py:func:`Labels.position` or when using these labels in a
+        :py:class:`TensorBlock`. Use :py:func:`Labels.has_unique_entries` to
+        check the entries on the same device as the ``values``.
+
+        :param names: names of the dimensions in the new labels. A single string
+                      is transformed into a list with one element, i.e.
+                      ``names="a"`` is the same as ``names=["a"]``.
+
+        :param values: values of the labels, this needs to be a 2-dimensional
+                       array of integers.
+
+        >>> from equistore.torch import Labels
+        >>> labels = Labels.deferred(["a", "b"], torch.tensor([[0, 1], [0, 1]]))
+        >>> labels.has_unique_entries()
+        tensor(False)
+        """
+
     def __len__(self) -> int:
         """number of entries in these labels"""
 
@@ -310,6 +337,32 @@ class Labels:
         labels.
         """
 
+    def positions(self, entries: torch.Tensor) -> torch.Tensor:
+        """
+        Get the positions of all the ``entries`` in this set of
+        :py:class:`Labels` in a single call.
+
+        :param entries: 2-D tensor of integers, containing one entry per row,
+            with as many values as there are dimensions in these
+            :py:class:`Labels`
+
+        :return: 1-D tensor of 64-bit integers, on the same device as
+            ``entries``, containing the position of each entry, or -1 for
+            entries which are not present in the labels.
+        """
+
+    def has_unique_entries(self) -> torch.Tensor:
+        """
+        Check if all the entries in these :py:class:`Labels` are unique.
+
+        The check only uses operations running on the same device as
+        :py:attr:`Labels.values`, and does not require any synchronization
+        with this device.
+
+        :return: 0-dimensional boolean tensor on the same device as
+            :py:attr:`Labels.values`
+        """
+
     def union(self, other: "Labels") -> "Labels":
         """
         Take the union of these :py:class:`Labels` with ``other``.
@@ -333,6 +386,35 @@ class Labels:
             entries from ``other``.
         """
 
+    @staticmethod
+    def union_many(labels: List["Labels"]) -> "Labels":
+        """
+        Take the union of all the :py:class:`Labels` in ``labels``, in a single
+        pass. The union contains all the entries of ``labels[0]``, followed by
+        the new entries from ``labels[1]``, and so on.
+
+        This gives the same result as repeatedly calling :py:meth:`Labels.union`,
+        without creating all the intermediary labels. If you want to know where
+        entries of each input end up in the union, you can use
+        :py:meth:`Labels.union_many_and_mapping`.
+        """
+
+    @staticmethod
+    def union_many_and_mapping(
+        labels: List["Labels"],
+    ) -> Tuple["Labels", List[torch.Tensor]]:
+        """
+        Take the union of all the :py:class:`Labels` in ``labels``, in a single
+        pass.
+
+        This function also returns the position in the union where each entry of
+        the input :py:class::`Labels` ended up.
+
+        :return: Tuple containing the union, and a list of
+            :py:class:`torch.Tensor` containing the position in the union of
+            the entries from each of the ``labels``.
+        """
+
     def intersection(self, other: "Labels") -> "Labels":
         """
         Take the intersection of these :py:class:`Labels` with ``other``.
@@ -649,6 +731,7 @@ class TensorMap:
         self,
         keys_to_move: Union[StrSequence, Labels],
         sort_samples: bool = True,
+        threads: int = 1,
     ) -> "TensorMap":
         """
         Merge blocks along the samples axis, adding ``keys_to_move`` to the end
@@ -676,6 +759,9 @@ class TensorMap:
         :param keys_to_move: description of the keys to move
         :param sort_samples: whether to sort the merged samples or keep them in
             the order in which they appear in the original blocks
+        :param threads: number of threads to use when merging blocks. By default
+            everything runs on the current thread, use ``0`` to use one thread
+            per CPU core.
         :return: a new :py:class:`TensorMap` with merged blocks
         """
 
@@ -683,6 +769,7 @@ class TensorMap:
         self,
         keys_to_move: Union[StrSequence, Labels],
         sort_samples: bool = True,
+        threads: int = 1,
     ) -> "TensorMap":
         """
         Merge blocks along the properties direction, adding ``keys_to_move`` at
@@ -724,9 +811,33 @@ class TensorMap:
         :param keys_to_move: description of the keys to move
         :param sort_samples: whether to sort the merged samples or keep them in
             the order in which they appear in the original blocks
+        :param threads: number of threads to use when merging blocks. By default
+            everything runs on the current thread, use ``0`` to use one thread
+            per CPU core.
         :return: a new :py:class:`TensorMap` with merged blocks
         """
 
+    @staticmethod
+    def join_samples(tensors: List["TensorMap"], threads: int) -> "TensorMap":
+        """
+        Concatenate the blocks of all the ``tensors`` along the samples axis.
+
+        The keys of the result are the union of the keys of all ``tensors``, and
+        each block contains the samples of all the blocks with the corresponding
+        key, in the order of ``tensors``. A new ``"tensor"`` dimension is added
+        to the samples, containing the index in ``tensors`` of the
+        :py:class:`TensorMap` each sample comes from.
+
+        Blocks with the same key must have the same samples names, components,
+        properties and gradients.
+
+        :param tensors: list of :py:class:`TensorMap` to join
+        :param threads: number of threads to use when joining blocks. Use ``1``
+            to run everything on the current thread, and ``0`` to use one
+            thread per CPU core.
+        :return: a new :py:class:`TensorMap` with joined blocks
+        """
+
     def components_to_properties(self, dimensions: StrSequence) -> "TensorMap":
         """
         Move the given ``dimensions`` from the component labels to the property
@@ -840,7 +951,119 @@ class TensorMap:
         """
 
 
-def load(path: str) -> TensorMap:
+class TensorMapBuilder:
+    """
+    Incremental construction of a :py:class:`TensorMap`, adding one block at a
+    time.
+
+    When adding a block with the same key as a block already in the builder, the
+    samples of the new block are appended to the samples of the existing block.
+    Both blocks must then have the same components, properties and gradients
+    parameters. The data is only assembled in a :py:class:`TensorMap` when calling
+    :py:func:`TensorMapBuilder.finish`.
+
+    >>> import torch
+    >>> from equistore.torch import Labels, TensorBlock, TensorMapBuilder
+    >>> def create_block(samples):
+    ...     return TensorBlock(
+    ...         values=torch.zeros(len(samples), 3),
+    ...         samples=Labels(["structure"], torch.tensor(samples).reshape(-1, 1)),
+    ...         components=[],
+    ...         properties=Labels.range("property", 3),
+    ...     )
+    >>> builder = TensorMapBuilder(["key"])
+    >>> builder.add_block([0], create_block([0, 1]))
+    >>> builder.add_block([1], create_block([0]))
+    >>> builder.add_block([0], create_block([2]))
+    >>> tensor = builder.finish()
+    >>> tensor.block_by_id(0).values.shape
+    torch.Size([3, 3])
+    """
+
+    def __init__(self, names: List[str]):
+        """
+        :param names: names of the dimensions of the keys
+        """
+
+    def add_block(self, key: List[int], block: TensorBlock):
+        """
+        Add a ``block`` associated with the given ``key`` to this builder. If
+        there is already a block with the same ``key``, the samples of ``block``
+        are appended to the existing block, and the ``"sample"`` dimension of the
+        gradients samples is updated accordingly.
+
+        :param key: values of the key for this block
+        :param block: block to add to the builder
+        """
+
+    def finish(self) -> TensorMap:
+        """
+        Assemble all the blocks added so far into a :py:class:`TensorMap`. The
+        builder can not be used after calling this function.
+        """
+
+
+class LazyTensorMap:
+    """
+    A :py:class:`TensorMap` stored in a file, from which blocks are only loaded
+    when they are accessed.
+
+    Opening a :py:class:`LazyTensorMap` only reads the keys from the file, the
+    labels and data of each block are read the first time the block is
+    requested with :py:func:`LazyTensorMap.block_by_id`. Loaded blocks are kept
+    in memory to be re-used later, optionally keeping only the ``max_blocks``
+    most recently used ones.
+    """
+
+    def __init__(self, path: str, max_blocks: int = 0):
+        """
+        :param path: path of the file to open
+        :param max_blocks: maximal number of blocks to keep in memory. When
+            loading more blocks, the least recently used blocks are released.
+            Use 0 to keep all loaded blocks in memory.
+        """
+
+    @property
+    def keys(self) -> Labels:
+        """the set of keys labeling the blocks in this :py:class:`LazyTensorMap`"""
+
+    def __len__(self) -> int:
+        """get the number of key/block pairs in this :py:class:`LazyTensorMap`"""
+
+    def blocks_matching(self, selection: Labels) -> List[int]:
+        """
+        Get a (possibly empty) list of block indexes matching the ``selection``.
+        This does not load any block from the file.
+
+        See :py:func:`TensorMap.blocks_matching` for more information.
+        """
+
+    def block_by_id(self, index: int) -> TensorBlock:
+        """
+        Get the block at ``index`` in this :py:class:`LazyTensorMap`, loading it
+        from the file if it is not already in memory.
+
+        The returned block stays valid even if it is later released from the set
+        of blocks kept in memory.
+
+        :param index: index of the block to retrieve
+        """
+
+    def loaded_blocks(self) -> int:
+        """get the number of blocks currently kept in memory"""
+
+    def clear(self):
+        """
+        Release all the blocks kept in memory. Blocks previously returned by
+        :py:func:`LazyTensorMap.block_by_id` stay valid.
+        """
+
+
+def load(
+    path: str,
+    threads: int = 1,
+    device: Optional[torch.device] = None,
+) -> TensorMap:
     """
     Load a previously saved :py:class:`TensorMap` from the given path.
 
@@ -850,6 +1073,25 @@ def load(path: str) -> TensorMap:
     information on the format.
 
     :param path: path of the file to load
+    :param threads: number of threads to use when decoding the blocks. Use 0 to
+        use one thread per CPU core.
+    :param device: device on which the values and gradients should be created.
+        The data is copied to this device a few samples at the time while the
+        file is read, without creating the full :py:class:`TensorMap` on CPU
+        first. Defaults to CPU. The metadata (:py:class:`Labels`) is always
+        loaded on CPU.
+    """
+
+
+def load_lazy(path: str, max_blocks: int = 0) -> LazyTensorMap:
+    """
+    Open a previously saved :py:class:`TensorMap` from the given path, loading
+    blocks only when they are accessed. This is equivalent to creating a
+    :py:class:`LazyTensorMap` directly.
+
+    :param path: path of the file to open
+    :param max_blocks: maximal number of blocks to keep in memory, use 0 to
+        keep all loaded blocks in memory
     """
 
 
@@ -862,6 +1104,123 @@ def save(path: str, tensor: TensorMap):
     is stored as a ``.npy`` array. See the C API documentation for more
     information on the format.
 
+    The values and gradients can be on any device. Data which is not on CPU is
+    copied to the host a few samples at the time while the file is written.
+
     :param path: path of the file where to save the data
     :param tensor: tensor to save
     """
+
+
+def add(A: TensorMap, B: Union[float, TensorMap]) -> TensorMap:
+    r"""
+    Get a new :py:class:`TensorMap` with the values being the sum of ``A`` and
+    ``B``. This is a native TorchScript implementation of
+    :py:func:`equistore.add`.
+
+    Gradients are propagated to the result, :math:`\nabla(A + B) = \nabla A +
+    \nabla B`.
+
+    :param A: first :py:class:`TensorMap` for the addition
+    :param B: either a scalar, or a :py:class:`TensorMap` with the same metadata
+        (including gradients) as ``A``
+    """
+
+
+def multiply(A: TensorMap, B: Union[float, TensorMap]) -> TensorMap:
+    r"""
+    Get a new :py:class:`TensorMap` with the values being the element-wise
+    product of ``A`` and ``B``. This is a native TorchScript implementation of
+    :py:func:`equistore.multiply`.
+
+    Gradients are propagated to the result, :math:`\nabla(A * B) = B * \nabla A
+    + A * \nabla B`.
+
+    :param A: first :py:class:`TensorMap` for the multiplication
+    :param B: either a scalar, or a :py:class:`TensorMap` with the same metadata
+        (including gradients) as ``A``
+    """
+
+
+def dot(A: TensorMap, B: TensorMap) -> TensorMap:
+    """
+    Compute the dot product of two :py:class:`TensorMap` with the same keys.
+    This is a native TorchScript implementation of :py:func:`equistore.dot`.
+
+    The values of the blocks in the result are ``A.values @ B.values.T``, and
+    the samples of ``B`` become the properties of the result. The blocks in
+    ``B`` should not have components or gradients.
+
+    :param A: first :py:class:`TensorMap` to multiply
+    :param B: second :py:class:`TensorMap` to multiply
+    """
+
+
+def sum_over_samples(tensor: TensorMap, sample_names: StrSequence) -> TensorMap:
+    """
+    Sum the values of all blocks in ``tensor`` over the given ``sample_names``.
+    This is a native TorchScript implementation of
+    :py:func:`equistore.operations.reduce_over_samples.sum_over_samples`.
+
+    :param tensor: input :py:class:`TensorMap`
+    :param sample_names: names of samples to sum over
+    """
+
+
+def mean_over_samples(tensor: TensorMap, sample_names: StrSequence) -> TensorMap:
+    """
+    Compute the mean of the values of all blocks in ``tensor`` over the given
+    ``sample_names``. This is a native TorchScript implementation of
+    :py:func:`equistore.operations.reduce_over_samples.mean_over_samples`.
+
+    :param tensor: input :py:class:`TensorMap`
+    :param sample_names: names of samples to average over
+    """
+
+
+def var_over_samples(tensor: TensorMap, sample_names: StrSequence) -> TensorMap:
+    """
+    Compute the variance of the values of all blocks in ``tensor`` over the
+    given ``sample_names``. This is a native TorchScript implementation of
+    :py:func:`equistore.operations.reduce_over_samples.var_over_samples`.
+
+    :param tensor: input :py:class:`TensorMap`
+    :param sample_names: names of samples to compute the variance over
+    """
+
+
+def std_over_samples(tensor: TensorMap, sample_names: StrSequence) -> TensorMap:
+    """
+    Compute the standard deviation of the values of all blocks in ``tensor``
+    over the given ``sample_names``. This is a native TorchScript
+    implementation of
+    :py:func:`equistore.operations.reduce_over_samples.std_over_samples`.
+
+    :param tensor: input :py:class:`TensorMap`
+    :param sample_names: names of samples to compute the standard deviation
+        over
+    """
+
+
+def slice(tensor: TensorMap, axis: str, labels: Labels) -> TensorMap:
+    """
+    Slice all the blocks in ``tensor`` along the given ``axis``, only keeping
+    the entries matching one of the entries in ``labels``. This is a native
+    TorchScript implementation of :py:func:`equistore.slice`.
+
+    :param tensor: input :py:class:`TensorMap`
+    :param axis: either ``"samples"`` or ``"properties"``
+    :param labels: entries to keep, with a subset of the dimensions of the
+        corresponding axis
+    """
+
+
+def join(tensors: List[TensorMap], axis: str) -> TensorMap:
+    """
+    Join a list of :py:class:`TensorMap` with the same keys along the given
+    ``axis``. This is a native TorchScript implementation of
+    :py:func:`equistore.join`.
+
+    :param tensors: list of :py:class:`TensorMap` to join
+    :param axis: either ``"samples"`` or ``"properties"``
+    """
@@ -312,6 +312,42 @@ def test_to():
         assert labels.values.device.type == torch.device(device).type
 
 
+def test_positions():
+    labels = Labels(names=("a", "b"), values=torch.IntTensor([[0, 0], [0, 1]]))
+
+    entries = torch.IntTensor([[0, 1], [1, 0], [0, 0]])
+    positions = labels.positions(entries)
+    assert positions.dtype == torch.int64
+    assert torch.all(positions == torch.tensor([1, -1, 0]))
+
+    message = "entries passed to Labels::positions must be a 2D Tensor"
+    with pytest.raises(ValueError, match=message):
+        labels.positions(torch.IntTensor([0, 1]))
+
+
+def test_deferred():
+    labels = Labels.deferred(names=("a", "b"), values=torch.IntTensor([[0, 0], [0, 0]]))
+    assert len(labels) == 2
+    assert labels.names == ["a", "b"]
+    assert not labels.has_unique_entries()
+
+    message = "can not have the same label value multiple time"
+    with pytest.raises(RuntimeError, match=message):
+        labels.position([0, 0])
+
+    labels = Labels.deferred(names=("a", "b"), values=torch.IntTensor([[0, 0], [0, 1]]))
+    assert labels.has_unique_entries()
+    assert labels.position([0, 1]) == 1
+    assert labels == Labels(names=("a", "b"), values=torch.IntTensor([[0, 0], [0, 1]]))
+
+    if torch.cuda.is_available():
+        values = torch.IntTensor([[0, 0], [0, 1]]).to("cuda")
+        labels = Labels.deferred(names=("a", "b"), values=values)
+        unique = labels.has_unique_entries()
+        assert unique.device.type == "cuda"
+        assert unique
+
+
 def test_position():
     labels = Labels(names=("a", "b"), values=torch.IntTensor([[0, 0], [0, 1]]))
 
@@ -367,6 +403,22 @@ def test_union():
     assert torch.all(second_mapping == torch.LongTensor([2, 1, 3]))
 
 
+def test_union_many():
+    first = Labels(["aa", "bb"], torch.IntTensor([[0, 1], [1, 2]]))
+    second = Labels(["aa", "bb"], torch.IntTensor([[2, 3], [1, 2], [4, 5]]))
+    third = Labels(["aa", "bb"], torch.IntTensor([[4, 5], [6, 7]]))
+
+    union = Labels.union_many([first, second, third])
+    assert union == first.union(second).union(third)
+
+    union_2, mappings = Labels.union_many_and_mapping([first, second, third])
+    assert union == union_2
+    assert len(mappings) == 3
+    assert torch.all(mappings[0] == torch.LongTensor([0, 1]))
+    assert torch.all(mappings[1] == torch.LongTensor([2, 1, 3]))
+    assert torch.all(mappings[2] == torch.LongTensor([3, 4]))
+
+
 def test_intersection():
     first = Labels(["aa", "bb"], torch.IntTensor([[0, 1], [1, 2]]))
     second = Labels(["aa", "bb"], torch.IntTensor([[2, 3], [1, 2], [4, 5]]))
@@ -0,0 +1,102 @@
+import pytest
+import torch
+
+import equistore.torch
+from equistore.torch import Labels, TensorMap
+
+from . import utils
+
+
+@pytest.fixture
+def tensor():
+    return utils.tensor()
+
+
+def test_add(tensor):
+    result = equistore.torch.add(tensor, 3.0)
+    assert result.keys == tensor.keys
+
+    for key, block in result.items():
+        expected = tensor.block(key)
+        assert block.samples == expected.samples
+        assert torch.all(block.values == expected.values + 3.0)
+
+        gradient = block.gradient("g")
+        assert torch.all(gradient.values == expected.gradient("g").values)
+
+    result = equistore.torch.add(tensor, tensor)
+    for key, block in result.items():
+        expected = tensor.block(key)
+        assert torch.all(block.values == 2 * expected.values)
+
+        gradient = block.gradient("g")
+        assert torch.all(gradient.values == 2 * expected.gradient("g").values)
+
+    message = "B should be a TensorMap or a scalar value in add"
+    with pytest.raises(TypeError, match=message):
+        equistore.torch.add(tensor, "not a tensor")
+
+
+def test_multiply(tensor):
+    result = equistore.torch.multiply(tensor, 2)
+    for key, block in result.items():
+        expected = tensor.block(key)
+        assert torch.all(block.values == 2 * expected.values)
+
+        gradient = block.gradient("g")
+        assert torch.all(gradient.values == 2 * expected.gradient("g").values)
+
+
+def test_sum_over_samples(tensor):
+    result = equistore.torch.sum_over_samples(tensor, "s")
+    for key, block in result.items():
+        assert block.samples == Labels(["_"], torch.IntTensor([[0]]))
+
+        expected = torch.sum(tensor.block(key).values, dim=0, keepdim=True)
+        assert torch.allclose(block.values, expected)
+
+    message = "one of the requested sample name \\(foo\\) is not part of this TensorMap"
+    with pytest.raises(ValueError, match=message):
+        equistore.torch.sum_over_samples(tensor, ["foo"])
+
+
+def test_slice(tensor):
+    samples = Labels(["s"], torch.IntTensor([[0], [2]]))
+    result = equistore.torch.slice(tensor, "samples", samples)
+
+    for key, block in result.items():
+        s = tensor.block(key).samples.values[:, 0]
+        kept = torch.logical_or(s == 0, s == 2)
+        assert torch.all(block.values == tensor.block(key).values[kept])
+
+    message = "`axis`: components is not known as a slicing axis"
+    with pytest.raises(ValueError, match=message):
+        equistore.torch.slice(tensor, "components", samples)
+
+
+def test_join(tensor):
+    result = equistore.torch.join([tensor, tensor], "samples")
+    assert result.keys == tensor.keys
+
+    for key, block in result.items():
+        assert block.samples.names == ["s", "tensor"]
+        assert len(block.samples) == 2 * len(tensor.block(key).samples)
+
+
+def test_script():
+    class TestModule(torch.nn.Module):
+        def forward(self, x: TensorMap) -> TensorMap:
+            x = equistore.torch.multiply(x, 3.0)
+            x = equistore.torch.add(x, x)
+            return equistore.torch.sum_over_samples(x, "s")
+
+    module = TestModule()
+    module = torch.jit.script(module)
+
+    tensor = utils.tensor()
+    result = module(tensor)
+    expected = equistore.torch.sum_over_samples(
+        equistore.torch.multiply(tensor, 6.0), "s"
+    )
+    for key, block in result.items():
+        assert torch.allclose(block.values, expected.block(key).values)
@@ -1,3 +1,4 @@
+import io
 import os
 
 import torch
@@ -42,6 +43,47 @@ def test_load():
     check_tensor(loaded)
 
 
+def test_load_lazy():
+    lazy = equistore.torch.load_lazy(
+        os.path.join(
+            os.path.dirname(__file__),
+            "..",
+            "..",
+            "..",
+            "equistore",
+            "tests",
+            "data.npz",
+        ),
+        max_blocks=2,
+    )
+
+    assert len(lazy) == 27
+    assert lazy.loaded_blocks() == 0
+
+    selection = equistore.torch.Labels(
+        names=["spherical_harmonics_l", "center_species", "neighbor_species"],
+        values=torch.tensor([[2, 6, 1]]),
+    )
+    matching = lazy.blocks_matching(selection)
+    assert len(matching) == 1
+    assert lazy.loaded_blocks() == 0
+
+    block = lazy.block_by_id(matching[0])
+    assert block.samples.names == ["structure", "center"]
+    assert block.values.shape == (9, 5, 3)
+    assert lazy.loaded_blocks() == 1
+
+    lazy.block_by_id(0)
+    lazy.block_by_id(1)
+    assert lazy.loaded_blocks() == 2
+
+    # blocks released from memory stay valid
+    assert block.values.shape == (9, 5, 3)
+
+    lazy.clear()
+    assert lazy.loaded_blocks() == 0
+
+
 def test_save(tmpdir):
     """Check that we can save and load a tensor to a file"""
     tmpfile = "serialize-test.npz"
@@ -55,6 +97,72 @@ def test_save(tmpdir):
     assert len(data.keys) == 4
 
 
+def test_save_load_float32(tmpdir):
+    """Check that the data is loaded with the same dtype it was saved with"""
+    tmpfile = "serialize-test-f32.npz"
+
+    tensor = utils.tensor(dtype=torch.float32)
+
+    with tmpdir.as_cwd():
+        equistore.torch.save(tmpfile, tensor)
+        data = equistore.torch.load(tmpfile)
+
+    for key, block in tensor.items():
+        loaded_block = data.block(key)
+        assert loaded_block.values.dtype == torch.float32
+        assert torch.all(loaded_block.values == block.values)
+
+
+def test_save_load_device(tmpdir):
+    """Check that we can save and load a tensor directly on a device"""
+    tmpfile = "serialize-test.npz"
+
+    devices = ["cpu"]
+    if torch.cuda.is_available():
+        devices.append("cuda")
+
+    for device in devices:
+        tensor = utils.tensor(dtype=torch.float64)
+        blocks = []
+        for block in tensor.blocks():
+            new_block = equistore.torch.TensorBlock(
+                values=block.values.to(device),
+                samples=block.samples,
+                components=block.components,
+                properties=block.properties,
+            )
+            for parameter, gradient in block.gradients().items():
+                new_block.add_gradient(
+                    parameter,
+                    equistore.torch.TensorBlock(
+                        values=gradient.values.to(device),
+                        samples=gradient.samples,
+                        components=gradient.components,
+                        properties=gradient.properties,
+                    ),
+                )
+            blocks.append(new_block)
+        tensor = equistore.torch.TensorMap(tensor.keys, blocks)
+
+        with tmpdir.as_cwd():
+            equistore.torch.save(tmpfile, tensor)
+            on_cpu = equistore.torch.load(tmpfile)
+            on_device = equistore.torch.load(tmpfile, device=torch.device(device))
+
+        for block, cpu_block, device_block in zip(
+            tensor.blocks(), on_cpu.blocks(), on_device.blocks()
+        ):
+            assert cpu_block.values.device.type == "cpu"
+            assert device_block.values.device.type == device
+            assert torch.all(cpu_block.values == block.values.cpu())
+            assert torch.all(device_block.values == block.values)
+
+            for parameter, gradient in block.gradients().items():
+                device_gradient = device_block.gradient(parameter)
+                assert device_gradient.values.device.type == device
+                assert torch.all(device_gradient.values == gradient.values)
+
+
 def test_pickle(tmpdir):
     tensor = equistore.torch.load(
         os.path.join(
@@ -74,3 +182,71 @@ def test_pickle(tmpdir):
         loaded = torch.load(tmpfile)
 
     check_tensor(loaded)
+
+
+def test_pickle_separate_values():
+    # values are stored as separate tensors in the pickle state, so they do
+    # not need to be float64 as with `save`
+    tensor = utils.tensor(dtype=torch.float32)
+
+    buffer = io.BytesIO()
+    torch.save(tensor, buffer)
+    buffer.seek(0)
+    loaded = torch.load(buffer)
+
+    assert loaded.keys == tensor.keys
+    for key, block in tensor.items():
+        loaded_block = loaded.block(key)
+        assert loaded_block.samples == block.samples
+        assert loaded_block.properties == block.properties
+        assert torch.all(loaded_block.values == block.values)
+
+        assert loaded_block.gradients_list() == block.gradients_list()
+        for parameter, gradient in block.gradients().items():
+            loaded_gradient = loaded_block.gradient(parameter)
+            assert loaded_gradient.samples == gradient.samples
+            assert torch.all(loaded_gradient.values == gradient.values)
+
+    labels = tensor.keys
+    buffer = io.BytesIO()
+    torch.save(labels, buffer)
+    buffer.seek(0)
+    assert torch.load(buffer) == labels
+
+
+def test_pickle_gradients_of_gradients():
+    block = equistore.torch.TensorBlock(
+        values=torch.full((3, 2), 11.0),
+        samples=equistore.torch.Labels.range("s", 3),
+        components=[],
+        properties=equistore.torch.Labels.range("p", 2),
+    )
+
+    gradient = equistore.torch.TensorBlock(
+        values=torch.full((1, 2), 1.0),
+        samples=equistore.torch.Labels(["sample", "g"], torch.tensor([[0, 1]])),
+        components=[],
+        properties=block.properties,
+    )
+    gradient.add_gradient(
+        "h",
+        equistore.torch.TensorBlock(
+            values=torch.full((1, 2), 2.0),
+            samples=equistore.torch.Labels(["sample", "h"], torch.tensor([[0, 3]])),
+            components=[],
+            properties=block.properties,
+        ),
+    )
+    block.add_gradient("g", gradient)
+
+    buffer = io.BytesIO()
+    torch.save(block, buffer)
+    buffer.seek(0)
+    loaded = torch.load(buffer)
+
+    assert loaded.gradients_list() == ["g"]
+    assert loaded.gradient("g").gradients_list() == ["h"]
+
+    nested = loaded.gradient("g").gradient("h")
+    assert nested.samples == block.gradient("g").gradient("h").samples
+    assert torch.all(nested.values == 2.0)
@@ -347,6 +347,30 @@ def test_components_to_properties(tensor):
     assert tuple(block.properties.values[2]) == (2, 0)
 
 
+def test_join_samples(tensor):
+    joined = TensorMap.join_samples([tensor, tensor], 1)
+    assert joined.keys == tensor.keys
+
+    block = joined.block_by_id(0)
+    assert block.samples.names == ["s", "tensor"]
+    assert block.samples.values.tolist() == [
+        [0, 0],
+        [2, 0],
+        [4, 0],
+        [0, 1],
+        [2, 1],
+        [4, 1],
+    ]
+    assert torch.all(block.values == 1.0)
+
+    gradient = block.gradient("g")
+    assert gradient.samples.values[:, 0].tolist() == [0, 2, 3, 5]
+
+    parallel = TensorMap.join_samples([tensor, tensor], 0)
+    for key, block in joined.items():
+        assert torch.all(parallel.block(key).values == block.values)
+
+
 def test_empty_tensor():
     empty_tensor = TensorMap(keys=Labels.empty(["key"]), blocks=[])
 